@@ -0,0 +1,335 @@
+/*
+ * mkadf 1.0
+ *
+ * creates a dump from a directory tree in one pass, with adfBuildImage()
+ *
+ * tested under Linux
+ */
+
+#define MKADF_VERSION "1.0"
+
+#include<stdio.h>
+#include<stdlib.h>
+#include<string.h>
+#include<time.h>
+#include<sys/types.h>
+#include<sys/stat.h>
+
+#ifdef WIN32
+#include<windows.h>
+#define DIRSEP '\\'
+#else
+#include<dirent.h>
+#define DIRSEP '/'
+#endif /* WIN32 */
+
+#include "adflib.h"
+
+
+/* the file read by readHost() */
+FILE *curFile = NULL;
+struct BuildNode *curNode = NULL;
+
+/* SOURCE_DATE_EPOCH : no date after this one */
+time_t maxDate = 0;
+
+
+void help()
+{
+    puts("mkadf [-oicH -s n -n name -b bootfile] srcdir dumpname.adf");
+    puts("    -o : OFS volume (FFS by default)");
+    puts("    -i : international mode");
+    puts("    -c : directory cache mode");
+    putchar('\n');
+    puts("    -H : high density floppy, 3520 blocks (1760 by default)");
+    puts("    -s n : hardfile of n blocks");
+    puts("    -n name : volume name");
+    puts("    -b bootfile : 1024 bytes of boot block code");
+    putchar('\n');
+    puts("    the dates newer than $SOURCE_DATE_EPOCH are set to it");
+}
+
+
+/*
+ * hostDate
+ *
+ */
+struct DateTime hostDate(time_t t)
+{
+    struct DateTime dt;
+    struct tm *tm;
+
+    if (maxDate!=0 && t>maxDate)
+        t = maxDate;
+    tm = maxDate!=0 ? gmtime(&t) : localtime(&t);
+    /* the Amiga dates start in 1978 */
+    if (tm==NULL || tm->tm_year<78) {
+        dt.year = 78; dt.mon = 1; dt.day = 1;
+        dt.hour = dt.min = dt.sec = 0;
+        return dt;
+    }
+    dt.year = tm->tm_year;
+    dt.mon = tm->tm_mon+1;
+    dt.day = tm->tm_mday;
+    dt.hour = tm->tm_hour;
+    dt.min = tm->tm_min;
+    dt.sec = tm->tm_sec;
+
+    return dt;
+}
+
+
+/*
+ * newNode
+ *
+ * 'path' is kept by the node, to read the file later
+ */
+struct BuildNode* newNode(char *path, char *name, struct BuildNode *next)
+{
+    struct BuildNode *node;
+    struct stat st;
+
+    if (strlen(name)>MAXNAMELEN) {
+        fprintf(stderr, "'%s' : name too long, skipped.\n", path);
+        free(path);
+        return next;
+    }
+    if (stat(path, &st)!=0 || (!S_ISDIR(st.st_mode) && !S_ISREG(st.st_mode))) {
+        fprintf(stderr, "'%s' : not a file or a directory, skipped.\n", path);
+        free(path);
+        return next;
+    }
+
+    node = (struct BuildNode*)calloc(1, sizeof(struct BuildNode));
+    if (!node) { fprintf(stderr,"malloc error\n"); exit(1); }
+    node->name = strdup(name);
+    node->user = path;
+    node->date = hostDate(st.st_mtime);
+    node->next = next;
+    if (S_ISDIR(st.st_mode))
+        node->type = ST_DIR;
+    else {
+        node->type = ST_FILE;
+        node->size = st.st_size;
+        /* not writable */
+        if (!(st.st_mode & S_IWUSR))
+            node->access = ACCMASK_W | ACCMASK_D;
+    }
+
+    return node;
+}
+
+
+/*
+ * readTree
+ *
+ * the entries of a host directory, and their subdirectories
+ */
+struct BuildNode* readTree(char *dirname)
+{
+    struct BuildNode *first, *node;
+    char *path;
+#ifdef WIN32
+    WIN32_FIND_DATA fd;
+    HANDLE h;
+#else
+    DIR *dir;
+    struct dirent *de;
+#endif
+
+    first = NULL;
+#ifdef WIN32
+    path = (char*)malloc(strlen(dirname)+3);
+    if (!path) { fprintf(stderr,"malloc error\n"); exit(1); }
+    sprintf(path, "%s%c*", dirname, DIRSEP);
+    h = FindFirstFile(path, &fd);
+    free(path);
+    if (h==INVALID_HANDLE_VALUE) {
+        fprintf(stderr, "can't read '%s'.\n", dirname);
+        return NULL;
+    }
+    do {
+        if (strcmp(fd.cFileName,".")==0 || strcmp(fd.cFileName,"..")==0)
+            continue;
+        path = (char*)malloc(strlen(dirname)+strlen(fd.cFileName)+2);
+        if (!path) { fprintf(stderr,"malloc error\n"); exit(1); }
+        sprintf(path, "%s%c%s", dirname, DIRSEP, fd.cFileName);
+        first = newNode(path, fd.cFileName, first);
+    }while(FindNextFile(h, &fd));
+    FindClose(h);
+#else
+    dir = opendir(dirname);
+    if (!dir) {
+        fprintf(stderr, "can't read '%s'.\n", dirname);
+        return NULL;
+    }
+    while((de=readdir(dir))!=NULL) {
+        if (strcmp(de->d_name,".")==0 || strcmp(de->d_name,"..")==0)
+            continue;
+        path = (char*)malloc(strlen(dirname)+strlen(de->d_name)+2);
+        if (!path) { fprintf(stderr,"malloc error\n"); exit(1); }
+        sprintf(path, "%s%c%s", dirname, DIRSEP, de->d_name);
+        first = newNode(path, de->d_name, first);
+    }
+    closedir(dir);
+#endif /* WIN32 */
+
+    for(node=first; node; node=node->next)
+        if (node->type==ST_DIR)
+            node->child = readTree((char*)node->user);
+
+    return first;
+}
+
+
+/*
+ * freeTree
+ *
+ */
+void freeTree(struct BuildNode *node)
+{
+    struct BuildNode *next;
+
+    while(node) {
+        next = node->next;
+        freeTree(node->child);
+        free(node->name);
+        free(node->user);
+        free(node);
+        node = next;
+    }
+}
+
+
+/*
+ * readHost
+ *
+ * called by adfBuildImage() for each file, from its start to its end
+ */
+long readHost(struct BuildNode *node, unsigned long pos, long n, unsigned char *buf)
+{
+    if (node!=curNode) {
+        if (curFile)
+            fclose(curFile);
+        curNode = node;
+        curFile = fopen((char*)node->user, "rb");
+        if (!curFile) {
+            fprintf(stderr, "can't open '%s'.\n", (char*)node->user);
+            return -1;
+        }
+    }
+    if (!curFile)
+        return -1;
+    if ((unsigned long)ftell(curFile)!=pos)
+        fseek(curFile, pos, SEEK_SET);
+
+    return fread(buf, 1, n, curFile);
+}
+
+
+int main(int argc, char* argv[])
+{
+    struct BuildImage img;
+    char *srcdir, *dumpname, *bootname, *env;
+    unsigned char bootCode[1024];
+    FILE *boot;
+    time_t now;
+    int i, j;
+    RETCODE rc;
+
+    memset(&img, 0, sizeof(struct BuildImage));
+    img.volType = FSMASK_FFS;
+    img.nbBlocks = 1760;
+    img.volName = "empty";
+    srcdir = dumpname = bootname = NULL;
+
+    fprintf(stderr,"mkADF v%s : directory tree to .ADF, powered by ADFlib (v%s - %s)\n\n",
+        MKADF_VERSION, adfGetVersionNumber(),adfGetVersionDate());
+
+    /* parse options */
+    for(i=1; i<argc; i++) {
+        if (argv[i][0]!='-') {
+            if (srcdir==NULL)
+                srcdir = argv[i];
+            else
+                dumpname = argv[i];
+            continue;
+        }
+        for(j=1; argv[i][j]!='\0'; j++) {
+            switch(argv[i][j]) {
+            case 'o':
+                img.volType &= ~FSMASK_FFS;
+                break;
+            case 'i':
+                img.volType |= FSMASK_INTL;
+                break;
+            case 'c':
+                img.volType |= FSMASK_DIRCACHE;
+                break;
+            case 'H':
+                img.nbBlocks = 3520;
+                break;
+            case 's':
+            case 'n':
+            case 'b':
+                if (i+1>=argc || argv[i][j+1]!='\0') {
+                    help();
+                    exit(1);
+                }
+                if (argv[i][j]=='s')
+                    img.nbBlocks = atol(argv[i+1]);
+                else if (argv[i][j]=='n')
+                    img.volName = argv[i+1];
+                else
+                    bootname = argv[i+1];
+                i++;
+                j = strlen(argv[i])-1;
+                break;
+            case 'h':
+            default:
+                help();
+                exit(0);
+            }
+        }
+    }
+    if (srcdir==NULL || dumpname==NULL) {
+        help();
+        exit(1);
+    }
+
+    env = getenv("SOURCE_DATE_EPOCH");
+    if (env!=NULL)
+        maxDate = (time_t)atol(env);
+    time(&now);
+    img.date = hostDate(maxDate!=0 ? maxDate : now);
+
+    if (bootname) {
+        boot = fopen(bootname, "rb");
+        if (!boot || fread(bootCode, 1, 1024, boot)!=1024) {
+            fprintf(stderr, "can't read 1024 bytes from '%s'.\n", bootname);
+            exit(1);
+        }
+        fclose(boot);
+        img.bootCode = bootCode;
+    }
+
+    /* initialize the library */
+    adfEnvInitDefault();
+
+    img.root = readTree(srcdir);
+    img.readFct = readHost;
+    rc = adfBuildImage(&img, dumpname);
+    if (curFile)
+        fclose(curFile);
+    freeTree(img.root);
+
+    adfEnvCleanUp();
+
+    if (rc!=RC_OK) {
+        fprintf(stderr, "can't build '%s'.\n", dumpname);
+        remove(dumpname);
+        exit(1);
+    }
+
+    return 0;
+}
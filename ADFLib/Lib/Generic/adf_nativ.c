@@ -2,17 +2,61 @@
  * adf_nativ.c
  *
  * file
+ *
+ * POSIX native devices : block devices ("/dev/...") and image files accessed
+ * like them ("|path"). Linux opens them with O_DIRECT when it can.
  */
 
+#ifdef __linux__
+#define _GNU_SOURCE		/* O_DIRECT */
+#endif
+
 #include<stdio.h>
 #include<stdlib.h>
 #include<string.h>
+#include<errno.h>
+#include<fcntl.h>
+#include<unistd.h>
+#include<sys/types.h>
+#include<sys/stat.h>
+#include<sys/ioctl.h>
+#ifdef __linux__
+#include<stdint.h>
+#include<linux/fs.h>
+#endif
 #include"adf_str.h"
 #include"adf_nativ.h"
 #include"adf_err.h"
 
+#ifndef O_DIRECT
+#define O_DIRECT 0
+#endif
+
 extern struct Env adfEnv;
 
+
+/*
+ * myOpen
+ *
+ * with O_DIRECT if the device or the filesystem accepts it
+ */
+static int myOpen(struct nativeDevice* nDev, char* name, int flags)
+{
+    nDev->direct = FALSE;
+    if (O_DIRECT!=0) {
+        nDev->handle = open(name, flags|O_DIRECT);
+        if (nDev->handle!=-1) {
+            nDev->direct = TRUE;
+            return nDev->handle;
+        }
+        if (errno!=EINVAL)
+            return -1;
+    }
+    nDev->handle = open(name, flags);
+    return nDev->handle;
+}
+
+
 /*
  * myInitDevice
  *
@@ -21,6 +65,13 @@ extern struct Env adfEnv;
 RETCODE myInitDevice(struct Device* dev, char* name,BOOL ro)
 {
     struct nativeDevice* nDev;
+    struct stat st;
+#ifdef BLKGETSIZE64
+    uint64_t size64;
+#endif
+#ifdef BLKSSZGET
+    int sectSize;
+#endif
 
     nDev = (struct nativeDevice*)dev->nativeDev;
 
@@ -29,27 +80,182 @@ RETCODE myInitDevice(struct Device* dev, char* name,BOOL ro)
         (*adfEnv.eFct)("myInitDevice : malloc");
         return RC_ERROR;
     }
-    dev->nativeDev = nDev;
-    if (!ro)
+    nDev->fd = NULL;
+    nDev->bounce = NULL;
+    nDev->bounceSize = 0;
+    nDev->nextRead = -1;
+    nDev->align = NATIVE_ALIGN;
+
+    /* an image file accessed as a device */
+    if (name[0]=='|')
+        name++;
+
+    dev->readOnly = ro;
+    errno = 0;
+    if (!ro) {
         /* check if device is writable, if not, force readOnly to TRUE */
-        dev->readOnly = FALSE;
+        if (myOpen(nDev, name, O_RDWR)==-1 && (errno==EACCES || errno==EROFS)) {
+            if (myOpen(nDev, name, O_RDONLY)!=-1)
+                (*adfEnv.wFct)("myInitDevice : open, read-only mode forced");
+            dev->readOnly = TRUE;
+        }
+    }
     else
         /* mount device as read only */
-        dev->readOnly = TRUE;
+        myOpen(nDev, name, O_RDONLY);
 
-    dev->size = 0;
+    if (nDev->handle==-1) {
+        free(nDev);
+        (*adfEnv.eFct)("myInitDevice : open");
+        return RC_ERROR;
+    }
 
+    if (fstat(nDev->handle, &st)!=0) {
+        close(nDev->handle); free(nDev);
+        (*adfEnv.eFct)("myInitDevice : fstat");
+        return RC_ERROR;
+    }
+    if (S_ISBLK(st.st_mode)) {
+        dev->size = (ADFOFF)lseek(nDev->handle, 0, SEEK_END);
+#ifdef BLKGETSIZE64
+        if (ioctl(nDev->handle, BLKGETSIZE64, &size64)==0)
+            dev->size = (ADFOFF)size64;
+#endif
+#ifdef BLKSSZGET
+        if (ioctl(nDev->handle, BLKSSZGET, &sectSize)==0 && sectSize>=NATIVE_ALIGN)
+            nDev->align = sectSize;
+#endif
+    }
+    else
+        dev->size = (ADFOFF)st.st_size;
+
+    dev->nativeDev = nDev;
+
+    return RC_OK;
+}
+
+
+/*
+ * myTransfer
+ *
+ * the whole request, even if the system cuts it
+ */
+static RETCODE myTransfer(struct nativeDevice* nDev, ADFOFF offset, int size,
+    unsigned char* buf, BOOL write)
+{
+    ssize_t r;
+
+    while(size>0) {
+        if (write)
+            r = pwrite(nDev->handle, buf, size, (off_t)offset);
+        else
+            r = pread(nDev->handle, buf, size, (off_t)offset);
+        if (r==-1 && errno==EINTR)
+            continue;
+        if (r<=0)
+            return RC_ERROR;
+        buf += r;
+        offset += r;
+        size -= (int)r;
+    }
     return RC_OK;
 }
 
 
+/*
+ * myAccess
+ *
+ * O_DIRECT wants aligned buffers, offsets and sizes : the other requests
+ * go through nDev->bounce. the borders of an unaligned write are read first
+ */
+static RETCODE myAccess(struct nativeDevice* nDev, ADFOFF offset, int size,
+    unsigned char* buf, BOOL write)
+{
+    ADFOFF start;
+    int len;
+    void *bounce;
+
+    if (!nDev->direct || ((size_t)buf%nDev->align==0
+        && offset%nDev->align==0 && size%nDev->align==0))
+        return myTransfer(nDev, offset, size, buf, write);
+
+    start = offset - offset%nDev->align;
+    len = (int)(((offset+size+nDev->align-1)/nDev->align)*nDev->align - start);
+    if (nDev->bounceSize<len) {
+        free(nDev->bounce);
+        nDev->bounce = NULL;
+        nDev->bounceSize = 0;
+        if (posix_memalign(&bounce, nDev->align, len)!=0) {
+            (*adfEnv.eFct)("myAccess : malloc");
+            return RC_ERROR;
+        }
+        nDev->bounce = (unsigned char*)bounce;
+        nDev->bounceSize = len;
+    }
+
+    if (!write || start!=offset || len!=size)
+        if (myTransfer(nDev, start, len, nDev->bounce, FALSE)!=RC_OK)
+            return RC_ERROR;
+    if (!write) {
+        memcpy(buf, nDev->bounce+(offset-start), size);
+        return RC_OK;
+    }
+    memcpy(nDev->bounce+(offset-start), buf, size);
+    return myTransfer(nDev, start, len, nDev->bounce, TRUE);
+}
+
+
+/*
+ * myRetry
+ *
+ * some filesystems accept O_DIRECT at open() time but not the requests :
+ * the device goes on without it
+ */
+static BOOL myRetry(struct nativeDevice* nDev)
+{
+    int flags;
+
+    if (!nDev->direct || errno!=EINVAL)
+        return FALSE;
+    flags = fcntl(nDev->handle, F_GETFL);
+    if (flags==-1 || fcntl(nDev->handle, F_SETFL, flags&~O_DIRECT)==-1)
+        return FALSE;
+    nDev->direct = FALSE;
+    (*adfEnv.wFct)("myAccess : O_DIRECT refused, buffered access");
+    return TRUE;
+}
+
+
 /*
  * myReadSector
  *
  */
 RETCODE myReadSector(struct Device *dev, long n, int size, unsigned char* buf)
 {
-     return RC_OK;   
+    struct nativeDevice* nDev;
+    ADFOFF offset;
+    RETCODE rc;
+
+    nDev = (struct nativeDevice*)dev->nativeDev;
+    offset = (ADFOFF)512*n;
+
+    rc = myAccess(nDev, offset, size, buf, FALSE);
+    if (rc!=RC_OK && myRetry(nDev))
+        rc = myAccess(nDev, offset, size, buf, FALSE);
+    if (rc!=RC_OK) {
+        (*adfEnv.eFct)("myReadSector : read");
+        return RC_ERROR;
+    }
+
+#ifdef POSIX_FADV_WILLNEED
+    /* sequential reads : the next ones are asked for in advance */
+    if (!nDev->direct && offset==nDev->nextRead)
+        posix_fadvise(nDev->handle, (off_t)(offset+size), NATIVE_READAHEAD,
+            POSIX_FADV_WILLNEED);
+#endif
+    nDev->nextRead = offset+size;
+
+    return RC_OK;
 }
 
 
@@ -59,6 +265,26 @@ RETCODE myReadSector(struct Device *dev, long n, int size, unsigned char* buf)
  */
 RETCODE myWriteSector(struct Device *dev, long n, int size, unsigned char* buf)
 {
+    struct nativeDevice* nDev;
+    ADFOFF offset;
+    RETCODE rc;
+
+    nDev = (struct nativeDevice*)dev->nativeDev;
+    offset = (ADFOFF)512*n;
+
+    if (dev->readOnly) {
+        (*adfEnv.wFct)("myWriteSector : read only device");
+        return RC_ERROR;
+    }
+
+    rc = myAccess(nDev, offset, size, buf, TRUE);
+    if (rc!=RC_OK && myRetry(nDev))
+        rc = myAccess(nDev, offset, size, buf, TRUE);
+    if (rc!=RC_OK) {
+        (*adfEnv.eFct)("myWriteSector : write");
+        return RC_ERROR;
+    }
+
     return RC_OK;
 }
 
@@ -74,6 +300,8 @@ RETCODE myReleaseDevice(struct Device *dev)
 
     nDev = (struct nativeDevice*)dev->nativeDev;
 
+    close(nDev->handle);
+    free(nDev->bounce);
 	free(nDev);
 
     return RC_OK;
@@ -101,9 +329,10 @@ void adfInitNativeFct()
 /*
  * myIsDevNative
  *
+ * "/dev/..." or an image file name beginning with '|'
  */
 BOOL myIsDevNative(char *devName)
 {
-    return (strncmp(devName,"/dev/",5)==0);
+    return (strncmp(devName,"/dev/",5)==0 || devName[0]=='|');
 }
 /*##########################################################################*/
@@ -12,6 +12,11 @@
 
 #define NATIVE_FILE  8001
 
+/* sector size assumed when the device can't tell it */
+#define NATIVE_ALIGN        512
+/* readahead asked for after each sequential read */
+#define NATIVE_READAHEAD    (64*1024)
+
 #ifndef BOOL
 #define BOOL int
 #endif
@@ -21,7 +26,16 @@
 #endif
 
 struct nativeDevice{
-    FILE* fd;
+    FILE* fd;                   /* dump devices, used by adf_dump.c */
+    unsigned char *mem;         /* dumps in memory : the whole image, fd is NULL */
+    struct ExtDump *ext;        /* extended ADF : the track table, used by adf_ext.c */
+
+    int handle;                 /* native devices : file descriptor */
+    BOOL direct;                /* opened with O_DIRECT */
+    int align;                  /* O_DIRECT alignment of buffers, offsets and sizes */
+    unsigned char *bounce;      /* aligned buffer for the other requests */
+    int bounceSize;
+    ADFOFF nextRead;            /* end of the last read, to detect sequential reads */
 };
 
 struct nativeFunctions{
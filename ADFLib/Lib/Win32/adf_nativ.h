@@ -23,6 +23,8 @@
 /*! \brief Native Device Struct */
 struct nativeDevice{
 	FILE *fd;		/*!< A file descriptor. Needed by adf_dump.c.			*/
+	unsigned char *mem;	/*!< The image of a dump in memory, fd is NULL.		*/
+	struct ExtDump *ext;	/*!< An extended ADF : its tracks. Used by adf_ext.c.	*/
 	void *hDrv;		/*!< A handle to a drive opened under NT4, 2k or XP.	*/
 };
 
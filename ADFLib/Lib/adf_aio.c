@@ -0,0 +1,693 @@
+/*
+ *  ADF Library. (C) 1997-2002 Laurent Clevy
+ */
+/*! \file	adf_aio.c
+ *  \brief	Asynchronous block reads.
+ *
+ *	Batches of block reads are given to an engine and come back in the order they complete, which is
+ *	not the order of submission. Under Linux the engine is io_uring when the kernel has it, elsewhere
+ *	a pool of threads doing positional reads. Reads from native devices, and all the reads under
+ *	Win32, are done by adfAioSubmit() itself.
+ */
+
+#include<stdio.h>
+#include<stdlib.h>
+#include<string.h>
+#include<errno.h>
+
+#ifndef _WIN32
+#define AIO_HAVE_THREADS
+#include<pthread.h>
+#include<unistd.h>
+#include<sys/types.h>
+#endif
+
+#if defined(__linux__) && defined(__GNUC__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include<sys/mman.h>
+#include<sys/syscall.h>
+#include<sys/uio.h>
+#include<linux/io_uring.h>
+#ifdef __NR_io_uring_setup
+#define AIO_HAVE_URING
+#endif
+#endif
+#endif
+
+#include"adf_defs.h"
+#include"adf_str.h"
+#include"adf_aio.h"
+#include"adf_disk.h"
+#include"adf_dump.h"
+
+extern struct Env adfEnv;
+
+#ifdef AIO_HAVE_URING
+/* a request being read by the ring */
+struct AioSlot{
+    struct AioRequest *req;
+    struct iovec iov;
+    long done;                      /* bytes already read */
+    int nextFree;
+};
+#endif
+
+struct AsyncIO{
+    int engine;
+    int depth;
+    long inFlight;                  /* submitted, not yet returned by adfAioComplete() */
+    struct AioRequest *queue;       /* waiting for the engine */
+    struct AioRequest *queueTail;
+    struct AioRequest *done;        /* read, in completion order */
+    struct AioRequest *doneTail;
+#ifdef AIO_HAVE_THREADS
+    pthread_t threads[AIO_NBTHREADS];
+    int nbThreads;
+    pthread_mutex_t lock;           /* queue, done and stop */
+    pthread_cond_t work;            /* a request was queued, or stop was set */
+    pthread_cond_t ready;           /* a request was read */
+    BOOL stop;
+#endif
+#ifdef AIO_HAVE_URING
+    int ring;
+    void *sqMap, *cqMap;
+    size_t sqMapSize, cqMapSize;
+    struct io_uring_sqe *sqes;
+    size_t sqesSize;
+    unsigned *sqTail, *sqMask, *sqArray;
+    unsigned *cqHead, *cqTail, *cqMask;
+    struct io_uring_cqe *cqes;
+    struct AioSlot *slots;          /* depth slots */
+    int freeSlot;                   /* first free slot, -1 if all are busy */
+    int busy;
+    int toSubmit;                   /* sqes filled since the last io_uring_enter() */
+#endif
+};
+
+
+/*
+ * adfAioAppend
+ *
+ */
+static void adfAioAppend(struct AioRequest **head, struct AioRequest **tail,
+    struct AioRequest *req)
+{
+    req->next = NULL;
+    if (*head)
+        (*tail)->next = req;
+    else
+        *head = req;
+    *tail = req;
+}
+
+
+/*
+ * adfAioDone
+ *
+ * a request completed in the thread of the caller
+ */
+static void adfAioDone(struct AsyncIO *aio, struct AioRequest *req)
+{
+#ifdef AIO_HAVE_THREADS
+    if (aio->engine==AIO_THREADS) {
+        pthread_mutex_lock(&aio->lock);
+        adfAioAppend(&aio->done, &aio->doneTail, req);
+        pthread_mutex_unlock(&aio->lock);
+        return;
+    }
+#endif
+    adfAioAppend(&aio->done, &aio->doneTail, req);
+}
+
+
+#ifdef AIO_HAVE_THREADS
+
+/*
+ * adfAioRead
+ *
+ */
+static RETCODE adfAioRead(struct AioRequest *req)
+{
+    unsigned char *buf;
+    ADFOFF offset;
+    long left;
+    ssize_t r;
+
+    buf = req->buf;
+    offset = req->offset;
+    left = 512L*req->nb;
+    while(left>0) {
+        r = pread(req->handle, buf, (size_t)left, (off_t)offset);
+        if (r==-1 && errno==EINTR)
+            continue;
+        if (r<=0)
+            return RC_ERROR;
+        buf += r;
+        offset += r;
+        left -= (long)r;
+    }
+    return RC_OK;
+}
+
+
+/*
+ * adfAioWorker
+ *
+ */
+static void* adfAioWorker(void *arg)
+{
+    struct AsyncIO *aio;
+    struct AioRequest *req;
+
+    aio = (struct AsyncIO*)arg;
+    pthread_mutex_lock(&aio->lock);
+    for(;;) {
+        while(!aio->queue && !aio->stop)
+            pthread_cond_wait(&aio->work, &aio->lock);
+        if (!aio->queue)
+            break;
+        req = aio->queue;
+        aio->queue = req->next;
+        pthread_mutex_unlock(&aio->lock);
+
+        req->rc = adfAioRead(req);
+
+        pthread_mutex_lock(&aio->lock);
+        adfAioAppend(&aio->done, &aio->doneTail, req);
+        pthread_cond_signal(&aio->ready);
+    }
+    pthread_mutex_unlock(&aio->lock);
+
+    return NULL;
+}
+
+
+/*
+ * adfAioInitThreads
+ *
+ */
+static RETCODE adfAioInitThreads(struct AsyncIO *aio)
+{
+    if (pthread_mutex_init(&aio->lock, NULL)!=0)
+        return RC_ERROR;
+    if (pthread_cond_init(&aio->work, NULL)!=0) {
+        pthread_mutex_destroy(&aio->lock);
+        return RC_ERROR;
+    }
+    if (pthread_cond_init(&aio->ready, NULL)!=0) {
+        pthread_cond_destroy(&aio->work);
+        pthread_mutex_destroy(&aio->lock);
+        return RC_ERROR;
+    }
+    aio->stop = FALSE;
+    aio->engine = AIO_THREADS;
+    for(aio->nbThreads=0; aio->nbThreads<AIO_NBTHREADS; aio->nbThreads++)
+        if (pthread_create(&aio->threads[aio->nbThreads], NULL, adfAioWorker, aio)!=0)
+            break;
+    if (aio->nbThreads>0)
+        return RC_OK;
+
+    pthread_cond_destroy(&aio->ready);
+    pthread_cond_destroy(&aio->work);
+    pthread_mutex_destroy(&aio->lock);
+    return RC_ERROR;
+}
+
+
+/*
+ * adfAioFreeThreads
+ *
+ * the requests which are not started are dropped
+ */
+static void adfAioFreeThreads(struct AsyncIO *aio)
+{
+    int i;
+
+    pthread_mutex_lock(&aio->lock);
+    aio->queue = NULL;
+    aio->stop = TRUE;
+    pthread_cond_broadcast(&aio->work);
+    pthread_mutex_unlock(&aio->lock);
+
+    for(i=0; i<aio->nbThreads; i++)
+        pthread_join(aio->threads[i], NULL);
+
+    pthread_cond_destroy(&aio->ready);
+    pthread_cond_destroy(&aio->work);
+    pthread_mutex_destroy(&aio->lock);
+}
+
+#endif /* AIO_HAVE_THREADS */
+
+
+#ifdef AIO_HAVE_URING
+
+/*
+ * adfAioFreeUring
+ *
+ */
+static void adfAioFreeUring(struct AsyncIO *aio)
+{
+    if (aio->sqes)
+        munmap(aio->sqes, aio->sqesSize);
+    if (aio->cqMap && aio->cqMap!=aio->sqMap)
+        munmap(aio->cqMap, aio->cqMapSize);
+    if (aio->sqMap)
+        munmap(aio->sqMap, aio->sqMapSize);
+    close(aio->ring);
+    free(aio->slots);
+}
+
+
+/*
+ * adfAioMap
+ *
+ */
+static void* adfAioMap(int ring, size_t size, off_t offset)
+{
+    void *p;
+
+    p = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, ring, offset);
+    return p==MAP_FAILED ? NULL : p;
+}
+
+
+/*
+ * adfAioInitUring
+ *
+ * RC_ERROR if the kernel doesn't have io_uring, or refuses it
+ */
+static RETCODE adfAioInitUring(struct AsyncIO *aio)
+{
+    struct io_uring_params p;
+    unsigned char *sq, *cq;
+    int i;
+
+    memset(&p, 0, sizeof(p));
+    aio->ring = (int)syscall(__NR_io_uring_setup, (unsigned)aio->depth, &p);
+    if (aio->ring<0)
+        return RC_ERROR;
+
+    aio->sqMap = aio->cqMap = NULL;
+    aio->sqes = NULL;
+    aio->slots = NULL;
+    aio->sqMapSize = p.sq_off.array + p.sq_entries*sizeof(unsigned);
+    aio->cqMapSize = p.cq_off.cqes + p.cq_entries*sizeof(struct io_uring_cqe);
+    aio->sqesSize = p.sq_entries*sizeof(struct io_uring_sqe);
+#ifdef IORING_FEAT_SINGLE_MMAP
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        if (aio->cqMapSize>aio->sqMapSize)
+            aio->sqMapSize = aio->cqMapSize;
+        aio->cqMapSize = aio->sqMapSize;
+    }
+#endif
+    aio->sqMap = adfAioMap(aio->ring, aio->sqMapSize, IORING_OFF_SQ_RING);
+    if (aio->sqMap) {
+#ifdef IORING_FEAT_SINGLE_MMAP
+        if (p.features & IORING_FEAT_SINGLE_MMAP)
+            aio->cqMap = aio->sqMap;
+        else
+#endif
+            aio->cqMap = adfAioMap(aio->ring, aio->cqMapSize, IORING_OFF_CQ_RING);
+    }
+    if (aio->cqMap)
+        aio->sqes = (struct io_uring_sqe*)adfAioMap(aio->ring, aio->sqesSize, IORING_OFF_SQES);
+    aio->depth = (int)p.sq_entries;
+    if (aio->sqes)
+        aio->slots = (struct AioSlot*)malloc(aio->depth*sizeof(struct AioSlot));
+    if (!aio->slots) {
+        adfAioFreeUring(aio);
+        return RC_ERROR;
+    }
+
+    sq = (unsigned char*)aio->sqMap;
+    aio->sqTail = (unsigned*)(sq+p.sq_off.tail);
+    aio->sqMask = (unsigned*)(sq+p.sq_off.ring_mask);
+    aio->sqArray = (unsigned*)(sq+p.sq_off.array);
+    cq = (unsigned char*)aio->cqMap;
+    aio->cqHead = (unsigned*)(cq+p.cq_off.head);
+    aio->cqTail = (unsigned*)(cq+p.cq_off.tail);
+    aio->cqMask = (unsigned*)(cq+p.cq_off.ring_mask);
+    aio->cqes = (struct io_uring_cqe*)(cq+p.cq_off.cqes);
+
+    for(i=0; i<aio->depth; i++)
+        aio->slots[i].nextFree = i+1<aio->depth ? i+1 : -1;
+    aio->freeSlot = 0;
+    aio->busy = 0;
+    aio->toSubmit = 0;
+    aio->engine = AIO_URING;
+
+    return RC_OK;
+}
+
+
+/*
+ * adfAioQueueSqe
+ *
+ * asks the ring to read what is left of the slot 'n'
+ */
+static void adfAioQueueSqe(struct AsyncIO *aio, int n)
+{
+    struct AioSlot *slot;
+    struct io_uring_sqe *sqe;
+    unsigned tail, index;
+
+    slot = &aio->slots[n];
+    slot->iov.iov_base = slot->req->buf + slot->done;
+    slot->iov.iov_len = (size_t)(512L*slot->req->nb - slot->done);
+
+    tail = *aio->sqTail;
+    index = tail & *aio->sqMask;
+    sqe = &aio->sqes[index];
+    memset(sqe, 0, sizeof(struct io_uring_sqe));
+    sqe->opcode = IORING_OP_READV;
+    sqe->fd = slot->req->handle;
+    sqe->off = (__u64)(slot->req->offset + slot->done);
+    sqe->addr = (__u64)(size_t)&slot->iov;
+    sqe->len = 1;
+    sqe->user_data = (__u64)n;
+    aio->sqArray[index] = index;
+    __atomic_store_n(aio->sqTail, tail+1, __ATOMIC_RELEASE);
+    aio->toSubmit++;
+}
+
+
+/*
+ * adfAioEnter
+ *
+ * submits the filled sqes, and if 'wait' is TRUE, waits for one completion
+ */
+static RETCODE adfAioEnter(struct AsyncIO *aio, BOOL wait)
+{
+    long r;
+
+    do {
+        r = syscall(__NR_io_uring_enter, aio->ring, (unsigned)aio->toSubmit,
+            wait ? 1U : 0U, wait ? IORING_ENTER_GETEVENTS : 0U, NULL, 0);
+    }while(r==-1 && errno==EINTR);
+    if (r==-1)
+        return RC_ERROR;
+    aio->toSubmit -= (int)r;
+
+    return RC_OK;
+}
+
+
+/*
+ * adfAioStart
+ *
+ * gives the queued requests to the free slots
+ */
+static void adfAioStart(struct AsyncIO *aio)
+{
+    struct AioRequest *req;
+    int n;
+
+    while(aio->queue && aio->freeSlot!=-1) {
+        req = aio->queue;
+        aio->queue = req->next;
+        n = aio->freeSlot;
+        aio->freeSlot = aio->slots[n].nextFree;
+        aio->busy++;
+        aio->slots[n].req = req;
+        aio->slots[n].done = 0;
+        adfAioQueueSqe(aio, n);
+    }
+}
+
+
+/*
+ * adfAioReap
+ *
+ * moves the completed reads to aio->done. short reads are asked again
+ */
+static void adfAioReap(struct AsyncIO *aio)
+{
+    struct io_uring_cqe *cqe;
+    struct AioSlot *slot;
+    unsigned head, tail;
+    long left;
+    int n;
+
+    head = *aio->cqHead;
+    tail = __atomic_load_n(aio->cqTail, __ATOMIC_ACQUIRE);
+    while(head!=tail) {
+        cqe = &aio->cqes[head & *aio->cqMask];
+        head++;
+        n = (int)cqe->user_data;
+        slot = &aio->slots[n];
+        left = 512L*slot->req->nb - slot->done;
+        if (cqe->res>0 && cqe->res<left) {
+            slot->done += cqe->res;
+            adfAioQueueSqe(aio, n);
+            continue;
+        }
+        slot->req->rc = cqe->res==left ? RC_OK : RC_ERROR;
+        adfAioAppend(&aio->done, &aio->doneTail, slot->req);
+        slot->nextFree = aio->freeSlot;
+        aio->freeSlot = n;
+        aio->busy--;
+    }
+    __atomic_store_n(aio->cqHead, head, __ATOMIC_RELEASE);
+}
+
+
+/*
+ * adfAioPollUring
+ *
+ */
+static RETCODE adfAioPollUring(struct AsyncIO *aio, BOOL wait)
+{
+    for(;;) {
+        adfAioStart(aio);
+        if (aio->toSubmit>0 && adfAioEnter(aio, FALSE)!=RC_OK)
+            return RC_ERROR;
+        adfAioReap(aio);
+        if (aio->done || !wait || aio->busy==0)
+            return RC_OK;
+        if (adfAioEnter(aio, TRUE)!=RC_OK)
+            return RC_ERROR;
+    }
+}
+
+#endif /* AIO_HAVE_URING */
+
+
+/*
+ * adfAioOpen
+ */
+/*!	\brief	Start an asynchronous I/O engine.
+ *	\param	depth  - the number of reads the engine does at the same time, 0 for AIO_DEPTH.
+ *	\param	engine - AIO_ANY, AIO_URING, AIO_THREADS or AIO_SYNC.
+ *	\return	The engine, or NULL if the requested engine isn't available.
+ *
+ *	One engine serves any number of volumes and devices. AIO_ANY takes io_uring, then the pool of
+ *	threads, then AIO_SYNC.
+ */
+struct AsyncIO* adfAioOpen(int depth, int engine)
+{
+    struct AsyncIO *aio;
+
+    aio = (struct AsyncIO*)malloc(sizeof(struct AsyncIO));
+    if (!aio) {
+        (*adfEnv.eFct)("adfAioOpen : malloc");
+        return NULL;
+    }
+    aio->depth = depth>0 ? depth : AIO_DEPTH;
+    aio->inFlight = 0;
+    aio->queue = aio->queueTail = NULL;
+    aio->done = aio->doneTail = NULL;
+
+#ifdef AIO_HAVE_URING
+    if ((engine==AIO_ANY || engine==AIO_URING) && adfAioInitUring(aio)==RC_OK)
+        return aio;
+#endif
+#ifdef AIO_HAVE_THREADS
+    if ((engine==AIO_ANY || engine==AIO_THREADS) && adfAioInitThreads(aio)==RC_OK)
+        return aio;
+#endif
+    if (engine==AIO_ANY || engine==AIO_SYNC) {
+        aio->engine = AIO_SYNC;
+        return aio;
+    }
+
+    free(aio);
+    (*adfEnv.eFct)("adfAioOpen : engine not available");
+    return NULL;
+}
+
+
+/*
+ * adfAioEngine
+ */
+/*!	\brief	The engine chosen by adfAioOpen().
+ *	\return	AIO_URING, AIO_THREADS or AIO_SYNC.
+ */
+int adfAioEngine(struct AsyncIO *aio)
+{
+    return aio->engine;
+}
+
+
+/*
+ * adfAioSubmit
+ */
+/*!	\brief	Submit a batch of block reads.
+ *	\param	aio - the engine.
+ *	\param	req - an array of requests, whose vol, sect, nb and buf are filled.
+ *	\param	nb  - the number of requests.
+ *	\return	RC_OK, or RC_ERROR if a request is out of its volume.
+ *
+ *	The requests and their buffers belong to the engine until adfAioComplete() returns them.
+ *	A refused request is returned too, with rc set to RC_ERROR. The blocks written with
+ *	adfWriteBlock() before the call are read, the ones written while the request is pending may
+ *	not be. The blocks kept by a session (see adfBeginSession()) are copied when the request
+ *	is returned.
+ */
+RETCODE adfAioSubmit(struct AsyncIO *aio, struct AioRequest *req, int nb)
+{
+    struct AioRequest *r;
+    struct Volume *vol;
+    struct Device *dev;
+    RETCODE rc;
+    int i, handle;
+
+    rc = RC_OK;
+    dev = NULL;
+    handle = -1;
+    for(i=0; i<nb; i++) {
+        r = &req[i];
+        vol = r->vol;
+        r->rc = RC_ERROR;
+        aio->inFlight++;
+
+        if (!vol || !vol->mounted || r->nb<1 || r->sect<0
+            || vol->firstBlock+r->sect+r->nb-1>vol->lastBlock) {
+            (*adfEnv.wFct)("adfAioSubmit : nSect out of range");
+            adfAioDone(aio, r);
+            rc = RC_ERROR;
+            continue;
+        }
+        /* the dump is flushed once for the requests that follow each other on it */
+        if (aio->engine!=AIO_SYNC && !vol->dev->isNativeDev && vol->dev!=dev) {
+            dev = vol->dev;
+            handle = adfDumpHandle(dev);
+        }
+        /* native devices and dumps in memory : no file descriptor */
+        if (aio->engine==AIO_SYNC || vol->dev->isNativeDev || handle==-1) {
+            r->rc = adfReadBlocks(vol, r->sect, r->nb, r->buf);
+            adfAioDone(aio, r);
+            continue;
+        }
+
+        if (adfEnv.useRWAccess) {
+            long j;
+            for(j=0; j<r->nb; j++)
+                (*adfEnv.rwhAccess)(vol->firstBlock+r->sect+j, r->sect+j, FALSE);
+        }
+        r->handle = handle;
+        r->offset = (ADFOFF)512*(vol->firstBlock+r->sect);
+
+#ifdef AIO_HAVE_THREADS
+        if (aio->engine==AIO_THREADS) {
+            pthread_mutex_lock(&aio->lock);
+            adfAioAppend(&aio->queue, &aio->queueTail, r);
+            pthread_cond_signal(&aio->work);
+            pthread_mutex_unlock(&aio->lock);
+            continue;
+        }
+#endif
+        adfAioAppend(&aio->queue, &aio->queueTail, r);
+    }
+
+#ifdef AIO_HAVE_URING
+    if (aio->engine==AIO_URING && adfAioPollUring(aio, FALSE)!=RC_OK) {
+        (*adfEnv.eFct)("adfAioSubmit : io_uring_enter");
+        rc = RC_ERROR;
+    }
+#endif
+
+    return rc;
+}
+
+
+/*
+ * adfAioComplete
+ */
+/*!	\brief	Get the completed requests.
+ *	\param	aio  - the engine.
+ *	\param	done - receives up to max requests.
+ *	\param	max  - size of done[].
+ *	\param	wait - if TRUE and no request is completed yet, wait for one.
+ *	\return	The number of requests put in done[], 0 if there are none, -1 if the engine failed.
+ *
+ *	The requests come in the order they completed. Their rc field tells if the read succeeded.
+ *	The calls with wait==TRUE return 0 only when all the submitted requests have been returned.
+ */
+int adfAioComplete(struct AsyncIO *aio, struct AioRequest **done, int max, BOOL wait)
+{
+    int n, i;
+
+#ifdef AIO_HAVE_URING
+    if (aio->engine==AIO_URING && adfAioPollUring(aio, wait)!=RC_OK) {
+        (*adfEnv.eFct)("adfAioComplete : io_uring_enter");
+        return -1;
+    }
+#endif
+#ifdef AIO_HAVE_THREADS
+    if (aio->engine==AIO_THREADS) {
+        pthread_mutex_lock(&aio->lock);
+        while(!aio->done && wait && aio->inFlight>0)
+            pthread_cond_wait(&aio->ready, &aio->lock);
+    }
+#endif
+
+    for(n=0; n<max && aio->done; n++) {
+        done[n] = aio->done;
+        aio->done = aio->done->next;
+    }
+    aio->inFlight -= n;
+
+#ifdef AIO_HAVE_THREADS
+    if (aio->engine==AIO_THREADS)
+        pthread_mutex_unlock(&aio->lock);
+#endif
+
+    /* the metadata of a session isn't on the disk yet */
+    for(i=0; i<n; i++)
+        if (done[i]->rc==RC_OK && done[i]->vol->nbMeta>0)
+            adfSessionCopy(done[i]->vol, done[i]->sect, done[i]->nb, done[i]->buf);
+
+    return n;
+}
+
+
+/*
+ * adfAioClose
+ */
+/*!	\brief	Stop an engine.
+ *	\param	aio - the engine.
+ *
+ *	The reads in progress are waited for, the requests not started yet are dropped.
+ */
+void adfAioClose(struct AsyncIO *aio)
+{
+#ifdef AIO_HAVE_URING
+    if (aio->engine==AIO_URING) {
+        aio->queue = NULL;
+        while(aio->busy>0) {
+            if (adfAioEnter(aio, TRUE)!=RC_OK)
+                break;
+            adfAioReap(aio);
+        }
+        adfAioFreeUring(aio);
+    }
+#endif
+#ifdef AIO_HAVE_THREADS
+    if (aio->engine==AIO_THREADS)
+        adfAioFreeThreads(aio);
+#endif
+    free(aio);
+}
+
+/*##########################################################################*/
@@ -0,0 +1,25 @@
+#ifndef ADF_AIO_H
+#define ADF_AIO_H 1
+
+/*
+ *  ADF Library. (C) 1997-2002 Laurent Clevy
+ */
+/*! \file	adf_aio.h
+ *  \brief	Asynchronous block reads header.
+ */
+
+#include"prefix.h"
+
+#include"adf_str.h"
+
+#define AIO_DEPTH       64      /* requests given to the engine at once, by default */
+#define AIO_NBTHREADS   4       /* threads of the AIO_THREADS engine */
+
+PREFIX struct AsyncIO* adfAioOpen(int depth, int engine);
+PREFIX int adfAioEngine(struct AsyncIO *aio);
+PREFIX RETCODE adfAioSubmit(struct AsyncIO *aio, struct AioRequest *req, int nb);
+PREFIX int adfAioComplete(struct AsyncIO *aio, struct AioRequest **done, int max, BOOL wait);
+PREFIX void adfAioClose(struct AsyncIO *aio);
+
+#endif /* ADF_AIO_H */
+/*##########################################################################*/
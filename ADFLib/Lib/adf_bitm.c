@@ -24,12 +24,17 @@ extern struct Env adfEnv;
  */
 RETCODE adfUpdateBitmap(struct Volume *vol)
 {
-	int i;
+	int i, j, nb;
     struct bRootBlock root;
+    unsigned char *buf;
 
 #ifdef _DEBUG_PRINTF_
 	printf("adfUpdateBitmap\n");
 #endif /*_DEBUG_PRINTF_*/
+
+    /* written once, by adfCommitSession() */
+    if (vol->session)
+        return RC_OK;
         
     if (adfReadRootBlock(vol, vol->rootBlock,&root)!=RC_OK)
 		return RC_ERROR;
@@ -38,12 +43,34 @@ RETCODE adfUpdateBitmap(struct Volume *vol)
     if (adfWriteRootBlock(vol,vol->rootBlock,&root)!=RC_OK)
 		return RC_ERROR;
 
-    for(i=0; i<vol->bitmapSize; i++)
-    if (vol->bitmapBlocksChg[i]) {
-        if (adfWriteBitmapBlock(vol, vol->bitmapBlocks[i], vol->bitmapTable[i])!=RC_OK)
+    buf = (unsigned char*)malloc(LOGICAL_BLOCK_SIZE*BM_MAXRUN);
+    if (!buf) {
+        (*adfEnv.eFct)("adfUpdateBitmap : malloc");
+        return RC_MALLOC;
+    }
+
+    /* the changed blocks that follow each other on the disk are written at once */
+    i = 0;
+    while(i<vol->bitmapSize) {
+        if (!vol->bitmapBlocksChg[i]) {
+            i++;
+            continue;
+        }
+        nb = 1;
+        while(nb<BM_MAXRUN && i+nb<vol->bitmapSize && vol->bitmapBlocksChg[i+nb]
+            && vol->bitmapBlocks[i+nb]==vol->bitmapBlocks[i]+nb)
+            nb++;
+        for(j=0; j<nb; j++)
+            adfBitmapBlock2Buf(vol->bitmapTable[i+j], buf+j*LOGICAL_BLOCK_SIZE);
+        if (adfWriteBlocks(vol, vol->bitmapBlocks[i], nb, buf)!=RC_OK) {
+            free(buf);
 			return RC_ERROR;
-  	    vol->bitmapBlocksChg[i] = FALSE;
+        }
+        for(j=0; j<nb; j++)
+  	        vol->bitmapBlocksChg[i+j] = FALSE;
+        i += nb;
     }
+    free(buf);
 
     root.bmFlag = BM_VALID;
     adfTime2AmigaTime(adfGiveCurrentTime(),&(root.days),&(root.mins),&(root.ticks));
@@ -54,6 +81,38 @@ RETCODE adfUpdateBitmap(struct Volume *vol)
 }
 
 
+/*
+ * adfSessionBitmap
+ *
+ * at the end of a session, the changed bitmap blocks and the root block with
+ * its new date join the blocks written by adfCommitSession()
+ */
+RETCODE adfSessionBitmap(struct Volume *vol)
+{
+    struct bRootBlock root;
+    BOOL changed;
+    long i;
+
+    changed = FALSE;
+    for(i=0; i<vol->bitmapSize; i++)
+        if (vol->bitmapBlocksChg[i]) {
+            if (adfWriteBitmapBlock(vol, vol->bitmapBlocks[i], vol->bitmapTable[i])!=RC_OK)
+                return RC_ERROR;
+            vol->bitmapBlocksChg[i] = FALSE;
+            changed = TRUE;
+        }
+    if (!changed)
+        return RC_OK;
+
+    if (adfReadRootBlock(vol, vol->rootBlock, &root)!=RC_OK)
+        return RC_ERROR;
+    root.bmFlag = BM_VALID;
+    adfTime2AmigaTime(adfGiveCurrentTime(),&(root.days),&(root.mins),&(root.ticks));
+
+    return adfWriteRootBlock(vol, vol->rootBlock, &root);
+}
+
+
 /* 
  *	adfCountFreeBlocks
  */
@@ -79,24 +138,26 @@ long adfCountFreeBlocks(struct Volume* vol)
 /*
  * adfReadBitmap
  *
+ * only the locations of the bitmap blocks given by the rootblock are noted : the blocks
+ * and the extension blocks are read on first access, by adfGetBitmapBlock()
  */
 RETCODE adfReadBitmap(struct Volume* vol, long nBlock, struct bRootBlock* root)
 {
 	long mapSize, nSect;
-	long j, i;
-	struct bBitmapExtBlock bmExt;
+	long i;
 
     mapSize = nBlock / (127*32);
     if ( (nBlock%(127*32))!=0 )
         mapSize++;
     vol->bitmapSize = mapSize;
+    vol->bitmapData = NULL;
 
-    vol->bitmapTable = (struct bBitmapBlock**) malloc(sizeof(struct bBitmapBlock*)*mapSize);
+    vol->bitmapTable = (struct bBitmapBlock**) calloc(mapSize, sizeof(struct bBitmapBlock*));
     if (!vol->bitmapTable) { 
 		(*adfEnv.eFct)("adfReadBitmap : malloc, vol->bitmapTable");
         return RC_MALLOC;
     }
-	vol->bitmapBlocks = (SECTNUM*) malloc(sizeof(SECTNUM)*mapSize);
+	vol->bitmapBlocks = (SECTNUM*) calloc(mapSize, sizeof(SECTNUM));
     if (!vol->bitmapBlocks) {
         free(vol->bitmapTable);
 		(*adfEnv.eFct)("adfReadBitmap : malloc, vol->bitmapBlocks");
@@ -108,67 +169,116 @@ RETCODE adfReadBitmap(struct Volume* vol, long nBlock, struct bRootBlock* root)
 		(*adfEnv.eFct)("adfReadBitmap : malloc, vol->bitmapBlocks");
         return RC_MALLOC;
     }
-    for(i=0; i<mapSize; i++) {
+    for(i=0; i<mapSize; i++)
         vol->bitmapBlocksChg[i] = FALSE;
 
-		vol->bitmapTable[i] = (struct bBitmapBlock*)malloc(sizeof(struct bBitmapBlock));
-		if (!vol->bitmapTable[i]) {
-            free(vol->bitmapBlocksChg); free(vol->bitmapBlocks);
-            for(j=0; j<i; j++) 
-                free(vol->bitmapTable[j]);
-            free(vol->bitmapTable);
-	        (*adfEnv.eFct)("adfReadBitmap : malloc, vol->bitmapBlocks");
-            return RC_MALLOC;
-        }
-    }
-
-	j=0; i=0;
+    i=0;
     /* bitmap pointers in rootblock : 0 <= i <BM_SIZE */
-	while(i<BM_SIZE && root->bmPages[i]!=0) {
-		vol->bitmapBlocks[j] = nSect = root->bmPages[i];
+	while(i<BM_SIZE && i<mapSize && root->bmPages[i]!=0) {
+		vol->bitmapBlocks[i] = nSect = root->bmPages[i];
         if ( !isSectNumValid(vol,nSect) ) {
 			(*adfEnv.wFct)("adfReadBitmap : sector out of range");
         }
-
-		if (adfReadBitmapBlock(vol, nSect, vol->bitmapTable[j])!=RC_OK) {
-            adfFreeBitmap(vol);
-            return RC_ERROR;
-		}
-		j++; i++;
+		i++;
 	}
-	nSect = root->bmExt;
+    vol->bitmapExt = root->bmExt;
+
+    return RC_OK;
+}
+
+
+/*
+ * adfReadBitmapExt
+ *
+ * completes vol->bitmapBlocks[] with the bitmap extension blocks
+ */
+static RETCODE adfReadBitmapExt(struct Volume* vol)
+{
+	long i, j;
+	SECTNUM nSect;
+	struct bBitmapExtBlock bmExt;
+
+	j=0;
+	while(j<BM_SIZE && j<vol->bitmapSize && vol->bitmapBlocks[j]!=0)
+		j++;
+	nSect = vol->bitmapExt;
 	while(nSect!=0) {
         /* bitmap pointers in bitmapExtBlock, j <= mapSize */
-        if (adfReadBitmapExtBlock(vol, nSect, &bmExt)!=RC_OK) {
-            adfFreeBitmap(vol);
+        if (adfReadBitmapExtBlock(vol, nSect, &bmExt)!=RC_OK)
             return RC_ERROR;
-        }
 		i=0;
-		while(i<127 && j<mapSize) {
+		while(i<127 && j<vol->bitmapSize) {
             nSect = bmExt.bmPages[i];
             if ( !isSectNumValid(vol,nSect) )
                 (*adfEnv.wFct)("adfReadBitmap : sector out of range");
 			vol->bitmapBlocks[j] = nSect;
-
-			if (adfReadBitmapBlock(vol, nSect, vol->bitmapTable[j])!=RC_OK) {
-                adfFreeBitmap(vol);
-                return RC_ERROR;
-            }
 			i++; j++;
 		}
 		nSect = bmExt.nextBlock;
 	}
+    vol->bitmapExt = 0;
 
     return RC_OK;
 }
 
 
+/*
+ * adfGetBitmapBlock
+ *
+ * returns the bitmap block number 'block', read on first access. NULL in case of error
+ */
+struct bBitmapBlock* adfGetBitmapBlock(struct Volume* vol, long block)
+{
+    int i, nb;
+
+    if (block<0 || block>=vol->bitmapSize) {
+        (*adfEnv.wFct)("adfGetBitmapBlock : sector out of range");
+        return NULL;
+    }
+    if (vol->bitmapTable[block]!=NULL)
+        return vol->bitmapTable[block];
+
+    if (vol->bitmapBlocks[block]==0 && vol->bitmapExt!=0)
+        if (adfReadBitmapExt(vol)!=RC_OK)
+            return NULL;
+    if (vol->bitmapBlocks[block]==0) {
+        (*adfEnv.wFct)("adfGetBitmapBlock : bitmap block not found");
+        return NULL;
+    }
+
+    /* room for all the blocks, the first time one is needed */
+    if (vol->bitmapData==NULL) {
+        vol->bitmapData = (struct bBitmapBlock*)malloc(sizeof(struct bBitmapBlock)*vol->bitmapSize);
+        if (!vol->bitmapData) {
+            (*adfEnv.eFct)("adfGetBitmapBlock : malloc");
+            return NULL;
+        }
+    }
+
+    /* the next blocks come with it if they follow on the disk */
+    nb = 1;
+    while(nb<BM_MAXRUN && block+nb<vol->bitmapSize && vol->bitmapTable[block+nb]==NULL
+        && vol->bitmapBlocks[block+nb]==vol->bitmapBlocks[block]+nb)
+        nb++;
+    if (adfReadBlocks(vol, vol->bitmapBlocks[block], nb,
+        (unsigned char*)&(vol->bitmapData[block]))!=RC_OK)
+        return NULL;
+    for(i=0; i<nb; i++) {
+        adfBuf2BitmapBlock((unsigned char*)&(vol->bitmapData[block+i]));
+        vol->bitmapTable[block+i] = &(vol->bitmapData[block+i]);
+    }
+
+    return vol->bitmapTable[block];
+}
+
+
 /*
  * adfIsBlockFree
  *
  */
 BOOL adfIsBlockFree(struct Volume* vol, SECTNUM nSect)
 {
+    struct bBitmapBlock *bm;
     int sectOfMap = nSect-2;
     int block = sectOfMap/(127*32);
     int indexInMap = (sectOfMap/32)%127;
@@ -177,11 +287,16 @@ BOOL adfIsBlockFree(struct Volume* vol, SECTNUM nSect)
 	printf("sect=%d block=%d ind=%d,  ",sectOfMap,block,indexInMap);
 	printf("bit=%d,  ",sectOfMap%32);
 	printf("bitm=%x,  ",bitMask[ sectOfMap%32]);
-	printf("res=%x,  ",vol->bitmapTable[ block ]->map[ indexInMap ]
-			& bitMask[ sectOfMap%32 ]);
 #endif /*_DEBUG_PRINTF_*/
 
-    return ( (vol->bitmapTable[ block ]->map[ indexInMap ]
+    /* the bootblock isn't in the bitmap */
+    if (sectOfMap<0)
+        return FALSE;
+    bm = adfGetBitmapBlock(vol, block);
+    if (!bm)
+        return FALSE;
+
+    return ( (bm->map[ indexInMap ]
         & bitMask[ sectOfMap%32 ])!=0 );
 }
 
@@ -189,9 +304,11 @@ BOOL adfIsBlockFree(struct Volume* vol, SECTNUM nSect)
 /*
  * adfSetBlockFree OK
  *
+ * RC_ERROR if the bitmap block can't be read
  */
-void adfSetBlockFree(struct Volume* vol, SECTNUM nSect)
+RETCODE adfSetBlockFree(struct Volume* vol, SECTNUM nSect)
 {
+    struct bBitmapBlock *bm;
     unsigned long oldValue;
     int sectOfMap = nSect-2;
     int block = sectOfMap/(127*32);
@@ -203,39 +320,51 @@ void adfSetBlockFree(struct Volume* vol, SECTNUM nSect)
 	printf("bitm=%x,  ",bitMask[ sectOfMap%32]);
 #endif /*_DEBUG_PRINTF_*/
 
-    oldValue = vol->bitmapTable[ block ]->map[ indexInMap ];
+    bm = adfGetBitmapBlock(vol, block);
+    if (!bm)
+        return RC_ERROR;
+    oldValue = bm->map[ indexInMap ];
 
 #ifdef _DEBUG_PRINTF_
 	printf("old=%x,  ",oldValue);
 #endif /*_DEBUG_PRINTF_*/
 
-    vol->bitmapTable[ block ]->map[ indexInMap ]
+    bm->map[ indexInMap ]
 	    = oldValue | bitMask[ sectOfMap%32 ];
 
 #ifdef _DEBUG_PRINTF_
-	printf("new=%x,  ",vol->bitmapTable[ block ]->map[ indexInMap ]);
+	printf("new=%x,  ",bm->map[ indexInMap ]);
 #endif /*_DEBUG_PRINTF_*/
 
     vol->bitmapBlocksChg[ block ] = TRUE;
+
+    return RC_OK;
 }
 
 
 /*
  * adfSetBlockUsed
  *
+ * RC_ERROR if the bitmap block can't be read
  */
-void adfSetBlockUsed(struct Volume* vol, SECTNUM nSect)
+RETCODE adfSetBlockUsed(struct Volume* vol, SECTNUM nSect)
 {
+    struct bBitmapBlock *bm;
     unsigned long oldValue;
     int sectOfMap = nSect-2;
     int block = sectOfMap/(127*32);
     int indexInMap = (sectOfMap/32)%127;
 
-    oldValue = vol->bitmapTable[ block ]->map[ indexInMap ];
+    bm = adfGetBitmapBlock(vol, block);
+    if (!bm)
+        return RC_ERROR;
+    oldValue = bm->map[ indexInMap ];
 
-    vol->bitmapTable[ block ]->map[ indexInMap ]
+    bm->map[ indexInMap ]
 	    = oldValue & (~bitMask[ sectOfMap%32 ]);
     vol->bitmapBlocksChg[ block ] = TRUE;
+
+    return RC_OK;
 }
 
 
@@ -285,7 +414,12 @@ BOOL adfGetFreeBlocks(struct Volume* vol, int nbSect, SECTNUM* sectList)
 
     if (!diskFull)
         for(j=0; j<nbSect; j++)
-            adfSetBlockUsed( vol, sectList[j] );
+            if (adfSetBlockUsed( vol, sectList[j] )!=RC_OK) {
+                /* none of them is allocated */
+                while(j-->0)
+                    adfSetBlockFree( vol, sectList[j] );
+                return FALSE;
+            }
 
     return (i==nbSect);
 }
@@ -299,7 +433,7 @@ BOOL adfGetFreeBlocks(struct Volume* vol, int nbSect, SECTNUM* sectList)
 RETCODE adfCreateBitmap(struct Volume *vol)
 {
     long nBlock, mapSize ;
-    int i, j;
+    int i;
 
     nBlock = vol->lastBlock - vol->firstBlock +1 - 2;
 
@@ -328,20 +462,20 @@ RETCODE adfCreateBitmap(struct Volume *vol)
         return RC_MALLOC;
     }
 
-    for(i=0; i<mapSize; i++) {
-        vol->bitmapTable[i] = (struct bBitmapBlock*)malloc(sizeof(struct bBitmapBlock));
-        if (!vol->bitmapTable[i]) {
-            free(vol->bitmapTable); free(vol->bitmapBlocksChg);
-            for(j=0; j<i; j++) 
-                free(vol->bitmapTable[j]);
-            free(vol->bitmapTable);
-			(*adfEnv.eFct)("adfCreateBitmap : malloc");
-            return RC_MALLOC;
-        }
+    /* a new bitmap is all in memory at once */
+    vol->bitmapData = (struct bBitmapBlock*)calloc(mapSize, sizeof(struct bBitmapBlock));
+    if (!vol->bitmapData) {
+        free(vol->bitmapTable); free(vol->bitmapBlocksChg); free(vol->bitmapBlocks);
+        (*adfEnv.eFct)("adfCreateBitmap : malloc");
+        return RC_MALLOC;
     }
+    for(i=0; i<mapSize; i++)
+        vol->bitmapTable[i] = &(vol->bitmapData[i]);
+    vol->bitmapExt = 0;
 
-    for(i=vol->firstBlock+2; i<=(vol->lastBlock - vol->firstBlock); i++)
-        adfSetBlockFree(vol, i);
+    for(i=2; i<=(vol->lastBlock - vol->firstBlock); i++)
+        if (adfSetBlockFree(vol, i)!=RC_OK)
+            return RC_ERROR;
 
     return RC_OK;
 }
@@ -408,9 +542,10 @@ RETCODE adfWriteNewBitmap(struct Volume *vol)
         k = 0;
         root.bmExt = bitExtBlock[ k ];
         while( nBlock<vol->bitmapSize ) {
+            memset(&bitme, 0, sizeof(struct bBitmapExtBlock));
             i=0;
             while( i<127 && nBlock<vol->bitmapSize ) {
-                bitme.bmPages[i] = vol->bitmapBlocks[nBlock] = sectList[i];
+                bitme.bmPages[i] = vol->bitmapBlocks[nBlock] = sectList[nBlock];
                 i++;
                 nBlock++;
             }
@@ -443,37 +578,45 @@ RETCODE adfWriteNewBitmap(struct Volume *vol)
 RETCODE
 adfReadBitmapBlock(struct Volume* vol, SECTNUM nSect, struct bBitmapBlock* bitm)
 {
-	unsigned char buf[LOGICAL_BLOCK_SIZE];
-
 #ifdef _DEBUG_PRINTF_
 	printf("bitmap %ld\n",nSect);
 #endif /*_DEBUG_PRINTF_*/
 
-	if (adfReadBlock(vol, nSect, buf)!=RC_OK)
+	if (adfReadBlock(vol, nSect, (unsigned char*)bitm)!=RC_OK)
 		return RC_ERROR;
 
-	memcpy(bitm, buf, LOGICAL_BLOCK_SIZE);
-#ifdef LITT_ENDIAN
-    /* big to little = 68000 to x86 */
-    swapEndian((unsigned char*)bitm, SWBL_BITMAP);
-#endif
+    adfBuf2BitmapBlock((unsigned char*)bitm);
 
-	if (bitm->checkSum!=adfNormalSum(buf,0,LOGICAL_BLOCK_SIZE))
+    return RC_OK;
+}
+
+
+/*
+ * adfBuf2BitmapBlock
+ *
+ * in place, checks the checksum of a block read from the disk and converts it
+ *
+ * ENDIAN DEPENDENT
+ */
+void adfBuf2BitmapBlock(unsigned char *buf)
+{
+	if ((unsigned long)swapLong(buf)!=adfNormalSum(buf,0,LOGICAL_BLOCK_SIZE))
 		(*adfEnv.wFct)("adfReadBitmapBlock : invalid checksum");
 
-    return RC_OK;
+#ifdef LITT_ENDIAN
+    /* big to little = 68000 to x86 */
+    swapEndian(buf, SWBL_BITMAP);
+#endif
 }
 
 
 /*
- * adfWriteBitmapBlock
+ * adfBitmapBlock2Buf
  *
- * OK
+ * the block as written on the disk, with its checksum
  */
-RETCODE
-adfWriteBitmapBlock(struct Volume* vol, SECTNUM nSect, struct bBitmapBlock* bitm)
+void adfBitmapBlock2Buf(struct bBitmapBlock* bitm, unsigned char *buf)
 {
-    unsigned char buf[LOGICAL_BLOCK_SIZE];
 	unsigned long newSum;
 	
 	memcpy(buf,bitm,LOGICAL_BLOCK_SIZE);
@@ -484,12 +627,26 @@ adfWriteBitmapBlock(struct Volume* vol, SECTNUM nSect, struct bBitmapBlock* bitm
 
 	newSum = adfNormalSum(buf, 0, LOGICAL_BLOCK_SIZE);
     swLong(buf,newSum);
+}
+
+
+/*
+ * adfWriteBitmapBlock
+ *
+ * OK
+ */
+RETCODE
+adfWriteBitmapBlock(struct Volume* vol, SECTNUM nSect, struct bBitmapBlock* bitm)
+{
+    unsigned char buf[LOGICAL_BLOCK_SIZE];
+
+    adfBitmapBlock2Buf(bitm, buf);
 
 #ifdef _DEBUG_PRINTF_
 	dumpBlock((unsigned char*)buf);
 #endif /*_DEBUG_PRINTF_*/
 
-	if (adfWriteBlock(vol, nSect, (unsigned char*)buf)!=RC_OK)
+	if (adfWriteMetaBlock(vol, nSect, (unsigned char*)buf)!=RC_OK)
 		return RC_ERROR;
 
     return RC_OK;
@@ -537,7 +694,7 @@ adfWriteBitmapExtBlock(struct Volume* vol, SECTNUM nSect, struct bBitmapExtBlock
 	dumpBlock((unsigned char*)buf);
 #endif /*_DEBUG_PRINTF_*/
 
-	if (adfWriteBlock(vol, nSect, (unsigned char*)buf)!=RC_OK)
+	if (adfWriteMetaBlock(vol, nSect, (unsigned char*)buf)!=RC_OK)
 		return RC_ERROR;
 
     return RC_OK;
@@ -550,12 +707,11 @@ adfWriteBitmapExtBlock(struct Volume* vol, SECTNUM nSect, struct bBitmapExtBlock
  */
 void adfFreeBitmap(struct Volume* vol)
 {
-    int i;
-
-    for(i=0; i<vol->bitmapSize; i++)
-        free(vol->bitmapTable[i]);
     vol->bitmapSize = 0;
 
+    free(vol->bitmapData);
+	vol->bitmapData = 0;
+
     free(vol->bitmapTable);
 	vol->bitmapTable = 0;
 
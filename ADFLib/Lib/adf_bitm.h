@@ -10,18 +10,24 @@
 #include"adf_str.h"
 #include"prefix.h"
 
+#define BM_MAXRUN   32      /* bitmap blocks read or written with one device access */
+
 RETCODE adfReadBitmapBlock(struct Volume*, SECTNUM nSect, struct bBitmapBlock*);
 RETCODE adfWriteBitmapBlock(struct Volume*, SECTNUM nSect, struct bBitmapBlock*);
+void adfBuf2BitmapBlock(unsigned char *buf);
+void adfBitmapBlock2Buf(struct bBitmapBlock* bitm, unsigned char *buf);
 RETCODE adfReadBitmapExtBlock(struct Volume*, SECTNUM nSect, struct bBitmapExtBlock*);
 RETCODE adfWriteBitmapExtBlock(struct Volume*, SECTNUM, struct bBitmapExtBlock* );
 
 SECTNUM adfGet1FreeBlock(struct Volume *vol);
 RETCODE adfUpdateBitmap(struct Volume *vol);
+RETCODE adfSessionBitmap(struct Volume *vol);
 PREFIX long adfCountFreeBlocks(struct Volume* vol);
 RETCODE adfReadBitmap(struct Volume* , SECTNUM nBlock, struct bRootBlock* root);
+struct bBitmapBlock* adfGetBitmapBlock(struct Volume* vol, long block);
 BOOL adfIsBlockFree(struct Volume* vol, SECTNUM nSect);
-void adfSetBlockFree(struct Volume* vol, SECTNUM nSect);
-void adfSetBlockUsed(struct Volume* vol, SECTNUM nSect);
+RETCODE adfSetBlockFree(struct Volume* vol, SECTNUM nSect);
+RETCODE adfSetBlockUsed(struct Volume* vol, SECTNUM nSect);
 BOOL adfGetFreeBlocks(struct Volume* vol, int nbSect, SECTNUM* sectList);
 RETCODE adfCreateBitmap(struct Volume *vol);
 RETCODE adfWriteNewBitmap(struct Volume *vol);
@@ -0,0 +1,775 @@
+/*
+ *  ADF Library. (C) 1997-2002 Laurent Clevy
+ */
+/*! \file	adf_build.c
+ *  \brief	Offline image builder.
+ *
+ *	A whole tree of entries is written into a new dump in one pass. The layout is planned first :
+ *	the directory and dircache blocks are grouped just before the root block, the root dircache
+ *	and the bitmap. Each file header is followed by its extension and data blocks, from block 2
+ *	up to the end of the volume, around this middle area. Then every block is built in memory
+ *	with its checksum, and written in sector order. The same tree with the same dates always
+ *	gives the same image.
+ */
+
+#include<stdio.h>
+#include<stdlib.h>
+#include<string.h>
+
+#include"adf_defs.h"
+#include"adf_str.h"
+#include"adf_build.h"
+#include"adf_raw.h"
+#include"adf_util.h"
+#include"adf_dir.h"
+#include"adf_file.h"
+#include"adf_cache.h"
+#include"adf_bitm.h"
+#include"defendian.h"
+
+extern unsigned long bitMask[32];
+
+extern struct Env adfEnv;
+
+
+/* one adfBuildImage() call */
+struct BuildState{
+    struct BuildImage *img;
+    FILE *out;
+    BOOL intl;
+    int blockSize;          /* data bytes of a data block : 488 or 512 */
+    SECTNUM rootBlock;
+    long nbRootDirc;
+    long nbBitmap;
+    long nbBitmapExt;
+    long nbReserved;        /* root, root dircache, bitmap and bitmap extension blocks */
+    long nbDirBlocks;       /* directory and dircache blocks, before the root block */
+    SECTNUM dirStart;
+    long nbAlloc;           /* file blocks of the plan */
+    SECTNUM cur;            /* next sector written */
+    BOOL reservedDone;
+};
+
+/* sorts the entries of a directory */
+struct BuildSort{
+    struct BuildNode *node;
+    char upper[MAXNAMELEN+1];
+};
+
+/* sorts the entries of a hash chain */
+struct BuildHash{
+    int i;
+    SECTNUM sect;
+};
+
+
+/*
+ * adfBuildSect
+ *
+ * the sector of the file block number 'a' of the plan
+ */
+static SECTNUM adfBuildSect(struct BuildState *st, long a)
+{
+    if (a+2<st->dirStart)
+        return a+2;
+    else
+        return a+2+st->nbDirBlocks+st->nbReserved;
+}
+
+
+/*
+ * adfBuildKey
+ *
+ * the header block of an entry
+ */
+static SECTNUM adfBuildKey(struct BuildState *st, struct BuildNode *node)
+{
+    if (node->type==ST_DIR)
+        return st->dirStart+node->first;
+    else
+        return adfBuildSect(st, node->first);
+}
+
+
+/*
+ * adfBuildSortCmp
+ *
+ */
+static int adfBuildSortCmp(const void *a, const void *b)
+{
+    return strcmp(((struct BuildSort*)a)->upper, ((struct BuildSort*)b)->upper);
+}
+
+
+/*
+ * adfBuildList
+ *
+ * the entries starting at 'first', sorted by name. NULL if one is not valid
+ */
+static struct BuildNode** adfBuildList(struct BuildState *st, struct BuildNode *first, int *n)
+{
+    struct BuildSort *sort;
+    struct BuildNode *node, **list;
+    char msg[MAXNAMELEN+60];
+    int i, len;
+
+    *n = 0;
+    for(node=first; node!=NULL; node=node->next)
+        (*n)++;
+
+    sort = (struct BuildSort*)malloc((*n+1)*sizeof(struct BuildSort));
+    list = (struct BuildNode**)malloc((*n+1)*sizeof(struct BuildNode*));
+    if (!sort || !list) {
+        (*adfEnv.eFct)("adfBuildList : malloc");
+        free(sort); free(list);
+        return NULL;
+    }
+
+    for(i=0, node=first; node!=NULL; i++, node=node->next) {
+        len = strlen(node->name);
+        if (len==0 || len>MAXNAMELEN || (node->type!=ST_FILE && node->type!=ST_DIR)
+            || (node->comment && strlen(node->comment)>MAXCMMTLEN)) {
+            sprintf(msg, "adfBuildImage : invalid entry \"%.*s\"", MAXNAMELEN, node->name);
+            (*adfEnv.wFct)(msg);
+            free(sort); free(list);
+            return NULL;
+        }
+        sort[i].node = node;
+        myToUpper((unsigned char*)sort[i].upper, (unsigned char*)node->name, len, st->intl);
+        sort[i].upper[len] = '\0';
+    }
+    if (*n>1)
+        qsort(sort, *n, sizeof(struct BuildSort), adfBuildSortCmp);
+
+    for(i=0; i<*n; i++) {
+        if (i>0 && strcmp(sort[i].upper, sort[i-1].upper)==0) {
+            sprintf(msg, "adfBuildImage : \"%s\" twice", sort[i].node->name);
+            (*adfEnv.wFct)(msg);
+            free(sort); free(list);
+            return NULL;
+        }
+        list[i] = sort[i].node;
+    }
+    free(sort);
+
+    return list;
+}
+
+
+/*
+ * adfBuildNbDirc
+ *
+ * the number of dircache blocks needed by the entries of 'list'
+ */
+static long adfBuildNbDirc(struct BuildState *st, struct BuildNode **list, int n)
+{
+    int i, len, used;
+    long nb;
+
+    if (!isDIRCACHE(st->img->volType))
+        return 0;
+
+    nb = 1;
+    used = 0;
+    for(i=0; i<n; i++) {
+        len = 24+strlen(list[i]->name)+1+(list[i]->comment ? strlen(list[i]->comment) : 0);
+        if (len%2)
+            len++;
+        if (used+len>488) {
+            nb++;
+            used = 0;
+        }
+        used += len;
+    }
+
+    return nb;
+}
+
+
+/*
+ * adfBuildPlan
+ *
+ * gives its blocks to the directory 'dir' (NULL for the root) and to its entries :
+ * header and dircache blocks in the directory area, the files in the file area,
+ * then the subdirectories
+ */
+static RETCODE adfBuildPlan(struct BuildState *st, struct BuildNode *dir)
+{
+    struct BuildNode **list;
+    int i, n;
+    RETCODE rc;
+
+    list = adfBuildList(st, dir ? dir->child : st->img->root, &n);
+    if (!list)
+        return RC_ERROR;
+
+    if (dir) {
+        dir->nbDirc = adfBuildNbDirc(st, list, n);
+        dir->first = st->nbDirBlocks;
+        st->nbDirBlocks += 1+dir->nbDirc;
+    }
+    else
+        st->nbRootDirc = adfBuildNbDirc(st, list, n);
+
+    for(i=0; i<n; i++)
+        if (list[i]->type==ST_FILE) {
+            list[i]->first = st->nbAlloc;
+            st->nbAlloc += adfFileRealSize(list[i]->size, st->blockSize, NULL, NULL);
+        }
+    rc = RC_OK;
+    for(i=0; i<n && rc==RC_OK; i++)
+        if (list[i]->type==ST_DIR)
+            rc = adfBuildPlan(st, list[i]);
+
+    free(list);
+
+    return rc;
+}
+
+
+/*
+ * adfBuildHashCmp
+ *
+ */
+static int adfBuildHashCmp(const void *a, const void *b)
+{
+    return ((struct BuildHash*)b)->sect - ((struct BuildHash*)a)->sect;
+}
+
+
+/*
+ * adfBuildHash
+ *
+ * the hash table of a directory, and the next entry of the same hash chain of each entry.
+ * the chains are sorted by block number
+ */
+static RETCODE adfBuildHash(struct BuildState *st, struct BuildNode **list, int n, long *hashTable,
+    SECTNUM *next)
+{
+    struct BuildHash *order;
+    int i, h;
+
+    order = (struct BuildHash*)malloc((n+1)*sizeof(struct BuildHash));
+    if (!order) {
+        (*adfEnv.eFct)("adfBuildHash : malloc");
+        return RC_MALLOC;
+    }
+    for(i=0; i<n; i++) {
+        order[i].i = i;
+        order[i].sect = adfBuildKey(st, list[i]);
+    }
+    if (n>1)
+        qsort(order, n, sizeof(struct BuildHash), adfBuildHashCmp);
+
+    memset(hashTable, 0, HT_SIZE*sizeof(long));
+    for(i=0; i<n; i++) {
+        h = adfGetHashValue((unsigned char*)list[order[i].i]->name, st->intl);
+        next[order[i].i] = hashTable[h];
+        hashTable[h] = order[i].sect;
+    }
+    free(order);
+
+    return RC_OK;
+}
+
+
+/*
+ * adfBuildDirList
+ *
+ * the sorted entries of the directory 'dir' (NULL for the root), its hash table,
+ * and the next entry of the same hash chain of each entry
+ */
+static struct BuildNode** adfBuildDirList(struct BuildState *st, struct BuildNode *dir, int *n,
+    long *hashTable, SECTNUM **next)
+{
+    struct BuildNode **list;
+
+    list = adfBuildList(st, dir ? dir->child : st->img->root, n);
+    if (!list)
+        return NULL;
+    *next = (SECTNUM*)malloc((*n+1)*sizeof(SECTNUM));
+    if (!*next) {
+        (*adfEnv.eFct)("adfBuildDirList : malloc");
+        free(list);
+        return NULL;
+    }
+    if (adfBuildHash(st, list, *n, hashTable, *next)!=RC_OK) {
+        free(*next);
+        free(list);
+        return NULL;
+    }
+
+    return list;
+}
+
+
+/*
+ * adfBuildEntry
+ *
+ * the fields common to the file headers and the directory blocks
+ */
+static void adfBuildEntry(struct BuildState *st, struct BuildNode *node, SECTNUM parent,
+    SECTNUM next, struct bEntryBlock *ent)
+{
+    memset(ent, 0, sizeof(struct bEntryBlock));
+    ent->type = T_HEADER;
+    ent->headerKey = adfBuildKey(st, node);
+    ent->access = node->access;
+    if (node->type==ST_FILE)
+        ent->byteSize = node->size;
+    if (node->comment) {
+        ent->commLen = strlen(node->comment);
+        memcpy(ent->comment, node->comment, ent->commLen);
+    }
+    adfTime2AmigaTime(node->date.mon!=0 ? node->date : st->img->date,
+        &(ent->days), &(ent->mins), &(ent->ticks));
+    ent->nameLen = strlen(node->name);
+    memcpy(ent->name, node->name, ent->nameLen);
+    ent->nextSameHash = next;
+    ent->parent = parent;
+    ent->secType = node->type;
+}
+
+
+static RETCODE adfBuildReserved(struct BuildState *st);
+
+
+/*
+ * adfBuildPut
+ *
+ * writes the next block of the image
+ */
+static RETCODE adfBuildPut(struct BuildState *st, unsigned char *buf)
+{
+    if (st->cur==st->dirStart && !st->reservedDone)
+        if (adfBuildReserved(st)!=RC_OK)
+            return RC_ERROR;
+
+    if (fwrite(buf, LOGICAL_BLOCK_SIZE, 1, st->out)!=1) {
+        (*adfEnv.eFct)("adfBuildImage : write error");
+        return RC_ERROR;
+    }
+    st->cur++;
+
+    if (adfEnv.useProgressBar && st->cur%1024==0)
+        (*adfEnv.progressBar)((int)(st->cur*100/st->img->nbBlocks));
+
+    return RC_OK;
+}
+
+
+/*
+ * adfBuildPutSum
+ *
+ * writes a block with the checksum at offset 20
+ */
+static RETCODE adfBuildPutSum(struct BuildState *st, void *blk, int swapType)
+{
+    unsigned char buf[LOGICAL_BLOCK_SIZE];
+    unsigned long newSum;
+
+    memcpy(buf, blk, LOGICAL_BLOCK_SIZE);
+#ifdef LITT_ENDIAN
+    swapEndian(buf, swapType);
+#endif
+    newSum = adfNormalSum(buf, 20, LOGICAL_BLOCK_SIZE);
+    swLong(buf+20, newSum);
+
+    return adfBuildPut(st, buf);
+}
+
+
+/*
+ * adfBuildDirc
+ *
+ * writes the dircache blocks of a directory, at sectors 'firstSect' and following
+ */
+static RETCODE adfBuildDirc(struct BuildState *st, struct BuildNode **list, int n,
+    SECTNUM parent, SECTNUM firstSect)
+{
+    struct bDirCacheBlock dirc;
+    struct bEntryBlock ent;
+    struct CacheEntry caEntry;
+    int i, len = 0, offset;
+    long j;
+
+    j = 0;
+    memset(&dirc, 0, sizeof(struct bDirCacheBlock));
+    offset = 0;
+    for(i=0; i<=n; i++) {
+        if (i<n) {
+            adfBuildEntry(st, list[i], parent, 0, &ent);
+            len = adfEntry2CacheEntry(&ent, &caEntry);
+        }
+        if (i==n || offset+len>488) {
+            dirc.type = T_DIRC;
+            dirc.headerKey = firstSect+j;
+            dirc.parent = parent;
+            if (i<n)
+                dirc.nextDirC = firstSect+j+1;
+            if (adfBuildPutSum(st, &dirc, SWBL_CACHE)!=RC_OK)
+                return RC_ERROR;
+            memset(&dirc, 0, sizeof(struct bDirCacheBlock));
+            offset = 0;
+            j++;
+        }
+        if (i<n) {
+            offset += adfPutCacheEntry(&dirc, &offset, &caEntry);
+            dirc.recordsNb++;
+        }
+    }
+
+    return RC_OK;
+}
+
+
+/*
+ * adfBuildDirBlocks
+ *
+ * writes the directory and dircache blocks of the subdirectories of 'dir' (NULL for the root),
+ * and of 'dir' itself, in the order of adfBuildPlan()
+ */
+static RETCODE adfBuildDirBlocks(struct BuildState *st, struct BuildNode *dir, SECTNUM parent,
+    SECTNUM next)
+{
+    struct BuildNode **list;
+    struct bDirBlock dirb;
+    long hashTable[HT_SIZE];
+    SECTNUM *nextSame, self;
+    int i, n;
+    RETCODE rc;
+
+    list = adfBuildDirList(st, dir, &n, hashTable, &nextSame);
+    if (!list)
+        return RC_ERROR;
+
+    rc = RC_OK;
+    if (dir) {
+        self = st->dirStart+dir->first;
+        adfBuildEntry(st, dir, parent, next, (struct bEntryBlock*)&dirb);
+        memcpy(dirb.hashTable, hashTable, sizeof(hashTable));
+        if (dir->nbDirc>0)
+            dirb.extension = self+1;
+        rc = adfBuildPutSum(st, &dirb, SWBL_DIR);
+        if (rc==RC_OK && dir->nbDirc>0)
+            rc = adfBuildDirc(st, list, n, self, self+1);
+    }
+    else
+        self = st->rootBlock;
+
+    for(i=0; i<n && rc==RC_OK; i++)
+        if (list[i]->type==ST_DIR)
+            rc = adfBuildDirBlocks(st, list[i], self, nextSame[i]);
+
+    free(nextSame);
+    free(list);
+
+    return rc;
+}
+
+
+/*
+ * adfBuildReserved
+ *
+ * writes the directory blocks, then the root block, its dircache and the bitmap
+ */
+static RETCODE adfBuildReserved(struct BuildState *st)
+{
+    struct BuildNode **list;
+    struct bRootBlock root;
+    struct bBitmapBlock bitm;
+    struct bBitmapExtBlock bitme;
+    unsigned char buf[LOGICAL_BLOCK_SIZE];
+    SECTNUM *next, bmSect, sect, a;
+    long i, k, bit, nbBlocks;
+    int n, nlen;
+    RETCODE rc;
+
+    st->reservedDone = TRUE;
+
+    if (adfBuildDirBlocks(st, NULL, 0, 0)!=RC_OK)
+        return RC_ERROR;
+
+    memset(&root, 0, sizeof(struct bRootBlock));
+    list = adfBuildDirList(st, NULL, &n, root.hashTable, &next);
+    if (!list)
+        return RC_ERROR;
+    root.type = T_HEADER;
+    root.hashTableSize = HT_SIZE;
+    root.bmFlag = BM_VALID;
+    bmSect = st->rootBlock+1+st->nbRootDirc;
+    for(i=0; i<st->nbBitmap && i<BM_SIZE; i++)
+        root.bmPages[i] = bmSect+i;
+    if (st->nbBitmapExt>0)
+        root.bmExt = bmSect+st->nbBitmap;
+    adfTime2AmigaTime(st->img->date, &(root.cDays), &(root.cMins), &(root.cTicks));
+    adfTime2AmigaTime(st->img->date, &(root.days), &(root.mins), &(root.ticks));
+    adfTime2AmigaTime(st->img->date, &(root.coDays), &(root.coMins), &(root.coTicks));
+    nlen = min(MAXNAMELEN, strlen(st->img->volName));
+    root.nameLen = nlen;
+    memcpy(root.diskName, st->img->volName, nlen);
+    if (st->nbRootDirc>0)
+        root.extension = st->rootBlock+1;
+    root.secType = ST_ROOT;
+
+    rc = adfBuildPutSum(st, &root, SWBL_ROOT);
+    if (rc==RC_OK && st->nbRootDirc>0)
+        rc = adfBuildDirc(st, list, n, st->rootBlock, st->rootBlock+1);
+    free(next);
+    free(list);
+    if (rc!=RC_OK)
+        return rc;
+
+    /* a bit set is a free block, from block 2 */
+    nbBlocks = st->img->nbBlocks;
+    for(k=0; k<st->nbBitmap; k++) {
+        memset(&bitm, 0, sizeof(struct bBitmapBlock));
+        for(bit=0; bit<127*32; bit++) {
+            sect = 2+k*127*32+bit;
+            if (sect>=nbBlocks)
+                break;
+            if (sect>=st->dirStart && sect<st->rootBlock+st->nbReserved)
+                continue;
+            a = sect<st->dirStart ? sect-2 : sect-2-st->nbDirBlocks-st->nbReserved;
+            if (a>=st->nbAlloc)
+                bitm.map[bit/32] |= bitMask[bit%32];
+        }
+        adfBitmapBlock2Buf(&bitm, buf);
+        if (adfBuildPut(st, buf)!=RC_OK)
+            return RC_ERROR;
+    }
+
+    for(k=0; k<st->nbBitmapExt; k++) {
+        memset(&bitme, 0, sizeof(struct bBitmapExtBlock));
+        for(i=0; i<127 && BM_SIZE+k*127+i<st->nbBitmap; i++)
+            bitme.bmPages[i] = bmSect+BM_SIZE+k*127+i;
+        if (k+1<st->nbBitmapExt)
+            bitme.nextBlock = bmSect+st->nbBitmap+k+1;
+        memcpy(buf, &bitme, LOGICAL_BLOCK_SIZE);
+#ifdef LITT_ENDIAN
+        swapEndian(buf, SWBL_BITMAPE);
+#endif
+        if (adfBuildPut(st, buf)!=RC_OK)
+            return RC_ERROR;
+    }
+
+    return RC_OK;
+}
+
+
+/*
+ * adfBuildFile
+ *
+ * writes the header, the extension blocks and the data blocks of a file
+ */
+static RETCODE adfBuildFile(struct BuildState *st, struct BuildNode *node, SECTNUM parent,
+    SECTNUM next)
+{
+    struct bFileHeaderBlock fhdr;
+    struct bFileExtBlock fext;
+    struct bOFSDataBlock data;
+    unsigned char buf[LOGICAL_BLOCK_SIZE], *ptr;
+    long dataN, extN, firstData, j, k, len;
+    unsigned long pos;
+    SECTNUM header;
+    char msg[MAXNAMELEN+60];
+
+    adfFileRealSize(node->size, st->blockSize, &dataN, &extN);
+    header = adfBuildSect(st, node->first);
+    firstData = node->first+1+extN;
+
+    adfBuildEntry(st, node, parent, next, (struct bEntryBlock*)&fhdr);
+    fhdr.highSeq = dataN<MAX_DATABLK ? dataN : MAX_DATABLK;
+    if (dataN>0)
+        fhdr.firstData = adfBuildSect(st, firstData);
+    for(k=0; k<fhdr.highSeq; k++)
+        fhdr.dataBlocks[MAX_DATABLK-1-k] = adfBuildSect(st, firstData+k);
+    if (extN>0)
+        fhdr.extension = adfBuildSect(st, node->first+1);
+    if (adfBuildPutSum(st, &fhdr, SWBL_FILE)!=RC_OK)
+        return RC_ERROR;
+
+    for(j=0; j<extN; j++) {
+        memset(&fext, 0, sizeof(struct bFileExtBlock));
+        fext.type = T_LIST;
+        fext.headerKey = adfBuildSect(st, node->first+1+j);
+        for(k=0; k<MAX_DATABLK && MAX_DATABLK*(j+1)+k<dataN; k++)
+            fext.dataBlocks[MAX_DATABLK-1-k] = adfBuildSect(st, firstData+MAX_DATABLK*(j+1)+k);
+        fext.highSeq = k;
+        fext.parent = header;
+        if (j+1<extN)
+            fext.extension = adfBuildSect(st, node->first+2+j);
+        fext.secType = ST_FILE;
+        if (adfBuildPutSum(st, &fext, SWBL_FEXT)!=RC_OK)
+            return RC_ERROR;
+    }
+
+    pos = 0;
+    for(k=0; k<dataN; k++) {
+        len = node->size-pos<(unsigned long)st->blockSize ? node->size-pos : st->blockSize;
+        if (isOFS(st->img->volType)) {
+            memset(&data, 0, sizeof(struct bOFSDataBlock));
+            ptr = data.data;
+        }
+        else {
+            memset(buf, 0, LOGICAL_BLOCK_SIZE);
+            ptr = buf;
+        }
+        if (node->data)
+            memcpy(ptr, node->data+pos, len);
+        else if (st->img->readFct && (*st->img->readFct)(node, pos, len, ptr)!=len) {
+            sprintf(msg, "adfBuildImage : can't read \"%s\"", node->name);
+            (*adfEnv.eFct)(msg);
+            return RC_ERROR;
+        }
+        pos += len;
+
+        if (isOFS(st->img->volType)) {
+            data.type = T_DATA;
+            data.headerKey = header;
+            data.seqNum = k+1;
+            data.dataSize = len;
+            if (k+1<dataN)
+                data.nextData = adfBuildSect(st, firstData+k+1);
+            if (adfBuildPutSum(st, &data, SWBL_DATA)!=RC_OK)
+                return RC_ERROR;
+        }
+        else if (adfBuildPut(st, buf)!=RC_OK)
+            return RC_ERROR;
+    }
+
+    return RC_OK;
+}
+
+
+/*
+ * adfBuildFiles
+ *
+ * writes the files of the directory 'dir' (NULL for the root), then the ones of its
+ * subdirectories, in the order of adfBuildPlan()
+ */
+static RETCODE adfBuildFiles(struct BuildState *st, struct BuildNode *dir)
+{
+    struct BuildNode **list;
+    long hashTable[HT_SIZE];
+    SECTNUM *nextSame, self;
+    int i, n;
+    RETCODE rc;
+
+    list = adfBuildDirList(st, dir, &n, hashTable, &nextSame);
+    if (!list)
+        return RC_ERROR;
+    self = dir ? st->dirStart+dir->first : st->rootBlock;
+
+    rc = RC_OK;
+    for(i=0; i<n && rc==RC_OK; i++)
+        if (list[i]->type==ST_FILE)
+            rc = adfBuildFile(st, list[i], self, nextSame[i]);
+    for(i=0; i<n && rc==RC_OK; i++)
+        if (list[i]->type==ST_DIR)
+            rc = adfBuildFiles(st, list[i]);
+
+    free(nextSame);
+    free(list);
+
+    return rc;
+}
+
+
+/*
+ * adfBuildImage
+ */
+/*!	\brief	Write a new image with a whole tree of entries.
+ *	\param	img      - the volume and its entries.
+ *	\param	filename - the image to create.
+ *	\return	RC_OK, RC_ERROR (an entry is invalid, or a write failed) or RC_VOLFULL.
+ *
+ *	The layout of all the entries is planned before writing : the directory blocks are grouped
+ *	near the root block, and the blocks of each file are contiguous. The image is written once,
+ *	in sector order, and is the same for the same tree and dates. The entries of a directory
+ *	are sorted by name.
+ */
+RETCODE adfBuildImage(struct BuildImage *img, char *filename)
+{
+    struct BuildState st;
+    struct bBootBlock boot;
+    unsigned char buf[LOGICAL_BLOCK_SIZE*2];
+    unsigned long newSum;
+    RETCODE rc;
+
+    memset(&st, 0, sizeof(struct BuildState));
+    st.img = img;
+    st.intl = isINTL(img->volType) || isDIRCACHE(img->volType);
+    st.blockSize = isOFS(img->volType) ? 488 : 512;
+    st.rootBlock = img->nbBlocks/2;
+
+    st.nbBitmap = (img->nbBlocks-2)/(127*32);
+    if ((img->nbBlocks-2)%(127*32))
+        st.nbBitmap++;
+    if (st.nbBitmap>BM_SIZE) {
+        st.nbBitmapExt = (st.nbBitmap-BM_SIZE)/127;
+        if ((st.nbBitmap-BM_SIZE)%127)
+            st.nbBitmapExt++;
+    }
+
+    if (adfBuildPlan(&st, NULL)!=RC_OK)
+        return RC_ERROR;
+    st.nbReserved = 1+st.nbRootDirc+st.nbBitmap+st.nbBitmapExt;
+    st.dirStart = st.rootBlock-st.nbDirBlocks;
+    if (img->nbBlocks<8 || st.dirStart<2
+        || st.nbAlloc>img->nbBlocks-2-st.nbDirBlocks-st.nbReserved) {
+        (*adfEnv.wFct)("adfBuildImage : the entries don't fit in the image");
+        return RC_VOLFULL;
+    }
+
+    st.out = fopen(filename, "wb");
+    if (!st.out) {
+        (*adfEnv.eFct)("adfBuildImage : can't create the image");
+        return RC_ERROR;
+    }
+
+    /* boot block */
+    memset(&boot, 0, sizeof(struct bBootBlock));
+    boot.dosType[0] = 'D';
+    boot.dosType[1] = 'O';
+    boot.dosType[2] = 'S';
+    boot.dosType[3] = img->volType;
+    if (img->bootCode) {
+        boot.rootBlock = 880;
+        memcpy(boot.data, img->bootCode+12, 1024-12);
+    }
+    memcpy(buf, &boot, LOGICAL_BLOCK_SIZE*2);
+#ifdef LITT_ENDIAN
+    swapEndian(buf, SWBL_BOOT);
+#endif
+    if (img->bootCode) {
+        newSum = adfBootSum(buf);
+        swLong(buf+4, newSum);
+    }
+    rc = RC_OK;
+    if (fwrite(buf, LOGICAL_BLOCK_SIZE, 2, st.out)!=2) {
+        (*adfEnv.eFct)("adfBuildImage : write error");
+        rc = RC_ERROR;
+    }
+    st.cur = 2;
+
+    if (rc==RC_OK)
+        rc = adfBuildFiles(&st, NULL);
+
+    /* the free blocks */
+    memset(buf, 0, LOGICAL_BLOCK_SIZE);
+    while(rc==RC_OK && st.cur<img->nbBlocks)
+        if (st.cur==st.dirStart && !st.reservedDone)
+            rc = adfBuildReserved(&st);
+        else
+            rc = adfBuildPut(&st, buf);
+
+    if (fclose(st.out)!=0 && rc==RC_OK) {
+        (*adfEnv.eFct)("adfBuildImage : write error");
+        rc = RC_ERROR;
+    }
+
+    return rc;
+}
+
+/*##########################################################################*/
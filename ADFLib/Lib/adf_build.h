@@ -0,0 +1,18 @@
+#ifndef ADF_BUILD_H
+#define ADF_BUILD_H 1
+
+/*
+ *  ADF Library. (C) 1997-2002 Laurent Clevy
+ */
+/*! \file	adf_build.h
+ *  \brief	Offline image builder header.
+ */
+
+#include"prefix.h"
+
+#include"adf_str.h"
+
+PREFIX RETCODE adfBuildImage(struct BuildImage *img, char *filename);
+
+#endif /* ADF_BUILD_H */
+/*##########################################################################*/
@@ -21,6 +21,9 @@
 
 
 extern struct Env adfEnv;
+
+static struct DirCache* adfDirCacheFind(struct Volume *vol, SECTNUM first, struct DirCache ***link);
+
 /*
 freeEntCache(struct CacheEntry *cEntry)
 {
@@ -34,83 +37,108 @@ freeEntCache(struct CacheEntry *cEntry)
 /*
  * adfGetDirEntCache
  *
- * replace 'adfGetDirEnt'. returns a the dir contents based on the dircache list
+ * replace 'adfGetDirEnt'. returns a the dir contents based on the dircache list.
+ * allocated in 'arena', or with malloc() if it is NULL
  */
-struct List* adfGetDirEntCache(struct Volume *vol, SECTNUM dir, BOOL recurs)
+struct List* adfGetDirEntCache(struct Volume *vol, SECTNUM dir, BOOL recurs, struct Arena *arena)
 {
 	struct bEntryBlock parent;
-	struct bDirCacheBlock dirc;
+	struct bDirCacheBlock *dirc;
+    struct DirCache *dc;
     int offset, n;
+    long i;
     struct List *cell, *head;
     struct CacheEntry caEntry;
     struct Entry *entry;
-    SECTNUM nSect;
+    BOOL loaded;
 
-    if (adfReadEntryBlock(vol,dir,&parent)!=RC_OK)
+    if (adfReadEntryBlock(vol,dir,&parent)!=RC_OK) {
+        adfDirFreeList(arena, NULL);
         return NULL;
+    }
 
-    nSect = parent.extension;
+    /* the blocks may have been modified in memory only. A model only loaded for the
+       listing isn't kept : a recursive listing holds one model per level */
+    loaded = adfDirCacheFind(vol, parent.extension, NULL)==NULL;
+    dc = adfGetDirCache(vol, &parent);
+    if (!dc) {
+        adfDirFreeList(arena, NULL);
+        return NULL;
+    }
 
     cell = head = NULL;
-    do {
+    for(i=0; i<dc->nbBlocks; i++) {
         /* one loop per cache block */
         n = offset = 0;
-	    if (adfReadDirCBlock(vol, nSect, &dirc)!=RC_OK)
-            return NULL;
-        while (n<dirc.recordsNb) {
+        dirc = &(dc->blocks[i]->dirc);
+        while (n<dirc->recordsNb) {
             /* one loop per record */
-            entry = (struct Entry*)malloc(sizeof(struct Entry));
-            if (!entry) {
-                adfFreeDirList(head);
-                return NULL;
-            }
-            adfGetCacheEntry(&dirc, &offset, &caEntry);
+            entry = adfDirNewEntry(arena);
+            if (!entry)
+                goto error;
+            adfGetCacheEntry(dirc, &offset, &caEntry);
 
             /* converts a cache entry into a dir entry */
-            entry->type = (int)caEntry.type;
-            entry->name = strdup(caEntry.name);
+            adfCacheEntry2Entry(&caEntry, dir, entry);
+            entry->name = adfDirStrDup(arena, caEntry.name);
             if (entry->name==NULL) {
-                free(entry); adfFreeDirList(head);
-                return NULL;
+                if (!arena) free(entry);
+                goto error;
             }
-            entry->sector = caEntry.header;
-            entry->comment = strdup(caEntry.comm);
+            entry->comment = adfDirStrDup(arena, caEntry.comm);
             if (entry->comment==NULL) {
-                free(entry->name); adfFreeDirList(head);
-                return NULL;
+                if (!arena) { free(entry->name); free(entry); }
+                goto error;
             }
-            entry->size = caEntry.size;
-            entry->access = caEntry.protect;
-            adfDays2Date( caEntry.days, &(entry->year), &(entry->month), 
-                &(entry->days) );
-            entry->hour = caEntry.mins/60;
-            entry->mins = caEntry.mins%60;
-            entry->secs = caEntry.ticks/50;
 
             /* add it into the linked list */
-            if (head==NULL)
-                head = cell = newCell(NULL, (void*)entry); 
-            else
-                cell = newCell(cell, (void*)entry); 
-
+            cell = adfDirNewCell(arena, cell, (void*)entry); 
             if (cell==NULL) {
-                adfFreeEntry(entry);
-                adfFreeDirList(head);
-                return NULL;
+                if (!arena) adfFreeEntry(entry);
+                goto error;
             }
+            if (head==NULL)
+                head = cell;
 
             if (recurs && entry->type==ST_DIR)
-                 cell->subdir = adfGetDirEntCache(vol,entry->sector,recurs);
+                 cell->subdir = adfGetDirEntCache(vol,entry->sector,recurs,arena);
 
             n++;
         }
-        nSect = dirc.nextDirC;
-    }while (nSect!=0);
-    
-    return head;	
+    }
+    if (loaded)
+        adfReleaseDirCache(vol, dc);
+
+    return head;
+
+error:
+    adfDirFreeList(arena, head);
+    if (loaded)
+        adfReleaseDirCache(vol, dc);
+    return NULL;
 }
 
 
+/*
+ * adfCacheEntry2Entry
+ *
+ * fills the fields of 'entry' from a cache record, except the name and the comment
+ */
+void adfCacheEntry2Entry(struct CacheEntry *caEntry, SECTNUM dir, struct Entry *entry)
+{
+    entry->type = (int)caEntry->type;
+    entry->sector = caEntry->header;
+    entry->parent = dir;
+    entry->real = 0L;
+    entry->size = caEntry->size;
+    entry->access = caEntry->protect;
+    adfDays2Date( caEntry->days, &(entry->year), &(entry->month), 
+        &(entry->days) );
+    entry->hour = caEntry->mins/60;
+    entry->mins = caEntry->mins%60;
+    entry->secs = caEntry->ticks/50;
+}
+
 
 /*
  * adfGetCacheEntry
@@ -267,89 +295,433 @@ int adfEntry2CacheEntry(struct bEntryBlock *entry, struct CacheEntry *newEntry)
 
 
 /*
- * adfDelFromCache
+ * adfDirCacheAddKey
  *
- * delete one cache entry from its block. don't do 'records garbage collecting'
  */
-RETCODE adfDelFromCache(struct Volume *vol, struct bEntryBlock *parent, 
-    SECTNUM headerKey)
+static RETCODE adfDirCacheAddKey(struct DirCache *dc, SECTNUM header, struct DirCBlock *blk)
+{
+    struct DirCKey *key, **newKeys, *next;
+    long i, h, newSize;
+
+    /* keeps at most one key per bucket on average */
+    if (dc->nbKeys>=dc->hashSize) {
+        newSize = dc->hashSize ? dc->hashSize*2 : 64;
+        newKeys = (struct DirCKey**)calloc(newSize, sizeof(struct DirCKey*));
+        if (!newKeys) {
+            (*adfEnv.eFct)("adfDirCacheAddKey : malloc");
+            return RC_MALLOC;
+        }
+        for(i=0; i<dc->hashSize; i++)
+            for(key=dc->keys[i]; key!=NULL; key=next) {
+                next = key->next;
+                h = key->header & (newSize-1);
+                key->next = newKeys[h];
+                newKeys[h] = key;
+            }
+        free(dc->keys);
+        dc->keys = newKeys;
+        dc->hashSize = newSize;
+    }
+
+    key = (struct DirCKey*)malloc(sizeof(struct DirCKey));
+    if (!key) {
+        (*adfEnv.eFct)("adfDirCacheAddKey : malloc");
+        return RC_MALLOC;
+    }
+    h = header & (dc->hashSize-1);
+    key->header = header;
+    key->blk = blk;
+    key->next = dc->keys[h];
+    dc->keys[h] = key;
+    dc->nbKeys++;
+
+    return RC_OK;
+}
+
+
+/*
+ * adfDirCacheFindKey
+ *
+ * returns the block holding the record of 'header', and unlinks the key if 'remove'
+ */
+static struct DirCBlock* adfDirCacheFindKey(struct DirCache *dc, SECTNUM header, BOOL remove)
+{
+    struct DirCKey *key, **prev;
+    struct DirCBlock *blk;
+
+    if (dc->hashSize==0)
+        return NULL;
+    prev = &(dc->keys[header & (dc->hashSize-1)]);
+    for(key=*prev; key!=NULL; prev=&(key->next), key=key->next)
+        if (key->header==header) {
+            blk = key->blk;
+            if (remove) {
+                *prev = key->next;
+                free(key);
+                dc->nbKeys--;
+            }
+            return blk;
+        }
+
+    return NULL;
+}
+
+
+/*
+ * adfDirCacheFindRecord
+ *
+ * returns the offset of the record of 'header' in one block and its length, -1 if not there.
+ * a block holds at most 18 records
+ */
+static int adfDirCacheFindRecord(struct DirCBlock *blk, SECTNUM header, int *len)
 {
-    struct bDirCacheBlock dirc;
-    SECTNUM nSect, prevSect;
     struct CacheEntry caEntry;
     int offset, oldOffset, n;
-    BOOL found;
-    int entryLen;
-    int i;
-    RETCODE rc = RC_OK;
 
-    prevSect = -1;
-	nSect = parent->extension;
-    found = FALSE;
+    offset = 0;
+    for(n=0; n<blk->dirc.recordsNb; n++) {
+        oldOffset = offset;
+        adfGetCacheEntry(&(blk->dirc), &offset, &caEntry);
+        if (caEntry.header==header) {
+            *len = offset-oldOffset;
+            return oldOffset;
+        }
+    }
+
+    return -1;
+}
+
+
+/*
+ * adfDirCacheAddBlock
+ *
+ * appends one block to the chain of the model
+ */
+static struct DirCBlock* adfDirCacheAddBlock(struct DirCache *dc, SECTNUM nSect)
+{
+    struct DirCBlock *blk, **newBlocks;
+
+    if (dc->nbBlocks==dc->maxBlocks) {
+        newBlocks = (struct DirCBlock**)realloc(dc->blocks, 
+            (dc->maxBlocks+8)*sizeof(struct DirCBlock*));
+        if (!newBlocks)
+            return NULL;
+        dc->blocks = newBlocks;
+        dc->maxBlocks += 8;
+    }
+    blk = (struct DirCBlock*)malloc(sizeof(struct DirCBlock));
+    if (!blk)
+        return NULL;
+    blk->sect = nSect;
+    blk->used = 0;
+    blk->dirty = FALSE;
+    dc->blocks[dc->nbBlocks++] = blk;
+
+    return blk;
+}
+
+
+/*
+ * adfDirCacheFree
+ *
+ */
+static void adfDirCacheFree(struct DirCache *dc)
+{
+    struct DirCKey *key, *next;
+    long i;
+
+    for(i=0; i<dc->hashSize; i++)
+        for(key=dc->keys[i]; key!=NULL; key=next) {
+            next = key->next;
+            free(key);
+        }
+    for(i=0; i<dc->nbBlocks; i++)
+        free(dc->blocks[i]);
+    free(dc->keys);
+    free(dc->blocks);
+    free(dc);
+}
+
+
+/*
+ * adfDirCacheFind
+ *
+ * the model whose chain starts at 'first', NULL if it isn't loaded. 'link' receives the pointer to it
+ */
+static struct DirCache* adfDirCacheFind(struct Volume *vol, SECTNUM first, struct DirCache ***link)
+{
+    struct DirCache **prev;
+
+    if (vol->dirCacheSize==0)
+        return NULL;
+    for(prev=&(vol->dirCache[first & (vol->dirCacheSize-1)]); *prev!=NULL; prev=&((*prev)->next))
+        if ((*prev)->first==first) {
+            if (link)
+                *link = prev;
+            return *prev;
+        }
+
+    return NULL;
+}
+
+
+/*
+ * adfFindDirCache
+ *
+ * the model of a directory if it is loaded, NULL otherwise : nothing is read
+ */
+struct DirCache* adfFindDirCache(struct Volume *vol, SECTNUM first)
+{
+    return adfDirCacheFind(vol, first, NULL);
+}
+
+
+/*
+ * adfDirCacheInsert
+ *
+ * adds a model to the index of the volume, at most one model per bucket on average
+ */
+static RETCODE adfDirCacheInsert(struct Volume *vol, struct DirCache *dc)
+{
+    struct DirCache **newHash, *cur, *next;
+    long i, h, newSize;
+
+    if (vol->nbDirCache>=vol->dirCacheSize) {
+        newSize = vol->dirCacheSize ? vol->dirCacheSize*2 : 16;
+        newHash = (struct DirCache**)calloc(newSize, sizeof(struct DirCache*));
+        if (!newHash) {
+            (*adfEnv.eFct)("adfDirCacheInsert : malloc");
+            return RC_MALLOC;
+        }
+        for(i=0; i<vol->dirCacheSize; i++)
+            for(cur=vol->dirCache[i]; cur!=NULL; cur=next) {
+                next = cur->next;
+                h = cur->first & (newSize-1);
+                cur->next = newHash[h];
+                newHash[h] = cur;
+            }
+        free(vol->dirCache);
+        vol->dirCache = newHash;
+        vol->dirCacheSize = newSize;
+    }
+
+    h = dc->first & (vol->dirCacheSize-1);
+    dc->next = vol->dirCache[h];
+    vol->dirCache[h] = dc;
+    vol->nbDirCache++;
+
+    return RC_OK;
+}
+
+
+/*
+ * adfGetDirCache
+ *
+ * returns the parsed dircache of the 'parent' directory. The chain is read and parsed
+ * only the first time, later calls only touch memory
+ */
+struct DirCache* adfGetDirCache(struct Volume *vol, struct bEntryBlock *parent)
+{
+    struct DirCache *dc;
+    struct DirCBlock *blk;
+    struct CacheEntry caEntry;
+    SECTNUM nSect;
+    int offset, n;
+
+    dc = adfDirCacheFind(vol, parent->extension, NULL);
+    if (dc)
+        return dc;
+
+    dc = (struct DirCache*)calloc(1, sizeof(struct DirCache));
+    if (!dc) {
+        (*adfEnv.eFct)("adfGetDirCache : malloc");
+        return NULL;
+    }
+    dc->first = parent->extension;
+
+    nSect = parent->extension;
     do {
-        adfReadDirCBlock(vol, nSect, &dirc);
-        offset = 0; n = 0;
-        while(n < dirc.recordsNb && !found) {
-            oldOffset = offset;
-            adfGetCacheEntry(&dirc, &offset, &caEntry);
-            found = (caEntry.header==headerKey);
-            if (found) {
-                entryLen = offset-oldOffset;
-                if (dirc.recordsNb>1 || prevSect==-1) {
-                    if (n<dirc.recordsNb-1) {
-                        /* not the last of the block : switch the following records */
-                        for(i=oldOffset; i<(488-entryLen); i++)
-                            dirc.records[i] = dirc.records[i+entryLen];
-                        /* and clear the following bytes */
-                        for(i=488-entryLen; i<488; i++)
-                            dirc.records[i] = 0;
-                    }
-                    else {
-                        /* the last record of this cache block */
-                        for(i=oldOffset; i<offset; i++)
-                            dirc.records[i] = 0;
-                    }
-                    dirc.recordsNb--;
-                    if (adfWriteDirCBlock(vol, dirc.headerKey, &dirc)!=RC_OK)
-						return -1;
-                }
-                else {
-                    /* dirc.recordsNb ==1 or == 0 , prevSect!=-1 : 
-                    * the only record in this dirc block and a previous dirc block exists 
-                    */
-                    adfSetBlockFree(vol, dirc.headerKey);
-                    adfReadDirCBlock(vol, prevSect, &dirc);
-                    dirc.nextDirC = 0L;
-                    adfWriteDirCBlock(vol, prevSect, &dirc);
-
-                    adfUpdateBitmap(vol);
-                }
+        blk = adfDirCacheAddBlock(dc, nSect);
+        if (!blk) {
+            (*adfEnv.eFct)("adfGetDirCache : malloc");
+            adfDirCacheFree(dc);
+            return NULL;
+        }
+        if (adfReadDirCBlock(vol, nSect, &(blk->dirc))!=RC_OK) {
+            adfDirCacheFree(dc);
+            return NULL;
+        }
+        offset = 0;
+        for(n=0; n<blk->dirc.recordsNb; n++) {
+            adfGetCacheEntry(&(blk->dirc), &offset, &caEntry);
+            if (adfDirCacheAddKey(dc, caEntry.header, blk)!=RC_OK) {
+                adfDirCacheFree(dc);
+                return NULL;
             }
-            n++;
         }
-        prevSect = nSect;
-        nSect = dirc.nextDirC;
-    }while(nSect!=0 && !found);
+        blk->used = offset;
+        nSect = blk->dirc.nextDirC;
+    }while(nSect!=0 && dc->nbBlocks<=vol->lastBlock-vol->firstBlock);
 
-    if (!found)
-        (*adfEnv.wFct)("adfUpdateCache : entry not found");
+    if (adfDirCacheInsert(vol, dc)!=RC_OK) {
+        adfDirCacheFree(dc);
+        return NULL;
+    }
+
+    return dc;
+}
+
+
+/*
+ * adfDropDirCache
+ *
+ * forgets the dircache starting at 'first' without writing it : the directory is deleted
+ */
+void adfDropDirCache(struct Volume *vol, SECTNUM first)
+{
+    struct DirCache *dc, **link;
+
+    dc = adfDirCacheFind(vol, first, &link);
+    if (dc) {
+        *link = dc->next;
+        vol->nbDirCache--;
+        adfDirCacheFree(dc);
+    }
+}
+
+
+/*
+ * adfReleaseDirCache
+ *
+ * frees a model which has no modified block : a listing which loaded it is finished
+ */
+void adfReleaseDirCache(struct Volume *vol, struct DirCache *dc)
+{
+    long i;
+
+    for(i=0; i<dc->nbBlocks; i++)
+        if (dc->blocks[i]->dirty)
+            return;
+    adfDropDirCache(vol, dc->first);
+}
+
+
+/*
+ * adfFlushDirCache
+ */
+/*!	\brief	Write back the modified dircache blocks.
+ *	\param	vol - the volume.
+ *	\return	RC_OK or RC_ERROR.
+ *
+ *	The dircache blocks of DIRCACHE volumes are modified in memory and only written
+ *	by adfUnMount() or by this function.
+ */
+RETCODE adfFlushDirCache(struct Volume *vol)
+{
+    struct DirCache *dc;
+    long i, h;
+    RETCODE rc = RC_OK;
+
+    for(h=0; h<vol->dirCacheSize; h++)
+        for(dc=vol->dirCache[h]; dc!=NULL; dc=dc->next)
+            for(i=0; i<dc->nbBlocks; i++)
+                if (dc->blocks[i]->dirty) {
+                    if (adfWriteDirCBlock(vol, dc->blocks[i]->sect, &(dc->blocks[i]->dirc))!=RC_OK)
+                        rc = RC_ERROR;
+                    else
+                        dc->blocks[i]->dirty = FALSE;
+                }
 
     return rc;
 }
 
 
+/*
+ * adfFreeDirCache
+ *
+ * frees all the dircache models of the volume. adfFlushDirCache() must be called before
+ */
+void adfFreeDirCache(struct Volume *vol)
+{
+    struct DirCache *dc;
+    long h;
+
+    for(h=0; h<vol->dirCacheSize; h++)
+        while(vol->dirCache[h]!=NULL) {
+            dc = vol->dirCache[h];
+            vol->dirCache[h] = dc->next;
+            adfDirCacheFree(dc);
+        }
+    free(vol->dirCache);
+    vol->dirCache = NULL;
+    vol->dirCacheSize = 0;
+    vol->nbDirCache = 0;
+}
+
+
+/*
+ * adfDelFromCache
+ *
+ * delete one cache entry from its block. don't do 'records garbage collecting'
+ */
+RETCODE adfDelFromCache(struct Volume *vol, struct bEntryBlock *parent, 
+    SECTNUM headerKey)
+{
+    struct DirCache *dc;
+    struct DirCBlock *blk;
+    int offset, entryLen;
+    long i;
+    RETCODE rc;
+
+    dc = adfGetDirCache(vol, parent);
+    if (!dc)
+        return RC_ERROR;
+
+    blk = adfDirCacheFindKey(dc, headerKey, TRUE);
+    if (blk==NULL || (offset=adfDirCacheFindRecord(blk, headerKey, &entryLen))==-1) {
+        (*adfEnv.wFct)("adfDelFromCache : entry not found");
+        return RC_OK;
+    }
+
+    /* switch the following records, and clear the freed bytes */
+    memmove(blk->dirc.records+offset, blk->dirc.records+offset+entryLen, 
+        blk->used-offset-entryLen);
+    memset(blk->dirc.records+blk->used-entryLen, 0, entryLen);
+    blk->used -= entryLen;
+    blk->dirc.recordsNb--;
+    blk->dirty = TRUE;
+
+    /* an empty block is removed from the chain, except the first one */
+    if (blk->dirc.recordsNb==0 && blk!=dc->blocks[0]) {
+        for(i=1; dc->blocks[i]!=blk; i++);
+        dc->blocks[i-1]->dirc.nextDirC = blk->dirc.nextDirC;
+        dc->blocks[i-1]->dirty = TRUE;
+        memmove(dc->blocks+i, dc->blocks+i+1, (dc->nbBlocks-i-1)*sizeof(struct DirCBlock*));
+        dc->nbBlocks--;
+
+        rc = adfSetBlockFree(vol, blk->sect);
+        free(blk);
+        adfUpdateBitmap(vol);
+        return rc;
+    }
+
+    return RC_OK;
+}
+
+
 /*
  * adfAddInCache
  *
+ * the record is appended to the tail block of the dircache model
  */
 RETCODE adfAddInCache(struct Volume *vol, struct bEntryBlock *parent, 
     struct bEntryBlock *entry)
 {
-    struct bDirCacheBlock dirc, newDirc;
-    SECTNUM nSect, nCache;
-    struct CacheEntry caEntry, newEntry;
-    int offset, n;
-    int entryLen;
+    struct DirCache *dc;
+    struct DirCBlock *blk, *tail;
+    SECTNUM nCache;
+    struct CacheEntry newEntry;
+    int offset, entryLen;
 
     entryLen = adfEntry2CacheEntry(entry, &newEntry);
 
@@ -361,49 +733,13 @@ RETCODE adfAddInCache(struct Volume *vol, struct bEntryBlock *parent,
 	newEntry.name, newEntry.comm);
 #endif /*_DEBUG_PRINTF_*/
 
-    nSect = parent->extension;
-    do {
-        if (adfReadDirCBlock(vol, nSect, &dirc)!=RC_OK)
-            return RC_ERROR;
-        offset = 0; n = 0;
-
-#ifdef _DEBUG_PRINTF_
-	printf("parent=%4ld\n",dirc.parent);
-#endif /*_DEBUG_PRINTF_*/
-
-        while(n < dirc.recordsNb) {
-            adfGetCacheEntry(&dirc, &offset, &caEntry);
-
-#ifdef _DEBUG_PRINTF_
-			printf("*%4ld %2d %6ld %8lx %4d %2d:%02d:%02d %30s %22s\n",
-					caEntry.header, caEntry.type, caEntry.size, caEntry.protect,
-					caEntry.days, caEntry.mins/60, caEntry.mins%60, 
-					caEntry.ticks/50,
-					caEntry.name, caEntry.comm);
-#endif /*_DEBUG_PRINTF_*/
+    dc = adfGetDirCache(vol, parent);
+    if (!dc)
+        return RC_ERROR;
 
-            n++;
-        }
-        
-/*        if (offset+entryLen<=488) {
-            adfPutCacheEntry(&dirc, &offset, &newEntry);
-            dirc.recordsNb++;
-            adfWriteDirCBlock(vol, dirc.headerKey, &dirc);
-            return rc;
-        }*/
-        nSect = dirc.nextDirC;
-    }while(nSect!=0);
-
-    /* in the last block */
-    if (offset+entryLen<=488) {
-        adfPutCacheEntry(&dirc, &offset, &newEntry);
-        dirc.recordsNb++;
-
-#ifdef _DEBUG_PRINTF_
-		printf("entry name=%s\n",newEntry.name);
-#endif /*_DEBUG_PRINTF_*/
-
-    }
+    tail = dc->blocks[dc->nbBlocks-1];
+    if (tail->used+entryLen<=488)
+        blk = tail;
     else {
         /* request one new block free */
         nCache = adfGet1FreeBlock(vol);
@@ -412,37 +748,41 @@ RETCODE adfAddInCache(struct Volume *vol, struct bEntryBlock *parent,
            return RC_VOLFULL;
         }
 
+        blk = adfDirCacheAddBlock(dc, nCache);
+        if (!blk) {
+            (*adfEnv.eFct)("adfAddInCache : malloc");
+            adfSetBlockFree(vol, nCache);
+            return RC_MALLOC;
+        }
+
         /* create a new dircache block */
-        memset(&newDirc,0,512);
+        memset(&(blk->dirc),0,512);
         if (parent->secType==ST_ROOT)
-            newDirc.parent = vol->rootBlock;
+            blk->dirc.parent = vol->rootBlock;
         else if (parent->secType==ST_DIR)
-            newDirc.parent = parent->headerKey;
+            blk->dirc.parent = parent->headerKey;
         else
             (*adfEnv.wFct)("adfAddInCache : unknown secType");
-        newDirc.recordsNb = 0L;
-        newDirc.nextDirC = 0L;
-
-        adfPutCacheEntry(&dirc, &offset, &newEntry);
-        newDirc.recordsNb++;
-        if (adfWriteDirCBlock(vol, nCache, &newDirc)!=RC_OK)
-			return RC_ERROR;
-        dirc.nextDirC = nCache;
-    }
+        blk->dirc.type = T_DIRC;
+        blk->dirc.headerKey = nCache;
+        blk->dirc.recordsNb = 0L;
+        blk->dirc.nextDirC = 0L;
 
-#ifdef _DEBUG_PRINTF_
-	printf("dirc.headerKey=%ld\n",dirc.headerKey);
-#endif /*_DEBUG_PRINTF_*/
+        tail->dirc.nextDirC = nCache;
+        tail->dirty = TRUE;
+    }
 
-    if (adfWriteDirCBlock(vol, dirc.headerKey, &dirc)!=RC_OK)
-		return RC_ERROR;
+    offset = blk->used;
+    adfPutCacheEntry(&(blk->dirc), &offset, &newEntry);
+    blk->used += entryLen;
+    blk->dirc.recordsNb++;
+    blk->dirty = TRUE;
 
 #ifdef _DEBUG_PRINTF_
-	if (strcmp(entry->name,"file_5u")==0)
-		dumpBlock(dirc.records);
+	printf("entry name=%s dirc=%ld\n",newEntry.name,blk->sect);
 #endif /*_DEBUG_PRINTF_*/
 
-    return RC_OK;
+    return adfDirCacheAddKey(dc, newEntry.header, blk);
 }
 
 
@@ -453,99 +793,52 @@ RETCODE adfAddInCache(struct Volume *vol, struct bEntryBlock *parent,
 RETCODE adfUpdateCache(struct Volume *vol, struct bEntryBlock *parent, 
     struct bEntryBlock *entry, BOOL entryLenChg)
 {
-    struct bDirCacheBlock dirc;
-    SECTNUM nSect;
-    struct CacheEntry caEntry, newEntry;
-    int offset, oldOffset, n;
-    BOOL found;
-    int i, oLen, nLen;
-    int sLen; /* shift length */
+    struct DirCache *dc;
+    struct DirCBlock *blk;
+    struct CacheEntry newEntry;
+    int offset, oLen, nLen;
 
     nLen = adfEntry2CacheEntry(entry, &newEntry);
 
-    nSect = parent->extension;
-    found = FALSE;
-    do {
-
-#ifdef _DEBUG_PRINTF_
-	printf("dirc=%ld\n",nSect);
-#endif /*_DEBUG_PRINTF_*/
+    dc = adfGetDirCache(vol, parent);
+    if (!dc)
+        return RC_ERROR;
 
-        if (adfReadDirCBlock(vol, nSect, &dirc)!=RC_OK)
-			return RC_ERROR;
-        offset = 0; n = 0;
-        /* search entry to update with its header_key */
-        while(n < dirc.recordsNb && !found) {
-            oldOffset = offset;
-            /* offset is updated */
-            adfGetCacheEntry(&dirc, &offset, &caEntry);
-            oLen = offset-oldOffset;
-            sLen = oLen-nLen;
+    blk = adfDirCacheFindKey(dc, newEntry.header, FALSE);
+    if (blk==NULL || (offset=adfDirCacheFindRecord(blk, newEntry.header, &oLen))==-1) {
+        (*adfEnv.wFct)("adfUpdateCache : entry not found");
+        return RC_OK;
+    }
 
 #ifdef _DEBUG_PRINTF_
 	printf("olen=%d nlen=%d\n",oLen,nLen);
 #endif /*_DEBUG_PRINTF_*/
 
-            found = (caEntry.header==newEntry.header);
-            if (found) {
-                if (!entryLenChg || oLen==nLen) {
-                    /* same length : remplace the old values */
-                    adfPutCacheEntry(&dirc, &oldOffset, &newEntry);
-
-#ifdef _DEBUG_PRINTF_
-					if(entryLenChg)
-						puts("oLen==nLen");
-#endif /*_DEBUG_PRINTF_*/
-
-                    if (adfWriteDirCBlock(vol, dirc.headerKey, &dirc)!=RC_OK)
-                        return RC_ERROR;
-                }
-                else if (oLen>nLen) {
-
-#ifdef _DEBUG_PRINTF_
-					puts("oLen>nLen");
-#endif /*_DEBUG_PRINTF_*/
-
-                    /* the new record is shorter, write it, 
-                     * then shift down the following records 
-                     */
-                    adfPutCacheEntry(&dirc, &oldOffset, &newEntry);
-                    for(i=oldOffset+nLen; i<(488-sLen); i++)
-                        dirc.records[i] = dirc.records[i+sLen];
-                    /* then clear the following bytes */
-                    for(i=488-sLen; i<488; i++)
-                        dirc.records[i] = (char)0;
-
-                    if (adfWriteDirCBlock(vol, dirc.headerKey, &dirc)!=RC_OK)
-                        return RC_ERROR;
-                }
-                else {
-                    /* the new record is larger */
-
-#ifdef _DEBUG_PRINTF_
-					puts("oLen<nLen");
-#endif /*_DEBUG_PRINTF_*/
-
-                    adfDelFromCache(vol,parent,entry->headerKey);
-                    adfAddInCache(vol,parent,entry);
-
-#ifdef _DEBUG_PRINTF_
-					puts("oLen<nLen end");
-#endif /*_DEBUG_PRINTF_*/
-
-                }
-            }
-            n++;
-        }
-        nSect = dirc.nextDirC;
-    }while(nSect!=0 && !found);
-
-    if (found) {
-        if (adfUpdateBitmap(vol)!=RC_OK)
-			return RC_ERROR;
+    if (!entryLenChg || oLen==nLen) {
+        /* same length : remplace the old values */
+        adfPutCacheEntry(&(blk->dirc), &offset, &newEntry);
+        blk->dirty = TRUE;
     }
-    else
-        (*adfEnv.wFct)("adfUpdateCache : entry not found");
+    else if (blk->used-oLen+nLen<=488) {
+        /* still fits in its block : shift the following records, then write it */
+        memmove(blk->dirc.records+offset+nLen, blk->dirc.records+offset+oLen,
+            blk->used-offset-oLen);
+        if (nLen<oLen)
+            memset(blk->dirc.records+blk->used-oLen+nLen, 0, oLen-nLen);
+        blk->used += nLen-oLen;
+        adfPutCacheEntry(&(blk->dirc), &offset, &newEntry);
+        blk->dirty = TRUE;
+    }
+    else {
+        /* the new record is larger than the free space of the block */
+        if (adfDelFromCache(vol,parent,entry->headerKey)!=RC_OK)
+            return RC_ERROR;
+        if (adfAddInCache(vol,parent,entry)!=RC_OK)
+            return RC_ERROR;
+    }
+
+    if (adfUpdateBitmap(vol)!=RC_OK)
+        return RC_ERROR;
 
     return RC_OK;
 }
@@ -645,7 +938,7 @@ RETCODE adfWriteDirCBlock(struct Volume* vol, long nSect, struct bDirCacheBlock*
     swLong(buf+20,newSum);
 /*    *(long*)(buf+20) = swapLong((unsigned char*)&newSum);*/
 
-    if (adfWriteBlock(vol, nSect, buf)!=RC_OK)
+    if (adfWriteMetaBlock(vol, nSect, buf)!=RC_OK)
 		return RC_ERROR;
 
 #ifdef _DEBUG_PRINTF_
@@ -8,18 +8,29 @@
  */
 
 
+#include"prefix.h"
+
 #include "adf_str.h"
 
 void adfGetCacheEntry(struct bDirCacheBlock *dirc, int *p, struct CacheEntry *cEntry);
 int adfPutCacheEntry( struct bDirCacheBlock *dirc, int *p, struct CacheEntry *cEntry);
+int adfEntry2CacheEntry(struct bEntryBlock *entry, struct CacheEntry *newEntry);
 
-struct List* adfGetDirEntCache(struct Volume *vol, SECTNUM dir, BOOL recurs);
+struct List* adfGetDirEntCache(struct Volume *vol, SECTNUM dir, BOOL recurs, struct Arena *arena);
+void adfCacheEntry2Entry(struct CacheEntry *caEntry, SECTNUM dir, struct Entry *entry);
 
 RETCODE adfCreateEmptyCache(struct Volume *vol, struct bEntryBlock *parent, SECTNUM nSect);
 RETCODE adfAddInCache(struct Volume *vol, struct bEntryBlock *parent, struct bEntryBlock *entry);
 RETCODE adfUpdateCache(struct Volume *vol, struct bEntryBlock *parent, struct bEntryBlock *entry, BOOL);
 RETCODE adfDelFromCache(struct Volume *vol, struct bEntryBlock *parent, SECTNUM);
 
+struct DirCache* adfGetDirCache(struct Volume *vol, struct bEntryBlock *parent);
+void adfDropDirCache(struct Volume *vol, SECTNUM first);
+void adfReleaseDirCache(struct Volume *vol, struct DirCache *dc);
+struct DirCache* adfFindDirCache(struct Volume *vol, SECTNUM first);
+PREFIX RETCODE adfFlushDirCache(struct Volume *vol);
+void adfFreeDirCache(struct Volume *vol);
+
 RETCODE adfReadDirCBlock(struct Volume *vol, SECTNUM nSect, struct bDirCacheBlock *dirc);
 RETCODE adfWriteDirCBlock(struct Volume*, long, struct bDirCacheBlock* dirc);
 
@@ -0,0 +1,610 @@
+/*
+ *  ADF Library. (C) 1997-2002 Laurent Clevy
+ */
+/*! \file	adf_defrag.c
+ *  \brief	Volume optimizer.
+ *
+ *	adfDefragVolume() moves in place the extension and data blocks of each file into one run
+ *	of free blocks, then rebuilds the bitmap. adfDefragCopy() writes the whole volume into
+ *	a new image with adfBuildImage(), the directory blocks grouped near the root block.
+ */
+
+#include<stdio.h>
+#include<stdlib.h>
+#include<string.h>
+
+#include"adf_defs.h"
+#include"adf_str.h"
+#include"adf_defrag.h"
+#include"adf_build.h"
+#include"adf_raw.h"
+#include"adf_util.h"
+#include"adf_disk.h"
+#include"adf_dir.h"
+#include"adf_file.h"
+#include"adf_bitm.h"
+#include"adf_cache.h"
+#include"defendian.h"
+
+extern struct Env adfEnv;
+
+
+/* a file of adfDefragCopy() */
+struct DefragFile{
+    struct Volume *vol;
+    SECTNUM parent;
+    struct File *file;
+};
+
+
+/*
+ * adfDefragIsDone
+ *
+ * TRUE if the extension blocks and then the data blocks follow each other
+ */
+static BOOL adfDefragIsDone(struct FileBlocks *fb)
+{
+    SECTNUM next;
+    long i;
+
+    next = -1;
+    for(i=0; i<fb->nbExtens; i++) {
+        if (next!=-1 && fb->extens[i]!=next)
+            return FALSE;
+        next = fb->extens[i]+1;
+    }
+    for(i=0; i<fb->nbData; i++) {
+        if (next!=-1 && fb->data[i]!=next)
+            return FALSE;
+        next = fb->data[i]+1;
+    }
+
+    return TRUE;
+}
+
+
+/*
+ * adfDefragIsFree
+ *
+ */
+static BOOL adfDefragIsFree(struct Volume *vol, SECTNUM start, long nb)
+{
+    long i;
+
+    if (start<2 || start+nb>vol->lastBlock-vol->firstBlock+1)
+        return FALSE;
+    for(i=0; i<nb; i++)
+        if (!adfIsBlockFree(vol, start+i))
+            return FALSE;
+
+    return TRUE;
+}
+
+
+/*
+ * adfDefragFindRun
+ *
+ * 'nb' free blocks that follow each other : after 'hint' if possible, else the first ones
+ * from the root block up to the end of the volume, then from the start. -1 if none
+ */
+static SECTNUM adfDefragFindRun(struct Volume *vol, long nb, SECTNUM hint)
+{
+    SECTNUM sect, start, end;
+    long len;
+    int pass;
+
+    if (adfDefragIsFree(vol, hint, nb))
+        return hint;
+
+    for(pass=0; pass<2; pass++) {
+        start = pass==0 ? vol->rootBlock+1 : 2;
+        end = pass==0 ? vol->lastBlock-vol->firstBlock+1 : vol->rootBlock;
+        len = 0;
+        for(sect=start; sect<end; sect++) {
+            if (adfIsBlockFree(vol, sect))
+                len++;
+            else
+                len = 0;
+            if (len==nb)
+                return sect-nb+1;
+        }
+    }
+
+    return -1;
+}
+
+
+/*
+ * adfDefragData
+ *
+ * copies the data blocks of a file to the sectors 'first' and following
+ */
+static RETCODE adfDefragData(struct Volume *vol, struct FileBlocks *fb, SECTNUM first)
+{
+    unsigned char *buf;
+    unsigned long newSum;
+    long i, j, nb, run;
+
+    buf = (unsigned char*)malloc(LOGICAL_BLOCK_SIZE*FILE_MAXRUN);
+    if (!buf) {
+        (*adfEnv.eFct)("adfDefragData : malloc");
+        return RC_MALLOC;
+    }
+
+    for(i=0; i<fb->nbData; i+=nb) {
+        nb = fb->nbData-i<FILE_MAXRUN ? fb->nbData-i : FILE_MAXRUN;
+        /* the old blocks that follow each other are read at once */
+        for(j=0; j<nb; j+=run) {
+            run = 1;
+            while(j+run<nb && fb->data[i+j+run]==fb->data[i+j]+run)
+                run++;
+            if (adfReadBlocks(vol, fb->data[i+j], run, buf+j*LOGICAL_BLOCK_SIZE)!=RC_OK) {
+                free(buf);
+                return RC_ERROR;
+            }
+        }
+        /* the next data block of the OFS ones */
+        if (isOFS(vol->dosType))
+            for(j=0; j<nb; j++) {
+                swLong(buf+j*LOGICAL_BLOCK_SIZE+16, i+j+1<fb->nbData ? first+i+j+1 : 0);
+                newSum = adfNormalSum(buf+j*LOGICAL_BLOCK_SIZE, 20, LOGICAL_BLOCK_SIZE);
+                swLong(buf+j*LOGICAL_BLOCK_SIZE+20, newSum);
+            }
+        if (adfWriteBlocks(vol, first+i, nb, buf)!=RC_OK) {
+            free(buf);
+            return RC_ERROR;
+        }
+    }
+    free(buf);
+
+    return RC_OK;
+}
+
+
+/*
+ * adfDefragFile
+ *
+ * moves the extension and data blocks of a file into one run of free blocks. the new blocks
+ * are written before the file header block, and the old ones are freed after it
+ */
+static RETCODE adfDefragFile(struct Volume *vol, SECTNUM nSect, struct bFileHeaderBlock *fhdr,
+    long *nbMoved)
+{
+    struct FileBlocks fb;
+    struct bFileExtBlock fext;
+    SECTNUM first, firstData;
+    long i, k, nb;
+    RETCODE rc;
+
+    if (adfGetFileBlocks(vol, fhdr, &fb)!=RC_OK)
+        return RC_ERROR;
+
+    nb = fb.nbExtens+fb.nbData;
+    first = -1;
+    if (nb>0 && !adfDefragIsDone(&fb))
+        first = adfDefragFindRun(vol, nb, nSect+1);
+    /* already done, or no room yet */
+    if (first==-1) {
+        free(fb.data);
+        free(fb.extens);
+        return RC_OK;
+    }
+    firstData = first+fb.nbExtens;
+
+    rc = adfDefragData(vol, &fb, firstData);
+
+    for(i=0; i<fb.nbExtens && rc==RC_OK; i++) {
+        rc = adfReadFileExtBlock(vol, fb.extens[i], &fext);
+        if (rc!=RC_OK)
+            break;
+        fext.headerKey = first+i;
+        for(k=0; k<fext.highSeq; k++)
+            fext.dataBlocks[MAX_DATABLK-1-k] = firstData+MAX_DATABLK*(i+1)+k;
+        fext.extension = i+1<fb.nbExtens ? first+i+1 : 0;
+        rc = adfWriteFileExtBlock(vol, first+i, &fext);
+    }
+
+    for(i=0; i<nb && rc==RC_OK; i++)
+        rc = adfSetBlockUsed(vol, first+i);
+
+    if (rc==RC_OK) {
+        fhdr->firstData = fb.nbData>0 ? firstData : 0;
+        for(k=0; k<fhdr->highSeq; k++)
+            fhdr->dataBlocks[MAX_DATABLK-1-k] = firstData+k;
+        fhdr->extension = fb.nbExtens>0 ? first : 0;
+        rc = adfWriteFileHdrBlock(vol, nSect, fhdr);
+    }
+
+    /* the file is moved, even if the bitmap of an old block can't be read */
+    if (rc==RC_OK) {
+        (*nbMoved)++;
+        for(i=0; i<fb.nbData && rc==RC_OK; i++)
+            rc = adfSetBlockFree(vol, fb.data[i]);
+        for(i=0; i<fb.nbExtens && rc==RC_OK; i++)
+            rc = adfSetBlockFree(vol, fb.extens[i]);
+    }
+    /* the file still uses its old blocks */
+    else
+        for(i=0; i<nb; i++)
+            adfSetBlockFree(vol, first+i);
+
+    free(fb.data);
+    free(fb.extens);
+
+    return rc;
+}
+
+
+/*
+ * adfDefragDir
+ *
+ * the files of a directory and of its subdirectories
+ */
+static RETCODE adfDefragDir(struct Volume *vol, long *hashTable, long *nbMoved)
+{
+    struct bEntryBlock entry;
+    SECTNUM nSect;
+    int i;
+
+    for(i=0; i<HT_SIZE; i++) {
+        nSect = hashTable[i];
+        while(nSect!=0) {
+            if (adfReadEntryBlock(vol, nSect, &entry)!=RC_OK)
+                return RC_ERROR;
+            if (entry.secType==ST_FILE) {
+                if (adfDefragFile(vol, nSect, (struct bFileHeaderBlock*)&entry, nbMoved)!=RC_OK)
+                    return RC_ERROR;
+            }
+            else if (entry.secType==ST_DIR)
+                if (adfDefragDir(vol, entry.hashTable, nbMoved)!=RC_OK)
+                    return RC_ERROR;
+            nSect = entry.nextSameHash;
+        }
+    }
+
+    return RC_OK;
+}
+
+
+/*
+ * adfDefragMark
+ *
+ * the blocks used by the entries of a directory and of its subdirectories. a block out of
+ * the volume or used twice is an invalid tree
+ */
+static RETCODE adfDefragMark(struct Volume *vol, long *hashTable, unsigned char *used)
+{
+    struct bEntryBlock entry;
+    struct bDirCacheBlock dirc;
+    struct FileBlocks fb;
+    SECTNUM nSect, cSect, s;
+    long j;
+    int i;
+    RETCODE rc;
+
+    for(i=0; i<HT_SIZE; i++) {
+        nSect = hashTable[i];
+        while(nSect!=0) {
+            if (!isSectNumValid(vol, nSect) || used[nSect]
+                || adfReadEntryBlock(vol, nSect, &entry)!=RC_OK)
+                return RC_ERROR;
+            used[nSect] = 1;
+            if (entry.secType==ST_FILE) {
+                if (adfGetFileBlocks(vol, (struct bFileHeaderBlock*)&entry, &fb)!=RC_OK)
+                    return RC_ERROR;
+                rc = RC_OK;
+                for(j=0; j<fb.nbData+fb.nbExtens && rc==RC_OK; j++) {
+                    s = j<fb.nbData ? fb.data[j] : fb.extens[j-fb.nbData];
+                    if (!isSectNumValid(vol, s) || used[s])
+                        rc = RC_ERROR;
+                    else
+                        used[s] = 1;
+                }
+                free(fb.data);
+                free(fb.extens);
+                if (rc!=RC_OK)
+                    return rc;
+            }
+            else if (entry.secType==ST_DIR) {
+                if (isDIRCACHE(vol->dosType))
+                    for(cSect=entry.extension; cSect!=0; cSect=dirc.nextDirC) {
+                        if (!isSectNumValid(vol, cSect) || used[cSect]
+                            || adfReadDirCBlock(vol, cSect, &dirc)!=RC_OK)
+                            return RC_ERROR;
+                        used[cSect] = 1;
+                    }
+                if (adfDefragMark(vol, entry.hashTable, used)!=RC_OK)
+                    return RC_ERROR;
+            }
+            nSect = entry.nextSameHash;
+        }
+    }
+
+    return RC_OK;
+}
+
+
+/*
+ * adfDefragBitmap
+ *
+ * rebuilds the bitmap from the blocks used by the directory tree. the blocks lost by
+ * interrupted writes are freed
+ */
+static RETCODE adfDefragBitmap(struct Volume *vol, struct bRootBlock *root)
+{
+    struct bBitmapExtBlock bitme;
+    struct bDirCacheBlock dirc;
+    unsigned char *used;
+    SECTNUM sect;
+    long i, nbBlocks;
+    RETCODE rc;
+
+    nbBlocks = vol->lastBlock-vol->firstBlock+1;
+    used = (unsigned char*)calloc(nbBlocks, 1);
+    if (!used) {
+        (*adfEnv.eFct)("adfDefragBitmap : malloc");
+        return RC_MALLOC;
+    }
+
+    used[vol->rootBlock] = 1;
+    for(i=0; i<vol->bitmapSize; i++)
+        used[vol->bitmapBlocks[i]] = 1;
+    rc = RC_OK;
+    for(sect=root->bmExt; sect!=0 && rc==RC_OK; sect=bitme.nextBlock) {
+        if (!isSectNumValid(vol, sect) || used[sect])
+            rc = RC_ERROR;
+        else
+            rc = adfReadBitmapExtBlock(vol, sect, &bitme);
+        used[sect] = 1;
+    }
+    if (isDIRCACHE(vol->dosType))
+        for(sect=root->extension; sect!=0 && rc==RC_OK; sect=dirc.nextDirC) {
+            if (!isSectNumValid(vol, sect) || used[sect])
+                rc = RC_ERROR;
+            else
+                rc = adfReadDirCBlock(vol, sect, &dirc);
+            used[sect] = 1;
+        }
+    if (rc==RC_OK)
+        rc = adfDefragMark(vol, root->hashTable, used);
+
+    /* nothing is freed if the tree can't be read */
+    if (rc!=RC_OK)
+        (*adfEnv.wFct)("adfDefragBitmap : invalid directory tree, bitmap not rebuilt");
+    else
+        for(sect=2; sect<nbBlocks && rc==RC_OK; sect++) {
+            if (used[sect] && adfIsBlockFree(vol, sect))
+                rc = adfSetBlockUsed(vol, sect);
+            else if (!used[sect] && !adfIsBlockFree(vol, sect))
+                rc = adfSetBlockFree(vol, sect);
+        }
+    free(used);
+
+    return rc;
+}
+
+
+/*
+ * adfDefragVolume
+ */
+/*!	\brief	Make the files of a volume contiguous, in place.
+ *	\param	vol     - the volume, mounted read-write.
+ *	\param	nbMoved - if not NULL, receives the number of files moved.
+ *	\return	RC_OK, RC_ERROR.
+ *
+ *	The extension blocks and the data blocks of each file are moved into one run of free blocks,
+ *	just after the file header if possible. The files that don't fit in a run are tried again
+ *	after the others have been moved. Then the bitmap is rebuilt from the directory tree.
+ *
+ *	\b Internals \n
+ *	The bitmap is marked invalid first, as AmigaDOS does while it writes. The new blocks of
+ *	a file are written before its header block, which is the only block pointing to them, so
+ *	an interruption leaves each file with either its old blocks or its new ones.
+ */
+RETCODE adfDefragVolume(struct Volume *vol, long *nbMoved)
+{
+    struct bRootBlock root;
+    long moved, total;
+    int pass;
+    RETCODE rc;
+
+    if (vol->readOnly || vol->session) {
+        (*adfEnv.wFct)("adfDefragVolume : read only volume, or session opened");
+        return RC_ERROR;
+    }
+
+    /* the dircache chains are read from the disk */
+    if (adfFlushDirCache(vol)!=RC_OK)
+        return RC_ERROR;
+    if (adfReadRootBlock(vol, vol->rootBlock, &root)!=RC_OK)
+        return RC_ERROR;
+    root.bmFlag = BM_INVALID;
+    if (adfWriteRootBlock(vol, vol->rootBlock, &root)!=RC_OK)
+        return RC_ERROR;
+
+    total = 0;
+    rc = RC_OK;
+    for(pass=0; pass<DEFRAG_MAXPASS && rc==RC_OK; pass++) {
+        moved = 0;
+        rc = adfDefragDir(vol, root.hashTable, &moved);
+        total += moved;
+        if (moved==0)
+            break;
+    }
+
+    if (rc==RC_OK)
+        rc = adfDefragBitmap(vol, &root);
+    /* the bitmap kept up to date by the moves is still right */
+    if (adfUpdateBitmap(vol)!=RC_OK)
+        rc = RC_ERROR;
+
+    if (nbMoved)
+        *nbMoved = total;
+
+    return rc;
+}
+
+
+/*
+ * adfDefragRead
+ *
+ * reads a file of the volume copied by adfDefragCopy()
+ */
+static long adfDefragRead(struct BuildNode *node, unsigned long pos, long n, unsigned char *buf)
+{
+    struct DefragFile *df;
+    SECTNUM dir;
+    long len;
+
+    df = (struct DefragFile*)node->user;
+    if (!df->file) {
+        dir = df->vol->curDirPtr;
+        df->vol->curDirPtr = df->parent;
+        df->file = adfOpenFile(df->vol, node->name, "r");
+        df->vol->curDirPtr = dir;
+        if (!df->file)
+            return -1;
+    }
+    len = adfReadFile(df->file, n, buf);
+    if (pos+n>=node->size) {
+        adfCloseFile(df->file);
+        df->file = NULL;
+    }
+
+    return len;
+}
+
+
+/*
+ * adfDefragFreeTree
+ *
+ */
+static void adfDefragFreeTree(struct BuildNode *node)
+{
+    struct BuildNode *next;
+    struct DefragFile *df;
+
+    while(node) {
+        next = node->next;
+        adfDefragFreeTree(node->child);
+        df = (struct DefragFile*)node->user;
+        if (df && df->file)
+            adfCloseFile(df->file);
+        free(df);
+        free(node->name);
+        free(node->comment);
+        free(node);
+        node = next;
+    }
+}
+
+
+/*
+ * adfDefragTree
+ *
+ * the entries of a directory of the volume, and of its subdirectories
+ */
+static RETCODE adfDefragTree(struct Volume *vol, SECTNUM dir, struct BuildNode **first)
+{
+    struct List *list, *cell;
+    struct Entry *entry;
+    struct BuildNode *node;
+    struct DefragFile *df;
+    RETCODE rc;
+
+    *first = NULL;
+    list = adfGetDirEnt(vol, dir);
+    rc = RC_OK;
+    for(cell=list; cell && rc==RC_OK; cell=cell->next) {
+        entry = (struct Entry*)cell->content;
+        if (entry->type!=ST_FILE && entry->type!=ST_DIR) {
+            (*adfEnv.wFct)("adfDefragCopy : links are not copied");
+            continue;
+        }
+        node = (struct BuildNode*)calloc(1, sizeof(struct BuildNode));
+        df = (struct DefragFile*)calloc(1, sizeof(struct DefragFile));
+        if (!node || !df) {
+            (*adfEnv.eFct)("adfDefragTree : malloc");
+            free(node); free(df);
+            rc = RC_MALLOC;
+            break;
+        }
+        node->next = *first;
+        *first = node;
+        node->user = df;
+        df->vol = vol;
+        df->parent = dir;
+
+        node->name = strdup(entry->name);
+        if (entry->comment && strlen(entry->comment)>0)
+            node->comment = strdup(entry->comment);
+        if (!node->name || (entry->comment && strlen(entry->comment)>0 && !node->comment)) {
+            (*adfEnv.eFct)("adfDefragTree : malloc");
+            rc = RC_MALLOC;
+            break;
+        }
+        node->type = entry->type;
+        node->size = entry->type==ST_FILE ? entry->size : 0;
+        node->access = entry->access;
+        node->date.year = entry->year-1900;
+        node->date.mon = entry->month;
+        node->date.day = entry->days;
+        node->date.hour = entry->hour;
+        node->date.min = entry->mins;
+        node->date.sec = entry->secs;
+        if (entry->type==ST_DIR)
+            rc = adfDefragTree(vol, entry->sector, &(node->child));
+    }
+    adfFreeDirList(list);
+
+    return rc;
+}
+
+
+/*
+ * adfDefragCopy
+ */
+/*!	\brief	Write an optimized copy of a volume into a new image.
+ *	\param	vol      - the volume.
+ *	\param	filename - the image to create.
+ *	\return	RC_OK, RC_ERROR, RC_MALLOC, RC_VOLFULL.
+ *
+ *	The new image has the same size, name, type, boot block and entries. It is written
+ *	by adfBuildImage() : the directory blocks are grouped near the root block, the blocks of
+ *	each file are contiguous, and the bitmap is new. The links are not copied.
+ */
+RETCODE adfDefragCopy(struct Volume *vol, char *filename)
+{
+    struct BuildImage img;
+    struct bRootBlock root;
+    struct bBootBlock boot;
+    unsigned char bootBuf[LOGICAL_BLOCK_SIZE*2];
+    int year;
+    RETCODE rc;
+
+    if (adfReadRootBlock(vol, vol->rootBlock, &root)!=RC_OK)
+        return RC_ERROR;
+
+    memset(&img, 0, sizeof(struct BuildImage));
+    img.volName = vol->volName ? vol->volName : "";
+    img.volType = vol->dosType;
+    img.nbBlocks = vol->lastBlock-vol->firstBlock+1;
+    adfDays2Date(root.days, &year, &(img.date.mon), &(img.date.day));
+    img.date.year = year-1900;
+    img.date.hour = root.mins/60;
+    img.date.min = root.mins%60;
+    img.date.sec = root.ticks/50;
+    if (adfReadBootBlock(vol, &boot)==RC_OK && boot.data[0]!=0
+        && adfReadBlocks(vol, 0, 2, bootBuf)==RC_OK)
+        img.bootCode = bootBuf;
+    img.readFct = adfDefragRead;
+
+    rc = adfDefragTree(vol, vol->rootBlock, &(img.root));
+    if (rc==RC_OK)
+        rc = adfBuildImage(&img, filename);
+    adfDefragFreeTree(img.root);
+
+    return rc;
+}
+
+/*##########################################################################*/
@@ -0,0 +1,21 @@
+#ifndef ADF_DEFRAG_H
+#define ADF_DEFRAG_H 1
+
+/*
+ *  ADF Library. (C) 1997-2002 Laurent Clevy
+ */
+/*! \file	adf_defrag.h
+ *  \brief	Volume optimizer header.
+ */
+
+#include"prefix.h"
+
+#include"adf_str.h"
+
+#define DEFRAG_MAXPASS  4       /* passes of adfDefragVolume() over the files */
+
+PREFIX RETCODE adfDefragVolume(struct Volume *vol, long *nbMoved);
+PREFIX RETCODE adfDefragCopy(struct Volume *vol, char *filename);
+
+#endif /* ADF_DEFRAG_H */
+/*##########################################################################*/
@@ -15,6 +15,15 @@
 #define SECTNUM long									/*!< Sector Number.		*/
 #define RETCODE long									/*!< Return Code.		*/
 
+/* byte offsets and sizes of devices, 64 bits wide even where long is 32 bits */
+#ifndef ADFOFF
+#ifdef _MSC_VER
+#define ADFOFF __int64									/*!< Device offset.		*/
+#else
+#define ADFOFF long long								/*!< Device offset.		*/
+#endif
+#endif
+
 #define TRUE    1										/*!< Boolean true.		*/
 #define FALSE   0										/*!< Boolean false.		*/
 
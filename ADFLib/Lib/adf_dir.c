@@ -184,6 +184,7 @@ RETCODE adfRemoveEntry(struct Volume *vol, SECTNUM pSect, char *name)
     SECTNUM nSect2, nSect;
     int hashVal;
     BOOL intl;
+    RETCODE rc;
 
     if (adfReadEntryBlock( vol, pSect, &parent )!=RC_OK)
 		return RC_ERROR;
@@ -224,16 +225,21 @@ RETCODE adfRemoveEntry(struct Volume *vol, SECTNUM pSect, char *name)
 			return RC_ERROR;
     }
 
+    /* the entry is unlinked : its blocks are freed as far as the bitmap can be read */
+    rc = RC_OK;
     if (entry.secType==ST_FILE) {
-        adfFreeFileBlocks(vol, (struct bFileHeaderBlock*)&entry);
+        rc = adfFreeFileBlocks(vol, (struct bFileHeaderBlock*)&entry);
         if (adfEnv.useNotify)
              (*adfEnv.notifyFct)(pSect,ST_FILE);
     }
     else if (entry.secType==ST_DIR) {
-        adfSetBlockFree(vol, nSect);
+        rc = adfSetBlockFree(vol, nSect);
         /* free dir cache block : the directory must be empty, so there's only one cache block */
-        if (isDIRCACHE(vol->dosType))
-            adfSetBlockFree(vol, entry.extension);
+        if (isDIRCACHE(vol->dosType)) {
+            adfDropDirCache(vol, entry.extension);
+            if (adfSetBlockFree(vol, entry.extension)!=RC_OK)
+                rc = RC_ERROR;
+        }
         if (adfEnv.useNotify)
             (*adfEnv.notifyFct)(pSect,ST_DIR);
     }
@@ -247,7 +253,7 @@ RETCODE adfRemoveEntry(struct Volume *vol, SECTNUM pSect, char *name)
 
     adfUpdateBitmap(vol);
 
-    return RC_OK;
+    return rc;
 }
 
 
@@ -370,15 +376,300 @@ void adfFreeDirList(struct List* list)
 
 
 /*
- * adfGetRDirEnt
+ * adfDirNewEntry
+ *
+ * the allocations of a listing come from the arena when there is one, from malloc() otherwise
  */
-/*	\brief	Returns a linked list which contains the entries of one directory.
- *	\param	vol		- A pointer to the volume structure.
- *	\param	nSect	- SECTNUM at which the entry resides.
- *	\param	recurs	- TRUE to recurse into sub-directories, FALSE if not.
- *	\return	The list, NULL in case of error.
+struct Entry* adfDirNewEntry(struct Arena *arena)
+{
+    struct Entry *entry;
+
+    if (arena)
+        return (struct Entry*)adfArenaAlloc(arena, sizeof(struct Entry));
+
+    entry = (struct Entry *)malloc(sizeof(struct Entry));
+    if (!entry)
+        (*adfEnv.eFct)("adfGetDirEnt : malloc");
+    return entry;
+}
+
+
+/*
+ * adfDirNewCell
+ *
  */
-struct List* adfGetRDirEnt(struct Volume* vol, SECTNUM nSect, BOOL recurs )
+struct List* adfDirNewCell(struct Arena *arena, struct List* list, void* content)
+{
+    struct List* cell;
+
+    if (!arena)
+        return newCell(list, content);
+
+    cell = (struct List*)adfArenaAlloc(arena, sizeof(struct List));
+    if (!cell)
+        return NULL;
+    cell->content = content;
+    cell->next = cell->subdir = 0;
+    if (list!=NULL)
+        list->next = cell;
+
+    return cell;
+}
+
+
+/*
+ * adfDirStrDup
+ *
+ */
+char* adfDirStrDup(struct Arena *arena, char *str)
+{
+    if (arena)
+        return adfArenaIntern(arena, str);
+    return strdup(str);
+}
+
+
+/*
+ * adfDirFreeList
+ *
+ * frees a partial listing after an error. Nothing to do for an arena, freed at once later
+ */
+void adfDirFreeList(struct Arena *arena, struct List* list)
+{
+    if (arena)
+        arena->failed = TRUE;
+    else
+        adfFreeDirList(list);
+}
+
+
+/*
+ * adfSeekCmpSect
+ *
+ */
+static int adfSeekCmpSect(const void *a, const void *b)
+{
+    SECTNUM sa = ((struct SeekItem*)a)->sect, sb = ((struct SeekItem*)b)->sect;
+
+    return (sa>sb) - (sa<sb);
+}
+
+
+/*
+ * adfSeekCmpPos
+ *
+ * the listing order : by directory, then hash table slot, then same hash chain
+ */
+static int adfSeekCmpPos(const void *a, const void *b)
+{
+    struct SeekItem *ia = (struct SeekItem*)a, *ib = (struct SeekItem*)b;
+
+    if (ia->dir!=ib->dir)
+        return (ia->dir>ib->dir) - (ia->dir<ib->dir);
+    if (ia->slot!=ib->slot)
+        return ia->slot - ib->slot;
+    return (ia->rank>ib->rank) - (ia->rank<ib->rank);
+}
+
+
+/*
+ * adfSeekAdd
+ *
+ */
+static RETCODE adfSeekAdd(struct SeekList *sl, SECTNUM sect, long dir, int slot, long rank,
+    struct List *parent)
+{
+    struct SeekItem *items;
+    struct SeekItem *item;
+    long max;
+
+    if (sl->nbItems==sl->maxItems) {
+        max = sl->maxItems ? 2*sl->maxItems : 256;
+        items = (struct SeekItem*)realloc(sl->items, max*sizeof(struct SeekItem));
+        if (!items) {
+            (*adfEnv.eFct)("adfGetSortedDirEnt : malloc");
+            return RC_MALLOC;
+        }
+        sl->items = items;
+        sl->maxItems = max;
+    }
+    item = &(sl->items[sl->nbItems++]);
+    item->sect = sect;
+    item->dir = dir;
+    item->slot = slot;
+    item->rank = rank;
+    item->parent = parent;
+    item->cell = NULL;
+
+    return RC_OK;
+}
+
+
+/*
+ * adfSeekFree
+ *
+ * after an error : the cells are not linked yet
+ */
+static void adfSeekFree(struct SeekList *sl, struct Arena *arena)
+{
+    long i;
+
+    if (arena)
+        arena->failed = TRUE;
+    else
+        for(i=0; i<sl->nbItems; i++)
+            if (sl->items[i].cell) {
+                adfFreeEntry((struct Entry*)sl->items[i].cell->content);
+                free(sl->items[i].cell);
+            }
+    free(sl->items);
+}
+
+
+/*
+ * adfSeekRead
+ *
+ * reads the entry of one item, and queues the blocks it points to
+ */
+static RETCODE adfSeekRead(struct SeekList *sl, long i, unsigned char *buf, BOOL recurs,
+    struct Arena *arena)
+{
+    struct bEntryBlock entryBlk;
+    struct Entry *entry;
+    struct List *cell;
+    long dir;
+    int j;
+
+    if (adfBuf2EntryBlock(buf, &entryBlk)!=RC_OK)
+        return RC_ERROR;
+
+    entry = adfDirNewEntry(arena);
+    if (!entry)
+        return RC_MALLOC;
+    if (adfEntBlock2ArenaEntry(&entryBlk, entry, arena)!=RC_OK) {
+        if (!arena) free(entry);
+        return RC_MALLOC;
+    }
+    entry->sector = sl->items[i].sect;
+
+    cell = adfDirNewCell(arena, NULL, (void*)entry);
+    if (!cell) {
+        if (!arena) adfFreeEntry(entry);
+        return RC_MALLOC;
+    }
+    sl->items[i].cell = cell;
+
+    /* the next one in the same hash chain */
+    if (entryBlk.nextSameHash!=0)
+        if (adfSeekAdd(sl, entryBlk.nextSameHash, sl->items[i].dir, sl->items[i].slot,
+            sl->items[i].rank+1, sl->items[i].parent)!=RC_OK)
+            return RC_MALLOC;
+
+    /* the hash table of a directory is already there */
+    if (recurs && entry->type==ST_DIR) {
+        dir = sl->nbDirs++;
+        for(j=0; j<HT_SIZE; j++)
+            if (entryBlk.hashTable[j]!=0)
+                if (adfSeekAdd(sl, entryBlk.hashTable[j], dir, j, 0, cell)!=RC_OK)
+                    return RC_MALLOC;
+    }
+
+    return RC_OK;
+}
+
+
+/*
+ * adfGetSortedDirEnt
+ *
+ * builds the same listing as adfGetArenaDirEnt(), but reads the blocks by ascending sector
+ * numbers : the pending blocks of one pass are sorted, and the close ones are read at once.
+ * the blocks found during a pass are read by the next one
+ */
+struct List* adfGetSortedDirEnt(struct Volume* vol, SECTNUM nSect, BOOL recurs,
+    struct Arena *arena)
+{
+    struct bEntryBlock parent;
+    struct SeekList sl;
+    struct List *head, *prev;
+    unsigned char *buf;
+    long start, end, i, k, m;
+    SECTNUM first, last;
+    RETCODE rc;
+
+    if (adfReadEntryBlock(vol,nSect,&parent)!=RC_OK) {
+        adfDirFreeList(arena, NULL);
+		return NULL;
+    }
+    buf = (unsigned char*)malloc(512*SEEK_MAXRUN);
+    if (!buf) {
+        (*adfEnv.eFct)("adfGetSortedDirEnt : malloc");
+        adfDirFreeList(arena, NULL);
+        return NULL;
+    }
+
+    sl.nbItems = sl.maxItems = 0;
+    sl.items = NULL;
+    sl.nbDirs = 1;
+    rc = RC_OK;
+    for(i=0; i<HT_SIZE && rc==RC_OK; i++)
+        if (parent.hashTable[i]!=0)
+            rc = adfSeekAdd(&sl, parent.hashTable[i], 0, (int)i, 0, NULL);
+
+    start = 0;
+    while(start<sl.nbItems && rc==RC_OK) {
+        /* one pass */
+        end = sl.nbItems;
+        qsort(sl.items+start, end-start, sizeof(struct SeekItem), adfSeekCmpSect);
+        k = start;
+        while(k<end && rc==RC_OK) {
+            /* one run : a small gap costs less than a seek */
+            first = last = sl.items[k].sect;
+            m = k+1;
+            while(m<end && sl.items[m].sect-last<=SEEK_MAXGAP
+                && sl.items[m].sect-first<SEEK_MAXRUN) {
+                last = sl.items[m].sect;
+                m++;
+            }
+            rc = adfReadBlocks(vol, first, last-first+1, buf);
+            for(i=k; i<m && rc==RC_OK; i++)
+                rc = adfSeekRead(&sl, i, buf+512*(sl.items[i].sect-first), recurs, arena);
+            k = m;
+        }
+        start = end;
+    }
+    free(buf);
+    if (rc!=RC_OK) {
+        adfSeekFree(&sl, arena);
+        return NULL;
+    }
+
+    /* links the cells in the listing order */
+    qsort(sl.items, sl.nbItems, sizeof(struct SeekItem), adfSeekCmpPos);
+    head = prev = NULL;
+    for(i=0; i<sl.nbItems; i++) {
+        if (i==0 || sl.items[i].dir!=sl.items[i-1].dir) {
+            if (sl.items[i].parent)
+                sl.items[i].parent->subdir = sl.items[i].cell;
+            else
+                head = sl.items[i].cell;
+        }
+        else
+            prev->next = sl.items[i].cell;
+        prev = sl.items[i].cell;
+    }
+    free(sl.items);
+
+    return head;
+}
+
+
+/*
+ * adfGetArenaDirEnt
+ *
+ * builds the listing of one directory, recursively or not, in 'arena' or with malloc()
+ */
+struct List* adfGetArenaDirEnt(struct Volume* vol, SECTNUM nSect, BOOL recurs, 
+    struct Arena *arena)
 {
     struct bEntryBlock entryBlk;
 	struct List *cell, *head;
@@ -390,71 +681,53 @@ struct List* adfGetRDirEnt(struct Volume* vol, SECTNUM nSect, BOOL recurs )
 
 
     if (adfEnv.useDirCache && isDIRCACHE(vol->dosType))
-        return (adfGetDirEntCache(vol, nSect, recurs ));
+        return (adfGetDirEntCache(vol, nSect, recurs, arena));
+
+    if (adfEnv.seekOrder)
+        return (adfGetSortedDirEnt(vol, nSect, recurs, arena));
 
 
-    if (adfReadEntryBlock(vol,nSect,&parent)!=RC_OK)
+    if (adfReadEntryBlock(vol,nSect,&parent)!=RC_OK) {
+        adfDirFreeList(arena, NULL);
 		return NULL;
+    }
 
     hashTable = parent.hashTable;
     cell = head = NULL;
     for(i=0; i<HT_SIZE; i++) {
-        if (hashTable[i]!=0) {
-             entry = (struct Entry *)malloc(sizeof(struct Entry));
-             if (!entry) {
-                 adfFreeDirList(head);
-				 (*adfEnv.eFct)("adfGetDirEnt : malloc");
-                 return NULL;
-             }
-             if (adfReadEntryBlock(vol, hashTable[i], &entryBlk)!=RC_OK) {
-				 adfFreeDirList(head);
-                 return NULL;
-             }
-             if (adfEntBlock2Entry(&entryBlk, entry)!=RC_OK) {
-				 adfFreeDirList(head); return NULL;
-             }
-             entry->sector = hashTable[i];
-	
-             if (head==NULL)
-                 head = cell = newCell(0, (void*)entry);
-             else
-                 cell = newCell(cell, (void*)entry);
-             if (cell==NULL) {
-                 adfFreeDirList(head); return NULL;
-             }
-
-             if (recurs && entry->type==ST_DIR)
-                 cell->subdir = adfGetRDirEnt(vol,entry->sector,recurs);
-
-             /* same hashcode linked list */
-             nextSector = entryBlk.nextSameHash;
-             while( nextSector!=0 ) {
-                 entry = (struct Entry *)malloc(sizeof(struct Entry));
-                 if (!entry) {
-                     adfFreeDirList(head);
-					 (*adfEnv.eFct)("adfGetDirEnt : malloc");
-                     return NULL;
-                 }
-                 if (adfReadEntryBlock(vol, nextSector, &entryBlk)!=RC_OK) {
-					 adfFreeDirList(head); return NULL;
-                 }
-
-                 if (adfEntBlock2Entry(&entryBlk, entry)!=RC_OK) {
-					 adfFreeDirList(head);
-                     return NULL;
-                 }
-                 entry->sector = nextSector;
-	
-                 cell = newCell(cell, (void*)entry);
-                 if (cell==NULL) {
-                     adfFreeDirList(head); return NULL;
-                 }
-				 
-                 if (recurs && entry->type==ST_DIR)
-                     cell->subdir = adfGetRDirEnt(vol,entry->sector,recurs);
-				 
-                 nextSector = entryBlk.nextSameHash;
-             }
+        /* the hashTable entry, then the same hashcode linked list */
+        nextSector = hashTable[i];
+        while( nextSector!=0 ) {
+            entry = adfDirNewEntry(arena);
+            if (!entry) {
+                adfDirFreeList(arena, head);
+                return NULL;
+            }
+            if (adfReadEntryBlock(vol, nextSector, &entryBlk)!=RC_OK) {
+                if (!arena) free(entry);
+                adfDirFreeList(arena, head);
+                return NULL;
+            }
+            if (adfEntBlock2ArenaEntry(&entryBlk, entry, arena)!=RC_OK) {
+                if (!arena) free(entry);
+                adfDirFreeList(arena, head);
+                return NULL;
+            }
+            entry->sector = nextSector;
+
+            cell = adfDirNewCell(arena, cell, (void*)entry);
+            if (cell==NULL) {
+                if (!arena) adfFreeEntry(entry);
+                adfDirFreeList(arena, head);
+                return NULL;
+            }
+            if (head==NULL)
+                head = cell;
+
+            if (recurs && entry->type==ST_DIR)
+                cell->subdir = adfGetArenaDirEnt(vol,entry->sector,recurs,arena);
+
+            nextSector = entryBlk.nextSameHash;
         }
     }
 
@@ -465,6 +738,283 @@ struct List* adfGetRDirEnt(struct Volume* vol, SECTNUM nSect, BOOL recurs )
 }
 
 
+/*
+ * adfGetRDirEnt
+ */
+/*	\brief	Returns a linked list which contains the entries of one directory.
+ *	\param	vol		- A pointer to the volume structure.
+ *	\param	nSect	- SECTNUM at which the entry resides.
+ *	\param	recurs	- TRUE to recurse into sub-directories, FALSE if not.
+ *	\return	The list, NULL in case of error.
+ *
+ *	Each cell, entry and string is allocated on its own, and can be freed on its own.
+ *	\sa See adfGetDirTree() for big recursive listings.
+ */
+struct List* adfGetRDirEnt(struct Volume* vol, SECTNUM nSect, BOOL recurs )
+{
+    return adfGetArenaDirEnt(vol, nSect, recurs, NULL);
+}
+
+
+/*
+ * adfGetDirTree
+ */
+/*!	\brief	Returns the entries of one directory, held in a single arena.
+ *	\param	vol		- A pointer to the volume structure.
+ *	\param	nSect	- SECTNUM at which the directory resides.
+ *	\param	recurs	- TRUE to recurse into sub-directories, FALSE if not.
+ *	\return	The tree, NULL in case of error.
+ *
+ *	tree->list has the same layout as the list returned by adfGetRDirEnt(), but the cells,
+ *	the entries and the strings belong to the tree : they must not be freed or modified.
+ *	Equal names and comments share the same string.
+ *
+ *	\b Internals \n
+ *	The allocations are taken from a few large chunks, in listing order.
+ *	\sa See adfFreeDirTree() to free the tree.
+ */
+struct DirTree* adfGetDirTree(struct Volume* vol, SECTNUM nSect, BOOL recurs)
+{
+    struct DirTree *tree;
+
+    tree = (struct DirTree*)malloc(sizeof(struct DirTree));
+    if (!tree) {
+        (*adfEnv.eFct)("adfGetDirTree : malloc");
+        return NULL;
+    }
+    adfArenaInit(&(tree->arena));
+
+    tree->list = adfGetArenaDirEnt(vol, nSect, recurs, &(tree->arena));
+    if (tree->arena.failed) {
+        adfFreeDirTree(tree);
+        return NULL;
+    }
+
+    return tree;
+}
+
+
+/*
+ * adfFreeDirTree
+ */
+/*!	\brief	Frees a tree returned by adfGetDirTree().
+ *	\param	tree - The tree.
+ *	\return	Void.
+ *
+ *	The cost doesn't depend on the number of entries : only the arena chunks are freed.
+ */
+void adfFreeDirTree(struct DirTree* tree)
+{
+    if (tree==NULL)
+        return;
+    adfArenaFree(&(tree->arena));
+    free(tree);
+}
+
+
+/*
+ * adfOpenDir
+ */
+/*!	\brief	Starts reading the entries of one directory, one at a time.
+ *	\param	vol		- A pointer to the volume structure.
+ *	\param	nSect	- SECTNUM of the directory.
+ *	\return	The iterator, NULL in case of error.
+ *
+ *	Unlike adfGetDirEnt(), nothing is allocated per entry : the memory used doesn't depend
+ *	on the size of the directory, and a caller which stops early reads no further blocks.
+ *
+ *	\b Internals \n
+ *	The iterator holds a copy of the directory block. It walks the hash table and the
+ *	same hash chains, or the chain of dircache blocks if it is used, one block at a time.
+ *	A dircache already parsed in memory is read there, as it may hold changes not written yet.
+ *	\sa See adfReadDir() and adfCloseDir().
+ */
+struct DirIter* adfOpenDir(struct Volume *vol, SECTNUM nSect)
+{
+    struct DirIter *it;
+
+    it = (struct DirIter*)malloc(sizeof(struct DirIter));
+    if (!it) {
+        (*adfEnv.eFct)("adfOpenDir : malloc");
+        return NULL;
+    }
+    if (adfReadEntryBlock(vol, nSect, &(it->parent))!=RC_OK) {
+        free(it);
+        return NULL;
+    }
+    if (it->parent.secType!=ST_ROOT && it->parent.secType!=ST_DIR) {
+        (*adfEnv.eFct)("adfOpenDir : not a directory");
+        free(it);
+        return NULL;
+    }
+    it->vol = vol;
+    it->dir = nSect;
+    it->useDirc = adfEnv.useDirCache && isDIRCACHE(vol->dosType);
+    it->slot = 0;
+    it->next = 0;
+    it->nextDirc = it->parent.extension;
+    it->nbDirc = 0;
+    it->blk = -1;
+    it->rec = it->offset = 0;
+    it->dirc.recordsNb = 0;
+    it->rc = RC_OK;
+
+    return it;
+}
+
+
+/*
+ * adfReadDir
+ */
+/*!	\brief	Returns the next entry of a directory opened with adfOpenDir().
+ *	\param	it - The iterator.
+ *	\return	The entry, NULL at the end of the directory or in case of error.
+ *
+ *	The entry and its strings belong to the iterator : they are overwritten by the next call.
+ *	it->rc is RC_OK at the end of the directory, the error code otherwise.
+ *	The directory must not be modified while it is read.
+ */
+struct Entry* adfReadDir(struct DirIter *it)
+{
+    struct bEntryBlock entryBlk;
+    struct DirCache *dc;
+    BOOL hasComm;
+
+    if (it->rc!=RC_OK)
+        return NULL;
+
+    if (it->useDirc) {
+        /* the next block with a record left : from the model in memory if there is one */
+        while (it->rec>=it->dirc.recordsNb) {
+            if (it->nextDirc==0 || it->nbDirc>it->vol->lastBlock-it->vol->firstBlock)
+                return NULL;
+            dc = adfFindDirCache(it->vol, it->parent.extension);
+            if (dc) {
+                if (it->blk+1>=dc->nbBlocks || dc->blocks[it->blk+1]->sect!=it->nextDirc)
+                    for(it->blk=0; it->blk<dc->nbBlocks
+                        && dc->blocks[it->blk]->sect!=it->nextDirc; it->blk++);
+                else
+                    it->blk++;
+                if (it->blk>=dc->nbBlocks) {
+                    it->rc = RC_ERROR;
+                    return NULL;
+                }
+                memcpy(&(it->dirc), &(dc->blocks[it->blk]->dirc), sizeof(struct bDirCacheBlock));
+            }
+            else if (adfReadDirCBlock(it->vol, it->nextDirc, &(it->dirc))!=RC_OK) {
+                it->rc = RC_ERROR;
+                return NULL;
+            }
+            it->nextDirc = it->dirc.nextDirC;
+            it->nbDirc++;
+            it->rec = it->offset = 0;
+        }
+        adfGetCacheEntry(&(it->dirc), &(it->offset), &(it->caEntry));
+        it->rec++;
+
+        adfCacheEntry2Entry(&(it->caEntry), it->dir, &(it->entry));
+        it->entry.name = it->caEntry.name;
+        it->entry.comment = it->caEntry.comm;
+
+        return &(it->entry);
+    }
+
+    /* the hashTable entry, then the same hashcode linked list */
+    while (it->next==0) {
+        if (it->slot>=HT_SIZE)
+            return NULL;
+        it->next = it->parent.hashTable[it->slot++];
+    }
+    if (adfReadEntryBlock(it->vol, it->next, &entryBlk)!=RC_OK) {
+        it->rc = RC_ERROR;
+        return NULL;
+    }
+    hasComm = adfEntBlock2Fields(&entryBlk, &(it->entry), it->name, it->comment);
+    it->entry.name = it->name;
+    it->entry.comment = hasComm ? it->comment : NULL;
+    it->entry.sector = it->next;
+
+    it->next = entryBlk.nextSameHash;
+
+    return &(it->entry);
+}
+
+
+/*
+ * adfCloseDir
+ */
+/*!	\brief	Frees an iterator returned by adfOpenDir().
+ *	\param	it - The iterator.
+ *	\return	Void.
+ */
+void adfCloseDir(struct DirIter *it)
+{
+    if (it)
+        free(it);
+}
+
+
+/*
+ * adfWalkDirLevel
+ *
+ * one iterator per level : the memory used depends on the depth only
+ */
+static RETCODE adfWalkDirLevel(struct Volume *vol, SECTNUM nSect, int depth,
+    BOOL (*walkFct)(struct Entry*, int, void*), void *data, BOOL *stop)
+{
+    struct DirIter *it;
+    struct Entry *entry;
+    RETCODE rc;
+
+    it = adfOpenDir(vol, nSect);
+    if (!it)
+        return RC_ERROR;
+
+    rc = RC_OK;
+    while (!*stop && (entry=adfReadDir(it))!=NULL) {
+        if (!(*walkFct)(entry, depth, data)) {
+            *stop = TRUE;
+            break;
+        }
+        if (entry->type==ST_DIR) {
+            rc = adfWalkDirLevel(vol, entry->sector, depth+1, walkFct, data, stop);
+            if (rc!=RC_OK)
+                break;
+        }
+    }
+    if (rc==RC_OK)
+        rc = it->rc;
+    adfCloseDir(it);
+
+    return rc;
+}
+
+
+/*
+ * adfWalkDir
+ */
+/*!	\brief	Calls a function for each entry of a directory and of its sub-directories.
+ *	\param	vol		- A pointer to the volume structure.
+ *	\param	nSect	- SECTNUM of the directory.
+ *	\param	walkFct	- Called with the entry, its depth (0 for the entries of nSect) and 'data'.
+ *					  Returns FALSE to stop the walk.
+ *	\param	data	- Passed to walkFct.
+ *	\return	RC_OK, also when walkFct stopped the walk, something different in case of error.
+ *
+ *	The entries of a sub-directory are given right after the sub-directory itself.
+ *	The entry is only valid during the call, and the directories must not be modified.
+ *	\sa See adfOpenDir().
+ */
+RETCODE adfWalkDir(struct Volume *vol, SECTNUM nSect,
+    BOOL (*walkFct)(struct Entry *entry, int depth, void *data), void *data)
+{
+    BOOL stop;
+
+    stop = FALSE;
+    return adfWalkDirLevel(vol, nSect, 0, walkFct, data, &stop);
+}
+
+
 /*
  * adfGetDirEnt
  */
@@ -573,21 +1123,32 @@ SECTNUM adfParentDir(struct Volume* vol)
  */
 RETCODE adfEntBlock2Entry(struct bEntryBlock *entryBlk, struct Entry *entry)
 {
-    char buf[MAXCMMTLEN+1];
+    return adfEntBlock2ArenaEntry(entryBlk, entry, NULL);
+}
+
+
+/*
+ * adfEntBlock2Fields
+ *
+ * fills 'entry' from an entry block, the name and the comment are copied into 'name' and 'comm'.
+ * returns TRUE if the entry type has a comment
+ */
+BOOL adfEntBlock2Fields(struct bEntryBlock *entryBlk, struct Entry *entry, char *name,
+    char *comm)
+{
     int len;
+    BOOL hasComm;
 
 	entry->type = entryBlk->secType;
     entry->parent = entryBlk->parent;
 
+    /* the names aren't terminated in the block : nameLen bytes, then the NUL */
     len = min(entryBlk->nameLen, MAXNAMELEN);
-    strncpy(buf, entryBlk->name, len);
-    buf[len] = '\0';
-    entry->name = strdup(buf);
-    if (entry->name==NULL)
-        return RC_MALLOC;
+    memcpy(name, entryBlk->name, len);
+    name[len] = '\0';
 
 #ifdef _DEBUG_PRINTF_
-	printf("len=%d name=%s parent=%ld\n",entryBlk->nameLen, entry->name,entry->parent );
+	printf("len=%d name=%s parent=%ld\n",entryBlk->nameLen, name,entry->parent );
 #endif /*_DEBUG_PRINTF_*/
 
     adfDays2Date( entryBlk->days, &(entry->year), &(entry->month), &(entry->days));
@@ -597,33 +1158,21 @@ RETCODE adfEntBlock2Entry(struct bEntryBlock *entryBlk, struct Entry *entry)
 
     entry->access = -1;
     entry->size = 0L;
-    entry->comment = NULL;
     entry->real = 0L;
+    hasComm = FALSE;
     switch(entryBlk->secType) {
     case ST_ROOT:
         break;
-    case ST_DIR:
-        entry->access = entryBlk->access;
-        len = min(entryBlk->commLen, MAXCMMTLEN);
-        strncpy(buf, entryBlk->comment, len);
-        buf[len] = '\0';
-        entry->comment = strdup(buf);
-        if (entry->comment==NULL) {
-            free(entry->name);
-            return RC_MALLOC;
-        }
-        break;
     case ST_FILE:
-        entry->access = entryBlk->access;
         entry->size = entryBlk->byteSize;
+    case ST_DIR:
+        entry->access = entryBlk->access;
         len = min(entryBlk->commLen, MAXCMMTLEN);
-        strncpy(buf, entryBlk->comment, len);
-        buf[len] = '\0';
-        entry->comment = strdup(buf);
-        if (entry->comment==NULL) {
-            free(entry->name);
-            return RC_MALLOC;
-        }
+        if (len<0)
+            len = 0;
+        memcpy(comm, entryBlk->comment, len);
+        comm[len] = '\0';
+        hasComm = TRUE;
         break;
     case ST_LFILE:
     case ST_LDIR:
@@ -633,6 +1182,36 @@ RETCODE adfEntBlock2Entry(struct bEntryBlock *entryBlk, struct Entry *entry)
     default:
         (*adfEnv.wFct)("unknown entry type");
     }
+
+    return hasComm;
+}
+
+
+/*
+ * adfEntBlock2ArenaEntry
+ *
+ * the strings are interned in 'arena', or strdup()'ed if it is NULL
+ */
+RETCODE adfEntBlock2ArenaEntry(struct bEntryBlock *entryBlk, struct Entry *entry,
+    struct Arena *arena)
+{
+    char name[MAXNAMELEN+1], comm[MAXCMMTLEN+1];
+    BOOL hasComm;
+
+    hasComm = adfEntBlock2Fields(entryBlk, entry, name, comm);
+
+    entry->name = adfDirStrDup(arena, name);
+    if (entry->name==NULL)
+        return RC_MALLOC;
+
+    entry->comment = NULL;
+    if (hasComm) {
+        entry->comment = adfDirStrDup(arena, comm);
+        if (entry->comment==NULL) {
+            if (!arena) free(entry->name);
+            return RC_MALLOC;
+        }
+    }
 	
     return RC_OK;
 }
@@ -1035,6 +1614,276 @@ RETCODE adfCreateFile(struct Volume* vol, SECTNUM nParent, char *name,
 }
 
 
+/*
+ * adfCheckNewNames
+ *
+ * the names of the batch must be valid, and unique in the batch and in the directory.
+ * each hash chain of 'parent' used by the batch is read once
+ */
+static RETCODE adfCheckNewNames(struct Volume *vol, struct bEntryBlock *parent,
+    struct NewEntry *entries, int nb, int *hashes, int *nextSameHash)
+{
+    struct bEntryBlock entry;
+    char upper[MAXNAMELEN+1], upper2[MAXNAMELEN+1], msg[MAXNAMELEN+50];
+    int first[HT_SIZE];
+    int i, j, len, h;
+    BOOL intl;
+    SECTNUM nSect;
+
+    intl = isINTL(vol->dosType) || isDIRCACHE(vol->dosType);
+    for(h=0; h<HT_SIZE; h++)
+        first[h] = -1;
+
+    for(i=0; i<nb; i++) {
+        len = strlen(entries[i].name);
+        if (len==0 || len>MAXNAMELEN
+            || (entries[i].type!=ST_FILE && entries[i].type!=ST_DIR)) {
+            (*adfEnv.wFct)("adfCreateEntries : invalid name or type");
+            return RC_ERROR;
+        }
+        h = adfGetHashValue((unsigned char*)entries[i].name, intl);
+        hashes[i] = h;
+        myToUpper((unsigned char*)upper, (unsigned char*)entries[i].name, len, intl);
+        for(j=first[h]; j!=-1; j=nextSameHash[j])
+            if ((int)strlen(entries[j].name)==len) {
+                myToUpper((unsigned char*)upper2, (unsigned char*)entries[j].name, len, intl);
+                if (strncmp(upper, upper2, len)==0) {
+                    sprintf(msg, "adfCreateEntries : \"%s\" twice", entries[i].name);
+                    (*adfEnv.wFct)(msg);
+                    return RC_ERROR;
+                }
+            }
+        nextSameHash[i] = first[h];
+        first[h] = i;
+    }
+
+    for(h=0; h<HT_SIZE; h++) {
+        if (first[h]==-1)
+            continue;
+        for(nSect=parent->hashTable[h]; nSect!=0; nSect=entry.nextSameHash) {
+            if (adfReadEntryBlock(vol, nSect, &entry)!=RC_OK)
+                return RC_ERROR;
+            /* a corrupt length can't match a new name, and would overflow upper2 */
+            if (entry.nameLen<=0 || entry.nameLen>MAXNAMELEN)
+                continue;
+            myToUpper((unsigned char*)upper2, (unsigned char*)entry.name, entry.nameLen, intl);
+            for(j=first[h]; j!=-1; j=nextSameHash[j])
+                if ((int)strlen(entries[j].name)==entry.nameLen) {
+                    myToUpper((unsigned char*)upper, (unsigned char*)entries[j].name,
+                        entry.nameLen, intl);
+                    if (strncmp(upper, upper2, entry.nameLen)==0) {
+                        sprintf(msg, "adfCreateEntries : \"%s\" already exists", entries[j].name);
+                        (*adfEnv.wFct)(msg);
+                        return RC_ERROR;
+                    }
+                }
+        }
+    }
+
+    return RC_OK;
+}
+
+
+/*
+ * adfCreateEntries
+ */
+/*!	\brief	Create many files and directories in one directory.
+ *	\param	vol     - the volume.
+ *	\param	nParent - the parent directory sector.
+ *	\param	entries - the entries to create. entries[i].sect receives the header block.
+ *	\param	nb      - the number of entries.
+ *	\return	RC_OK, RC_ERROR or RC_VOLFULL. Nothing is created if a name is invalid or already exists,
+ *			if the volume is full, or if a block can't be written.
+ *
+ *	The blocks of all the entries are allocated with one search of the bitmap, the files are
+ *	written with their content. The new headers are put at the start of their hash chain and the
+ *	dircache records are built in memory, so the parent block is written once. The metadata blocks
+ *	are written by a session, opened here if the caller has none. When a write fails, the parent
+ *	isn't written, the session opened here is dropped and the blocks of the batch are freed.
+ */
+RETCODE adfCreateEntries(struct Volume* vol, SECTNUM nParent, struct NewEntry *entries, int nb)
+{
+    struct bEntryBlock parent;
+    struct bFileHeaderBlock fhdr;
+    struct bFileExtBlock fext;
+    struct bDirBlock dir;
+    struct bRootBlock *root;
+    struct DateTime dt;
+    struct DirCache *dc;
+    SECTNUM *sects, *data, *ext;
+    int *hashes, *nextSameHash;
+    long total, dataN, extN, p, i, j, k, nbDirc;
+    BOOL opened;
+    RETCODE rc;
+
+    if (nb<=0)
+        return RC_OK;
+    if (vol->dev->readOnly || vol->readOnly) {
+        (*adfEnv.wFct)("adfCreateEntries : volume is mounted 'read only'");
+        return RC_ERROR;
+    }
+    if (adfReadEntryBlock(vol, nParent, &parent)!=RC_OK)
+        return RC_ERROR;
+    if (parent.secType!=ST_ROOT && parent.secType!=ST_DIR) {
+        (*adfEnv.wFct)("adfCreateEntries : parent is not a directory");
+        return RC_ERROR;
+    }
+
+    hashes = (int*)malloc(2*nb*sizeof(int));
+    if (!hashes) {
+        (*adfEnv.eFct)("adfCreateEntries : malloc");
+        return RC_MALLOC;
+    }
+    nextSameHash = hashes+nb;
+    if (adfCheckNewNames(vol, &parent, entries, nb, hashes, nextSameHash)!=RC_OK) {
+        free(hashes);
+        return RC_ERROR;
+    }
+
+    /* header, data and extension blocks of the files, header and dircache blocks of the dirs */
+    total = 0;
+    for(i=0; i<nb; i++)
+        if (entries[i].type==ST_FILE)
+            total += adfFileRealSize(entries[i].size, vol->datablockSize, NULL, NULL);
+        else
+            total += isDIRCACHE(vol->dosType) ? 2 : 1;
+    sects = (SECTNUM*)malloc(total*sizeof(SECTNUM));
+    if (!sects) {
+        (*adfEnv.eFct)("adfCreateEntries : malloc");
+        free(hashes);
+        return RC_MALLOC;
+    }
+    if (!adfGetFreeBlocks(vol, (int)total, sects)) {
+        (*adfEnv.wFct)("adfCreateEntries : not enough free blocks");
+        free(sects); free(hashes);
+        return RC_VOLFULL;
+    }
+
+    /* the dircache changes made before are written, so a failure drops only the batch ones */
+    rc = RC_OK;
+    dc = NULL;
+    nbDirc = 0;
+    if (isDIRCACHE(vol->dosType)) {
+        rc = adfFlushDirCache(vol);
+        if (rc==RC_OK && (dc=adfGetDirCache(vol, &parent))==NULL)
+            rc = RC_ERROR;
+        if (dc)
+            nbDirc = dc->nbBlocks;
+    }
+
+    opened = !vol->session;
+    if (opened && rc==RC_OK)
+        rc = adfBeginSession(vol);
+
+    dt = adfGiveCurrentTime();
+    p = 0;
+    for(i=0; i<nb && rc==RC_OK; i++) {
+        entries[i].sect = sects[p++];
+
+        if (entries[i].type==ST_FILE) {
+            adfFileRealSize(entries[i].size, vol->datablockSize, &dataN, &extN);
+            data = sects+p;
+            ext = data+dataN;
+            p += dataN+extN;
+
+            memset(&fhdr, 0, sizeof(struct bFileHeaderBlock));
+            fhdr.secType = ST_FILE;
+            fhdr.headerKey = entries[i].sect;
+            fhdr.highSeq = dataN<MAX_DATABLK ? dataN : MAX_DATABLK;
+            fhdr.firstData = dataN>0 ? data[0] : 0;
+            for(k=0; k<fhdr.highSeq; k++)
+                fhdr.dataBlocks[MAX_DATABLK-1-k] = data[k];
+            fhdr.access = entries[i].access;
+            fhdr.byteSize = entries[i].size;
+            adfTime2AmigaTime(dt, &(fhdr.days), &(fhdr.mins), &(fhdr.ticks));
+            fhdr.nameLen = strlen(entries[i].name);
+            memcpy(fhdr.fileName, entries[i].name, fhdr.nameLen);
+            fhdr.nextSameHash = parent.hashTable[hashes[i]];
+            fhdr.parent = parent.secType==ST_ROOT ? vol->rootBlock : parent.headerKey;
+            fhdr.extension = extN>0 ? ext[0] : 0;
+
+            for(j=0; j<extN && rc==RC_OK; j++) {
+                memset(&fext, 0, sizeof(struct bFileExtBlock));
+                fext.headerKey = ext[j];
+                fext.parent = entries[i].sect;
+                for(k=0; k<MAX_DATABLK && MAX_DATABLK*(j+1)+k<dataN; k++)
+                    fext.dataBlocks[MAX_DATABLK-1-k] = data[MAX_DATABLK*(j+1)+k];
+                fext.highSeq = k;
+                fext.extension = j+1<extN ? ext[j+1] : 0;
+                rc = adfWriteFileExtBlock(vol, ext[j], &fext);
+            }
+            if (rc==RC_OK && dataN>0)
+                rc = adfWriteFileData(vol, entries[i].sect, data, dataN,
+                    entries[i].data, entries[i].size);
+            if (rc==RC_OK)
+                rc = adfWriteFileHdrBlock(vol, entries[i].sect, &fhdr);
+            if (rc==RC_OK && isDIRCACHE(vol->dosType))
+                rc = adfAddInCache(vol, &parent, (struct bEntryBlock*)&fhdr);
+        }
+        else {
+            memset(&dir, 0, sizeof(struct bDirBlock));
+            dir.secType = ST_DIR;
+            dir.headerKey = entries[i].sect;
+            dir.access = entries[i].access;
+            adfTime2AmigaTime(dt, &(dir.days), &(dir.mins), &(dir.ticks));
+            dir.nameLen = strlen(entries[i].name);
+            memcpy(dir.dirName, entries[i].name, dir.nameLen);
+            dir.nextSameHash = parent.hashTable[hashes[i]];
+            dir.parent = parent.secType==ST_ROOT ? vol->rootBlock : parent.headerKey;
+
+            if (isDIRCACHE(vol->dosType)) {
+                rc = adfAddInCache(vol, &parent, (struct bEntryBlock*)&dir);
+                if (rc==RC_OK)
+                    rc = adfCreateEmptyCache(vol, (struct bEntryBlock*)&dir, sects[p++]);
+            }
+            if (rc==RC_OK)
+                rc = adfWriteDirBlock(vol, entries[i].sect, &dir);
+        }
+        parent.hashTable[hashes[i]] = entries[i].sect;
+    }
+
+    if (rc==RC_OK && parent.secType==ST_ROOT) {
+        root = (struct bRootBlock*)&parent;
+        adfTime2AmigaTime(dt, &(root->cDays), &(root->cMins), &(root->cTicks));
+        rc = adfWriteRootBlock(vol, vol->rootBlock, root);
+    }
+    else if (rc==RC_OK) {
+        adfTime2AmigaTime(dt, &(parent.days), &(parent.mins), &(parent.ticks));
+        rc = adfWriteDirBlock(vol, parent.headerKey, (struct bDirBlock*)&parent);
+    }
+
+    if (rc!=RC_OK) {
+        /* nothing is linked to the parent on the disk : the blocks of the batch are given back */
+        for(i=0; i<total; i++)
+            adfSetBlockFree(vol, sects[i]);
+        if (dc) {
+            for(k=nbDirc; k<dc->nbBlocks; k++) {
+                adfSessionDrop(vol, dc->blocks[k]->sect, 1);
+                adfSetBlockFree(vol, dc->blocks[k]->sect);
+            }
+            adfDropDirCache(vol, dc->first);
+        }
+        if (opened && vol->session)
+            adfDropSession(vol);
+        else
+            for(i=0; i<total; i++)
+                adfSessionDrop(vol, sects[i], 1);
+    }
+    else if (opened && adfCommitSession(vol)!=RC_OK)
+        rc = RC_ERROR;
+    adfUpdateBitmap(vol);
+
+    if (rc==RC_OK && adfEnv.useNotify)
+        for(i=0; i<nb; i++)
+            (*adfEnv.notifyFct)(nParent, entries[i].type);
+
+    free(sects);
+    free(hashes);
+
+    return rc;
+}
+
+
 /*
  * adfReadEntryBlock
  *
@@ -1046,15 +1895,31 @@ RETCODE adfReadEntryBlock(struct Volume* vol, SECTNUM nSect, struct bEntryBlock
     if (adfReadBlock(vol, nSect, buf)!=RC_OK)
         return RC_ERROR;
 
+#ifdef _DEBUG_PRINTF_
+	printf("readentry=%d\n",nSect);
+#endif /*_DEBUG_PRINTF_*/
+
+    return adfBuf2EntryBlock(buf, ent);
+}
+
+
+/*
+ * adfBuf2EntryBlock
+ *
+ * checks and converts an entry block read by the caller
+ */
+RETCODE adfBuf2EntryBlock(unsigned char *buf, struct bEntryBlock *ent)
+{
     memcpy(ent, buf, 512);
 #ifdef LITT_ENDIAN
     swapEndian((unsigned char*)ent, SWBL_ENTRY);
+    /* the rootblock has longs where the entries have the comment : bmPages[] and bmExt */
+    if (ent->secType==ST_ROOT) {
+        memcpy(ent, buf, 512);
+        swapEndian((unsigned char*)ent, SWBL_ROOT);
+    }
 #endif
 
-#ifdef _DEBUG_PRINTF_
-	printf("readentry=%d\n",nSect);
-#endif /*_DEBUG_PRINTF_*/
-
     if (ent->checkSum!=adfNormalSum((unsigned char*)buf,20,512)) {
         (*adfEnv.wFct)("adfReadEntryBlock : invalid checksum");
         return RC_ERROR;
@@ -1089,12 +1954,15 @@ RETCODE adfWriteEntryBlock(struct Volume* vol, SECTNUM nSect, struct bEntryBlock
     memcpy(buf, ent, sizeof(struct bEntryBlock));
 
 #ifdef LITT_ENDIAN
-    swapEndian(buf, SWBL_ENTRY);
+    if (ent->secType==ST_ROOT)
+        swapEndian(buf, SWBL_ROOT);
+    else
+        swapEndian(buf, SWBL_ENTRY);
 #endif
     newSum = adfNormalSum(buf,20,sizeof(struct bEntryBlock));
     swLong(buf+20, newSum);
 
-    if (adfWriteBlock(vol, nSect, buf)!=RC_OK)
+    if (adfWriteMetaBlock(vol, nSect, buf)!=RC_OK)
 		return RC_ERROR;
 
     return RC_OK;
@@ -1127,7 +1995,7 @@ RETCODE adfWriteDirBlock(struct Volume* vol, SECTNUM nSect, struct bDirBlock *di
     newSum = adfNormalSum(buf,20,sizeof(struct bDirBlock));
     swLong(buf+20, newSum);
 
-    if (adfWriteBlock(vol, nSect, buf)!=RC_OK)
+    if (adfWriteMetaBlock(vol, nSect, buf)!=RC_OK)
 		return RC_ERROR;
 
     return RC_OK;
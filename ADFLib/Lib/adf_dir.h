@@ -14,23 +14,63 @@
 
 #include"prefix.h"
 
+#define SEEK_MAXRUN		32		/* blocks read at once by adfGetSortedDirEnt()	*/
+#define SEEK_MAXGAP		4		/* unused blocks read rather than skipped		*/
+
+/*! \brief Pending block of a sector ordered listing */
+struct SeekItem{
+    SECTNUM sect;				/*!< Entry block.										*/
+    long dir;					/*!< Directory number, 0 for the listed directory.		*/
+    int slot;					/*!< Hash table slot.									*/
+    long rank;					/*!< Position in the same hash chain.					*/
+    struct List *parent;		/*!< Cell of the directory, NULL for the listed one.	*/
+    struct List *cell;			/*!< Cell of the entry, once read.						*/
+};
+
+/*! \brief Blocks of a sector ordered listing */
+struct SeekList{
+    long nbItems;				/*!< Blocks queued.										*/
+    long maxItems;				/*!< Size of items[].									*/
+    struct SeekItem *items;		/*!< The blocks, one pass after the other.				*/
+    long nbDirs;				/*!< Directories found.									*/
+};
+
 PREFIX RETCODE adfToRootDir(struct Volume *vol);
 BOOL isDirEmpty(struct bDirBlock *dir);
 PREFIX RETCODE adfRemoveEntry(struct Volume *vol, SECTNUM pSect, char *name);
 PREFIX struct List* adfGetDirEnt(struct Volume* vol, SECTNUM nSect );
 PREFIX struct List* adfGetRDirEnt(struct Volume* vol, SECTNUM nSect, BOOL recurs );
 PREFIX void adfFreeDirList(struct List* list);
+PREFIX struct DirTree* adfGetDirTree(struct Volume* vol, SECTNUM nSect, BOOL recurs);
+PREFIX void adfFreeDirTree(struct DirTree* tree);
+PREFIX struct DirIter* adfOpenDir(struct Volume *vol, SECTNUM nSect);
+PREFIX struct Entry* adfReadDir(struct DirIter *it);
+PREFIX void adfCloseDir(struct DirIter *it);
+PREFIX RETCODE adfWalkDir(struct Volume *vol, SECTNUM nSect,
+    BOOL (*walkFct)(struct Entry *entry, int depth, void *data), void *data);
+struct List* adfGetArenaDirEnt(struct Volume* vol, SECTNUM nSect, BOOL recurs, struct Arena *arena);
+struct List* adfGetSortedDirEnt(struct Volume* vol, SECTNUM nSect, BOOL recurs,
+    struct Arena *arena);
+struct Entry* adfDirNewEntry(struct Arena *arena);
+struct List* adfDirNewCell(struct Arena *arena, struct List* list, void* content);
+char* adfDirStrDup(struct Arena *arena, char *str);
+void adfDirFreeList(struct Arena *arena, struct List* list);
 
 RETCODE adfEntBlock2Entry(struct bEntryBlock *entryBlk, struct Entry *entry);
+BOOL adfEntBlock2Fields(struct bEntryBlock *entryBlk, struct Entry *entry, char *name,
+    char *comm);
+RETCODE adfEntBlock2ArenaEntry(struct bEntryBlock *entryBlk, struct Entry *entry, struct Arena *arena);
 PREFIX void adfFreeEntry(struct Entry *entry);
 RETCODE adfCreateFile(struct Volume* vol, SECTNUM parent, char *name,
     struct bFileHeaderBlock *fhdr);
 PREFIX RETCODE adfCreateDir(struct Volume* vol, SECTNUM parent, char* name);
+PREFIX RETCODE adfCreateEntries(struct Volume* vol, SECTNUM parent, struct NewEntry *entries, int nb);
 SECTNUM adfCreateEntry(struct Volume *vol, struct bEntryBlock *dir, char *name, SECTNUM );
 PREFIX RETCODE adfRenameEntry(struct Volume *vol, SECTNUM, char *old,SECTNUM,char *new);
 
 
 RETCODE adfReadEntryBlock(struct Volume* vol, SECTNUM nSect, struct bEntryBlock* ent);
+RETCODE adfBuf2EntryBlock(unsigned char *buf, struct bEntryBlock *ent);
 RETCODE adfWriteDirBlock(struct Volume* vol, SECTNUM nSect, struct bDirBlock *dir);
 RETCODE adfWriteEntryBlock(struct Volume* vol, SECTNUM nSect, struct bEntryBlock *ent);
 
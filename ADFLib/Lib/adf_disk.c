@@ -167,7 +167,7 @@ void adfVolumeInfo(struct Volume *vol)
  *	\b Internals \n
  *	1. Read the bootblock to determine vol->dosType and vol->datablockSize. \n
  *	2. Read the rootblock, fills vol->curDirPtr. \n
- *	3. Read and allocate the bitmap : vol->bitmapBlocks[], vol->bitmapTable[], vol->bitmapSize, vol->bitmapBlocksChg[]. \n
+ *	3. Allocate the bitmap : vol->bitmapBlocks[], vol->bitmapTable[], vol->bitmapSize, vol->bitmapBlocksChg[]. The bitmap blocks are read on first use. \n
  */
 struct Volume* adfMount( struct Device *dev, int nPart, BOOL readOnly )
 {
@@ -230,7 +230,8 @@ struct Volume* adfMount( struct Device *dev, int nPart, BOOL readOnly )
  *	\param	vol - the volume to dismount.
  *	\return	Void.
  *
- *	Release a Volume. Free the bitmap structures. Free the current directory.
+ *	Release a Volume. Write back the modified dircache blocks. Free the bitmap structures.
+ *	Free the current directory.
  */
 void adfUnMount(struct Volume *vol)
 {
@@ -239,6 +240,12 @@ void adfUnMount(struct Volume *vol)
         return;
     }
 
+    adfCommitSession(vol);
+
+    /* the dircache blocks are written lazily */
+    adfFlushDirCache(vol);
+    adfFreeDirCache(vol);
+
     adfFreeBitmap(vol);
 
     vol->mounted = FALSE;
@@ -275,6 +282,13 @@ struct Volume* adfCreateVol( struct Device* dev, long start, long len,
     }
 	
     vol->dev = dev;
+    vol->dirCache = NULL;
+    vol->dirCacheSize = 0;
+    vol->nbDirCache = 0;
+    vol->session = FALSE;
+    vol->nbMeta = 0;
+    vol->metaHashSize = 0;
+    vol->metaHash = NULL;
     vol->firstBlock = (dev->heads * dev->sectors)*start;
     vol->lastBlock = (vol->firstBlock + (dev->heads * dev->sectors)*len)-1;
     vol->rootBlock = (vol->lastBlock - vol->firstBlock+1)/2;
@@ -435,6 +449,10 @@ RETCODE adfReadBlock(struct Volume* vol, long nSect, unsigned char* buf)
 	printf("pSect R =%ld\n",pSect);
 #endif /*_DEBUG_PRINTF_*/
 
+    /* written during the session, not yet on the disk */
+    if (vol->nbMeta>0 && adfSessionCopy(vol, nSect, 1, buf)==1)
+        return RC_OK;
+
     nFct = adfEnv.nativeFct;
     if (vol->dev->isNativeDev)
         rc = (*nFct->adfNativeReadSector)(vol->dev, pSect, 512, buf);
@@ -452,6 +470,58 @@ RETCODE adfReadBlock(struct Volume* vol, long nSect, unsigned char* buf)
 }
 
 
+/*
+ * adfReadBlocks
+ */
+/*!	\brief	Read consecutive logical blocks.
+ *	\param	vol   - the parent volume.
+ *	\param	nSect - the location of the first block.
+ *	\param	nb    - the number of blocks.
+ *	\param	buf   - a buffer of nb*512 bytes to receive the read data.
+ *	\return	RC_OK or RC_ERROR.
+ *
+ *	The blocks are read with one access to the native or dump device, so a
+ *	track or a whole floppy can be read at once.
+ */
+RETCODE adfReadBlocks(struct Volume* vol, long nSect, int nb, unsigned char* buf)
+{
+    long pSect;
+    struct nativeFunctions *nFct;
+    RETCODE rc;
+    int i;
+
+    if (!vol->mounted) {
+        (*adfEnv.eFct)("the volume isn't mounted, adfReadBlocks not possible");
+        return RC_ERROR;
+    }
+
+    pSect = nSect+vol->firstBlock;
+
+    if (adfEnv.useRWAccess)
+        for(i=0; i<nb; i++)
+            (*adfEnv.rwhAccess)(pSect+i,nSect+i,FALSE);
+
+    if (nb<1 || nSect<0 || pSect+nb-1>vol->lastBlock) {
+        (*adfEnv.wFct)("adfReadBlocks : nSect out of range");
+        return RC_ERROR;
+    }
+
+    nFct = adfEnv.nativeFct;
+    if (vol->dev->isNativeDev)
+        rc = (*nFct->adfNativeReadSector)(vol->dev, pSect, 512*nb, buf);
+    else
+        rc = adfReadDumpSector(vol->dev, pSect, 512*nb, buf);
+
+    if (rc!=RC_OK)
+        return RC_ERROR;
+
+    if (vol->nbMeta>0)
+        adfSessionCopy(vol, nSect, nb, buf);
+
+    return RC_OK;
+}
+
+
 /*
  * adfWriteBlock
  */
@@ -496,6 +566,10 @@ RETCODE adfWriteBlock(struct Volume* vol, long nSect, unsigned char *buf)
 	printf("nativ=%d\n",vol->dev->isNativeDev);
 #endif /*_DEBUG_PRINTF_*/
 
+    /* the block is no longer metadata of the session */
+    if (vol->nbMeta>0)
+        adfSessionDrop(vol, nSect, 1);
+
     if (vol->dev->isNativeDev)
         rc = (*nFct->adfNativeWriteSector)(vol->dev, pSect, 512, buf);
     else
@@ -508,5 +582,329 @@ RETCODE adfWriteBlock(struct Volume* vol, long nSect, unsigned char *buf)
 }
 
 
+/*
+ * adfWriteBlocks
+ */
+/*!	\brief	Write consecutive logical blocks.
+ *	\param	vol   - the parent volume.
+ *	\param	nSect - the location of the first block.
+ *	\param	nb    - the number of blocks.
+ *	\param	buf   - a buffer containing the nb*512 bytes to write.
+ *	\return	RC_OK or RC_ERROR.
+ *
+ *	The blocks are written with one access to the native or dump device.
+ */
+RETCODE adfWriteBlocks(struct Volume* vol, long nSect, int nb, unsigned char *buf)
+{
+    long pSect;
+    struct nativeFunctions *nFct;
+    RETCODE rc;
+    int i;
+
+    if (!vol->mounted) {
+        (*adfEnv.eFct)("the volume isn't mounted, adfWriteBlocks not possible");
+        return RC_ERROR;
+    }
+
+    if (vol->readOnly) {
+        (*adfEnv.wFct)("adfWriteBlocks : can't write block, read only volume");
+        return RC_ERROR;
+    }
+
+    pSect = nSect+vol->firstBlock;
+
+    if (adfEnv.useRWAccess)
+        for(i=0; i<nb; i++)
+            (*adfEnv.rwhAccess)(pSect+i,nSect+i,TRUE);
+
+    if (nb<1 || nSect<0 || pSect+nb-1>vol->lastBlock) {
+        (*adfEnv.wFct)("adfWriteBlocks : nSect out of range");
+        return RC_ERROR;
+    }
+
+    if (vol->nbMeta>0)
+        adfSessionDrop(vol, nSect, nb);
+
+    nFct = adfEnv.nativeFct;
+    if (vol->dev->isNativeDev)
+        rc = (*nFct->adfNativeWriteSector)(vol->dev, pSect, 512*nb, buf);
+    else
+        rc = adfWriteDumpSector(vol->dev, pSect, 512*nb, buf);
+
+    if (rc!=RC_OK)
+        return RC_ERROR;
+    else
+        return RC_OK;
+}
+
+
+
+/*
+ * adfSessionFind
+ *
+ * the link to the block 'nSect' in vol->metaHash[], or to the NULL ending its chain
+ */
+static struct MetaBlock** adfSessionFind(struct Volume *vol, SECTNUM nSect)
+{
+    struct MetaBlock **link;
+
+    link = &(vol->metaHash[nSect & (vol->metaHashSize-1)]);
+    while(*link!=NULL && (*link)->sect!=nSect)
+        link = &((*link)->next);
+
+    return link;
+}
+
+
+/*
+ * adfSessionPut
+ *
+ */
+static RETCODE adfSessionPut(struct Volume *vol, SECTNUM nSect, unsigned char *buf)
+{
+    struct MetaBlock **link, **newHash, *blk, *next;
+    long i, newSize;
+
+    /* keeps at most one block per bucket on average */
+    if (vol->nbMeta>=vol->metaHashSize) {
+        newSize = vol->metaHashSize ? vol->metaHashSize*2 : 256;
+        newHash = (struct MetaBlock**)calloc(newSize, sizeof(struct MetaBlock*));
+        if (!newHash) {
+            (*adfEnv.eFct)("adfSessionPut : malloc");
+            return RC_MALLOC;
+        }
+        for(i=0; i<vol->metaHashSize; i++)
+            for(blk=vol->metaHash[i]; blk!=NULL; blk=next) {
+                next = blk->next;
+                blk->next = newHash[blk->sect & (newSize-1)];
+                newHash[blk->sect & (newSize-1)] = blk;
+            }
+        free(vol->metaHash);
+        vol->metaHash = newHash;
+        vol->metaHashSize = newSize;
+    }
+
+    link = adfSessionFind(vol, nSect);
+    if (*link==NULL) {
+        blk = (struct MetaBlock*)malloc(sizeof(struct MetaBlock));
+        if (!blk) {
+            (*adfEnv.eFct)("adfSessionPut : malloc");
+            return RC_MALLOC;
+        }
+        blk->sect = nSect;
+        blk->next = NULL;
+        *link = blk;
+        vol->nbMeta++;
+    }
+    memcpy((*link)->data, buf, LOGICAL_BLOCK_SIZE);
+
+    return RC_OK;
+}
+
+
+/*
+ * adfSessionDrop
+ *
+ */
+void adfSessionDrop(struct Volume *vol, SECTNUM nSect, int nb)
+{
+    struct MetaBlock **link, *blk;
+    int i;
+
+    for(i=0; i<nb && vol->nbMeta>0; i++) {
+        link = adfSessionFind(vol, nSect+i);
+        if (*link!=NULL) {
+            blk = *link;
+            *link = blk->next;
+            free(blk);
+            vol->nbMeta--;
+        }
+    }
+}
+
+
+/*
+ * adfSessionCopy
+ *
+ * copies in 'buf' the blocks between nSect and nSect+nb-1 kept by the session.
+ * returns the number of blocks copied
+ */
+int adfSessionCopy(struct Volume *vol, SECTNUM nSect, int nb, unsigned char *buf)
+{
+    struct MetaBlock *blk;
+    int i, n;
+
+    n = 0;
+    for(i=0; i<nb && n<vol->nbMeta; i++) {
+        blk = *adfSessionFind(vol, nSect+i);
+        if (blk!=NULL) {
+            memcpy(buf+i*LOGICAL_BLOCK_SIZE, blk->data, LOGICAL_BLOCK_SIZE);
+            n++;
+        }
+    }
+
+    return n;
+}
+
+
+/*
+ * adfWriteMetaBlock
+ *
+ * writes a header, directory, dircache or bitmap block. during a session,
+ * the block stays in memory until adfCommitSession()
+ */
+RETCODE adfWriteMetaBlock(struct Volume* vol, long nSect, unsigned char *buf)
+{
+    if (!vol->session)
+        return adfWriteBlock(vol, nSect, buf);
+
+    if (nSect<0 || nSect+vol->firstBlock>vol->lastBlock) {
+        (*adfEnv.wFct)("adfWriteMetaBlock : nSect out of range");
+        return RC_ERROR;
+    }
+
+    return adfSessionPut(vol, nSect, buf);
+}
+
+
+/*
+ * adfSessionCmp
+ *
+ */
+static int adfSessionCmp(const void *a, const void *b)
+{
+    SECTNUM sa, sb;
+
+    sa = (*(struct MetaBlock**)a)->sect;
+    sb = (*(struct MetaBlock**)b)->sect;
+
+    return sa<sb ? -1 : (sa>sb ? 1 : 0);
+}
+
+
+/*
+ * adfBeginSession
+ */
+/*!	\brief	Keep the metadata changes in memory.
+ *	\param	vol - the volume.
+ *	\return	RC_OK or RC_ERROR.
+ *
+ *	Until adfCommitSession() or adfUnMount(), the header, directory, dircache and bitmap blocks
+ *	are written in memory only, so creating many entries writes each of these blocks once. The
+ *	data blocks are written at once. The reads of the library see the changes.
+ */
+RETCODE adfBeginSession(struct Volume *vol)
+{
+    if (!vol->mounted || vol->readOnly) {
+        (*adfEnv.wFct)("adfBeginSession : volume not mounted or read only");
+        return RC_ERROR;
+    }
+    vol->session = TRUE;
+
+    return RC_OK;
+}
+
+
+/*
+ * adfCommitSession
+ */
+/*!	\brief	Write the metadata changes kept since adfBeginSession().
+ *	\param	vol - the volume.
+ *	\return	RC_OK or RC_ERROR.
+ *
+ *	The blocks are written in sector order, the consecutive ones with one device access. The root
+ *	block, with the bitmap flag and the date, is written last. The session ends.
+ */
+RETCODE adfCommitSession(struct Volume *vol)
+{
+    struct MetaBlock **list, *blk, *next, *root;
+    unsigned char *buf;
+    long i, n, nb, j;
+    RETCODE rc;
+
+    if (!vol->session)
+        return RC_OK;
+
+    /* the dircache and the bitmap join the session */
+    rc = adfFlushDirCache(vol);
+    if (adfSessionBitmap(vol)!=RC_OK)
+        rc = RC_ERROR;
+    vol->session = FALSE;
+
+    /* detached from the volume, so the writes below don't drop them */
+    list = (struct MetaBlock**)malloc((vol->nbMeta+1)*sizeof(struct MetaBlock*));
+    buf = (unsigned char*)malloc(LOGICAL_BLOCK_SIZE*SESSION_MAXRUN);
+    n = 0;
+    root = NULL;
+    for(i=0; i<vol->metaHashSize; i++)
+        for(blk=vol->metaHash[i]; blk!=NULL; blk=next) {
+            next = blk->next;
+            if (list && buf)
+                list[n++] = blk;
+            else {
+                /* no memory to sort them */
+                vol->nbMeta = 0;
+                if (adfWriteBlock(vol, blk->sect, blk->data)!=RC_OK)
+                    rc = RC_ERROR;
+                free(blk);
+            }
+        }
+    free(vol->metaHash);
+    vol->metaHash = NULL;
+    vol->metaHashSize = 0;
+    vol->nbMeta = 0;
+
+    if (n>1)
+        qsort(list, n, sizeof(struct MetaBlock*), adfSessionCmp);
+    i = 0;
+    while(i<n) {
+        if (list[i]->sect==vol->rootBlock) {
+            root = list[i++];
+            continue;
+        }
+        nb = 1;
+        while(nb<SESSION_MAXRUN && i+nb<n && list[i+nb]->sect==list[i]->sect+nb
+            && list[i+nb]->sect!=vol->rootBlock)
+            nb++;
+        for(j=0; j<nb; j++)
+            memcpy(buf+j*LOGICAL_BLOCK_SIZE, list[i+j]->data, LOGICAL_BLOCK_SIZE);
+        if (adfWriteBlocks(vol, list[i]->sect, (int)nb, buf)!=RC_OK)
+            rc = RC_ERROR;
+        i += nb;
+    }
+    if (root && adfWriteBlock(vol, root->sect, root->data)!=RC_OK)
+        rc = RC_ERROR;
+
+    for(i=0; i<n; i++)
+        free(list[i]);
+    free(list);
+    free(buf);
+
+    return rc;
+}
+
+
+/*
+ * adfDropSession
+ *
+ * ends the session without writing the blocks it kept : the changes are given up
+ */
+void adfDropSession(struct Volume *vol)
+{
+    struct MetaBlock *blk, *next;
+    long i;
+
+    for(i=0; i<vol->metaHashSize; i++)
+        for(blk=vol->metaHash[i]; blk!=NULL; blk=next) {
+            next = blk->next;
+            free(blk);
+        }
+    free(vol->metaHash);
+    vol->metaHash = NULL;
+    vol->metaHashSize = 0;
+    vol->nbMeta = 0;
+    vol->session = FALSE;
+}
+
 
 /*#######################################################################################*/
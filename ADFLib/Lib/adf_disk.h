@@ -13,6 +13,8 @@
 #include "adf_str.h"
 #include "adf_defs.h"
 
+#define SESSION_MAXRUN  64      /* blocks written with one device access by adfCommitSession() */
+
 PREFIX RETCODE adfInstallBootBlock(struct Volume *vol,unsigned char*);
 
 PREFIX BOOL isSectNumValid(struct Volume *vol, SECTNUM nSect);
@@ -28,6 +30,15 @@ void adfUpdateBitmap(struct Volume*);
 */
 PREFIX RETCODE adfReadBlock(struct Volume* , long nSect, unsigned char* buf);
 PREFIX RETCODE adfWriteBlock(struct Volume* , long nSect, unsigned char* buf);
+PREFIX RETCODE adfReadBlocks(struct Volume* , long nSect, int nb, unsigned char* buf);
+PREFIX RETCODE adfWriteBlocks(struct Volume* , long nSect, int nb, unsigned char* buf);
+
+PREFIX RETCODE adfBeginSession(struct Volume *vol);
+PREFIX RETCODE adfCommitSession(struct Volume *vol);
+RETCODE adfWriteMetaBlock(struct Volume* vol, long nSect, unsigned char *buf);
+int adfSessionCopy(struct Volume *vol, SECTNUM nSect, int nb, unsigned char *buf);
+void adfSessionDrop(struct Volume *vol, SECTNUM nSect, int nb);
+void adfDropSession(struct Volume *vol);
 
 #endif /* _ADF_DISK_H */
 
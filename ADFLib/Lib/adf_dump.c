@@ -7,12 +7,18 @@
 
 #include<stdio.h>
 #include<stdlib.h>
+#include<string.h>
 #include<errno.h>
+#ifndef _MSC_VER
+#include<sys/types.h>
+#endif
 
 #include"adf_defs.h"
 #include"adf_str.h"
 #include"adf_disk.h"
 #include"adf_nativ.h"
+#include"adf_dump.h"
+#include"adf_ext.h"
 #include"adf_err.h"
 
 extern struct Env adfEnv;
@@ -24,7 +30,7 @@ extern struct Env adfEnv;
 RETCODE adfInitDumpDevice(struct Device* dev, char* name, BOOL ro)
 {
     struct nativeDevice* nDev;
-    long size;
+    ADFOFF size;
 
     nDev = (struct nativeDevice*)dev->nativeDev;
 
@@ -34,6 +40,8 @@ RETCODE adfInitDumpDevice(struct Device* dev, char* name, BOOL ro)
         return RC_MALLOC;
     }
     dev->nativeDev = nDev;
+    nDev->mem = NULL;
+    nDev->ext = NULL;
 
     dev->readOnly = ro;
     errno = 0;
@@ -57,10 +65,20 @@ RETCODE adfInitDumpDevice(struct Device* dev, char* name, BOOL ro)
         return RC_ERROR;
     }
 
+    /* an extended ADF : its size is the one of the floppy */
+    if (adfIsExtDump(nDev->fd)) {
+        if (adfInitExtDevice(dev)!=RC_OK) {
+            fclose(nDev->fd);
+            free(nDev);
+            return RC_ERROR;
+        }
+        return RC_OK;
+    }
+
     /* determines size */
-    fseek(nDev->fd, 0, SEEK_END);
-	size = ftell(nDev->fd);
-    fseek(nDev->fd, 0, SEEK_SET);
+    adfSeekEnd(nDev->fd);
+	size = adfTell(nDev->fd);
+    adfSeek(nDev->fd, 0);
 
     dev->size = size;
 	
@@ -68,6 +86,30 @@ RETCODE adfInitDumpDevice(struct Device* dev, char* name, BOOL ro)
 }
 
 
+/*
+ * adfInitMemDumpDevice
+ *
+ * the image is malloc()ed by the caller, and freed by adfReleaseDumpDevice()
+ */
+RETCODE adfInitMemDumpDevice(struct Device* dev, unsigned char* image, ADFOFF size)
+{
+    struct nativeDevice* nDev;
+
+    nDev = (struct nativeDevice*)malloc(sizeof(struct nativeDevice));
+    if (!nDev) {
+        (*adfEnv.eFct)("adfInitMemDumpDevice : malloc");
+        return RC_MALLOC;
+    }
+    dev->nativeDev = nDev;
+    nDev->fd = NULL;
+    nDev->mem = image;
+    nDev->ext = NULL;
+    dev->size = size;
+
+    return RC_OK;
+}
+
+
 /*
  * adfReadDumpSector
  *
@@ -82,7 +124,15 @@ RETCODE adfReadDumpSector(struct Device *dev, long n, int size, unsigned char* b
 #endif /*_DEBUG_PRINTF_*/
 
     nDev = (struct nativeDevice*)dev->nativeDev;
-    r = fseek(nDev->fd, 512*n, SEEK_SET);
+    if (nDev->mem) {
+        if (n<0 || (ADFOFF)512*n+size>dev->size)
+            return RC_ERROR;
+        memcpy(buf, nDev->mem+(ADFOFF)512*n, size);
+        return RC_OK;
+    }
+    if (nDev->ext)
+        return adfReadExtSector(dev, n, size, buf);
+    r = adfSeek(nDev->fd, (ADFOFF)512*n);
 
 #ifdef _DEBUG_PRINTF_
 	printf("nnn=%ld size=%d\n",n,size);
@@ -122,8 +172,16 @@ RETCODE adfWriteDumpSector(struct Device *dev, long n, int size, unsigned char*
     int r;
 
     nDev = (struct nativeDevice*)dev->nativeDev;
+    if (nDev->mem) {
+        if (n<0 || (ADFOFF)512*n+size>dev->size)
+            return RC_ERROR;
+        memcpy(nDev->mem+(ADFOFF)512*n, buf, size);
+        return RC_OK;
+    }
+    if (nDev->ext)
+        return adfWriteExtSector(dev, n, size, buf);
 
-    r=fseek(nDev->fd, 512*n, SEEK_SET);
+    r=adfSeek(nDev->fd, (ADFOFF)512*n);
     if (r==-1)
         return RC_ERROR;
 
@@ -138,6 +196,29 @@ RETCODE adfWriteDumpSector(struct Device *dev, long n, int size, unsigned char*
 }
 
 
+/*
+ * adfDumpHandle
+ *
+ * file descriptor of the dump, for the positional reads of adf_aio.c.
+ * the data written through the FILE* is flushed first. -1 for a dump in memory
+ * or an extended ADF, whose blocks aren't at their place in the file
+ */
+int adfDumpHandle(struct Device *dev)
+{
+    struct nativeDevice* nDev;
+
+    nDev = (struct nativeDevice*)dev->nativeDev;
+    if (nDev->mem || nDev->ext)
+        return -1;
+    fflush(nDev->fd);
+#ifdef _MSC_VER
+    return _fileno(nDev->fd);
+#else
+    return fileno(nDev->fd);
+#endif
+}
+
+
 /*
  * adfReleaseDumpDevice
  *
@@ -150,7 +231,12 @@ RETCODE adfReleaseDumpDevice(struct Device *dev)
 		return RC_ERROR;
 
     nDev = (struct nativeDevice*)dev->nativeDev;
-    fclose(nDev->fd);
+    if (nDev->mem)
+        free(nDev->mem);
+    else {
+        adfReleaseExtDevice(dev);
+        fclose(nDev->fd);
+    }
 
     free(nDev);
 
@@ -244,6 +330,8 @@ adfCreateDumpDevice(char* filename, long cylinders, long heads, long sectors)
         return NULL;
     }
     dev->nativeDev = nDev;
+    nDev->mem = NULL;
+    nDev->ext = NULL;
 
     nDev->fd = (FILE*)fopen(filename,"wb");
     if (!nDev->fd) {
@@ -255,7 +343,7 @@ adfCreateDumpDevice(char* filename, long cylinders, long heads, long sectors)
 /*    for(i=0; i<cylinders*heads*sectors; i++)
         fwrite(buf, sizeof(unsigned char), 512 , nDev->fd);
 */
-    r=fseek(nDev->fd, ((cylinders*heads*sectors)-1)*LOGICAL_BLOCK_SIZE, SEEK_SET);
+    r=adfSeek(nDev->fd, ((ADFOFF)cylinders*heads*sectors-1)*LOGICAL_BLOCK_SIZE);
     if (r==-1) {
         fclose(nDev->fd); free(nDev); free(dev);
         (*adfEnv.eFct)("adfCreateDumpDevice : fseek");
@@ -275,7 +363,7 @@ adfCreateDumpDevice(char* filename, long cylinders, long heads, long sectors)
     dev->cylinders = cylinders;
     dev->heads = heads;
     dev->sectors = sectors;
-    dev->size = cylinders*heads*sectors* LOGICAL_BLOCK_SIZE;	
+    dev->size = (ADFOFF)cylinders*heads*sectors* LOGICAL_BLOCK_SIZE;	
 
     if (dev->size==80*11*2*LOGICAL_BLOCK_SIZE)
         dev->devType = DEVTYPE_FLOPDD;
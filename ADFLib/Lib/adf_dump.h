@@ -8,14 +8,27 @@
  *  \brief	Amiga Dump File specific routines header..
  */
 
+/* 64 bits offsets. elsewhere than Win32, build with _FILE_OFFSET_BITS=64 */
+#ifdef _MSC_VER
+#define adfSeek(fd,off)     _fseeki64(fd,off,SEEK_SET)
+#define adfTell(fd)         _ftelli64(fd)
+#define adfSeekEnd(fd)      _fseeki64(fd,0,SEEK_END)
+#else
+#define adfSeek(fd,off)     fseeko(fd,(off_t)(off),SEEK_SET)
+#define adfTell(fd)         ((ADFOFF)ftello(fd))
+#define adfSeekEnd(fd)      fseeko(fd,0,SEEK_END)
+#endif
+
 PREFIX     struct Device*
 adfCreateDumpDevice(char* filename, long cyl, long heads, long sec);
 PREFIX RETCODE adfCreateHdFile(struct Device* dev, char* volName, int volType);
 /* GJH 7/11/02 - changed return values below to RETCODE to match main declarations. */
 RETCODE adfInitDumpDevice(struct Device* dev, char* name,BOOL);
+RETCODE adfInitMemDumpDevice(struct Device* dev, unsigned char* image, ADFOFF size);
 RETCODE adfReadDumpSector(struct Device *dev, long n, int size, unsigned char* buf);
 RETCODE adfWriteDumpSector(struct Device *dev, long n, int size, unsigned char* buf);
 RETCODE adfReleaseDumpDevice(struct Device *dev);
+int adfDumpHandle(struct Device *dev);
 
 
 #endif /* ADF_DUMP_H */
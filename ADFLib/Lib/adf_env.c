@@ -150,6 +150,7 @@ void adfEnvInitDefault()
     adfEnv.progressBar = progressBar;
 	
     adfEnv.useDirCache = FALSE;
+    adfEnv.seekOrder = FALSE;
     adfEnv.useRWAccess = FALSE;
     adfEnv.useNotify = FALSE;
     adfEnv.useProgressBar = FALSE;
@@ -207,6 +208,7 @@ void adfEnvCleanUp()
  *										sector accessed, (void(*)(SECTNUM, SECTNUM, BOOL)).
  *	<TR><TD> PR_USE_RWACCESS	<TD> Use read/write access (default = off). BOOL.
  *	<TR><TD> PR_USEDIRC			<TD> Use dircache blocks. BOOL (default = off).
+ *	<TR><TD> PR_SEEKORDER		<TD> Read the blocks of recursive listings in ascending order (default = off). BOOL.
  *	</TABLE>
  *
  *	For the non pointer types (int with PR_USEDIRC), you have to use a temporary variable. To successfully override
@@ -251,6 +253,10 @@ void adfChgEnvProp(int prop, void *new)
         newBool = (BOOL*)new;
 		adfEnv.useDirCache = *newBool;
         break;
+    case PR_SEEKORDER:
+        newBool = (BOOL*)new;
+		adfEnv.seekOrder = *newBool;
+        break;
     }
 }
 
@@ -0,0 +1,513 @@
+/*
+ *  ADF Library. (C) 1997-2002 Laurent Clevy
+ */
+/*! \file	adf_ext.c
+ *  \brief	Extended ADF (UAE-1ADF) dump files.
+ *
+ *	An extended ADF starts with "UAE-1ADF", a reserved word and the number of tracks. A header of
+ *	12 bytes per track follows : a reserved word, the type, the space taken in the file and the
+ *	length in bits, all big endian. Then the data of the tracks, one after the other. The tracks
+ *	of type 0 are the sectors of an AmigaDOS track. Those of type 1 are raw MFM : they are decoded
+ *	the first time one of their sectors is read, and kept in a small cache. A raw track which is
+ *	not AmigaDOS can still be read by adfReadExtTrack(), bits as they are.
+ */
+
+#include<stdio.h>
+#include<stdlib.h>
+#include<string.h>
+#ifndef _MSC_VER
+#include<sys/types.h>
+#endif
+
+#include"adf_defs.h"
+#include"adf_str.h"
+#include"adf_nativ.h"
+#include"adf_ext.h"
+#include"adf_dump.h"
+#include"adf_mfm.h"
+#include"adf_err.h"
+
+extern struct Env adfEnv;
+
+#define EXT_DOS_TRACK   0           /* types of the track headers */
+#define EXT_RAW_TRACK   1
+#define EXT_SECTOR      1080        /* MFM bytes of a sector after its sync */
+#define EXT_SYNC        0x44894489L
+#define EXT_WRAPBITS    ((EXT_SECTOR+8)*8)  /* copied after the end, for the sectors across the index */
+
+/* a track header */
+struct ExtTrack{
+    int type;
+    long space;                     /* bytes in the file */
+    long bits;
+    int nbSect;                     /* AmigaDOS sectors a type 0 track holds */
+    ADFOFF offset;                  /* of its data in the file */
+};
+
+/* the sectors decoded from a raw track */
+struct ExtCache{
+    int track;                      /* -1 if free */
+    unsigned long last;             /* to find the least recently used */
+    unsigned char *data;            /* 'sectors' blocks */
+    BOOL found[22];                 /* FALSE : missing or bad checksum */
+    int nbFound;
+};
+
+struct ExtDump{
+    int nbTracks;
+    int sectors;                    /* 11, 22 for high density images */
+    struct ExtTrack *tracks;
+    struct ExtCache cache[EXT_CACHE];
+    unsigned long time;
+    unsigned char *mfm;             /* a raw track, its start copied after its end */
+    long mfmSize;
+    unsigned char *sectData;        /* the blocks of the cache */
+    unsigned char syncByte[256];    /* bit k : the second byte of a sync at bit k */
+};
+
+
+/*
+ * adfExtBit
+ *
+ */
+static int adfExtBit(unsigned char *p, long n)
+{
+    return (p[n>>3]>>(7-(n&7)))&1;
+}
+
+
+/*
+ * adfExtSyncAt
+ *
+ * TRUE if the 32 bits at bit 'n' are a sync
+ */
+static BOOL adfExtSyncAt(unsigned char *p, long n)
+{
+    ULONG w;
+    int shift;
+
+    p += n>>3;
+    shift = (int)(n&7);
+    w = ((ULONG)p[0]<<24) | ((ULONG)p[1]<<16) | ((ULONG)p[2]<<8) | p[3];
+    if (shift)
+        w = (w<<shift) | (p[4]>>(8-shift));
+
+    return (w&0xffffffffUL)==EXT_SYNC;
+}
+
+
+/*
+ * adfIsExtDump
+ *
+ * TRUE if the file starts with the magic of an extended ADF. the file position is lost
+ */
+BOOL adfIsExtDump(FILE *fd)
+{
+    char magic[8];
+
+    if (adfSeek(fd, 0)==-1 || fread(magic, 1, 8, fd)!=8)
+        return FALSE;
+
+    return memcmp(magic, EXT_MAGIC, 8)==0;
+}
+
+
+/*
+ * adfInitExtDevice
+ *
+ * reads the track headers of the dump opened by adfInitDumpDevice(), and fills dev->size
+ */
+RETCODE adfInitExtDevice(struct Device *dev)
+{
+    struct nativeDevice* nDev;
+    struct ExtDump *ext;
+    struct ExtTrack *tr;
+    unsigned char hdr[EXT_TRACKHEADER];
+    ADFOFF offset, fileSize;
+    long maxRaw;
+    int i, cylinders;
+    BOOL raw;
+
+    nDev = (struct nativeDevice*)dev->nativeDev;
+
+    adfSeekEnd(nDev->fd);
+    fileSize = adfTell(nDev->fd);
+    if (adfSeek(nDev->fd, 0)==-1 || fread(hdr, 1, EXT_HEADER, nDev->fd)!=EXT_HEADER) {
+        (*adfEnv.eFct)("adfInitExtDevice : fread");
+        return RC_ERROR;
+    }
+
+    ext = (struct ExtDump*)malloc(sizeof(struct ExtDump));
+    if (!ext) {
+        (*adfEnv.eFct)("adfInitExtDevice : malloc");
+        return RC_MALLOC;
+    }
+    memset(ext, 0, sizeof(struct ExtDump));
+    ext->nbTracks = swapShort(hdr+10);
+    if (ext->nbTracks==0 || ext->nbTracks>EXT_MAXTRACKS) {
+        free(ext);
+        (*adfEnv.eFct)("adfInitExtDevice : wrong number of tracks");
+        return RC_ERROR;
+    }
+    ext->tracks = (struct ExtTrack*)malloc(sizeof(struct ExtTrack)*ext->nbTracks);
+    if (!ext->tracks) {
+        free(ext);
+        (*adfEnv.eFct)("adfInitExtDevice : malloc");
+        return RC_MALLOC;
+    }
+
+    /* the data starts after the last header */
+    offset = EXT_HEADER+(ADFOFF)EXT_TRACKHEADER*ext->nbTracks;
+    ext->sectors = 11;
+    maxRaw = 0;
+    raw = FALSE;
+    for(i=0; i<ext->nbTracks; i++) {
+        tr = &ext->tracks[i];
+        if (fread(hdr, 1, EXT_TRACKHEADER, nDev->fd)!=EXT_TRACKHEADER) {
+            free(ext->tracks); free(ext);
+            (*adfEnv.eFct)("adfInitExtDevice : fread");
+            return RC_ERROR;
+        }
+        tr->type = swapShort(hdr+2);
+        tr->space = (long)swapLong(hdr+4);
+        tr->bits = (long)swapLong(hdr+8);
+        tr->offset = offset;
+        tr->nbSect = 0;
+        offset += tr->space;
+        if ((tr->type!=EXT_DOS_TRACK && tr->type!=EXT_RAW_TRACK)
+            || tr->space<0 || tr->bits<0 || (tr->bits+7)/8>tr->space || offset>fileSize) {
+            free(ext->tracks); free(ext);
+            (*adfEnv.eFct)("adfInitExtDevice : wrong track header");
+            return RC_ERROR;
+        }
+        if (tr->type==EXT_DOS_TRACK) {
+            tr->nbSect = (int)(tr->bits/8/512);
+            if (tr->nbSect>11)
+                ext->sectors = 22;
+        }
+        else {
+            raw = TRUE;
+            if (tr->bits>EXT_HDBITS)
+                ext->sectors = 22;
+            if (tr->space>maxRaw)
+                maxRaw = tr->space;
+        }
+    }
+    for(i=0; i<ext->nbTracks; i++)
+        if (ext->tracks[i].nbSect>ext->sectors)
+            ext->tracks[i].nbSect = ext->sectors;
+
+    ext->mfmSize = maxRaw+EXT_WRAPBITS/8+2;
+    ext->mfm = (unsigned char*)malloc(ext->mfmSize);
+    ext->sectData = (unsigned char*)malloc(EXT_CACHE*ext->sectors*512);
+    if (!ext->mfm || !ext->sectData) {
+        if (ext->mfm) free(ext->mfm);
+        if (ext->sectData) free(ext->sectData);
+        free(ext->tracks); free(ext);
+        (*adfEnv.eFct)("adfInitExtDevice : malloc");
+        return RC_MALLOC;
+    }
+    /* the second byte of a sync starting at bit k of a byte */
+    for(i=0; i<8; i++)
+        ext->syncByte[(EXT_SYNC>>(16+i))&0xff] |= (unsigned char)(1<<i);
+    for(i=0; i<EXT_CACHE; i++) {
+        ext->cache[i].track = -1;
+        ext->cache[i].data = ext->sectData+i*ext->sectors*512;
+    }
+    nDev->ext = ext;
+
+    /* a floppy : 80 to 83 cylinders, 80 for high density */
+    cylinders = (ext->nbTracks+1)/2;
+    if (cylinders<80 || ext->sectors==22)
+        cylinders = 80;
+    else if (cylinders>83)
+        cylinders = 83;
+    dev->size = (ADFOFF)cylinders*2*ext->sectors*512;
+
+    /* the raw tracks can't be written back */
+    if (raw && !dev->readOnly) {
+        dev->readOnly = TRUE;
+        (*adfEnv.wFct)("adfInitExtDevice : raw MFM tracks, read-only mode forced");
+    }
+
+    return RC_OK;
+}
+
+
+/*
+ * adfExtDecodeSector
+ *
+ * the sector whose sync ends before bit 'pos'. FALSE if its header isn't one of 'track'
+ */
+static BOOL adfExtDecodeSector(struct ExtDump *ext, long pos, int track, struct ExtCache *c)
+{
+    unsigned char info[4], label[16], chk[4];
+    unsigned char *p;
+    ULONG sum;
+    int shift, s;
+
+    p = ext->mfm+pos/8;
+    shift = (int)(pos%8);
+    sum = adfMfmDecode(p, shift, info, 4);
+    s = info[2];
+    if (info[0]!=0xff || info[1]!=track || s>=ext->sectors)
+        return FALSE;
+    sum ^= adfMfmDecode(p+8, shift, label, 16);
+    adfMfmDecode(p+40, shift, chk, 4);
+    if (sum!=(ULONG)swapLong(chk))
+        return FALSE;
+    if (c->found[s])
+        return TRUE;
+
+    adfMfmDecode(p+48, shift, chk, 4);
+    sum = adfMfmDecode(p+56, shift, c->data+s*512, 512);
+    if (sum==(ULONG)swapLong(chk)) {
+        c->found[s] = TRUE;
+        c->nbFound++;
+    }
+
+    return TRUE;
+}
+
+
+/*
+ * adfExtTrack
+ *
+ * the sectors of the raw track 't', from the cache or decoded in the least recently used entry
+ */
+static struct ExtCache* adfExtTrack(struct Device *dev, int t)
+{
+    struct nativeDevice* nDev;
+    struct ExtDump *ext;
+    struct ExtTrack *tr;
+    struct ExtCache *c, *lru;
+    unsigned char *mfm;
+    long i, p, nb, bits;
+    int k;
+
+    nDev = (struct nativeDevice*)dev->nativeDev;
+    ext = nDev->ext;
+    ext->time++;
+    lru = &ext->cache[0];
+    for(k=0; k<EXT_CACHE; k++) {
+        c = &ext->cache[k];
+        if (c->track==t) {
+            c->last = ext->time;
+            return c;
+        }
+        if (c->last<lru->last)
+            lru = c;
+    }
+    c = lru;
+    c->track = -1;
+
+    tr = &ext->tracks[t];
+    mfm = ext->mfm;
+    bits = tr->bits;
+    nb = (bits+7)/8;
+    if (adfSeek(nDev->fd, tr->offset)==-1 || (long)fread(mfm, 1, nb, nDev->fd)!=nb)
+        return NULL;
+    if (bits%8)
+        mfm[bits/8] &= (unsigned char)(0xff<<(8-bits%8));
+    memset(mfm+nb, 0, ext->mfmSize-nb);
+
+    /* the start of the track after its end */
+    k = (int)(bits%8);
+    if (k==0 && bits>=EXT_WRAPBITS)
+        memcpy(mfm+nb, mfm, EXT_WRAPBITS/8);
+    else if (bits>=EXT_WRAPBITS)
+        for(i=0; i<EXT_WRAPBITS/8; i++) {
+            mfm[bits/8+i] |= (unsigned char)(mfm[i]>>k);
+            mfm[bits/8+i+1] = (unsigned char)(mfm[i]<<(8-k));
+        }
+    else if (bits>0)
+        for(i=0; i<EXT_WRAPBITS; i++)
+            if (adfExtBit(mfm, i%bits))
+                mfm[(bits+i)>>3] |= (unsigned char)(0x80>>((bits+i)&7));
+
+    /* the syncs, from the bytes which can be their second one */
+    memset(c->found, 0, sizeof(c->found));
+    c->nbFound = 0;
+    for(i=1; i<=(bits+7)/8; i++) {
+        if (!ext->syncByte[mfm[i]])
+            continue;
+        for(k=0; k<8; k++) {
+            p = (i-1)*8+k;
+            if (!(ext->syncByte[mfm[i]]&(1<<k)) || p>=bits || !adfExtSyncAt(mfm, p))
+                continue;
+            if (adfExtDecodeSector(ext, p+32, t, c)) {
+                /* to the gap before the next sync */
+                i = (p+32+EXT_SECTOR*8)/8;
+                break;
+            }
+        }
+    }
+    c->track = t;
+    c->last = ext->time;
+
+    return c;
+}
+
+
+/*
+ * adfReadExtSector
+ *
+ * the sectors 'n'..., in the track data or decoded. RC_ERROR for a missing or bad sector
+ */
+RETCODE adfReadExtSector(struct Device *dev, long n, int size, unsigned char* buf)
+{
+    struct nativeDevice* nDev;
+    struct ExtDump *ext;
+    struct ExtTrack *tr;
+    struct ExtCache *c;
+    int t, s, len;
+
+    nDev = (struct nativeDevice*)dev->nativeDev;
+    ext = nDev->ext;
+    while(size>0) {
+        if (n<0 || n/ext->sectors>=ext->nbTracks)
+            return RC_ERROR;
+        t = (int)(n/ext->sectors);
+        s = (int)(n%ext->sectors);
+        tr = &ext->tracks[t];
+        if (tr->type==EXT_DOS_TRACK) {
+            /* the following sectors of the track at once */
+            if (s>=tr->nbSect)
+                return RC_ERROR;
+            len = (tr->nbSect-s)*512;
+            if (len>size)
+                len = size;
+            if (adfSeek(nDev->fd, tr->offset+512*s)==-1
+                || (int)fread(buf, 1, len, nDev->fd)!=len)
+                return RC_ERROR;
+        }
+        else {
+            c = adfExtTrack(dev, t);
+            if (!c || !c->found[s])
+                return RC_ERROR;
+            len = size<512 ? size : 512;
+            memcpy(buf, c->data+s*512, len);
+        }
+        buf += len;
+        size -= len;
+        n += (len+511)/512;
+    }
+
+    return RC_OK;
+}
+
+
+/*
+ * adfWriteExtSector
+ *
+ * only in the tracks of type 0
+ */
+RETCODE adfWriteExtSector(struct Device *dev, long n, int size, unsigned char* buf)
+{
+    struct nativeDevice* nDev;
+    struct ExtDump *ext;
+    struct ExtTrack *tr;
+    int t, s, len;
+
+    nDev = (struct nativeDevice*)dev->nativeDev;
+    ext = nDev->ext;
+    while(size>0) {
+        if (n<0 || n/ext->sectors>=ext->nbTracks)
+            return RC_ERROR;
+        t = (int)(n/ext->sectors);
+        s = (int)(n%ext->sectors);
+        tr = &ext->tracks[t];
+        if (tr->type!=EXT_DOS_TRACK || s>=tr->nbSect)
+            return RC_ERROR;
+        len = (tr->nbSect-s)*512;
+        if (len>size)
+            len = size;
+        if (adfSeek(nDev->fd, tr->offset+512*s)==-1
+            || (int)fwrite(buf, 1, len, nDev->fd)!=len)
+            return RC_ERROR;
+        buf += len;
+        size -= len;
+        n += (len+511)/512;
+    }
+
+    return RC_OK;
+}
+
+
+/*
+ * adfReleaseExtDevice
+ *
+ */
+void adfReleaseExtDevice(struct Device *dev)
+{
+    struct nativeDevice* nDev;
+    struct ExtDump *ext;
+
+    nDev = (struct nativeDevice*)dev->nativeDev;
+    ext = nDev->ext;
+    if (!ext)
+        return;
+    free(ext->mfm);
+    free(ext->sectData);
+    free(ext->tracks);
+    free(ext);
+    nDev->ext = NULL;
+}
+
+
+/*
+ * adfReadExtTrack
+ */
+/*!	\brief	Read a track of an extended ADF as it is stored.
+ *	\param	dev   - a device mounted from an extended ADF (UAE-1ADF).
+ *	\param	track - the track, cylinder*2+head.
+ *	\param	buf   - receives the data of the track, at most 'size' bytes.
+ *	\param	size  - the size of buf.
+ *	\param	type  - if not NULL, receives EXT_DOS, EXT_MFM or EXT_CUSTOM.
+ *	\return	The length of the track in bits, or -1 if an error occurs.
+ *
+ *	The sectors of a track stored decoded are EXT_DOS. A raw MFM track is EXT_MFM when all its AmigaDOS
+ *	sectors are found with good checksums, EXT_CUSTOM otherwise : another format, a copy protection or a
+ *	damaged track. Its bits are copied as they are, for an analysis by the caller.
+ */
+long adfReadExtTrack(struct Device *dev, int track, unsigned char *buf, long size, int *type)
+{
+    struct nativeDevice* nDev;
+    struct ExtDump *ext;
+    struct ExtTrack *tr;
+    struct ExtCache *c;
+    long len;
+
+    nDev = (struct nativeDevice*)dev->nativeDev;
+    if (dev->isNativeDev || !nDev || !nDev->ext) {
+        (*adfEnv.eFct)("adfReadExtTrack : not an extended ADF");
+        return -1;
+    }
+    ext = nDev->ext;
+    if (track<0 || track>=ext->nbTracks) {
+        (*adfEnv.eFct)("adfReadExtTrack : track out of range");
+        return -1;
+    }
+
+    tr = &ext->tracks[track];
+    len = (tr->bits+7)/8;
+    if (len>size)
+        len = size;
+    if (adfSeek(nDev->fd, tr->offset)==-1 || (long)fread(buf, 1, len, nDev->fd)!=len) {
+        (*adfEnv.eFct)("adfReadExtTrack : fread");
+        return -1;
+    }
+
+    if (type) {
+        if (tr->type==EXT_DOS_TRACK)
+            *type = EXT_DOS;
+        else {
+            c = adfExtTrack(dev, track);
+            *type = (c && c->nbFound==ext->sectors) ? EXT_MFM : EXT_CUSTOM;
+        }
+    }
+
+    return tr->bits;
+}
+
+/*##########################################################################*/
@@ -0,0 +1,32 @@
+#ifndef ADF_EXT_H
+#define ADF_EXT_H 1
+
+/*
+ *  ADF Library. (C) 1997-2002 Laurent Clevy
+ */
+/*! \file	adf_ext.h
+ *  \brief	Extended ADF (UAE-1ADF) dump files header.
+ */
+
+#include<stdio.h>
+
+#include"prefix.h"
+
+#include"adf_str.h"
+
+#define EXT_MAGIC       "UAE-1ADF"
+#define EXT_HEADER      12          /* magic, reserved, number of tracks */
+#define EXT_TRACKHEADER 12          /* reserved, type, space, bits */
+#define EXT_MAXTRACKS   200
+#define EXT_CACHE       8           /* raw MFM tracks kept decoded */
+#define EXT_HDBITS      150000      /* longer raw tracks are high density */
+
+BOOL adfIsExtDump(FILE *fd);
+RETCODE adfInitExtDevice(struct Device *dev);
+RETCODE adfReadExtSector(struct Device *dev, long n, int size, unsigned char* buf);
+RETCODE adfWriteExtSector(struct Device *dev, long n, int size, unsigned char* buf);
+void adfReleaseExtDevice(struct Device *dev);
+
+PREFIX long adfReadExtTrack(struct Device *dev, int track, unsigned char *buf, long size, int *type);
+
+#endif /* ADF_EXT_H */
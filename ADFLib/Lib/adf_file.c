@@ -140,13 +140,17 @@ RETCODE adfFreeFileBlocks(struct Volume* vol, struct bFileHeaderBlock *entry)
     struct FileBlocks fileBlocks;
     RETCODE rc = RC_OK;
 
-    adfGetFileBlocks(vol,entry,&fileBlocks);
+    if (adfGetFileBlocks(vol,entry,&fileBlocks)!=RC_OK)
+        return RC_ERROR;
 
+    /* all the blocks that can be are freed */
     for(i=0; i<fileBlocks.nbData; i++) {
-        adfSetBlockFree(vol, fileBlocks.data[i]);
+        if (adfSetBlockFree(vol, fileBlocks.data[i])!=RC_OK)
+            rc = RC_ERROR;
     }
     for(i=0; i<fileBlocks.nbExtens; i++) {
-        adfSetBlockFree(vol, fileBlocks.extens[i]);
+        if (adfSetBlockFree(vol, fileBlocks.extens[i])!=RC_OK)
+            rc = RC_ERROR;
     }
 
     free(fileBlocks.data);
@@ -226,7 +230,7 @@ RETCODE adfWriteFileHdrBlock(struct Volume *vol, SECTNUM nSect, struct bFileHead
     swLong(buf+20, newSum);
 /*    *(unsigned long*)(buf+20) = swapLong((unsigned char*)&newSum);*/
 
-    adfWriteBlock(vol, nSect, buf);
+    adfWriteMetaBlock(vol, nSect, buf);
 
     return rc;
 }
@@ -400,6 +404,74 @@ void adfCloseFile(struct File *file)
 }
 
 
+/*
+ * adfNextFileSect
+ *
+ * FFS : the sector of the data block number 'file->nDataBlock',
+ * the extension blocks are read when needed
+ */
+static SECTNUM adfNextFileSect(struct File* file)
+{
+    SECTNUM nSect;
+
+    if (file->nDataBlock<MAX_DATABLK)
+        nSect = file->fileHdr->dataBlocks[MAX_DATABLK-1-file->nDataBlock];
+    else {
+        if (file->nDataBlock==MAX_DATABLK) {
+            file->currentExt=(struct bFileExtBlock*)malloc(sizeof(struct bFileExtBlock));
+            if (!file->currentExt) (*adfEnv.eFct)("adfReadNextFileBlock : malloc");
+            adfReadFileExtBlock(file->volume, file->fileHdr->extension,
+                file->currentExt);
+            file->posInExtBlk = 0;
+        }
+        else if (file->posInExtBlk==MAX_DATABLK) {
+            adfReadFileExtBlock(file->volume, file->currentExt->extension,
+                file->currentExt);
+            file->posInExtBlk = 0;
+        }
+        nSect = file->currentExt->dataBlocks[MAX_DATABLK-1-file->posInExtBlk];
+        file->posInExtBlk++;
+    }
+    return nSect;
+}
+
+
+/*
+ * adfReadFileBlocks
+ *
+ * FFS : reads the next 'nb' data blocks straight into 'buf', with one device
+ * access per run of blocks which follow each other on the disk.
+ * returns the number of blocks put into 'buf'. when a run ends before 'nb',
+ * the block which broke it is read into file->currentData and '*current' is TRUE
+ */
+static long adfReadFileBlocks(struct File* file, long nb, unsigned char *buf, BOOL *current)
+{
+    SECTNUM first, nSect;
+    long run, i;
+
+    *current = FALSE;
+    first = adfNextFileSect(file);
+    file->nDataBlock++;
+    run = 1;
+    while(run<nb && run<FILE_MAXRUN) {
+        nSect = adfNextFileSect(file);
+        file->nDataBlock++;
+        if (nSect!=first+run) {
+            adfReadDataBlock(file->volume, nSect, file->currentData);
+            *current = TRUE;
+            break;
+        }
+        run++;
+    }
+
+    if (adfReadBlocks(file->volume, first, run, buf)!=RC_OK)
+        for(i=0; i<run; i++)
+            adfReadBlock(file->volume, first+i, buf+i*LOGICAL_BLOCK_SIZE);
+
+    return run;
+}
+
+
 /*
  * adfReadFile
  */
@@ -414,9 +486,10 @@ void adfCloseFile(struct File *file)
  */
 long adfReadFile(struct File* file, long n, unsigned char *buffer)
 {
-    long bytesRead;
+    long bytesRead, size;
     unsigned char *dataPtr, *bufPtr;
-	int blockSize, size;
+	int blockSize;
+    BOOL current;
 
     if (n==0) return(n);
     blockSize = file->volume->datablockSize;
@@ -433,24 +506,33 @@ long adfReadFile(struct File* file, long n, unsigned char *buffer)
     else
         dataPtr = file->currentData;
 
-    if (file->pos==0 || file->posInDataBlk==blockSize) {
-        adfReadNextFileBlock(file);
-        file->posInDataBlk = 0;
-    }
+    /* no data block read yet */
+    if (file->pos==0)
+        file->posInDataBlk = blockSize;
 
     bytesRead = 0; bufPtr = buffer;
     size = 0;
     while ( bytesRead < n ) {
+        if (file->posInDataBlk==blockSize) {
+            /* whole FFS data blocks go straight to the buffer */
+            if (isFFS(file->volume->dosType) && n-bytesRead>=blockSize) {
+                size = adfReadFileBlocks(file, (n-bytesRead)/blockSize, bufPtr, &current)*blockSize;
+                bufPtr += size;
+                file->pos += size;
+                bytesRead += size;
+                if (!current)
+                    continue;
+            }
+            else
+                adfReadNextFileBlock(file);
+            file->posInDataBlk = 0;
+        }
         size = min(n-bytesRead, blockSize-file->posInDataBlk);
         memcpy(bufPtr, dataPtr+file->posInDataBlk, size);
         bufPtr += size;
         file->pos += size;
         bytesRead += size;
         file->posInDataBlk += size;
-        if (file->posInDataBlk==blockSize && bytesRead<n) {
-            adfReadNextFileBlock(file);
-            file->posInDataBlk = 0;
-        }
     }
     file->eof = (file->pos==file->fileHdr->byteSize);
     return( bytesRead );
@@ -488,26 +570,8 @@ RETCODE adfReadNextFileBlock(struct File* file)
     else if (isOFS(file->volume->dosType)) {
         nSect = data->nextData;
     }
-    else {
-        if (file->nDataBlock<MAX_DATABLK)
-            nSect = file->fileHdr->dataBlocks[MAX_DATABLK-1-file->nDataBlock];
-        else {
-            if (file->nDataBlock==MAX_DATABLK) {
-                file->currentExt=(struct bFileExtBlock*)malloc(sizeof(struct bFileExtBlock));
-                if (!file->currentExt) (*adfEnv.eFct)("adfReadNextFileBlock : malloc");
-                adfReadFileExtBlock(file->volume, file->fileHdr->extension,
-                    file->currentExt);
-                file->posInExtBlk = 0;
-            }
-            else if (file->posInExtBlk==MAX_DATABLK) {
-                adfReadFileExtBlock(file->volume, file->currentExt->extension,
-                    file->currentExt);
-                file->posInExtBlk = 0;
-            }
-            nSect = file->currentExt->dataBlocks[MAX_DATABLK-1-file->posInExtBlk];
-            file->posInExtBlk++;
-        }
-    }
+    else
+        nSect = adfNextFileSect(file);
     adfReadDataBlock(file->volume,nSect,file->currentData);
 
     if (isOFS(file->volume->dosType) && data->seqNum!=file->nDataBlock+1)
@@ -777,6 +841,26 @@ RETCODE adfReadDataBlock(struct Volume *vol, SECTNUM nSect, void *data)
 }
 
 
+/*
+ * adfOFSData2Buf
+ *
+ * the OFS data block, with its type and checksum, as written on the disk
+ */
+static void adfOFSData2Buf(struct bOFSDataBlock *dataB, unsigned char *buf)
+{
+    unsigned long newSum;
+
+    dataB->type = T_DATA;
+    memcpy(buf,dataB,512);
+#ifdef LITT_ENDIAN
+    swapEndian(buf, SWBL_DATA);
+#endif
+    newSum = adfNormalSum(buf,20,512);
+    swLong(buf+20,newSum);
+/*    *(long*)(buf+20) = swapLong((unsigned char*)&newSum);*/
+}
+
+
 /*
  * adfWriteDataBlock
  *
@@ -784,21 +868,10 @@ RETCODE adfReadDataBlock(struct Volume *vol, SECTNUM nSect, void *data)
 RETCODE adfWriteDataBlock(struct Volume *vol, SECTNUM nSect, void *data)
 {
     unsigned char buf[512];
-    unsigned long newSum;
-    struct bOFSDataBlock *dataB;
     RETCODE rc = RC_OK;
 
-    newSum = 0L;
     if (isOFS(vol->dosType)) {
-        dataB = (struct bOFSDataBlock *)data;
-        dataB->type = T_DATA;
-        memcpy(buf,dataB,512);
-#ifdef LITT_ENDIAN
-        swapEndian(buf, SWBL_DATA);
-#endif
-        newSum = adfNormalSum(buf,20,512);
-        swLong(buf+20,newSum);
-/*        *(long*)(buf+20) = swapLong((unsigned char*)&newSum);*/
+        adfOFSData2Buf((struct bOFSDataBlock *)data, buf);
         adfWriteBlock(vol,nSect,buf);
     }
     else {
@@ -813,6 +886,65 @@ RETCODE adfWriteDataBlock(struct Volume *vol, SECTNUM nSect, void *data)
 }
 
 
+/*
+ * adfWriteFileData
+ *
+ * writes the 'nb' data blocks of a new file at sects[], from the 'size' bytes of 'data'
+ * (zeros if NULL). the consecutive sectors are written with one device access
+ */
+RETCODE adfWriteFileData(struct Volume *vol, SECTNUM header, SECTNUM *sects, long nb,
+    unsigned char *data, unsigned long size)
+{
+    unsigned char *buf;
+    struct bOFSDataBlock dataB;
+    unsigned long pos, len;
+    int blockSize;
+    long i, run;
+    RETCODE rc;
+
+    buf = (unsigned char*)malloc(512*(nb<FILE_MAXRUN ? nb : FILE_MAXRUN));
+    if (!buf) {
+        (*adfEnv.eFct)("adfWriteFileData : malloc");
+        return RC_MALLOC;
+    }
+
+    rc = RC_OK;
+    blockSize = vol->datablockSize;
+    pos = 0;
+    i = 0;
+    while(i<nb && rc==RC_OK) {
+        run = 0;
+        do {
+            len = size-pos<(unsigned long)blockSize ? size-pos : (unsigned long)blockSize;
+            if (isOFS(vol->dosType)) {
+                memset(&dataB, 0, sizeof(struct bOFSDataBlock));
+                dataB.headerKey = header;
+                dataB.seqNum = i+run+1;
+                dataB.dataSize = len;
+                dataB.nextData = i+run+1<nb ? sects[i+run+1] : 0;
+                if (data)
+                    memcpy(dataB.data, data+pos, len);
+                adfOFSData2Buf(&dataB, buf+512*run);
+            }
+            else {
+                memset(buf+512*run, 0, 512);
+                if (data)
+                    memcpy(buf+512*run, data+pos, len);
+            }
+            pos += len;
+            run++;
+        }while(i+run<nb && run<FILE_MAXRUN && sects[i+run]==sects[i+run-1]+1);
+
+        rc = adfWriteBlocks(vol, sects[i], (int)run, buf);
+        i += run;
+    }
+
+    free(buf);
+
+    return rc;
+}
+
+
 /*
  * adfReadFileExtBlock
  *
@@ -874,7 +1006,7 @@ RETCODE adfWriteFileExtBlock(struct Volume *vol, SECTNUM nSect, struct bFileExtB
     swLong(buf+20,newSum);
 /*    *(long*)(buf+20) = swapLong((unsigned char*)&newSum);*/
 
-    adfWriteBlock(vol,nSect,buf);
+    adfWriteMetaBlock(vol,nSect,buf);
 
     return rc;
 }
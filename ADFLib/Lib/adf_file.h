@@ -12,6 +12,8 @@
 
 #include"adf_str.h"
 
+#define FILE_MAXRUN     128     /* data blocks read or written with one device access */
+
 RETCODE adfGetFileBlocks(struct Volume* vol, struct bFileHeaderBlock* entry,
     struct FileBlocks* );
 RETCODE adfFreeFileBlocks(struct Volume* vol, struct bFileHeaderBlock *entry);
@@ -23,6 +25,8 @@ RETCODE adfWriteFileHdrBlock(struct Volume *vol, SECTNUM nSect, struct bFileHead
 
 RETCODE adfReadDataBlock(struct Volume *vol, SECTNUM nSect, void *data);
 RETCODE adfWriteDataBlock(struct Volume *vol, SECTNUM nSect, void *data);
+RETCODE adfWriteFileData(struct Volume *vol, SECTNUM header, SECTNUM *sects, long nb,
+    unsigned char *data, unsigned long size);
 RETCODE adfReadFileExtBlock(struct Volume *vol, SECTNUM nSect, struct bFileExtBlock* fext);
 RETCODE adfWriteFileExtBlock(struct Volume *vol, SECTNUM nSect, struct bFileExtBlock* fext);
 
@@ -20,6 +20,7 @@
 #include"adf_nativ.h"
 #include"adf_dump.h"
 #include"adf_err.h"
+#include"adf_cache.h"
 
 #include"defendian.h"
 
@@ -129,16 +130,133 @@ void adfFreeTmpVolList(struct List *root)
 }
 
 
+/*
+ * adfReadBlockDev
+ *
+ * reads 'size' bytes from the sector 'nSect' of a dump or a native device
+ */
+RETCODE adfReadBlockDev(struct Device* dev, long nSect, long size, unsigned char* buf)
+{
+    struct nativeFunctions *nFct;
+
+    nFct = adfEnv.nativeFct;
+    if (dev->isNativeDev)
+        return (*nFct->adfNativeReadSector)(dev, nSect, (int)size, buf);
+    else
+        return adfReadDumpSector(dev, nSect, (int)size, buf);
+}
+
+
+/*
+ * adfWriteBlockDev
+ *
+ */
+RETCODE adfWriteBlockDev(struct Device* dev, long nSect, long size, unsigned char* buf)
+{
+    struct nativeFunctions *nFct;
+
+    nFct = adfEnv.nativeFct;
+    if (dev->isNativeDev)
+        return (*nFct->adfNativeWriteSector)(dev, nSect, (int)size, buf);
+    else
+        return adfWriteDumpSector(dev, nSect, (int)size, buf);
+}
+
+
+/*
+ * adfHdfIsRoot
+ *
+ * checks the block type, the secondary type and the checksum
+ */
+static BOOL adfHdfIsRoot(unsigned char *buf, BOOL *goodSum)
+{
+    if (swapLong(buf)!=T_HEADER || swapLong(buf+508)!=ST_ROOT)
+        return FALSE;
+    *goodSum = swapLong(buf+20)==adfNormalSum(buf,20,512);
+    return TRUE;
+}
+
+
+/*
+ * adfHdfProbe
+ *
+ * reads one sector and checks if it is a valid rootblock
+ */
+static BOOL adfHdfProbe(struct Device *dev, SECTNUM nSect, long nbSect)
+{
+    unsigned char buf[512];
+    BOOL goodSum;
+
+    if (nSect<2 || nSect>=nbSect)
+        return FALSE;
+    if (adfReadBlockDev(dev, nSect, 512, buf)!=RC_OK)
+        return FALSE;
+    return adfHdfIsRoot(buf, &goodSum) && goodSum;
+}
+
+
+/*
+ * adfHdfScan
+ *
+ * scans down from 'top' by runs of HDF_SCANRUN sectors.
+ * returns the highest rootblock with a good checksum, or if there is none,
+ * the highest one with a bad checksum. -1 if not found
+ */
+static SECTNUM adfHdfScan(struct Device *dev, SECTNUM top)
+{
+    unsigned char *buf;
+    SECTNUM first, badRoot;
+    int nb, i;
+    BOOL goodSum;
+
+    buf = (unsigned char*)malloc(512*HDF_SCANRUN);
+    if (!buf) {
+        (*adfEnv.eFct)("adfHdfScan : malloc");
+        return -1;
+    }
+    badRoot = -1;
+    while (top>=2) {
+        first = top-HDF_SCANRUN+1;
+        if (first<2)
+            first = 2;
+        nb = top-first+1;
+        if (adfReadBlockDev(dev, first, 512*nb, buf)!=RC_OK)
+            break;
+        for(i=nb-1; i>=0; i--)
+            if (adfHdfIsRoot(buf+512*i, &goodSum)) {
+                if (goodSum) {
+                    free(buf);
+                    return first+i;
+                }
+                if (badRoot==-1)
+                    badRoot = first+i;
+            }
+        top = first-1;
+    }
+    free(buf);
+
+    if (badRoot!=-1)
+        (*adfEnv.wFct)("adfHdfScan : rootblock checksum error");
+    return badRoot;
+}
+
+
 /*
  * adfMountHdFile
  *
+ * a hardfile is one volume without RDSK header. the position of the rootblock
+ * gives the size of the volume.
+ *
+ * the rootblock is looked for where AmigaDOS and ADFLib put it, then by
+ * scanning down from the middle of the file
  */
 RETCODE adfMountHdFile(struct Device *dev)
 {
     struct Volume* vol;
-    unsigned char buf[512];
-    long size;
+    long nbSect;
+    SECTNUM candidates[2];
     BOOL found;
+    int i;
 
     dev->devType = DEVTYPE_HARDFILE;
     dev->nVol = 0;
@@ -157,6 +275,13 @@ RETCODE adfMountHdFile(struct Device *dev)
     dev->nVol++;      /* fixed by Dan, ... and by Gary */
 
     vol->volName=NULL;
+    vol->dirCache=NULL;
+    vol->dirCacheSize=0;
+    vol->nbDirCache=0;
+    vol->session=FALSE;
+    vol->nbMeta=0;
+    vol->metaHashSize=0;
+    vol->metaHash=NULL;
     
     dev->cylinders = dev->size/512;
     dev->heads = 1;
@@ -164,30 +289,44 @@ RETCODE adfMountHdFile(struct Device *dev)
 
     vol->firstBlock = 0;
 
-    size = dev->size + 512-(dev->size%512);
+    /* a last incomplete sector is ignored */
+    nbSect = dev->size/512;
 
 #ifdef _DEBUG_PRINTF_
-	printf("size=%ld\n",size);
+	printf("size=%.0f\n",(double)dev->size);
 #endif /*_DEBUG_PRINTF_*/
 
-    vol->rootBlock = (size/512)/2;
+    found = FALSE;
+
+    /* the volume fills the file : 'size/2' for ADFLib, '(size+1)/2' for AmigaDOS */
+    candidates[0] = (nbSect+1)/2;
+    candidates[1] = nbSect/2;
+    for(i=0; i<2 && !found; i++) {
+        found = adfHdfProbe(dev, candidates[i], nbSect);
+        if (found)
+            vol->rootBlock = candidates[i];
+    }
+
+    if (!found) {
+        vol->rootBlock = adfHdfScan(dev, (nbSect+1)/2);
+        found = vol->rootBlock!=-1;
+    }
 
 #ifdef _DEBUG_PRINTF_
 	printf("root=%ld\n",vol->rootBlock);
 #endif /*_DEBUG_PRINTF_*/
 
-    do {
-        adfReadDumpSector(dev, vol->rootBlock, 512, buf);
-        found = swapLong(buf)==T_HEADER && swapLong(buf+508)==ST_ROOT;
-        if (!found)
-            (vol->rootBlock)--;
-    }while (vol->rootBlock>1 && !found);
-
-    if (vol->rootBlock==1) {
+    if (!found) {
         (*adfEnv.eFct)("adfMountHdFile : rootblock not found");
         return RC_ERROR;
     }
-    vol->lastBlock = vol->rootBlock*2 - 1 ;
+
+    /* the last sector of the file when the rootblock is in the middle of it,
+     * 2 x rootBlock - 1 when the volume is smaller than the file */
+    if (nbSect-1>=2*vol->rootBlock-2 && nbSect-1<=2*vol->rootBlock)
+        vol->lastBlock = nbSect-1;
+    else
+        vol->lastBlock = vol->rootBlock*2 - 1 ;
 
     return RC_OK;
 }
@@ -238,6 +377,13 @@ RETCODE adfMountHd(struct Device *dev)
             return RC_ERROR;
         }
         vol->volName=NULL;
+        vol->dirCache=NULL;
+        vol->dirCacheSize=0;
+        vol->nbDirCache=0;
+        vol->session=FALSE;
+        vol->nbMeta=0;
+        vol->metaHashSize=0;
+        vol->metaHash=NULL;
         dev->nVol++;
 
         vol->firstBlock = rdsk.cylBlocks * part.lowCyl;
@@ -337,6 +483,13 @@ RETCODE adfMountFlop(struct Device* dev)
     }
 
     vol->mounted = TRUE;
+    vol->dirCache = NULL;
+    vol->dirCacheSize = 0;
+    vol->nbDirCache = 0;
+    vol->session = FALSE;
+    vol->nbMeta = 0;
+    vol->metaHashSize = 0;
+    vol->metaHash = NULL;
     vol->firstBlock = 0;
     vol->lastBlock =(dev->cylinders * dev->heads * dev->sectors)-1;
     vol->rootBlock = (vol->lastBlock+1 - vol->firstBlock)/2;
@@ -368,59 +521,17 @@ RETCODE adfMountFlop(struct Device* dev)
 
 
 /*
- * adfMountDev
- */
-/*!	\brief	Mount a dump file (.adf) or a real device (uses adf_nativ.c and .h).
- *	\param	filename - the device name.
- *	\param	ro       - TRUE if read only access is edsired, FALSE otherwise.
- *	\return	A Device structure pointer or NULL if an error occurs.
+ * adfMountDevVolumes
  *
- *	Mounts a device. The name could be a filename for an ADF dump, or a real device name such as "|F:" for the
- *	Win32 F: partition. The real device name is plateform dependent. adfInitDevice() must fill dev->size!
- *
- *	\b Internals: \n
- *	1. Allocation of struct Device *dev. \n
- *	2. Calls adfIsNativeDev() to determine if the name point out a ADF dump or a real (native) device. The
- *	field dev->isNativeDev is filled. \n
- *	3. Initialize the (real or dump) device. The field dev->size is filled. \n
- *	4. dev->devType is filled. \n
- *	5. The device is mounted : dev->nVol, dev->volList[], dev->cylinders, dev->heads, dev->sectors are filled. \n
- *	6. dev is returned.
- *
- *	Warning, in each dev->volList[i] volumes (vol), only vol->volName (might be NULL), vol->firstBlock,
- *	vol->lastBlock and vol->rootBlock are filled!
- *
- *	\b Files: \n
- *	Real devices allocation : adf_nativ.c, adf_nativ.h. \n
- *	ADF allocation : adf_dump.c, adf_dump.h.
- *	\sa	 struct Device, real (native) devices.
+ * the volumes of an initialized device, by its type. dev is freed if it fails
  */
-struct Device* adfMountDev( char* filename, BOOL ro)
+static struct Device* adfMountDevVolumes(struct Device* dev, char* filename)
 {
-    struct Device* dev;
     struct nativeFunctions *nFct;
     RETCODE rc;
     unsigned char buf[512];
 
-    dev = (struct Device*)malloc(sizeof(struct Device));
-    if (!dev) {
-		(*adfEnv.eFct)("adfMountDev : malloc error");
-        return NULL;
-    }
-
-    dev->readOnly = ro;
-
-    /* switch between dump files and real devices */
     nFct = adfEnv.nativeFct;
-    dev->isNativeDev = (*nFct->adfIsDevNative)(filename);
-    if (dev->isNativeDev)
-        rc = (*nFct->adfInitDevice)(dev, filename,ro);
-    else
-        rc = adfInitDumpDevice(dev,filename,ro);
-    if (rc!=RC_OK) {
-        free(dev); return(NULL);
-    }
-
     dev->devType = adfDevType(dev);
 
     switch( dev->devType ) {
@@ -452,8 +563,8 @@ struct Device* adfMountDev( char* filename, BOOL ro)
             free(dev); return NULL;
         }
 
-        /* a file with the first three bytes equal to 'DOS' */
-    	if (!dev->isNativeDev && strncmp("DOS",buf,3)==0) {
+        /* a file or a device with the first three bytes equal to 'DOS' */
+    	if (strncmp("DOS",buf,3)==0) {
             if (adfMountHdFile(dev)!=RC_OK) {
 	            if (dev->isNativeDev)
 		            (*nFct->adfReleaseDevice)(dev);
@@ -484,6 +595,97 @@ struct Device* adfMountDev( char* filename, BOOL ro)
 }
 
 
+/*
+ * adfMountDev
+ */
+/*!	\brief	Mount a dump file (.adf) or a real device (uses adf_nativ.c and .h).
+ *	\param	filename - the device name.
+ *	\param	ro       - TRUE if read only access is edsired, FALSE otherwise.
+ *	\return	A Device structure pointer or NULL if an error occurs.
+ *
+ *	Mounts a device. The name could be a filename for an ADF dump, or a real device name such as "|F:" for the
+ *	Win32 F: partition. The real device name is plateform dependent. adfInitDevice() must fill dev->size!
+ *
+ *	\b Internals: \n
+ *	1. Allocation of struct Device *dev. \n
+ *	2. Calls adfIsNativeDev() to determine if the name point out a ADF dump or a real (native) device. The
+ *	field dev->isNativeDev is filled. \n
+ *	3. Initialize the (real or dump) device. The field dev->size is filled. \n
+ *	4. dev->devType is filled. \n
+ *	5. The device is mounted : dev->nVol, dev->volList[], dev->cylinders, dev->heads, dev->sectors are filled. \n
+ *	6. dev is returned.
+ *
+ *	Warning, in each dev->volList[i] volumes (vol), only vol->volName (might be NULL), vol->firstBlock,
+ *	vol->lastBlock and vol->rootBlock are filled!
+ *
+ *	\b Files: \n
+ *	Real devices allocation : adf_nativ.c, adf_nativ.h. \n
+ *	ADF allocation : adf_dump.c, adf_dump.h.
+ *	\sa	 struct Device, real (native) devices.
+ */
+struct Device* adfMountDev( char* filename, BOOL ro)
+{
+    struct Device* dev;
+    struct nativeFunctions *nFct;
+    RETCODE rc;
+
+    dev = (struct Device*)malloc(sizeof(struct Device));
+    if (!dev) {
+		(*adfEnv.eFct)("adfMountDev : malloc error");
+        return NULL;
+    }
+
+    dev->readOnly = ro;
+
+    /* switch between dump files and real devices */
+    nFct = adfEnv.nativeFct;
+    dev->isNativeDev = (*nFct->adfIsDevNative)(filename);
+    if (dev->isNativeDev)
+        rc = (*nFct->adfInitDevice)(dev, filename,ro);
+    else
+        rc = adfInitDumpDevice(dev,filename,ro);
+    if (rc!=RC_OK) {
+        free(dev); return(NULL);
+    }
+
+    return adfMountDevVolumes(dev, filename);
+}
+
+
+/*
+ * adfMountMemDev
+ */
+/*!	\brief	Mount a dump held in memory.
+ *	\param	image - the dump, allocated with malloc().
+ *	\param	size  - its size in bytes.
+ *	\param	ro    - TRUE if read only access is desired, FALSE otherwise.
+ *	\return	A Device structure pointer or NULL if an error occurs.
+ *
+ *	Mounts an image built in memory, a floppy decoded from another format for example, as adfMountDev()
+ *	mounts a dump file. The writes change the image. It is freed by adfUnMountDev(), or at once if the
+ *	mount fails.
+ */
+struct Device* adfMountMemDev(unsigned char* image, ADFOFF size, BOOL ro)
+{
+    struct Device* dev;
+
+    dev = (struct Device*)malloc(sizeof(struct Device));
+    if (!dev) {
+        (*adfEnv.eFct)("adfMountMemDev : malloc error");
+        free(image);
+        return NULL;
+    }
+    dev->readOnly = ro;
+    dev->isNativeDev = FALSE;
+    if (adfInitMemDumpDevice(dev, image, size)!=RC_OK) {
+        free(image);
+        free(dev); return NULL;
+    }
+
+    return adfMountDevVolumes(dev, "");
+}
+
+
 /*
  * adfCreateHdHeader
  *
@@ -671,11 +873,13 @@ RETCODE adfCreateHd(struct Device* dev, int n, struct Partition** partList )
 					partList[i]->volType );
         if (dev->volList[i]==NULL) {
            for(j=0; j<i; j++) {
-               free( dev->volList[i] );
-/* pas fini */
+               free( dev->volList[j]->volName );
+               free( dev->volList[j] );
            }
            free(dev->volList);
+           dev->volList = NULL;
            (*adfEnv.eFct)("adfCreateHd : adfCreateVol() fails");
+           return RC_ERROR;
         }
         dev->volList[i]->blockSize = 512;
     }
@@ -714,6 +918,13 @@ void adfUnMountDev( struct Device* dev)
 	   return;
 
     for(i=0; i<dev->nVol; i++) {
+        /* still mounted : don't lose the session and dircache changes */
+        if (dev->volList[i]->mounted)
+            adfCommitSession(dev->volList[i]);
+        if (dev->volList[i]->mounted && dev->volList[i]->dirCache!=NULL) {
+            adfFlushDirCache(dev->volList[i]);
+            adfFreeDirCache(dev->volList[i]);
+        }
         free(dev->volList[i]->volName);
         free(dev->volList[i]);
     }
@@ -14,12 +14,17 @@
 #include "hd_blk.h"
 #include "adf_err.h"
 
+/* rootblock discovery of hardfiles */
+#define HDF_SCANRUN     64      /* sectors read at once when scanning for the rootblock */
+
 int adfDevType(struct Device *dev);
 PREFIX void adfDeviceInfo(struct Device *dev);
 
 RETCODE adfMountHd(struct Device *dev);
+RETCODE adfMountHdFile(struct Device *dev);
 RETCODE adfMountFlop(struct Device* dev);
 PREFIX struct Device* adfMountDev( char* filename,BOOL);
+PREFIX struct Device* adfMountMemDev(unsigned char* image, ADFOFF size, BOOL ro);
 PREFIX void adfUnMountDev( struct Device* dev);
 
 RETCODE adfCreateHdHeader(struct Device* dev, int n, struct Partition** partList );
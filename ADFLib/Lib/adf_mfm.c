@@ -0,0 +1,250 @@
+/*
+ *  ADF Library. (C) 1997-2002 Laurent Clevy
+ */
+/*! \file	adf_mfm.c
+ *  \brief	Amiga MFM decoding.
+ *
+ *	The fields of an Amiga sector are written as their odd bits, then their even bits, each bit
+ *	followed by a clock bit. As the longs are big endian, a byte of data only depends on the bytes
+ *	at the same place in the odd and even halves : the kernels work on bytes, 1, 16 or 32 at a time,
+ *	and fold the checksum at the end. The SSE2 and AVX2 kernels are used when the processor has them.
+ */
+
+#include<stdio.h>
+#include<stdlib.h>
+
+#include"adf_defs.h"
+#include"adf_str.h"
+#include"adf_mfm.h"
+
+/* gcc and clang build the kernels of any x86, and ask the processor. MSVC needs /arch */
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__clang__) || __GNUC__>=5)
+#define MFM_HAVE_SSE2
+#define MFM_HAVE_AVX2
+#define MFM_TARGET(t) __attribute__((target(t)))
+#define MFM_CPU(t) __builtin_cpu_supports(t)
+#elif defined(_MSC_VER) && (defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP>=2))
+#define MFM_HAVE_SSE2
+#ifdef __AVX2__
+#define MFM_HAVE_AVX2
+#endif
+#define MFM_TARGET(t)
+#define MFM_CPU(t) 1
+#endif
+
+#ifdef MFM_HAVE_AVX2
+#include<immintrin.h>
+#elif defined(MFM_HAVE_SSE2)
+#include<emmintrin.h>
+#endif
+
+
+static ULONG (*mfmDecode)(unsigned char*, int, unsigned char*, int) = NULL;
+
+
+/*
+ * adfMfmTail
+ *
+ * bytes 'i' to 'len' of the field, one at a time, 'chk' xored with them by place in the long
+ */
+static void adfMfmTail(unsigned char *mfm, int shift, unsigned char *data, int len, int i,
+    unsigned char *chk)
+{
+    unsigned char *even;
+    unsigned char o, e;
+
+    even = mfm+len;
+    for(; i<len; i++) {
+        if (shift) {
+            o = (unsigned char)((mfm[i]<<shift) | (mfm[i+1]>>(8-shift)));
+            e = (unsigned char)((even[i]<<shift) | (even[i+1]>>(8-shift)));
+        }
+        else {
+            o = mfm[i];
+            e = even[i];
+        }
+        chk[i&3] ^= o^e;
+        data[i] = (unsigned char)(((o&0x55)<<1) | (e&0x55));
+    }
+}
+
+
+/*
+ * adfMfmChecksum
+ *
+ */
+static ULONG adfMfmChecksum(unsigned char *chk)
+{
+    return (((ULONG)chk[0]<<24) | ((ULONG)chk[1]<<16) | ((ULONG)chk[2]<<8) | chk[3]) & MFM_MASK;
+}
+
+
+/*
+ * adfMfmDecodeScalar
+ *
+ */
+static ULONG adfMfmDecodeScalar(unsigned char *mfm, int shift, unsigned char *data, int len)
+{
+    unsigned char chk[4];
+
+    chk[0] = chk[1] = chk[2] = chk[3] = 0;
+    adfMfmTail(mfm, shift, data, len, 0, chk);
+
+    return adfMfmChecksum(chk);
+}
+
+
+#ifdef MFM_HAVE_SSE2
+
+/*
+ * adfMfmDecodeSse2
+ *
+ * a byte shifted is made of two 16 bits shifts of the bytes and the next ones, masked
+ */
+MFM_TARGET("sse2")
+static ULONG adfMfmDecodeSse2(unsigned char *mfm, int shift, unsigned char *data, int len)
+{
+    __m128i m55, acc, o, e, hi, lo, cnt, rcnt;
+    unsigned char chk[4], v[16];
+    unsigned char *even;
+    int i;
+
+    even = mfm+len;
+    m55 = _mm_set1_epi8(0x55);
+    hi = _mm_set1_epi8((char)(0xff<<shift));
+    lo = _mm_set1_epi8((char)(0xff>>(8-shift)));
+    cnt = _mm_cvtsi32_si128(shift);
+    rcnt = _mm_cvtsi32_si128(8-shift);
+    acc = _mm_setzero_si128();
+    for(i=0; i+16<=len; i+=16) {
+        o = _mm_loadu_si128((__m128i*)(mfm+i));
+        e = _mm_loadu_si128((__m128i*)(even+i));
+        if (shift) {
+            o = _mm_or_si128(_mm_and_si128(_mm_sll_epi16(o, cnt), hi),
+                _mm_and_si128(_mm_srl_epi16(_mm_loadu_si128((__m128i*)(mfm+i+1)), rcnt), lo));
+            e = _mm_or_si128(_mm_and_si128(_mm_sll_epi16(e, cnt), hi),
+                _mm_and_si128(_mm_srl_epi16(_mm_loadu_si128((__m128i*)(even+i+1)), rcnt), lo));
+        }
+        acc = _mm_xor_si128(acc, _mm_xor_si128(o, e));
+        _mm_storeu_si128((__m128i*)(data+i), _mm_or_si128(
+            _mm_slli_epi16(_mm_and_si128(o, m55), 1), _mm_and_si128(e, m55)));
+    }
+
+    _mm_storeu_si128((__m128i*)v, acc);
+    chk[0] = (unsigned char)(v[0]^v[4]^v[8]^v[12]);
+    chk[1] = (unsigned char)(v[1]^v[5]^v[9]^v[13]);
+    chk[2] = (unsigned char)(v[2]^v[6]^v[10]^v[14]);
+    chk[3] = (unsigned char)(v[3]^v[7]^v[11]^v[15]);
+    adfMfmTail(mfm, shift, data, len, i, chk);
+
+    return adfMfmChecksum(chk);
+}
+
+#endif /* MFM_HAVE_SSE2 */
+
+
+#ifdef MFM_HAVE_AVX2
+
+/*
+ * adfMfmDecodeAvx2
+ *
+ * the SSE2 kernel, 32 bytes at a time
+ */
+MFM_TARGET("avx2")
+static ULONG adfMfmDecodeAvx2(unsigned char *mfm, int shift, unsigned char *data, int len)
+{
+    __m256i m55, acc, o, e, hi, lo;
+    __m128i cnt, rcnt, acc2;
+    unsigned char chk[4], v[16];
+    unsigned char *even;
+    int i;
+
+    even = mfm+len;
+    m55 = _mm256_set1_epi8(0x55);
+    hi = _mm256_set1_epi8((char)(0xff<<shift));
+    lo = _mm256_set1_epi8((char)(0xff>>(8-shift)));
+    cnt = _mm_cvtsi32_si128(shift);
+    rcnt = _mm_cvtsi32_si128(8-shift);
+    acc = _mm256_setzero_si256();
+    for(i=0; i+32<=len; i+=32) {
+        o = _mm256_loadu_si256((__m256i*)(mfm+i));
+        e = _mm256_loadu_si256((__m256i*)(even+i));
+        if (shift) {
+            o = _mm256_or_si256(_mm256_and_si256(_mm256_sll_epi16(o, cnt), hi),
+                _mm256_and_si256(_mm256_srl_epi16(_mm256_loadu_si256((__m256i*)(mfm+i+1)), rcnt), lo));
+            e = _mm256_or_si256(_mm256_and_si256(_mm256_sll_epi16(e, cnt), hi),
+                _mm256_and_si256(_mm256_srl_epi16(_mm256_loadu_si256((__m256i*)(even+i+1)), rcnt), lo));
+        }
+        acc = _mm256_xor_si256(acc, _mm256_xor_si256(o, e));
+        _mm256_storeu_si256((__m256i*)(data+i), _mm256_or_si256(
+            _mm256_slli_epi16(_mm256_and_si256(o, m55), 1), _mm256_and_si256(e, m55)));
+    }
+
+    /* the two halves are at the same place in the longs */
+    acc2 = _mm_xor_si128(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+    _mm_storeu_si128((__m128i*)v, acc2);
+    chk[0] = (unsigned char)(v[0]^v[4]^v[8]^v[12]);
+    chk[1] = (unsigned char)(v[1]^v[5]^v[9]^v[13]);
+    chk[2] = (unsigned char)(v[2]^v[6]^v[10]^v[14]);
+    chk[3] = (unsigned char)(v[3]^v[7]^v[11]^v[15]);
+    adfMfmTail(mfm, shift, data, len, i, chk);
+
+    return adfMfmChecksum(chk);
+}
+
+#endif /* MFM_HAVE_AVX2 */
+
+
+/*
+ * adfMfmKernel
+ */
+/*!	\brief	Choose the kernel of adfMfmDecode().
+ *	\param	kernel - MFM_ANY, MFM_SCALAR, MFM_SSE2 or MFM_AVX2.
+ *	\return	The kernel now used, or -1 if the requested one isn't available.
+ *
+ *	MFM_ANY takes AVX2, then SSE2, then the scalar kernel. It is the default. All the kernels
+ *	give the same bytes, the choice is only for tests and measures.
+ */
+int adfMfmKernel(int kernel)
+{
+#ifdef MFM_HAVE_AVX2
+    if ((kernel==MFM_ANY || kernel==MFM_AVX2) && MFM_CPU("avx2")) {
+        mfmDecode = adfMfmDecodeAvx2;
+        return MFM_AVX2;
+    }
+#endif
+#ifdef MFM_HAVE_SSE2
+    if ((kernel==MFM_ANY || kernel==MFM_SSE2) && MFM_CPU("sse2")) {
+        mfmDecode = adfMfmDecodeSse2;
+        return MFM_SSE2;
+    }
+#endif
+    if (kernel==MFM_ANY || kernel==MFM_SCALAR) {
+        mfmDecode = adfMfmDecodeScalar;
+        return MFM_SCALAR;
+    }
+
+    return -1;
+}
+
+
+/*
+ * adfMfmDecode
+ */
+/*!	\brief	Decode a field of an Amiga sector : its odd bits, then its even bits.
+ *	\param	mfm   - the first byte of the field.
+ *	\param	shift - the field starts at this bit of that byte, 0 (the highest bit) to 7.
+ *	\param	data  - receives the 'len' bytes decoded.
+ *	\param	len   - the size of the data, a multiple of 4 : 4 for the header info and the
+ *					checksums, 16 for the label, 512 for the data.
+ *	\return	The Amiga checksum of the 2*len MFM bytes : their longs xored, masked with MFM_MASK.
+ *
+ *	2*len bytes are read, one more when 'shift' isn't 0. Several threads can decode at once.
+ */
+ULONG adfMfmDecode(unsigned char *mfm, int shift, unsigned char *data, int len)
+{
+    if (!mfmDecode)
+        adfMfmKernel(MFM_ANY);
+
+    return (*mfmDecode)(mfm, shift, data, len);
+}
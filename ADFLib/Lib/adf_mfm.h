@@ -0,0 +1,20 @@
+#ifndef ADF_MFM_H
+#define ADF_MFM_H 1
+
+/*
+ *  ADF Library. (C) 1997-2002 Laurent Clevy
+ */
+/*! \file	adf_mfm.h
+ *  \brief	Amiga MFM decoding header.
+ */
+
+#include"prefix.h"
+
+#include"adf_str.h"
+
+#define MFM_MASK    0x55555555L     /* data bits of a MFM long */
+
+PREFIX ULONG adfMfmDecode(unsigned char *mfm, int shift, unsigned char *data, int len);
+PREFIX int adfMfmKernel(int kernel);
+
+#endif /* ADF_MFM_H */
@@ -153,7 +153,7 @@ RETCODE adfWriteRootBlock(struct Volume* vol, long nSect, struct bRootBlock* roo
  	dumpBlock(buf);
 #endif /*_DEBUG_PRINTF_*/
 
-	if (adfWriteBlock(vol, nSect, buf)!=RC_OK)
+	if (adfWriteMetaBlock(vol, nSect, buf)!=RC_OK)
         return RC_ERROR;
 
 #ifdef _DEBUG_PRINTF_
@@ -179,16 +179,13 @@ adfReadBootBlock(struct Volume* vol, struct bBootBlock* boot)
 	puts("22");
 #endif /*_DEBUG_PRINTF_*/
 
-	if (adfReadBlock(vol, 0, buf)!=RC_OK)
+	if (adfReadBlocks(vol, 0, 2, buf)!=RC_OK)
 		return RC_ERROR;
 
 #ifdef _DEBUG_PRINTF_
 	puts("11");
 #endif /*_DEBUG_PRINTF_*/
 
-    if (adfReadBlock(vol, 1, buf+LOGICAL_BLOCK_SIZE)!=RC_OK)
-		return RC_ERROR;
-
     memcpy(boot, buf, LOGICAL_BLOCK_SIZE*2);
 #ifdef LITT_ENDIAN
     swapEndian((unsigned char*)boot,SWBL_BOOT);
@@ -242,9 +239,7 @@ adfWriteBootBlock(struct Volume* vol, struct bBootBlock* boot)
 	dumpBlock(buf+512);
 #endif /*_DEBUG_PRINTF_*/
 
-    if (adfWriteBlock(vol, 0, buf)!=RC_OK)
-		return RC_ERROR;
-	if (adfWriteBlock(vol, 1,  buf+512)!=RC_OK)
+    if (adfWriteBlocks(vol, 0, 2, buf)!=RC_OK)
 		return RC_ERROR;
 
 #ifdef _DEBUG_PRINTF_
@@ -18,6 +18,7 @@
 #include "adf_dir.h"
 #include "adf_file.h"
 #include "adf_cache.h"
+#include "adf_raw.h"
 
 extern struct Env adfEnv;
 
@@ -212,13 +213,16 @@ RETCODE adfUndelDir(struct Volume* vol, SECTNUM pSect, SECTNUM nSect,
     strncpy(name, entry->dirName, entry->nameLen);
     name[(int)entry->nameLen] = '\0';
     /* insert the entry in the parent hashTable, with the headerKey sector pointer */
-    adfSetBlockUsed(vol,entry->headerKey);
+    if (adfSetBlockUsed(vol,entry->headerKey)!=RC_OK)
+        return RC_ERROR;
+    if (isDIRCACHE(vol->dosType) && adfSetBlockUsed(vol,entry->extension)!=RC_OK) {
+        adfSetBlockFree(vol,entry->headerKey);
+        return RC_ERROR;
+    }
     adfCreateEntry(vol, &parent, name, entry->headerKey);
 
-    if (isDIRCACHE(vol->dosType)) {
+    if (isDIRCACHE(vol->dosType))
         adfAddInCache(vol, &parent, (struct bEntryBlock *)entry);
-        adfSetBlockUsed(vol,entry->extension);
-    }
 
     adfUpdateBitmap(vol);
 
@@ -249,19 +253,22 @@ RETCODE adfUndelFile(struct Volume* vol, SECTNUM pSect, SECTNUM nSect, struct bF
 
     adfGetFileBlocks(vol, entry, &fileBlocks);
 
-    for(i=0; i<fileBlocks.nbData; i++)
+    rc = RC_OK;
+    for(i=0; i<fileBlocks.nbData && rc==RC_OK; i++)
         if ( !adfIsBlockFree(vol,fileBlocks.data[i]) )
-            return RC_ERROR;
+            rc = RC_ERROR;
         else
-            adfSetBlockUsed(vol, fileBlocks.data[i]);
-    for(i=0; i<fileBlocks.nbExtens; i++)
+            rc = adfSetBlockUsed(vol, fileBlocks.data[i]);
+    for(i=0; i<fileBlocks.nbExtens && rc==RC_OK; i++)
         if ( !adfIsBlockFree(vol,fileBlocks.extens[i]) )
-            return RC_ERROR;
+            rc = RC_ERROR;
         else
-            adfSetBlockUsed(vol, fileBlocks.extens[i]);
+            rc = adfSetBlockUsed(vol, fileBlocks.extens[i]);
 
     free(fileBlocks.data);
     free(fileBlocks.extens);
+    if (rc!=RC_OK)
+        return rc;
 
     if (adfReadEntryBlock(vol, pSect, &parent)!=RC_OK)
 		return RC_ERROR;
@@ -435,4 +442,621 @@ RETCODE adfCheckEntry(struct Volume* vol, SECTNUM nSect, int level)
 }
 
 
+/*
+ * adfCarveCmpData
+ *
+ * qsort() order for the OFS data block index : headerKey, then seqNum
+ */
+static int adfCarveCmpData(const void *a, const void *b)
+{
+    const struct CarveData *da = (const struct CarveData*)a;
+    const struct CarveData *db = (const struct CarveData*)b;
+
+    if (da->headerKey!=db->headerKey)
+        return (da->headerKey<db->headerKey) ? -1 : 1;
+    if (da->seqNum!=db->seqNum)
+        return (da->seqNum<db->seqNum) ? -1 : 1;
+    return (da->sect<db->sect) ? -1 : (da->sect>db->sect);
+}
+
+
+/*
+ * adfCarveCmpExt
+ *
+ * qsort() order for the extension block index : parent, then sector
+ */
+static int adfCarveCmpExt(const void *a, const void *b)
+{
+    const struct CarveExt *ea = (const struct CarveExt*)a;
+    const struct CarveExt *eb = (const struct CarveExt*)b;
+
+    if (ea->parent!=eb->parent)
+        return (ea->parent<eb->parent) ? -1 : 1;
+    return (ea->sect<eb->sect) ? -1 : (ea->sect>eb->sect);
+}
+
+
+/*
+ * adfCarveFindHeader
+ *
+ * binary search in the header index, which is filled in sector order
+ */
+static struct CarveHeader* adfCarveFindHeader(struct CarveIndex *idx, SECTNUM sect)
+{
+    long lo, hi, mid;
+
+    lo = 0; hi = idx->nbHeader-1;
+    while(lo<=hi) {
+        mid = (lo+hi)/2;
+        if (idx->header[mid].sect==sect)
+            return &(idx->header[mid]);
+        if (idx->header[mid].sect<sect)
+            lo = mid+1;
+        else
+            hi = mid-1;
+    }
+    return NULL;
+}
+
+
+/*
+ * adfCarveFindExt
+ *
+ * binary search for an extension block among ext[first..last-1], which are sorted by sector.
+ * Returns its index, or -1
+ */
+static long adfCarveFindExt(struct CarveIndex *idx, long first, long last, SECTNUM sect)
+{
+    long lo, hi, mid;
+
+    lo = first; hi = last-1;
+    while(lo<=hi) {
+        mid = (lo+hi)/2;
+        if (idx->ext[mid].sect==sect)
+            return mid;
+        if (idx->ext[mid].sect<sect)
+            lo = mid+1;
+        else
+            hi = mid-1;
+    }
+    return -1;
+}
+
+
+/*
+ * adfCarveGrow
+ *
+ * makes room for one more record in an index table
+ */
+static void* adfCarveGrow(void *table, long nb, long *max, size_t size)
+{
+    void *newTable;
+
+    if (nb<*max)
+        return table;
+    newTable = realloc(table, (*max ? *max*2 : 256) * size);
+    if (newTable)
+        *max = *max ? *max*2 : 256;
+    return newTable;
+}
+
+
+/*
+ * adfCarveFreeIndex
+ *
+ */
+static void adfCarveFreeIndex(struct CarveIndex *idx)
+{
+    free(idx->data);
+    free(idx->ext);
+    free(idx->header);
+    free(idx->blocks);
+}
+
+
+/*
+ * adfCarveAddBlocks
+ *
+ * copies the data block pointers of a file header or extension block at the end of
+ * idx->blocks, in file order. Returns their number, or -1. They are only kept if the
+ * caller then adds it to idx->nbBlocks
+ */
+static long adfCarveAddBlocks(struct Volume *vol, struct CarveIndex *idx, unsigned char *buf,
+    long *maxBlocks)
+{
+    void *table;
+    long i, highSeq;
+    SECTNUM sect;
+
+    table = adfCarveGrow(idx->blocks, idx->nbBlocks+MAX_DATABLK-1, maxBlocks, sizeof(SECTNUM));
+    if (!table)
+        return -1;
+    idx->blocks = (SECTNUM*)table;
+
+    highSeq = swapLong(buf+8);
+    if (highSeq<0)
+        highSeq = 0;
+    if (highSeq>MAX_DATABLK)
+        highSeq = MAX_DATABLK;
+    for(i=0; i<highSeq; i++) {
+        sect = swapLong(buf+24+(MAX_DATABLK-1-i)*4);
+        idx->blocks[idx->nbBlocks+i] = isSectNumValid(vol, sect) ? sect : 0;
+    }
+
+    return highSeq;
+}
+
+
+/*
+ * adfCarveBuildIndex
+ *
+ * one sequential pass over the volume : every block is read exactly once,
+ * and only a few longs per interesting block are kept, with the data block
+ * pointers of the file headers and extension blocks
+ */
+static RETCODE adfCarveBuildIndex(struct Volume *vol, struct CarveIndex *idx)
+{
+    unsigned char one[LOGICAL_BLOCK_SIZE];
+    unsigned char *buf, *run;
+    long i, nbBlocks, type, secType;
+    long maxData, maxExt, maxHeader, maxBlocks;
+    long highSeq;
+    void *table;
+    BOOL runRead;
+
+    memset(idx, 0, sizeof(struct CarveIndex));
+    maxData = maxExt = maxHeader = maxBlocks = 0;
+
+    run = (unsigned char*)malloc(LOGICAL_BLOCK_SIZE*SALV_RUN);
+    if (!run) {
+        (*adfEnv.eFct)("adfCarveBuildIndex : malloc");
+        return RC_MALLOC;
+    }
+    runRead = FALSE;
+
+    nbBlocks = vol->lastBlock - vol->firstBlock + 1;
+    for(i=0; i<nbBlocks; i++) {
+        /* read by runs of SALV_RUN blocks, one by one where a run can't be read */
+        if (i%SALV_RUN==0)
+            runRead = adfReadBlocks(vol, i, min(SALV_RUN, nbBlocks-i), run)==RC_OK;
+        if (runRead)
+            buf = run+(i%SALV_RUN)*LOGICAL_BLOCK_SIZE;
+        else {
+            if (adfReadBlock(vol, i, one)!=RC_OK)
+                continue;
+            buf = one;
+        }
+        type = swapLong(buf);
+        if (type!=T_DATA && type!=T_LIST && type!=T_HEADER)
+            continue;
+        if ((ULONG)swapLong(buf+20)!=adfNormalSum(buf,20,LOGICAL_BLOCK_SIZE))
+            continue;
+        secType = swapLong(buf+vol->blockSize-4);
+
+        if (type==T_DATA && isOFS(vol->dosType)) {
+            table = adfCarveGrow(idx->data, idx->nbData, &maxData, sizeof(struct CarveData));
+            if (!table) goto error;
+            idx->data = (struct CarveData*)table;
+            idx->data[idx->nbData].sect = i;
+            idx->data[idx->nbData].headerKey = swapLong(buf+4);
+            idx->data[idx->nbData].seqNum = swapLong(buf+8);
+            idx->data[idx->nbData].dataSize = swapLong(buf+12);
+            if (idx->data[idx->nbData].seqNum>0
+                && idx->data[idx->nbData].seqNum<=nbBlocks
+                && idx->data[idx->nbData].dataSize>=0
+                && idx->data[idx->nbData].dataSize<=vol->datablockSize
+                && isSectNumValid(vol, idx->data[idx->nbData].headerKey))
+                idx->nbData++;
+        }
+        else if (type==T_LIST && secType==ST_FILE) {
+            table = adfCarveGrow(idx->ext, idx->nbExt, &maxExt, sizeof(struct CarveExt));
+            if (!table) goto error;
+            idx->ext = (struct CarveExt*)table;
+            idx->ext[idx->nbExt].sect = i;
+            idx->ext[idx->nbExt].parent = swapLong(buf+vol->blockSize-12);
+            idx->ext[idx->nbExt].next = swapLong(buf+vol->blockSize-8);
+            if (swapLong(buf+4)==i
+                && isSectNumValid(vol, idx->ext[idx->nbExt].parent)) {
+                highSeq = adfCarveAddBlocks(vol, idx, buf, &maxBlocks);
+                if (highSeq<0) goto error;
+                idx->ext[idx->nbExt].highSeq = highSeq;
+                idx->ext[idx->nbExt].blocks = idx->nbBlocks;
+                idx->nbBlocks += highSeq;
+                idx->nbExt++;
+            }
+        }
+        else if (type==T_HEADER && secType==ST_FILE && swapLong(buf+4)==i) {
+            table = adfCarveGrow(idx->header, idx->nbHeader, &maxHeader, sizeof(struct CarveHeader));
+            if (!table) goto error;
+            idx->header = (struct CarveHeader*)table;
+            highSeq = adfCarveAddBlocks(vol, idx, buf, &maxBlocks);
+            if (highSeq<0) goto error;
+            idx->header[idx->nbHeader].sect = i;
+            idx->header[idx->nbHeader].parent = swapLong(buf+vol->blockSize-12);
+            idx->header[idx->nbHeader].extension = swapLong(buf+vol->blockSize-8);
+            idx->header[idx->nbHeader].highSeq = highSeq;
+            idx->header[idx->nbHeader].blocks = idx->nbBlocks;
+            idx->nbBlocks += highSeq;
+            idx->nbHeader++;
+        }
+    }
+
+    free(run);
+
+    if (idx->nbData>0)
+        qsort(idx->data, idx->nbData, sizeof(struct CarveData), adfCarveCmpData);
+    if (idx->nbExt>0)
+        qsort(idx->ext, idx->nbExt, sizeof(struct CarveExt), adfCarveCmpExt);
+
+    return RC_OK;
+
+error:
+    (*adfEnv.eFct)("adfCarveBuildIndex : malloc");
+    free(run);
+    adfCarveFreeIndex(idx);
+    return RC_MALLOC;
+}
+
+
+/*
+ * adfCarveWalk
+ *
+ * follows the 'next' pointers from ext[i] inside ext[first..last-1], until a block
+ * that is lost or already taken. Appends the blocks to order[], returns its new length
+ */
+static long adfCarveWalk(struct CarveIndex *idx, long first, long last, long i,
+    BOOL *done, long *order, long n)
+{
+    while(i!=-1 && !done[i-first]) {
+        done[i-first] = TRUE;
+        order[n++] = i;
+        i = adfCarveFindExt(idx, first, last, idx->ext[i].next);
+    }
+    return n;
+}
+
+
+/*
+ * adfCarveLiveBlocks
+ *
+ * the data blocks a file header found by the scan still owns : the ones of its table, then the
+ * ones of the extension blocks reachable from it. Returns a malloc'ed array in file order, or
+ * NULL with *nb set to -1 if out of memory
+ */
+static SECTNUM* adfCarveLiveBlocks(struct CarveIndex *idx, struct CarveHeader *header, long *nb)
+{
+    SECTNUM *live;
+    BOOL *done;
+    long *order;
+    long i, j, n, first, last, nbOrder;
+
+    /* the extension blocks of this header : sorted by parent first */
+    first = 0; last = idx->nbExt;
+    while(first<last) {
+        i = (first+last)/2;
+        if (idx->ext[i].parent<header->sect)
+            first = i+1;
+        else
+            last = i;
+    }
+    for(last=first; last<idx->nbExt && idx->ext[last].parent==header->sect; last++);
+
+    done = (BOOL*)calloc(last-first+1, sizeof(BOOL));
+    order = (long*)malloc((last-first+1)*sizeof(long));
+    if (!done || !order) {
+        free(done); free(order);
+        *nb = -1;
+        return NULL;
+    }
+    nbOrder = adfCarveWalk(idx, first, last,
+        adfCarveFindExt(idx, first, last, header->extension), done, order, 0);
+
+    n = header->highSeq;
+    for(i=0; i<nbOrder; i++)
+        n += idx->ext[order[i]].highSeq;
+    live = (SECTNUM*)malloc((n+1)*sizeof(SECTNUM));
+    if (live) {
+        memcpy(live, idx->blocks+header->blocks, header->highSeq*sizeof(SECTNUM));
+        n = header->highSeq;
+        for(i=0; i<nbOrder; i++)
+            for(j=0; j<idx->ext[order[i]].highSeq; j++)
+                live[n++] = idx->blocks[idx->ext[order[i]].blocks+j];
+    }
+    else
+        n = -1;
+    free(done); free(order);
+
+    *nb = n;
+    return live;
+}
+
+
+/*
+ * adfCarveOFSFile
+ *
+ * data[first..last-1] share the same headerKey and are sorted by seqNum.
+ * A valid file header at headerKey only owns the blocks it lists : the sector may
+ * have been taken by another file since, and what it doesn't list is orphaned
+ */
+static struct OrphanFile* adfCarveOFSFile(struct Volume *vol, struct CarveIndex *idx,
+    long first, long last)
+{
+    struct OrphanFile *file;
+    struct CarveHeader *header;
+    struct CarveData *d;
+    SECTNUM *live;
+    BOOL *owned;
+    long i, maxSeq, nbLive;
+
+    d = idx->data;
+    owned = (BOOL*)calloc(last-first, sizeof(BOOL));
+    if (!owned)
+        return NULL;
+
+    header = adfCarveFindHeader(idx, d[first].headerKey);
+    if (header!=NULL && isSectNumValid(vol, header->parent)) {
+        live = adfCarveLiveBlocks(idx, header, &nbLive);
+        if (nbLive<0) {
+            free(owned);
+            return NULL;
+        }
+        for(i=first; i<last; i++)
+            owned[i-first] = d[i].seqNum<=nbLive && live[d[i].seqNum-1]==d[i].sect;
+        free(live);
+    }
+
+    /* the highest seqNum which is not owned */
+    for(i=last-1; i>=first && owned[i-first]; i--);
+    if (i<first) {
+        free(owned);
+        return NULL;
+    }
+    maxSeq = d[i].seqNum;
+
+    file = (struct OrphanFile*)malloc(sizeof(struct OrphanFile));
+    if (file)
+        file->data = (SECTNUM*)calloc(maxSeq, sizeof(SECTNUM));
+    if (!file || !file->data) {
+        free(file); free(owned);
+        return NULL;
+    }
+    file->header = d[first].headerKey;
+    file->headerFound = FALSE;
+    file->nbData = maxSeq;
+    file->nbMissing = maxSeq;
+    file->size = 0;
+    for(i=first; i<last; i++)
+        /* first block wins when several claim the same seqNum */
+        if (!owned[i-first] && file->data[d[i].seqNum-1]==0) {
+            file->data[d[i].seqNum-1] = d[i].sect;
+            file->nbMissing--;
+            if (d[i].seqNum==maxSeq)
+                file->size = (maxSeq-1)*vol->datablockSize + d[i].dataSize;
+        }
+    free(owned);
+
+    return file;
+}
+
+
+/*
+ * adfCarveCheckHeader
+ *
+ * the header block of a FFS orphan may have been reused since : its data block pointers are
+ * only taken if it is still a file header with a full table, whose parent is a directory
+ */
+static BOOL adfCarveCheckHeader(struct Volume *vol, SECTNUM nSect, struct bFileHeaderBlock *fhdr)
+{
+    struct bEntryBlock parent;
+
+    if (adfReadEntryBlock(vol, nSect, (struct bEntryBlock*)fhdr)!=RC_OK)
+        return FALSE;
+    if (fhdr->secType!=ST_FILE || fhdr->headerKey!=nSect || fhdr->highSeq!=MAX_DATABLK)
+        return FALSE;
+    if (!isSectNumValid(vol, fhdr->parent)
+        || adfReadEntryBlock(vol, fhdr->parent, &parent)!=RC_OK)
+        return FALSE;
+
+    return parent.secType==ST_DIR || parent.secType==ST_ROOT;
+}
+
+
+/*
+ * adfCarveFFSFile
+ *
+ * ext[first..last-1] share the same parent and are sorted by sector.
+ * The chain order is rebuilt from the 'extension' pointers of the survivors,
+ * and their data block pointers were kept by the scan : no block is read again.
+ */
+static struct OrphanFile* adfCarveFFSFile(struct Volume *vol, struct CarveIndex *idx,
+    long first, long last)
+{
+    struct OrphanFile *file;
+    struct CarveHeader *header;
+    struct bFileHeaderBlock fhdr;
+    struct CarveExt *e;
+    BOOL *done, *pointed;
+    long *order;
+    long i, j, k, n, nbExt, nbOrder;
+
+    e = idx->ext;
+    nbExt = last-first;
+    header = adfCarveFindHeader(idx, e[first].parent);
+    if (header!=NULL && adfCarveFindExt(idx, first, last, header->extension)!=-1)
+        return NULL;    /* chain is reachable from the header */
+    if (header!=NULL && !adfCarveCheckHeader(vol, header->sect, &fhdr))
+        header = NULL;
+
+    /* the first MAX_DATABLK pointers lived in the header block */
+    n = MAX_DATABLK;
+    for(i=first; i<last; i++)
+        n += e[i].highSeq;
+
+    done = (BOOL*)calloc(nbExt, sizeof(BOOL));
+    pointed = (BOOL*)calloc(nbExt, sizeof(BOOL));
+    order = (long*)malloc(nbExt*sizeof(long));
+    file = (struct OrphanFile*)malloc(sizeof(struct OrphanFile));
+    if (file)
+        file->data = (SECTNUM*)calloc(n, sizeof(SECTNUM));
+    if (!done || !pointed || !order || !file || !file->data) {
+        if (file) free(file->data);
+        free(file); free(done); free(pointed); free(order);
+        return NULL;
+    }
+    file->header = e[first].parent;
+    file->headerFound = (header!=NULL);
+
+    /* a block another survivor points to is not the start of a chain */
+    for(i=first; i<last; i++) {
+        j = adfCarveFindExt(idx, first, last, e[i].next);
+        if (j!=-1 && j!=i)
+            pointed[j-first] = TRUE;
+    }
+    /* the chains first, in sector order, then what is left : cycles */
+    nbOrder = 0;
+    for(k=0; k<2; k++)
+        for(i=first; i<last; i++)
+            if (!done[i-first] && (k==1 || !pointed[i-first]))
+                nbOrder = adfCarveWalk(idx, first, last, i, done, order, nbOrder);
+
+    n = 0;
+    file->nbMissing = 0;
+    if (header!=NULL)
+        for(i=0; i<MAX_DATABLK; i++)
+            file->data[n++] = fhdr.dataBlocks[MAX_DATABLK-1-i];
+    else {
+        n = MAX_DATABLK;
+        file->nbMissing = MAX_DATABLK;
+    }
+    for(k=0; k<nbOrder; k++)
+        for(j=0; j<e[order[k]].highSeq; j++) {
+            file->data[n] = idx->blocks[e[order[k]].blocks+j];
+            if (file->data[n]==0)
+                file->nbMissing++;
+            n++;
+        }
+    free(done); free(pointed); free(order);
+
+    file->nbData = n;
+    file->size = n*vol->datablockSize;
+    if (header!=NULL && fhdr.byteSize<(ULONG)file->size)
+        file->size = fhdr.byteSize;
+
+    return file;
+}
+
+
+/*
+ * adfGetOrphanFiles
+ */
+/*!	\brief	Find files whose header or extension chain is destroyed.
+ *	\param	vol - the volume to search.
+ *	\return	A list of OrphanFile structs. NULL if nothing was found.
+ *
+ *	The volume is read once, block after block, and the surviving OFS data blocks are grouped by
+ *	headerKey and seqNum, and the FFS file extension blocks are grouped by parent. Files whose
+ *	header block is missing (or now belongs to another file) are rebuilt from those groups.
+ *
+ *	\b Internals \n
+ *	OFS data blocks carry their own header pointer and sequence number, so the whole file can be
+ *	rebuilt and holes are reported in nbMissing. FFS data blocks carry nothing, so only the
+ *	blocks listed in surviving extension blocks are recovered; the MAX_DATABLK pointers of a
+ *	destroyed header are counted as missing.
+ *	\sa See adfSaveOrphanFile() to write a file out. \n
+ *	See adfFreeOrphanList() to free the list.
+ */
+struct List* adfGetOrphanFiles(struct Volume *vol)
+{
+    struct CarveIndex idx;
+    struct OrphanFile *file;
+    struct List *list, *head;
+    long i, j;
+
+    if (adfCarveBuildIndex(vol, &idx)!=RC_OK)
+        return NULL;
+
+    list = head = NULL;
+    for(i=0; i<idx.nbData; i=j) {
+        for(j=i+1; j<idx.nbData && idx.data[j].headerKey==idx.data[i].headerKey; j++);
+        file = adfCarveOFSFile(vol, &idx, i, j);
+        if (file) {
+            list = newCell(list, (void*)file);
+            if (head==NULL) head = list;
+        }
+    }
+    /* OFS extension blocks only duplicate what the data blocks already tell */
+    for(i=0; !isOFS(vol->dosType) && i<idx.nbExt; i=j) {
+        for(j=i+1; j<idx.nbExt && idx.ext[j].parent==idx.ext[i].parent; j++);
+        file = adfCarveFFSFile(vol, &idx, i, j);
+        if (file) {
+            list = newCell(list, (void*)file);
+            if (head==NULL) head = list;
+        }
+    }
+
+    adfCarveFreeIndex(&idx);
+    return head;
+}
+
+
+/*
+ * adfSaveOrphanFile
+ */
+/*!	\brief	Write the recovered content of an orphaned file.
+ *	\param	vol  - the volume the file was found on.
+ *	\param	file - an entry of the list returned by adfGetOrphanFiles().
+ *	\param	out  - an opened host file.
+ *	\return	RC_OK or RC_ERROR.
+ *
+ *	Missing blocks are written as zeros so that the following data keeps its offset.
+ */
+RETCODE adfSaveOrphanFile(struct Volume *vol, struct OrphanFile *file, FILE *out)
+{
+    unsigned char buf[LOGICAL_BLOCK_SIZE];
+    long i, len, left, offset;
+
+    offset = isOFS(vol->dosType) ? 24 : 0;
+    left = file->size;
+    for(i=0; i<file->nbData && left>0; i++) {
+        len = min(left, vol->datablockSize);
+        if (file->data[i]==0)
+            memset(buf, 0, LOGICAL_BLOCK_SIZE);
+        else {
+            if (adfReadBlock(vol, file->data[i], buf)!=RC_OK)
+                return RC_ERROR;
+            if (isOFS(vol->dosType))
+                len = min(len, swapLong(buf+12));
+        }
+        if (fwrite(buf+offset, 1, len, out)!=(size_t)len) {
+            (*adfEnv.eFct)("adfSaveOrphanFile : fwrite");
+            return RC_ERROR;
+        }
+        left -= min(left, vol->datablockSize);
+    }
+
+    return RC_OK;
+}
+
+
+/*
+ * adfFreeOrphanList
+ */
+/*!	\brief	Free the list of orphaned files.
+ *	\param	list - the list to free.
+ *	\return	Void.
+ */
+void adfFreeOrphanList(struct List* list)
+{
+    struct List *cell;
+
+    cell = list;
+    while(cell!=NULL) {
+        free(((struct OrphanFile*)cell->content)->data);
+        free(cell->content);
+        cell = cell->next;
+    }
+    freeList(list);
+}
+
+
 /*#############################################################################*/
@@ -12,11 +12,54 @@
 
 #include "adf_str.h"
 
+#define SALV_RUN    64      /* blocks read with one device access by the salvage scans */
+
+/*! \brief OFS data block, as indexed by adfGetOrphanFiles() */
+struct CarveData{
+    SECTNUM sect;		/*!< Block location.				*/
+    SECTNUM headerKey;	/*!< File header block pointer.		*/
+    long seqNum;		/*!< Position in the file (from 1).	*/
+    long dataSize;		/*!< Bytes used in the block.		*/
+};
+
+/*! \brief File extension block, as indexed by adfGetOrphanFiles() */
+struct CarveExt{
+    SECTNUM sect;		/*!< Block location.				*/
+    SECTNUM parent;		/*!< File header block pointer.		*/
+    SECTNUM next;		/*!< Next extension block.			*/
+    long highSeq;		/*!< Number of data block pointers.	*/
+    long blocks;		/*!< First of them in CarveIndex.blocks.	*/
+};
+
+/*! \brief Valid file header block, as indexed by adfGetOrphanFiles() */
+struct CarveHeader{
+    SECTNUM sect;		/*!< Block location.				*/
+    SECTNUM parent;		/*!< Parent directory.				*/
+    SECTNUM extension;	/*!< First extension block.			*/
+    long highSeq;		/*!< Number of data block pointers.	*/
+    long blocks;		/*!< First of them in CarveIndex.blocks.	*/
+};
+
+/*! \brief Result of the single scan pass of adfGetOrphanFiles() */
+struct CarveIndex{
+    long nbData;
+    struct CarveData *data;		/*!< Sorted by headerKey, seqNum.	*/
+    long nbExt;
+    struct CarveExt *ext;		/*!< Sorted by parent, sect.		*/
+    long nbHeader;
+    struct CarveHeader *header;	/*!< Sorted by sect.				*/
+    long nbBlocks;
+    SECTNUM *blocks;			/*!< Data block pointers of the headers and extension blocks, in file order.	*/
+};
+
 RETCODE adfReadGenBlock(struct Volume *vol, SECTNUM nSect, struct GenBlock *block);
 PREFIX RETCODE adfCheckEntry(struct Volume* vol, SECTNUM nSect, int level);
 PREFIX RETCODE adfUndelEntry(struct Volume* vol, SECTNUM parent, SECTNUM nSect);
 PREFIX struct List* adfGetDelEnt(struct Volume *vol);
 PREFIX void adfFreeDelList(struct List* list);
+PREFIX struct List* adfGetOrphanFiles(struct Volume *vol);
+PREFIX RETCODE adfSaveOrphanFile(struct Volume *vol, struct OrphanFile *file, FILE *out);
+PREFIX void adfFreeOrphanList(struct List* list);
 
 
 /*##########################################################################*/
@@ -48,7 +48,26 @@ struct Volume {
     struct bBitmapBlock **bitmapTable;	/*!< Pointer to an array of bitmap block structs.					*/
     BOOL *bitmapBlocksChg;				/*!< Array of bitmap block change flags. TRUE if bitmapTable[i} has
 											 changed and needs to be written at bitmapBlocks[i].			*/
+    struct bBitmapBlock *bitmapData;	/*!< The bitmap blocks, in one allocation. bitmapTable[i] is NULL until
+											 the block is read, on first access.							*/
+    SECTNUM bitmapExt;					/*!< First bitmap extension block, 0 once bitmapBlocks[] is known.	*/
     SECTNUM curDirPtr;					/*!< The sector number of the current directory.					*/
+    struct DirCache **dirCache;			/*!< Dircaches parsed since the mount, hashed on their first block.
+											 The modified ones are written back by adfUnMount.				*/
+    long dirCacheSize;					/*!< Size of dirCache[], a power of 2.								*/
+    long nbDirCache;					/*!< Number of dircaches in dirCache[].								*/
+    BOOL session;						/*!< TRUE between adfBeginSession() and adfCommitSession().		*/
+    long nbMeta;						/*!< Number of blocks in metaHash[].								*/
+    long metaHashSize;					/*!< Size of metaHash[], a power of 2.								*/
+    struct MetaBlock **metaHash;		/*!< Metadata blocks written during the session, by sector.			*/
+};
+
+
+/*! \brief Metadata Block Struct : a block kept in memory until adfCommitSession() */
+struct MetaBlock{
+    SECTNUM sect;						/*!< Block location, from vol->firstBlock.						*/
+    struct MetaBlock *next;				/*!< Next block with the same hash value.						*/
+    unsigned char data[LOGICAL_BLOCK_SIZE];	/*!< Block contents, as written on the disk.				*/
 };
 
 
@@ -71,7 +90,7 @@ struct Partition {
 struct Device {
     int devType;						/*!< DEVTYPE_FLOPDD, DEVTYPE_FLOPHD or DEVTYPE_HARDDISK.	*/
     BOOL readOnly;						/*!< Read-only flag.										*/
-    long size;							/*!< Device size in bytes. Limited to 4GB.					*/
+    ADFOFF size;						/*!< Device size in bytes.									*/
 
     int nVol;							/*!< The number of partitions.								*/
     struct Volume** volList;  			/*!< A pointer to an array of volume structs.				*/
@@ -126,6 +145,43 @@ struct Entry{
 	int secs;			  		/*!< Time. */
 };
 
+/*! \brief New Entry Struct, see adfCreateEntries() */
+struct NewEntry{
+    char *name;					/*!< Name.															*/
+    int type;					/*!< ST_FILE or ST_DIR.												*/
+    unsigned long size;			/*!< ST_FILE : size in bytes.										*/
+    unsigned char *data;		/*!< ST_FILE : the size bytes of the file, NULL to fill with zeros.	*/
+    long access;				/*!< RWEDAPSH access flags.											*/
+    SECTNUM sect;				/*!< Returned : the header block.									*/
+};
+
+/*! \brief Dircache Block Struct (in memory) */
+struct DirCBlock{
+    SECTNUM sect;					/*!< Block location.								*/
+    int used;						/*!< Bytes used in dirc.records[].				*/
+    BOOL dirty;						/*!< TRUE if the block must be written back.		*/
+    struct bDirCacheBlock dirc;		/*!< Block contents, in host byte order.			*/
+};
+
+/*! \brief Dircache Record Key Struct */
+struct DirCKey{
+    SECTNUM header;					/*!< Entry block of the record.					*/
+    struct DirCBlock *blk;			/*!< Dircache block holding the record.			*/
+    struct DirCKey *next;			/*!< Next key with the same hash value.			*/
+};
+
+/*! \brief Dircache Struct : the parsed dircache of one directory */
+struct DirCache{
+    SECTNUM first;					/*!< First dircache block (parent->extension).	*/
+    long nbBlocks;					/*!< Number of blocks in the chain.				*/
+    long maxBlocks;					/*!< Size of blocks[].							*/
+    struct DirCBlock **blocks;		/*!< The chain, in order. The last is the tail.	*/
+    long nbKeys;					/*!< Number of records.							*/
+    long hashSize;					/*!< Size of keys[], a power of 2.				*/
+    struct DirCKey **keys;			/*!< Record location, hashed on the entry block.	*/
+    struct DirCache *next;			/*!< Next directory with the same hash value.		*/
+};
+
 /*! \brief Cache Entry Struct */
 struct CacheEntry{
     long header;  				/*!< Entry block.										*/
@@ -167,6 +223,7 @@ struct DateTime{
 #define PR_USE_PROGBAR 	8	/*!< Use progress bar.							*/
 #define PR_RWACCESS 	9	/*!< Read/write access function.				*/
 #define PR_USE_RWACCESS 10	/*!< Use read/write access.						*/
+#define PR_SEEKORDER	11	/*!< Read recursive listings in sector order.	*/
 
 /*! \brief Environment Struct */
 struct Env{
@@ -184,6 +241,7 @@ struct Env{
     BOOL useProgressBar;						/*!< Use progress bar.							*/
 
     BOOL useDirCache;							/*!< Use directory cache blocks.				*/
+    BOOL seekOrder;								/*!< Read recursive listings in sector order.	*/
 	
     void *nativeFct;							/*!< Native device access function.				*/
 };
@@ -197,6 +255,35 @@ struct List{				/* generic linked tree */
     struct List* next;		/*!< Next cell.																				*/
 };
 
+/*! \brief Arena Chunk Struct */
+struct ArenaChunk{
+    struct ArenaChunk *next;	/*!< Previously filled chunk.						*/
+    long size;					/*!< Usable bytes following this header.			*/
+};
+
+/*! \brief Interned String Struct */
+struct ArenaName{
+    struct ArenaName *next;		/*!< Next string with the same hash value.			*/
+    char str[1];				/*!< The string, allocated to its real length.		*/
+};
+
+/*! \brief Arena Struct : many small allocations, freed at once */
+struct Arena{
+    struct ArenaChunk *chunks;	/*!< Allocated chunks, the current one first.		*/
+    char *ptr;					/*!< Free space in the current chunk.				*/
+    long left;					/*!< Bytes left in the current chunk.				*/
+    long nbNames;				/*!< Number of interned strings.					*/
+    long hashSize;				/*!< Size of names[], a power of 2.					*/
+    struct ArenaName **names;	/*!< Interned strings.								*/
+    BOOL failed;				/*!< TRUE once an allocation failed.				*/
+};
+
+/*! \brief Directory Tree Struct */
+struct DirTree{
+    struct List *list;			/*!< The entries, laid out like adfGetRDirEnt() does.	*/
+    struct Arena arena;			/*!< Holds the cells, the entries and the strings.		*/
+};
+
 /*! \brief Generic Block Struct */
 struct GenBlock{
     SECTNUM sect;		/*!< Current sector.														*/
@@ -206,6 +293,16 @@ struct GenBlock{
     char *name;			/*!< Name. (If type = T_HEADER and secType = ST_DIR or secType = ST_FILE).	*/
 };
 
+/*! \brief Orphaned File Struct */
+struct OrphanFile{
+    SECTNUM header;		/*!< Header block the carved blocks belong to (destroyed or reused).		*/
+    BOOL headerFound;	/*!< TRUE if the header block survived and only its extension chain is lost.	*/
+    long nbData;		/*!< Number of entries in data.												*/
+    long nbMissing;		/*!< Number of data blocks that could not be found (0 in data).				*/
+    long size;			/*!< Recoverable size in bytes, missing blocks included.					*/
+    SECTNUM* data;		/*!< Data block sectors, in file order.										*/
+};
+
 /*! \brief File Block Struct */
 struct FileBlocks{
     SECTNUM header;		/*!< Header sector location.			*/
@@ -266,6 +363,99 @@ struct bEntryBlock {
 	long	secType;				/*!< 1fc \n Secondary type = ST_FILE.											*/
 	};
 
+/*! \brief Directory Iterator Struct : the position of adfReadDir() in one directory */
+struct DirIter{
+    struct Volume *vol;					/*!< The volume.												*/
+    SECTNUM dir;						/*!< The directory.											*/
+    struct bEntryBlock parent;			/*!< The directory block, with its hash table.				*/
+    BOOL useDirc;						/*!< TRUE if the records of the dircache are read.			*/
+    int slot;							/*!< Next hash table slot.										*/
+    SECTNUM next;						/*!< Next entry block of the current same hash chain.		*/
+    SECTNUM nextDirc;					/*!< Next dircache block to read, 0 at the end of the chain.	*/
+    long nbDirc;						/*!< Dircache blocks read, against a looping chain.			*/
+    long blk;							/*!< Index of the current block in a dircache model, or -1.	*/
+    int rec;							/*!< Next record in dirc.										*/
+    int offset;							/*!< Offset of the next record in dirc.records[].				*/
+    struct bDirCacheBlock dirc;			/*!< Copy of the current dircache block.						*/
+    struct CacheEntry caEntry;			/*!< Last record read, holds the strings in dircache mode.	*/
+    char name[MAXNAMELEN+1];			/*!< Last name read in hash table mode.						*/
+    char comment[MAXCMMTLEN+1];			/*!< Last comment read in hash table mode.					*/
+    struct Entry entry;					/*!< Last entry returned by adfReadDir().						*/
+    RETCODE rc;							/*!< RC_OK, or the error which stopped the iteration.			*/
+};
+
+
+/* ----- IMAGE BUILDER ----- */
+
+/*! \brief Image Builder Entry Struct, see adfBuildImage() */
+struct BuildNode{
+    char *name;						/*!< Name.															*/
+    int type;						/*!< ST_FILE or ST_DIR.												*/
+    unsigned long size;				/*!< ST_FILE : size in bytes.										*/
+    unsigned char *data;			/*!< ST_FILE : the content, NULL to read it with readFct.			*/
+    long access;					/*!< RWEDAPSH access flags.											*/
+    char *comment;					/*!< Comment, or NULL.												*/
+    struct DateTime date;			/*!< Date. If date.mon is 0, the date of the image.				*/
+    struct BuildNode *child;		/*!< ST_DIR : first entry of the directory.						*/
+    struct BuildNode *next;			/*!< Next entry of the same directory.								*/
+    void *user;						/*!< Free for the caller.											*/
+    long first;						/*!< Private : first block allocated to the entry, in the plan.	*/
+    long nbDirc;					/*!< Private : ST_DIR : number of dircache blocks.					*/
+};
+
+/*! \brief Image Builder Struct, see adfBuildImage() */
+struct BuildImage{
+    char *volName;					/*!< Volume name.													*/
+    int volType;					/*!< FSMASK_FFS, FSMASK_INTL and FSMASK_DIRCACHE.					*/
+    long nbBlocks;					/*!< Size of the image : 1760 for a DD floppy, 3520 for a HD one.	*/
+    unsigned char *bootCode;		/*!< 1024 bytes of a boot block, or NULL.							*/
+    struct DateTime date;			/*!< Date of the volume, and of the entries without date.			*/
+    struct BuildNode *root;			/*!< First entry of the root directory.							*/
+    long (*readFct)(struct BuildNode *node, unsigned long pos, long n, unsigned char *buf);
+									/*!< Reads the files without data, in order. Returns n.			*/
+};
+
+
+/* ----- ASYNCHRONOUS I/O ----- */
+
+#define AIO_ANY			0	/*!< Best engine available.						*/
+#define AIO_URING		1	/*!< Linux io_uring.								*/
+#define AIO_THREADS		2	/*!< Pool of threads doing positional reads.		*/
+#define AIO_SYNC		3	/*!< Read when submitted.							*/
+
+/*! \brief Asynchronous Read Request Struct, see adfAioSubmit() */
+struct AioRequest{
+    struct Volume *vol;				/*!< The volume.												*/
+    SECTNUM sect;					/*!< First block, from vol->firstBlock, as with adfReadBlocks().	*/
+    int nb;							/*!< Number of consecutive blocks.								*/
+    unsigned char *buf;				/*!< Receives nb*512 bytes.									*/
+    void *user;						/*!< Free for the caller.										*/
+    RETCODE rc;						/*!< RC_OK or RC_ERROR, once returned by adfAioComplete().		*/
+    struct AioRequest *next;		/*!< Private : queue of the engine.							*/
+    int handle;						/*!< Private : file descriptor of the dump.					*/
+    ADFOFF offset;					/*!< Private : position of the first block in the dump.		*/
+};
+
+/*! \brief Asynchronous I/O Engine, private to adf_aio.c */
+struct AsyncIO;
+
+
+/* ----- MFM DECODING ----- */
+
+#define MFM_ANY			0	/*!< Fastest kernel of the processor.			*/
+#define MFM_SCALAR		1	/*!< One byte at a time, everywhere.				*/
+#define MFM_SSE2		2	/*!< 16 bytes at a time.							*/
+#define MFM_AVX2		3	/*!< 32 bytes at a time.							*/
+
+
+/* ----- EXTENDED ADF ----- */
+
+#define EXT_DOS			0	/*!< AmigaDOS sectors, stored decoded.			*/
+#define EXT_MFM			1	/*!< Raw MFM, all its AmigaDOS sectors good.	*/
+#define EXT_CUSTOM		2	/*!< Raw MFM of another format, or damaged.		*/
+
+/*! \brief Tracks of an extended ADF, private to adf_ext.c */
+struct ExtDump;
 
 #define ENV_DECLARATION struct Env adfEnv	/*!< The environment struct. */
 
@@ -6,6 +6,7 @@
  */
 
 #include<stdlib.h>
+#include<string.h>
 #include<time.h>
 
 #include "adf_util.h"
@@ -239,4 +240,140 @@ void dumpBlock(unsigned char *buf)
 
 
 
+/*
+ * adfArenaInit
+ *
+ */
+void adfArenaInit(struct Arena *arena)
+{
+    memset(arena, 0, sizeof(struct Arena));
+}
+
+
+/*
+ * adfArenaAlloc
+ *
+ * returns 'size' bytes from the current chunk. a new chunk is started when it is full :
+ * the chunk size doubles, up to ARENA_MAXCHUNK
+ */
+void* adfArenaAlloc(struct Arena *arena, long size)
+{
+    struct ArenaChunk *chunk;
+    long chunkSize;
+    void *p;
+
+    /* keeps the next allocation aligned for any type */
+    size = (size+7) & ~7L;
+    if (size>arena->left) {
+        chunkSize = arena->chunks ? arena->chunks->size*2 : ARENA_MINCHUNK;
+        if (chunkSize>ARENA_MAXCHUNK)
+            chunkSize = ARENA_MAXCHUNK;
+        if (chunkSize<size)
+            chunkSize = size;
+        /* header rounded up, so that the data keeps the alignment of malloc() */
+        chunk = (struct ArenaChunk*)malloc(((sizeof(struct ArenaChunk)+7) & ~7L) + chunkSize);
+        if (!chunk) {
+            (*adfEnv.eFct)("adfArenaAlloc : malloc");
+            arena->failed = TRUE;
+            return NULL;
+        }
+        chunk->size = chunkSize;
+        chunk->next = arena->chunks;
+        arena->chunks = chunk;
+        arena->ptr = (char*)chunk + ((sizeof(struct ArenaChunk)+7) & ~7L);
+        arena->left = chunkSize;
+    }
+    p = arena->ptr;
+    arena->ptr += size;
+    arena->left -= size;
+
+    return p;
+}
+
+
+/*
+ * adfArenaHash
+ *
+ */
+static unsigned long adfArenaHash(char *str)
+{
+    unsigned long hash;
+    unsigned char *c;
+
+    hash = 5381;
+    for(c=(unsigned char*)str; *c; c++)
+        hash = hash*33 + *c;
+
+    return hash;
+}
+
+
+/*
+ * adfArenaIntern
+ *
+ * returns a copy of 'str' stored once in the arena : equal strings share the same copy
+ */
+char* adfArenaIntern(struct Arena *arena, char *str)
+{
+    struct ArenaName *name, **newNames, *next;
+    unsigned long h;
+    long i, newSize;
+
+    if (arena->hashSize>0)
+        for(name=arena->names[adfArenaHash(str) & (arena->hashSize-1)]; name!=NULL; name=name->next)
+            if (strcmp(name->str, str)==0)
+                return name->str;
+
+    /* at most one string per bucket in average */
+    if (arena->nbNames>=arena->hashSize) {
+        newSize = arena->hashSize ? arena->hashSize*2 : 256;
+        newNames = (struct ArenaName**)calloc(newSize, sizeof(struct ArenaName*));
+        if (!newNames) {
+            (*adfEnv.eFct)("adfArenaIntern : malloc");
+            arena->failed = TRUE;
+            return NULL;
+        }
+        for(i=0; i<arena->hashSize; i++)
+            for(name=arena->names[i]; name!=NULL; name=next) {
+                next = name->next;
+                h = adfArenaHash(name->str) & (newSize-1);
+                name->next = newNames[h];
+                newNames[h] = name;
+            }
+        free(arena->names);
+        arena->names = newNames;
+        arena->hashSize = newSize;
+    }
+
+    name = (struct ArenaName*)adfArenaAlloc(arena, sizeof(struct ArenaName)+strlen(str));
+    if (!name)
+        return NULL;
+    strcpy(name->str, str);
+    h = adfArenaHash(str) & (arena->hashSize-1);
+    name->next = arena->names[h];
+    arena->names[h] = name;
+    arena->nbNames++;
+
+    return name->str;
+}
+
+
+/*
+ * adfArenaFree
+ *
+ * frees everything allocated in the arena, one free() per chunk
+ */
+void adfArenaFree(struct Arena *arena)
+{
+    struct ArenaChunk *chunk, *next;
+
+    for(chunk=arena->chunks; chunk!=NULL; chunk=next) {
+        next = chunk->next;
+        free(chunk);
+    }
+    free(arena->names);
+    adfArenaInit(arena);
+}
+
+
 /*################################################################################*/
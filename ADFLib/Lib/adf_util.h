@@ -12,6 +12,9 @@
 
 #include "adf_str.h"
 
+#define ARENA_MINCHUNK	(16*1024)		/* first chunk of an arena */
+#define ARENA_MAXCHUNK	(1024*1024)		/* the chunk size doubles up to this size */
+
 
 void swLong(unsigned char* buf, unsigned long val);
 void swShort(unsigned char* buf, unsigned short val);
@@ -27,6 +30,11 @@ adfGiveCurrentTime( void );
 
 void dumpBlock(unsigned char *buf);
 
+void adfArenaInit(struct Arena *arena);
+void* adfArenaAlloc(struct Arena *arena, long size);
+char* adfArenaIntern(struct Arena *arena, char *str);
+void adfArenaFree(struct Arena *arena);
+
 /*##########################################################################*/
 #endif /* _ADF_UTIL_H */
 
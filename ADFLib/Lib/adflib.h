@@ -38,6 +38,7 @@ PREFIX void freeList(struct List* list);
 /* dir */
 PREFIX RETCODE adfToRootDir(struct Volume *vol);
 PREFIX RETCODE adfCreateDir(struct Volume* vol, SECTNUM parent, char* name);
+PREFIX RETCODE adfCreateEntries(struct Volume* vol, SECTNUM parent, struct NewEntry *entries, int nb);
 PREFIX RETCODE adfChangeDir(struct Volume* vol, char *name);
 PREFIX RETCODE adfParentDir(struct Volume* vol);
 PREFIX RETCODE adfRemoveEntry(struct Volume *vol, SECTNUM pSect, char *name);
@@ -45,6 +46,13 @@ PREFIX struct List* adfGetDirEnt(struct Volume* vol, SECTNUM nSect );
 PREFIX struct List* adfGetRDirEnt(struct Volume* vol, SECTNUM nSect, BOOL recurs );
 PREFIX void printEntry(struct Entry* entry);
 PREFIX void adfFreeDirList(struct List* list);
+PREFIX struct DirTree* adfGetDirTree(struct Volume* vol, SECTNUM nSect, BOOL recurs);
+PREFIX void adfFreeDirTree(struct DirTree* tree);
+PREFIX struct DirIter* adfOpenDir(struct Volume *vol, SECTNUM nSect);
+PREFIX struct Entry* adfReadDir(struct DirIter *it);
+PREFIX void adfCloseDir(struct DirIter *it);
+PREFIX RETCODE adfWalkDir(struct Volume *vol, SECTNUM nSect,
+    BOOL (*walkFct)(struct Entry *entry, int depth, void *data), void *data);
 PREFIX void adfFreeEntry(struct Entry *);
 PREFIX RETCODE adfRenameEntry(struct Volume *vol, SECTNUM, char *old,SECTNUM, char *pNew);	/* BV */
 PREFIX RETCODE adfSetEntryAccess(struct Volume*, SECTNUM, char*, long);
@@ -65,10 +73,14 @@ PREFIX RETCODE adfInstallBootBlock(struct Volume *vol,unsigned char*);
 PREFIX struct Volume* adfMount( struct Device *dev, int nPart, BOOL readOnly );
 PREFIX void adfUnMount(struct Volume *vol);
 PREFIX void adfVolumeInfo(struct Volume *vol);
+PREFIX RETCODE adfFlushDirCache(struct Volume *vol);
+PREFIX RETCODE adfBeginSession(struct Volume *vol);
+PREFIX RETCODE adfCommitSession(struct Volume *vol);
 
 /* device */
 PREFIX void adfDeviceInfo(struct Device *dev);
 PREFIX struct Device* adfMountDev( char* filename,BOOL ro);
+PREFIX struct Device* adfMountMemDev(unsigned char* image, ADFOFF size, BOOL ro);
 PREFIX void adfUnMountDev( struct Device* dev);
 PREFIX RETCODE adfCreateHd(struct Device* dev, int n, struct Partition** partList );
 PREFIX RETCODE adfCreateFlop(struct Device* dev, char* volName, int volType );
@@ -77,6 +89,27 @@ PREFIX RETCODE adfCreateHdFile(struct Device* dev, char* volName, int volType);
 /* dump device */
 PREFIX struct Device* adfCreateDumpDevice(char* filename, long cyl, long heads, long sec);
 
+/* asynchronous reads */
+PREFIX struct AsyncIO* adfAioOpen(int depth, int engine);
+PREFIX int adfAioEngine(struct AsyncIO *aio);
+PREFIX RETCODE adfAioSubmit(struct AsyncIO *aio, struct AioRequest *req, int nb);
+PREFIX int adfAioComplete(struct AsyncIO *aio, struct AioRequest **done, int max, BOOL wait);
+PREFIX void adfAioClose(struct AsyncIO *aio);
+
+/* MFM decoding */
+PREFIX ULONG adfMfmDecode(unsigned char *mfm, int shift, unsigned char *data, int len);
+PREFIX int adfMfmKernel(int kernel);
+
+/* extended ADF */
+PREFIX long adfReadExtTrack(struct Device *dev, int track, unsigned char *buf, long size, int *type);
+
+/* image builder */
+PREFIX RETCODE adfBuildImage(struct BuildImage *img, char *filename);
+
+/* volume optimizer */
+PREFIX RETCODE adfDefragVolume(struct Volume *vol, long *nbMoved);
+PREFIX RETCODE adfDefragCopy(struct Volume *vol, char *filename);
+
 /* env */
 PREFIX void adfEnvInitDefault();
 PREFIX void adfEnvCleanUp();
@@ -94,6 +127,9 @@ PREFIX struct List* adfGetDelEnt(struct Volume *vol);
 PREFIX RETCODE adfUndelEntry(struct Volume* vol, SECTNUM parent, SECTNUM nSect);
 PREFIX void adfFreeDelList(struct List* list);
 PREFIX RETCODE adfCheckEntry(struct Volume* vol, SECTNUM nSect, int level);
+PREFIX struct List* adfGetOrphanFiles(struct Volume *vol);
+PREFIX RETCODE adfSaveOrphanFile(struct Volume *vol, struct OrphanFile *file, FILE *out);
+PREFIX void adfFreeOrphanList(struct List* list);
 
 /* middle level API */
 
@@ -103,6 +139,8 @@ PREFIX BOOL isSectNumValid(struct Volume *vol, SECTNUM nSect);
 
 PREFIX RETCODE adfReadBlock(struct Volume* , long nSect, unsigned char* buf);
 PREFIX RETCODE adfWriteBlock(struct Volume* , long nSect, unsigned char* buf);
+PREFIX RETCODE adfReadBlocks(struct Volume* , long nSect, int nb, unsigned char* buf);
+PREFIX RETCODE adfWriteBlocks(struct Volume* , long nSect, int nb, unsigned char* buf);
 PREFIX long adfCountFreeBlocks(struct Volume* vol);
 
 
@@ -0,0 +1,178 @@
+/*
+ *  aio_read.c
+ *
+ *  batches of asynchronous block reads on two dumps and a native device,
+ *  with each engine
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include"adflib.h"
+
+
+#define NBREQ       300
+#define BATCH       40
+#define MAXNB       32
+
+
+struct Volume *vols[3];
+struct AioRequest req[NBREQ];
+unsigned char *bufs[NBREQ];
+unsigned char image[2][512*1760];
+
+
+/*
+ * fillVolume
+ *
+ * the boot block and the blocks around the root are kept
+ */
+void fillVolume(struct Volume *vol, int v)
+{
+    unsigned char buf[512];
+    long sect;
+    int i;
+
+    for(sect=2; sect<1760; sect++) {
+        if (sect>=870 && sect<890)
+            continue;
+        for(i=0; i<512; i++)
+            buf[i] = (unsigned char)(v*71+sect*13+i+sect/251);
+        adfWriteBlock(vol, sect, buf);
+    }
+}
+
+
+/*
+ * checkRequest
+ *
+ */
+int checkRequest(struct AioRequest *r)
+{
+    int v;
+
+    v = r->vol==vols[0] ? 0 : 1;
+    return memcmp(r->buf, image[v]+512*r->sect, 512*r->nb)!=0;
+}
+
+
+/*
+ * runEngine
+ *
+ */
+int runEngine(int engine, char *title)
+{
+    struct AsyncIO *aio;
+    struct AioRequest *done[BATCH];
+    unsigned long seed;
+    int i, n, nbDone, rc, bad;
+
+    aio = adfAioOpen(8, engine);
+    if (!aio) {
+        printf("%-8s : not available\n", title);
+        return 0;
+    }
+
+    seed = 12345;
+    for(i=0; i<NBREQ; i++) {
+        seed = seed*1103515245+12345;
+        req[i].vol = vols[(seed>>16)%3];
+        req[i].nb = 1+(int)((seed>>8)%MAXNB);
+        req[i].sect = (long)((seed>>4)%(1760-req[i].nb+1));
+        req[i].buf = bufs[i];
+        req[i].user = (void*)&req[i];
+        memset(bufs[i], 0, 512*MAXNB);
+    }
+    /* out of the volume */
+    req[NBREQ-1].sect = 1759;
+    req[NBREQ-1].nb = 4;
+
+    rc = nbDone = bad = 0;
+    for(i=0; i<NBREQ; i+=BATCH) {
+        n = NBREQ-i<BATCH ? NBREQ-i : BATCH;
+        adfAioSubmit(aio, req+i, n);
+        while((n=adfAioComplete(aio, done, BATCH, FALSE))>0)
+            for(nbDone+=n; n>0; n--)
+                bad += done[n-1]->user!=done[n-1] || (done[n-1]!=&req[NBREQ-1]
+                    && (done[n-1]->rc!=RC_OK || checkRequest(done[n-1])));
+        rc |= n<0;
+    }
+    while((n=adfAioComplete(aio, done, BATCH, TRUE))>0)
+        for(nbDone+=n; n>0; n--)
+            bad += done[n-1]->user!=done[n-1] || (done[n-1]!=&req[NBREQ-1]
+                && (done[n-1]->rc!=RC_OK || checkRequest(done[n-1])));
+    rc |= n<0;
+    rc |= req[NBREQ-1].rc!=RC_ERROR;
+
+    printf("%-8s : %d requests completed, %d bad\n", title, nbDone, bad);
+    rc |= nbDone!=NBREQ || bad!=0;
+
+    adfAioClose(aio);
+
+    return rc;
+}
+
+
+/*
+ *
+ *
+ */
+int main(int argc, char *argv[])
+{
+    struct Device *dev[3];
+    int i, rc;
+
+    adfEnvInitDefault();
+
+    for(i=0; i<NBREQ; i++) {
+        bufs[i] = (unsigned char*)malloc(512*MAXNB);
+        if (!bufs[i]) exit(1);
+    }
+
+    /* two floppies, the second one also mounted as a native device */
+    for(i=0; i<2; i++) {
+        dev[i] = adfCreateDumpDevice(i==0 ? "newdev" : "newdev2", 80, 2, 11);
+        if (!dev[i]) {
+            fprintf(stderr, "can't mount device\n");
+            adfEnvCleanUp(); exit(1);
+        }
+        adfCreateFlop(dev[i], "aio", FSMASK_FFS);
+        vols[i] = adfMount(dev[i], 0, FALSE);
+        if (!vols[i]) {
+            fprintf(stderr, "can't mount volume\n");
+            adfEnvCleanUp(); exit(1);
+        }
+        fillVolume(vols[i], i);
+        adfReadBlocks(vols[i], 0, 1760, image[i]);
+    }
+    /* the blocks of newdev stay in the buffer of the FILE* until the reads are submitted */
+    adfUnMount(vols[1]);
+    adfUnMountDev(dev[1]);
+    dev[1] = adfMountDev("newdev2", TRUE);
+    vols[1] = dev[1] ? adfMount(dev[1], 0, TRUE) : NULL;
+    dev[2] = adfMountDev("|newdev2", TRUE);
+    vols[2] = dev[2] ? adfMount(dev[2], 0, TRUE) : NULL;
+    if (!vols[1] || !vols[2]) {
+        fprintf(stderr, "can't mount native device\n");
+        adfEnvCleanUp(); exit(1);
+    }
+
+    rc = 0;
+    rc |= runEngine(AIO_URING, "io_uring");
+    rc |= runEngine(AIO_THREADS, "threads");
+    rc |= runEngine(AIO_SYNC, "sync");
+    rc |= runEngine(AIO_ANY, "any");
+
+    for(i=2; i>=0; i--) {
+        adfUnMount(vols[i]);
+        adfUnMountDev(dev[i]);
+    }
+    for(i=0; i<NBREQ; i++)
+        free(bufs[i]);
+
+    adfEnvCleanUp();
+
+    return rc;
+}
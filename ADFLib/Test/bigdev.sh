@@ -24,3 +24,27 @@ rm newdev
 echo "-----"
 
 hardfile /home/root/hardfile.hdf
+
+dir_seek
+rm newdev
+echo "-----"
+
+bitm_lazy
+rm newdev
+echo "-----"
+
+hdf_probe
+rm newdev
+echo "-----"
+
+hd_big
+rm newdev
+echo "-----"
+
+native_dev
+rm newdev
+echo "-----"
+
+build_img hd
+rm newdev newdev2
+echo "-----"
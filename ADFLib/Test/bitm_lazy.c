@@ -0,0 +1,113 @@
+/*
+ *  bitm_lazy.c
+ *
+ *  the bitmap blocks are read only when they are needed
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include"adflib.h"
+
+
+long nbReads;
+
+
+/*
+ * countReads
+ *
+ */
+void countReads(SECTNUM physical, SECTNUM logical, BOOL write)
+{
+    if (!write)
+        nbReads++;
+}
+
+
+/*
+ *
+ *
+ */
+int main(int argc, char *argv[])
+{
+    struct Device *hd;
+    struct Volume *vol;
+    struct File *fic;
+    struct List *list;
+    unsigned char buf[2048];
+    long free1, free2, mountReads;
+    BOOL true = TRUE;
+    int rc;
+
+    adfEnvInitDefault();
+
+    adfChgEnvProp(PR_RWACCESS, countReads);
+    adfChgEnvProp(PR_USE_RWACCESS, &true);
+
+    /* 128000 blocks : 32 bitmap blocks, so one bitmap extension block */
+    hd = adfCreateDumpDevice("newdev", 1000, 4, 32);
+    if (!hd) {
+        fprintf(stderr, "can't mount device\n");
+        adfEnvCleanUp(); exit(1);
+    }
+    adfCreateHdFile( hd, "lazy", FSMASK_FFS );
+    vol = adfMount(hd, 0, FALSE);
+    if (!vol) {
+        adfUnMountDev(hd);
+        fprintf(stderr, "can't mount volume\n");
+        adfEnvCleanUp(); exit(1);
+    }
+    memset(buf, 'x', 2048);
+    fic = adfOpenFile(vol, "file", "w");
+    adfWriteFile(fic, 2048, buf);
+    adfCloseFile(fic);
+    free1 = adfCountFreeBlocks(vol);
+    adfUnMount(vol);
+
+    /* read only listing : the bootblock and the rootblock only */
+    nbReads = 0;
+    vol = adfMount(hd, 0, TRUE);
+    mountReads = nbReads;
+    list = adfGetDirEnt(vol, vol->curDirPtr);
+    adfFreeDirList(list);
+    printf("read only mount : %ld blocks read, with the listing : %ld\n", mountReads, nbReads);
+    rc = mountReads>3 || vol->bitmapData!=NULL;
+
+    /* all the bitmap blocks, extension included */
+    free2 = adfCountFreeBlocks(vol);
+    printf("free blocks : %ld before, %ld after\n", free1, free2);
+    rc = rc || free1!=free2;
+    adfUnMount(vol);
+
+    /* the blocks changed by a deletion are written back */
+    vol = adfMount(hd, 0, FALSE);
+    adfRemoveEntry(vol, vol->curDirPtr, "file");
+    free1 = adfCountFreeBlocks(vol);
+    adfUnMount(vol);
+    vol = adfMount(hd, 0, TRUE);
+    free2 = adfCountFreeBlocks(vol);
+    printf("after the deletion : %ld free blocks, %ld after remount\n", free1, free2);
+    rc = rc || free1!=free2;
+    adfUnMount(vol);
+
+    /* a bitmap block that can't be read fails the deletion */
+    vol = adfMount(hd, 0, FALSE);
+    fic = adfOpenFile(vol, "file2", "w");
+    adfWriteFile(fic, 2048, buf);
+    adfCloseFile(fic);
+    adfUnMount(vol);
+    vol = adfMount(hd, 0, FALSE);
+    vol->bitmapBlocks[(vol->rootBlock-2)/(127*32)] = vol->lastBlock-vol->firstBlock+1;
+    free1 = adfRemoveEntry(vol, vol->curDirPtr, "file2");
+    printf("deletion with an unreadable bitmap block : %s\n", free1==RC_OK ? "RC_OK" : "error");
+    rc = rc || free1==RC_OK;
+    adfUnMount(vol);
+
+    adfUnMountDev(hd);
+
+    adfEnvCleanUp();
+
+    return rc;
+}
@@ -0,0 +1,172 @@
+/*
+ *  block_io.c
+ *
+ *  multi-block reads and writes, and file reads by runs of blocks
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include"adflib.h"
+
+
+#define BIGSIZE     150000
+#define SMALLSIZE   20000
+
+
+/*
+ * writeFile
+ *
+ */
+void writeFile(struct Volume *vol, char *name, unsigned char *buf, long size)
+{
+    struct File *fic;
+
+    fic = adfOpenFile(vol, name, "w");
+    adfWriteFile(fic, size, buf);
+    adfCloseFile(fic);
+}
+
+
+/*
+ * checkFile
+ *
+ * reads the file by chunks of 'chunk' bytes
+ */
+int checkFile(struct Volume *vol, char *name, unsigned char *buf, long size, long chunk)
+{
+    struct File *fic;
+    unsigned char *out;
+    long pos, n;
+    int rc;
+
+    out = (unsigned char*)malloc(size+chunk);
+    if (!out)
+        return 1;
+    fic = adfOpenFile(vol, name, "r");
+    if (!fic) {
+        free(out);
+        return 1;
+    }
+    pos = 0;
+    while(!adfEndOfFile(fic) && pos<=size) {
+        n = adfReadFile(fic, chunk, out+pos);
+        if (n==0)
+            break;
+        pos += n;
+    }
+    adfCloseFile(fic);
+
+    rc = pos!=size || memcmp(buf, out, size)!=0;
+    free(out);
+
+    return rc;
+}
+
+
+/*
+ * checkVolume
+ *
+ */
+int checkVolume(struct Volume *vol, char *title, unsigned char *buf)
+{
+    static long chunks[] = { 1, 100, 511, 512, 513, 4096, 65536, BIGSIZE };
+    int i, rc;
+
+    rc = 0;
+    for(i=0; i<(int)(sizeof(chunks)/sizeof(long)); i++) {
+        rc |= checkFile(vol, "big", buf, BIGSIZE, chunks[i]);
+        rc |= checkFile(vol, "frag", buf+1, BIGSIZE, chunks[i]);
+    }
+    printf("%s : file reads %s\n", title, rc ? "different" : "same");
+
+    return rc;
+}
+
+
+/*
+ *
+ *
+ */
+int main(int argc, char *argv[])
+{
+    struct Device *flop;
+    struct Volume *vol;
+    unsigned char *buf, *disk, *one;
+    long i;
+    int rc, type;
+
+    adfEnvInitDefault();
+
+    buf = (unsigned char*)malloc(BIGSIZE+1);
+    disk = (unsigned char*)malloc(512*1760);
+    one = (unsigned char*)malloc(512*1760);
+    if (!buf || !disk || !one) exit(1);
+    for(i=0; i<BIGSIZE+1; i++)
+        buf[i] = (unsigned char)(i*13+i/509);
+
+    rc = 0;
+    for(type=0; type<2; type++) {
+        flop = adfCreateDumpDevice("newdev", 80, 2, 11);
+        if (!flop) {
+            fprintf(stderr, "can't mount device\n");
+            adfEnvCleanUp(); exit(1);
+        }
+        adfCreateFlop( flop, "blocks", type==0 ? FSMASK_FFS : 0 );
+        vol = adfMount(flop, 0, FALSE);
+        if (!vol) {
+            adfUnMountDev(flop);
+            fprintf(stderr, "can't mount volume\n");
+            adfEnvCleanUp(); exit(1);
+        }
+
+        /* 'frag' fills the hole left by 'small', then goes on after 'big' */
+        writeFile(vol, "small", buf, SMALLSIZE);
+        writeFile(vol, "big", buf, BIGSIZE);
+        adfRemoveEntry(vol, vol->curDirPtr, "small");
+        writeFile(vol, "frag", buf+1, BIGSIZE);
+
+        rc |= checkVolume(vol, type==0 ? "FFS" : "OFS", buf);
+
+        /* the whole floppy at once, by tracks and block by block */
+        rc |= adfReadBlocks(vol, 0, 1760, disk)!=RC_OK;
+        for(i=0; i<1760; i++)
+            rc |= adfReadBlock(vol, i, one+i*512)!=RC_OK;
+        rc |= memcmp(disk, one, 512*1760)!=0;
+        memset(one, 0, 512*1760);
+        for(i=0; i<160; i++)
+            rc |= adfReadBlocks(vol, i*11, 11, one+i*11*512)!=RC_OK;
+        rc |= memcmp(disk, one, 512*1760)!=0;
+        printf("whole disk, tracks and blocks : %s\n", rc ? "different" : "same");
+
+        /* out of the volume */
+        rc |= adfReadBlocks(vol, 1750, 11, one)==RC_OK;
+
+        adfUnMount(vol);
+        adfUnMountDev(flop);
+
+        /* written back as the whole disk */
+        flop = adfMountDev("newdev", FALSE);
+        vol = adfMount(flop, 0, FALSE);
+        for(i=0; i<512*1760; i++)
+            one[i] = disk[i];
+        rc |= adfWriteBlocks(vol, 0, 1760, one)!=RC_OK;
+        adfUnMount(vol);
+        adfUnMountDev(flop);
+
+        flop = adfMountDev("newdev", TRUE);
+        vol = adfMount(flop, 0, TRUE);
+        rc |= checkVolume(vol, "rewritten", buf);
+        rc |= adfWriteBlocks(vol, 0, 2, one)==RC_OK;
+        adfUnMount(vol);
+        adfUnMountDev(flop);
+    }
+
+    free(buf); free(disk); free(one);
+
+    adfEnvCleanUp();
+
+    return rc;
+}
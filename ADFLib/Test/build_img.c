@@ -0,0 +1,380 @@
+/*
+ *  build_img.c
+ *
+ *  adfBuildImage : the same image twice, read back by the usual functions,
+ *  and still usable by them
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include"adflib.h"
+
+
+#define NBMANY      40
+#define BIGSIZE     100000
+#define ADDSIZE     50000
+
+
+struct BuildNode top[5], sub[3], many[NBMANY], deep[2];
+char manyNames[NBMANY][32];
+unsigned char *big;
+
+
+/*
+ * fileByte
+ *
+ */
+unsigned char fileByte(struct BuildNode *node, unsigned long pos)
+{
+    return (unsigned char)(node->name[0]*3+node->size+pos+pos/487);
+}
+
+
+/*
+ * readBig
+ *
+ * the files without data
+ */
+long readBig(struct BuildNode *node, unsigned long pos, long n, unsigned char *buf)
+{
+    long i;
+
+    for(i=0; i<n; i++)
+        buf[i] = fileByte(node, pos+i);
+
+    return n;
+}
+
+
+/*
+ * setNode
+ *
+ */
+void setNode(struct BuildNode *node, char *name, int type, unsigned long size,
+    struct BuildNode *child, struct BuildNode *next)
+{
+    unsigned long i;
+
+    memset(node, 0, sizeof(struct BuildNode));
+    node->name = name;
+    node->type = type;
+    node->size = size;
+    node->child = child;
+    node->next = next;
+    if (type==ST_FILE && size>0 && size<BIGSIZE) {
+        node->data = (unsigned char*)malloc(size);
+        if (!node->data) exit(1);
+        for(i=0; i<size; i++)
+            node->data[i] = fileByte(node, i);
+    }
+}
+
+
+/*
+ * makeTree
+ *
+ * files of many sizes, a directory with many entries, and a deep one
+ */
+void makeTree()
+{
+    int i;
+
+    setNode(&top[0], "readme", ST_FILE, 700, NULL, &top[1]);
+    top[0].comment = "a comment";
+    top[0].date.year = 95; top[0].date.mon = 6; top[0].date.day = 15;
+    setNode(&top[1], "Empty", ST_FILE, 0, NULL, &top[2]);
+    setNode(&top[2], "big", ST_FILE, BIGSIZE, NULL, &top[3]);
+    setNode(&top[3], "Sub", ST_DIR, 0, &sub[0], &top[4]);
+    setNode(&top[4], "one", ST_FILE, 488, NULL, NULL);
+
+    setNode(&sub[0], "many", ST_DIR, 0, &many[0], &sub[1]);
+    setNode(&sub[1], "deep", ST_DIR, 0, &deep[0], &sub[2]);
+    setNode(&sub[2], "two", ST_FILE, 512, NULL, NULL);
+
+    for(i=0; i<NBMANY; i++) {
+        sprintf(manyNames[i], "an_entry_with_a_long_name_%d", i);
+        setNode(&many[i], manyNames[i], ST_FILE, i*61, NULL, i+1<NBMANY ? &many[i+1] : NULL);
+    }
+
+    setNode(&deep[0], "deeper", ST_DIR, 0, &deep[1], NULL);
+    setNode(&deep[1], "last", ST_FILE, 1000, NULL, NULL);
+}
+
+
+/*
+ * checkTree
+ *
+ * returns the number of wrong entries
+ */
+int checkTree(struct Volume *vol, struct BuildNode *node)
+{
+    struct File *fic;
+    unsigned char *buf;
+    SECTNUM dir;
+    unsigned long i;
+    long n;
+    int bad;
+
+    bad = 0;
+    dir = vol->curDirPtr;
+    buf = (unsigned char*)malloc(BIGSIZE+1);
+    for(; node; node=node->next) {
+        if (node->type==ST_DIR) {
+            if (adfChangeDir(vol, node->name)!=RC_OK) {
+                bad++;
+                continue;
+            }
+            bad += checkTree(vol, node->child);
+            vol->curDirPtr = dir;
+            continue;
+        }
+        fic = adfOpenFile(vol, node->name, "r");
+        if (!fic) {
+            bad++;
+            continue;
+        }
+        n = adfReadFile(fic, BIGSIZE+1, buf);
+        if (n!=(long)node->size)
+            bad++;
+        else
+            for(i=0; i<node->size; i++)
+                if (buf[i]!=fileByte(node, i)) {
+                    bad++;
+                    break;
+                }
+        adfCloseFile(fic);
+    }
+    free(buf);
+
+    return bad;
+}
+
+
+/*
+ * checkList
+ *
+ * the entries of 'many' by the hash table, or the dircache
+ */
+int checkList(struct Volume *vol)
+{
+    struct List *list, *cell;
+    struct Entry *e;
+    int i, found;
+
+    adfToRootDir(vol);
+    adfChangeDir(vol, "Sub");
+    adfChangeDir(vol, "many");
+    found = 0;
+    list = adfGetDirEnt(vol, vol->curDirPtr);
+    for(cell=list; cell; cell=cell->next) {
+        e = (struct Entry*)cell->content;
+        for(i=0; i<NBMANY; i++)
+            if (strcmp(e->name, many[i].name)==0 && e->size==many[i].size)
+                found++;
+    }
+    adfFreeDirList(list);
+    adfToRootDir(vol);
+
+    return NBMANY-found;
+}
+
+
+/*
+ * sameFiles
+ *
+ */
+BOOL sameFiles(char *name1, char *name2)
+{
+    FILE *f1, *f2;
+    int c1, c2;
+
+    f1 = fopen(name1, "rb");
+    f2 = fopen(name2, "rb");
+    if (!f1 || !f2) {
+        if (f1) fclose(f1);
+        if (f2) fclose(f2);
+        return FALSE;
+    }
+    do {
+        c1 = getc(f1);
+        c2 = getc(f2);
+    }while(c1==c2 && c1!=EOF);
+    fclose(f1);
+    fclose(f2);
+
+    return c1==c2;
+}
+
+
+/*
+ * readBoot
+ *
+ */
+void readBoot(char *name, unsigned char *buf)
+{
+    FILE *f;
+
+    memset(buf, 0, 1024);
+    f = fopen(name, "rb");
+    if (f) {
+        fread(buf, 1, 1024, f);
+        fclose(f);
+    }
+}
+
+
+/*
+ * freeTree
+ *
+ */
+void freeTree(struct BuildNode *node)
+{
+    for(; node; node=node->next) {
+        freeTree(node->child);
+        free(node->data);
+    }
+}
+
+
+/*
+ * run
+ *
+ */
+int run(int volType, long nbBlocks, unsigned char *bootCode, char *title)
+{
+    struct BuildImage img;
+    struct Device *dev;
+    struct Volume *vol;
+    struct File *fic;
+    unsigned char boot[2048];
+    long freeBlocks;
+    int bad, rc;
+
+    memset(&img, 0, sizeof(struct BuildImage));
+    img.volName = "built";
+    img.volType = volType;
+    img.nbBlocks = nbBlocks;
+    img.bootCode = bootCode;
+    img.date.year = 100; img.date.mon = 1; img.date.day = 2;
+    img.root = &top[0];
+    img.readFct = readBig;
+
+    rc = 0;
+    rc |= adfBuildImage(&img, "newdev")!=RC_OK;
+    rc |= adfBuildImage(&img, "newdev2")!=RC_OK;
+    rc |= !sameFiles("newdev", "newdev2");
+
+    dev = adfMountDev("newdev", FALSE);
+    if (!dev) {
+        fprintf(stderr, "can't mount device\n");
+        return 1;
+    }
+    vol = adfMount(dev, 0, FALSE);
+    if (!vol) {
+        adfUnMountDev(dev);
+        fprintf(stderr, "can't mount volume\n");
+        return 1;
+    }
+    bad = checkTree(vol, img.root);
+    bad += checkList(vol);
+    /* the same boot block as the one installed by the library */
+    if (bootCode) {
+        readBoot("newdev", boot);
+        rc |= adfInstallBootBlock(vol, bootCode)!=RC_OK;
+        readBoot("newdev", boot+1024);
+        rc |= memcmp(boot, boot+1024, 1024)!=0;
+    }
+
+    /* the bitmap : a new file must not overwrite the others */
+    freeBlocks = adfCountFreeBlocks(vol);
+    fic = adfOpenFile(vol, "added", "w");
+    rc |= fic==NULL;
+    if (fic) {
+        adfWriteFile(fic, ADDSIZE, big);
+        adfCloseFile(fic);
+    }
+    freeBlocks -= adfFileRealSize(ADDSIZE, vol->datablockSize, NULL, NULL);
+    rc |= adfCountFreeBlocks(vol)!=freeBlocks;
+    adfUnMount(vol);
+    adfUnMountDev(dev);
+
+    dev = adfMountDev("newdev", TRUE);
+    vol = adfMount(dev, 0, TRUE);
+    bad += checkTree(vol, img.root);
+    fic = adfOpenFile(vol, "added", "r");
+    if (!fic || adfReadFile(fic, BIGSIZE, big+ADDSIZE)!=ADDSIZE
+        || memcmp(big, big+ADDSIZE, ADDSIZE)!=0)
+        bad++;
+    if (fic)
+        adfCloseFile(fic);
+    rc |= adfCountFreeBlocks(vol)!=freeBlocks;
+    adfUnMount(vol);
+    adfUnMountDev(dev);
+
+    printf("%-10s : %ld free blocks, %d bad entries\n", title, freeBlocks, bad);
+
+    return rc || bad!=0;
+}
+
+
+/*
+ *
+ *
+ */
+int main(int argc, char *argv[])
+{
+    struct BuildImage img;
+    struct BuildNode dup[2], huge;
+    unsigned char bootCode[1024];
+    BOOL true = TRUE;
+    int i, rc;
+
+    adfEnvInitDefault();
+
+    makeTree();
+    big = (unsigned char*)malloc(ADDSIZE*2);
+    if (!big) exit(1);
+    for(i=0; i<ADDSIZE; i++)
+        big[i] = (unsigned char)(i*13);
+    memset(bootCode, 0, 1024);
+    memcpy(bootCode, "DOS", 3);
+    for(i=12; i<1024; i++)
+        bootCode[i] = (unsigned char)i;
+
+    rc = 0;
+    if (argc>1 && strcmp(argv[1], "hd")==0) {
+        /* with bitmap extension blocks */
+        rc |= run(FSMASK_FFS, 120000, NULL, "hardfile");
+    }
+    else {
+        rc |= run(FSMASK_FFS, 1760, NULL, "FFS");
+        rc |= run(0, 1760, NULL, "OFS");
+        rc |= run(FSMASK_FFS|FSMASK_INTL, 3520, bootCode, "HD, boot");
+        adfChgEnvProp(PR_USEDIRC, &true);
+        rc |= run(FSMASK_FFS|FSMASK_DIRCACHE, 1760, NULL, "DIRCACHE");
+        rc |= run(FSMASK_DIRCACHE, 1760, NULL, "OFS, DIRC");
+    }
+
+    /* the same name twice, and too large : no image */
+    memset(&img, 0, sizeof(struct BuildImage));
+    img.volName = "bad";
+    img.nbBlocks = 1760;
+    setNode(&dup[0], "Same", ST_FILE, 10, NULL, &dup[1]);
+    setNode(&dup[1], "sAME", ST_FILE, 10, NULL, NULL);
+    img.root = &dup[0];
+    rc |= adfBuildImage(&img, "newdev")==RC_OK;
+    setNode(&huge, "huge", ST_FILE, 2000000, NULL, NULL);
+    img.root = &huge;
+    img.readFct = readBig;
+    rc |= adfBuildImage(&img, "newdev")!=RC_VOLFULL;
+
+    freeTree(&top[0]);
+    freeTree(&dup[0]);
+    free(big);
+    adfEnvCleanUp();
+
+    return rc;
+}
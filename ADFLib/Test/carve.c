@@ -0,0 +1,244 @@
+/*
+ *  carve.c
+ *
+ *  recovers files whose header block was overwritten
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include"adflib.h"
+
+#define FILESIZE 60000
+#define BIGSIZE  200000  /* 4 full extension blocks and a partial one */
+
+unsigned char buf[BIGSIZE];
+
+
+/*
+ * destroy
+ *
+ * writes a file, then wipes its header block
+ */
+SECTNUM destroy(struct Volume *vol, char *name, long size)
+{
+    struct File *fic;
+    unsigned char zero[512];
+    SECTNUM nSect;
+
+    fic = adfOpenFile(vol, name, "w");
+    if (!fic) return -1;
+    adfWriteFile(fic, size, buf);
+    nSect = fic->fileHdr->headerKey;
+    adfCloseFile(fic);
+
+    memset(zero, 0, 512);
+    adfWriteBlock(vol, nSect, zero);
+
+    return nSect;
+}
+
+
+/*
+ * reuse
+ *
+ * writes a file, then turns its header block into the one of a small file
+ * without extension blocks, as if the sector had been taken again. The
+ * first data block of the old file may be lost too
+ */
+SECTNUM reuse(struct Volume *vol, char *name, long size, BOOL loseFirst)
+{
+    struct File *fic;
+    unsigned char blk[512], zero[512];
+    unsigned long sum;
+    SECTNUM nSect, first;
+    int i;
+
+    fic = adfOpenFile(vol, name, "w");
+    if (!fic) return -1;
+    adfWriteFile(fic, size, buf);
+    nSect = fic->fileHdr->headerKey;
+    adfCloseFile(fic);
+
+    adfReadBlock(vol, nSect, blk);
+    first = ((long)blk[308]<<24) | ((long)blk[309]<<16) | ((long)blk[310]<<8) | blk[311];
+    memset(blk+8, 0, 4);
+    blk[11] = 3;
+    memset(blk+512-8, 0, 4);
+    /* the 3 data blocks of the new file are elsewhere */
+    for(i=0; i<3; i++) {
+        blk[308-i*4] = (unsigned char)(vol->rootBlock>>24);
+        blk[309-i*4] = (unsigned char)(vol->rootBlock>>16);
+        blk[310-i*4] = (unsigned char)(vol->rootBlock>>8);
+        blk[311-i*4] = (unsigned char)vol->rootBlock;
+    }
+    memset(blk+20, 0, 4);
+    sum = 0;
+    for(i=0; i<512; i+=4)
+        sum += ((unsigned long)blk[i]<<24) | ((unsigned long)blk[i+1]<<16)
+            | ((unsigned long)blk[i+2]<<8) | blk[i+3];
+    sum = -sum;
+    blk[20] = (unsigned char)(sum>>24); blk[21] = (unsigned char)(sum>>16);
+    blk[22] = (unsigned char)(sum>>8); blk[23] = (unsigned char)sum;
+    adfWriteBlock(vol, nSect, blk);
+
+    if (loseFirst) {
+        memset(zero, 0, 512);
+        adfWriteBlock(vol, first, zero);
+    }
+
+    return nSect;
+}
+
+
+/*
+ * check
+ *
+ */
+int check(struct Volume *vol, SECTNUM nSect, long size, long skip, long missing)
+{
+    struct List *list, *cell;
+    struct OrphanFile *file;
+    unsigned char *out;
+    FILE *f;
+    int found, ok;
+
+    found = ok = 0;
+    cell = list = adfGetOrphanFiles(vol);
+    while(cell) {
+        file = (struct OrphanFile*)cell->content;
+        printf("header %ld data %ld missing %ld size %ld\n", file->header,
+            file->nbData, file->nbMissing, file->size);
+        if (file->header==nSect) {
+            found = 1;
+            f = fopen("carved","wb");
+            adfSaveOrphanFile(vol, file, f);
+            fclose(f);
+
+            /* FFS : without the header, the size is rounded to the block */
+            out = (unsigned char*)malloc(file->size);
+            f = fopen("carved","rb");
+            fread(out, 1, file->size, f);
+            fclose(f);
+            ok = file->size>=size && file->nbMissing==missing
+                && memcmp(out+skip, buf+skip, size-skip)==0;
+            free(out);
+        }
+        cell = cell->next;
+    }
+    adfFreeOrphanList(list);
+    remove("carved");
+
+    return found && ok;
+}
+
+
+/*
+ *
+ *
+ */
+int main(int argc, char *argv[])
+{
+    struct Device *hd;
+    struct Volume *vol;
+    SECTNUM nSect;
+    int i, rc;
+
+    adfEnvInitDefault();
+
+    for(i=0; i<BIGSIZE; i++)
+        buf[i] = (unsigned char)(i*7+i/512);
+
+    rc = 0;
+
+    /* OFS : every data block is found again */
+    hd = adfCreateDumpDevice("newdev", 80, 2, 11);
+    if (!hd) {
+        fprintf(stderr, "can't mount device\n");
+        adfEnvCleanUp(); exit(1);
+    }
+    adfCreateFlop( hd, "ofs", 0 );
+    vol = adfMount(hd, 0, FALSE);
+    nSect = destroy(vol, "file_ofs", FILESIZE);
+    if (check(vol, nSect, FILESIZE, 0, 0))
+        puts("OFS ok");
+    else {
+        puts("OFS failed"); rc = 1;
+    }
+    adfUnMount(vol);
+    adfUnMountDev(hd);
+
+    /* OFS : the header sector now holds another file and the first data block is lost */
+    hd = adfCreateDumpDevice("newdev", 80, 2, 11);
+    if (!hd) {
+        fprintf(stderr, "can't mount device\n");
+        adfEnvCleanUp(); exit(1);
+    }
+    adfCreateFlop( hd, "ofs", 0 );
+    vol = adfMount(hd, 0, FALSE);
+    nSect = reuse(vol, "file_ofs", FILESIZE, TRUE);
+    if (check(vol, nSect, FILESIZE, 488, 1))
+        puts("OFS reused header ok");
+    else {
+        puts("OFS reused header failed"); rc = 1;
+    }
+    adfUnMount(vol);
+    adfUnMountDev(hd);
+
+    /* FFS : the blocks listed in the header are lost */
+    hd = adfCreateDumpDevice("newdev", 80, 2, 11);
+    if (!hd) {
+        fprintf(stderr, "can't mount device\n");
+        adfEnvCleanUp(); exit(1);
+    }
+    adfCreateFlop( hd, "ffs", FSMASK_FFS );
+    vol = adfMount(hd, 0, FALSE);
+    nSect = destroy(vol, "file_ffs", FILESIZE);
+    if (check(vol, nSect, FILESIZE, 72*512, 72))
+        puts("FFS ok");
+    else {
+        puts("FFS failed"); rc = 1;
+    }
+    adfUnMount(vol);
+    adfUnMountDev(hd);
+
+    /* FFS : the header sector now holds another file, its pointers aren't taken */
+    hd = adfCreateDumpDevice("newdev", 80, 2, 11);
+    if (!hd) {
+        fprintf(stderr, "can't mount device\n");
+        adfEnvCleanUp(); exit(1);
+    }
+    adfCreateFlop( hd, "ffs", FSMASK_FFS );
+    vol = adfMount(hd, 0, FALSE);
+    nSect = reuse(vol, "file_ffs", FILESIZE, FALSE);
+    if (check(vol, nSect, FILESIZE, 72*512, 72))
+        puts("FFS reused header ok");
+    else {
+        puts("FFS reused header failed"); rc = 1;
+    }
+    adfUnMount(vol);
+    adfUnMountDev(hd);
+
+    /* FFS : a chain of several extension blocks, the last one partial */
+    hd = adfCreateDumpDevice("newdev", 80, 2, 11);
+    if (!hd) {
+        fprintf(stderr, "can't mount device\n");
+        adfEnvCleanUp(); exit(1);
+    }
+    adfCreateFlop( hd, "ffs", FSMASK_FFS );
+    vol = adfMount(hd, 0, FALSE);
+    nSect = destroy(vol, "file_big", BIGSIZE);
+    if (check(vol, nSect, BIGSIZE, 72*512, 72))
+        puts("FFS extension chain ok");
+    else {
+        puts("FFS extension chain failed"); rc = 1;
+    }
+    adfUnMount(vol);
+    adfUnMountDev(hd);
+
+    adfEnvCleanUp();
+
+    return rc;
+}
@@ -0,0 +1,389 @@
+/*
+ *  create_ent.c
+ *
+ *  adfCreateEntries : files of many sizes and directories created in one call,
+ *  read back by the usual functions. a batch whose writes fail creates nothing,
+ *  an entry with a corrupt name length is skipped by the name check
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include"adflib.h"
+
+
+#define NBENT       120
+#define BIGSIZE     40000
+#define FLOPSIZE    (80*2*11*512L)
+#define WRITABLE    40          /* blocks after the rootblock the failing device writes */
+
+
+struct NewEntry ent[NBENT];
+char names[NBENT][32];
+unsigned char *content[NBENT];
+SECTNUM rootSects[NBENT];
+
+
+/*
+ * entrySize
+ *
+ * empty, small, one block, and large files with extension blocks
+ */
+unsigned long entrySize(int i)
+{
+    if (i%40==39)
+        return BIGSIZE+i;
+    if (i%7==0)
+        return 0;
+    if (i%7==1)
+        return 488;
+    if (i%7==2)
+        return 512;
+    return (unsigned long)(i*37%3000+1);
+}
+
+
+/*
+ * fillBatch
+ *
+ */
+void fillBatch(char *prefix)
+{
+    unsigned long j;
+    int i;
+
+    for(i=0; i<NBENT; i++) {
+        sprintf(names[i], "%s%d", prefix, i);
+        ent[i].name = names[i];
+        ent[i].access = 0;
+        ent[i].sect = -1;
+        if (i%17==5) {
+            ent[i].type = ST_DIR;
+            ent[i].size = 0;
+            ent[i].data = NULL;
+            continue;
+        }
+        ent[i].type = ST_FILE;
+        ent[i].size = entrySize(i);
+        ent[i].data = content[i];
+        for(j=0; j<ent[i].size; j++)
+            content[i][j] = (unsigned char)(i*7+j+j/509);
+        /* zero filled */
+        if (i%11==3)
+            ent[i].data = NULL;
+    }
+}
+
+
+/*
+ * checkBatch
+ *
+ * returns the number of wrong entries
+ */
+int checkBatch(struct Volume *vol, SECTNUM dir)
+{
+    struct List *list, *cell;
+    struct File *fic;
+    struct Entry *e;
+    unsigned char *buf;
+    long n;
+    int i, bad, found;
+
+    bad = 0;
+    buf = (unsigned char*)malloc(BIGSIZE+NBENT+1);
+    vol->curDirPtr = dir;
+    for(i=0; i<NBENT; i++) {
+        if (ent[i].type==ST_DIR) {
+            if (adfChangeDir(vol, ent[i].name)!=RC_OK || vol->curDirPtr!=ent[i].sect)
+                bad++;
+            vol->curDirPtr = dir;
+            continue;
+        }
+        fic = adfOpenFile(vol, ent[i].name, "r");
+        if (!fic) {
+            bad++;
+            continue;
+        }
+        n = adfReadFile(fic, BIGSIZE+NBENT+1, buf);
+        if (n!=(long)ent[i].size)
+            bad++;
+        else if (ent[i].data && memcmp(buf, ent[i].data, n)!=0)
+            bad++;
+        else if (!ent[i].data) {
+            while(n>0 && buf[n-1]==0)
+                n--;
+            bad += n!=0;
+        }
+        adfCloseFile(fic);
+    }
+    free(buf);
+
+    /* by the hash table, or the dircache */
+    found = 0;
+    list = adfGetDirEnt(vol, dir);
+    for(cell=list; cell; cell=cell->next) {
+        e = (struct Entry*)cell->content;
+        for(i=0; i<NBENT; i++)
+            if (strcmp(e->name, ent[i].name)==0 && e->sector==ent[i].sect
+                && e->type==ent[i].type && e->size==(ent[i].type==ST_FILE ? ent[i].size : 0))
+                found++;
+    }
+    adfFreeDirList(list);
+    bad += NBENT-found;
+
+    return bad;
+}
+
+
+/*
+ * run
+ *
+ */
+int run(int volType, char *title)
+{
+    struct Device *flop;
+    struct Volume *vol;
+    struct NewEntry dup[2];
+    struct File *fic;
+    SECTNUM sub;
+    long freeBlocks;
+    int i, bad, rc;
+
+    flop = adfCreateDumpDevice("newdev", 80, 2, 11);
+    if (!flop) {
+        fprintf(stderr, "can't mount device\n");
+        return 1;
+    }
+    adfCreateFlop(flop, "entries", volType);
+    vol = adfMount(flop, 0, FALSE);
+    if (!vol) {
+        adfUnMountDev(flop);
+        fprintf(stderr, "can't mount volume\n");
+        return 1;
+    }
+
+    rc = 0;
+    adfCreateDir(vol, vol->rootBlock, "old");
+    adfChangeDir(vol, "old");
+    sub = vol->curDirPtr;
+    adfToRootDir(vol);
+
+    /* in the root directory, then in a subdirectory */
+    fillBatch("r");
+    rc |= adfCreateEntries(vol, vol->rootBlock, ent, NBENT)!=RC_OK;
+    bad = checkBatch(vol, vol->rootBlock);
+    for(i=0; i<NBENT; i++)
+        rootSects[i] = ent[i].sect;
+    fillBatch("s");
+    rc |= adfCreateEntries(vol, sub, ent, NBENT)!=RC_OK;
+    bad += checkBatch(vol, sub);
+
+    /* already there, and twice in the batch : nothing is created */
+    freeBlocks = adfCountFreeBlocks(vol);
+    dup[0].name = "new"; dup[0].type = ST_FILE; dup[0].size = 100; dup[0].data = NULL;
+    dup[0].access = 0;
+    dup[1] = dup[0];
+    dup[1].name = "s0";
+    rc |= adfCreateEntries(vol, sub, dup, 2)==RC_OK;
+    dup[1].name = "NEW";
+    rc |= adfCreateEntries(vol, sub, dup, 2)==RC_OK;
+    rc |= adfCountFreeBlocks(vol)!=freeBlocks;
+
+    /* the usual functions still work in the new directories */
+    vol->curDirPtr = ent[5].sect;
+    adfCloseFile(adfOpenFile(vol, "inside", "w"));
+    fic = adfOpenFile(vol, "inside", "r");
+    rc |= fic==NULL;
+    adfCloseFile(fic);
+    adfToRootDir(vol);
+
+    freeBlocks = adfCountFreeBlocks(vol);
+    adfUnMount(vol);
+    adfUnMountDev(flop);
+
+    /* on the disk */
+    flop = adfMountDev("newdev", TRUE);
+    vol = adfMount(flop, 0, TRUE);
+    bad += checkBatch(vol, sub);
+    rc |= adfCountFreeBlocks(vol)!=freeBlocks;
+    fillBatch("r");
+    for(i=0; i<NBENT; i++)
+        ent[i].sect = rootSects[i];
+    bad += checkBatch(vol, vol->rootBlock);
+    adfUnMount(vol);
+    adfUnMountDev(flop);
+
+    printf("%-10s : %ld free blocks, %d bad entries\n", title, freeBlocks, bad);
+
+    return rc || bad!=0;
+}
+
+
+/*
+ * countEntries
+ *
+ */
+int countEntries(struct Volume *vol)
+{
+    struct List *list, *cell;
+    int n;
+
+    n = 0;
+    list = adfGetDirEnt(vol, vol->rootBlock);
+    for(cell=list; cell; cell=cell->next)
+        n++;
+    adfFreeDirList(list);
+
+    return n;
+}
+
+
+/*
+ * failBatch
+ *
+ * the floppy in memory, which refuses the writes after the first blocks of
+ * the batch : nothing is created, the blocks stay free
+ */
+int failBatch(int volType, char *title)
+{
+    struct Device *flop;
+    struct Volume *vol;
+    unsigned char *image;
+    long freeBlocks;
+    int nbEnt, rc;
+    FILE *f;
+
+    flop = adfCreateDumpDevice("newdev", 80, 2, 11);
+    if (!flop)
+        return 1;
+    adfCreateFlop(flop, "fail", volType);
+    vol = adfMount(flop, 0, FALSE);
+    if (!vol) {
+        adfUnMountDev(flop);
+        return 1;
+    }
+    adfCreateDir(vol, vol->rootBlock, "old");
+    adfUnMount(vol);
+    adfUnMountDev(flop);
+
+    image = (unsigned char*)malloc(FLOPSIZE);
+    f = fopen("newdev", "rb");
+    if (!image || !f || fread(image, 1, FLOPSIZE, f)!=FLOPSIZE)
+        return 1;
+    fclose(f);
+    flop = adfMountMemDev(image, FLOPSIZE, FALSE);
+    vol = flop ? adfMount(flop, 0, FALSE) : NULL;
+    if (!vol)
+        return 1;
+
+    freeBlocks = adfCountFreeBlocks(vol);
+    nbEnt = countEntries(vol);
+    fillBatch("f");
+    flop->size = 512*(vol->rootBlock+WRITABLE);
+    rc = adfCreateEntries(vol, vol->rootBlock, ent, NBENT)==RC_OK;
+    flop->size = FLOPSIZE;
+    rc |= adfCountFreeBlocks(vol)!=freeBlocks || countEntries(vol)!=nbEnt;
+    adfUnMount(vol);
+
+    /* on the image */
+    vol = adfMount(flop, 0, TRUE);
+    rc |= !vol || adfCountFreeBlocks(vol)!=freeBlocks || countEntries(vol)!=nbEnt;
+    if (vol)
+        adfUnMount(vol);
+    adfUnMountDev(flop);
+
+    printf("%-10s : failed batch, %s\n", title, rc ? "error" : "nothing created");
+
+    return rc;
+}
+
+
+/*
+ * corruptName
+ *
+ * a directory whose name length on disk is too large, in the hash chain
+ * of a new entry : it can't match, and must not overflow the name check
+ */
+int corruptName(int volType, char *title)
+{
+    struct Device *flop;
+    struct Volume *vol;
+    struct List *list;
+    struct NewEntry one;
+    unsigned char blk[512];
+    unsigned long sum;
+    SECTNUM nSect;
+    int i, rc;
+
+    flop = adfCreateDumpDevice("newdev", 80, 2, 11);
+    if (!flop)
+        return 1;
+    adfCreateFlop(flop, "name", volType);
+    vol = adfMount(flop, 0, FALSE);
+    if (!vol) {
+        adfUnMountDev(flop);
+        return 1;
+    }
+    adfCreateDir(vol, vol->rootBlock, "old");
+    list = adfGetDirEnt(vol, vol->rootBlock);
+    nSect = ((struct Entry*)list->content)->sector;
+    adfFreeDirList(list);
+
+    adfReadBlock(vol, nSect, blk);
+    blk[0x1b0] = 100;
+    memset(blk+20, 0, 4);
+    sum = 0;
+    for(i=0; i<512; i+=4)
+        sum += ((unsigned long)blk[i]<<24) | ((unsigned long)blk[i+1]<<16)
+            | ((unsigned long)blk[i+2]<<8) | blk[i+3];
+    sum = -sum;
+    blk[20] = (unsigned char)(sum>>24); blk[21] = (unsigned char)(sum>>16);
+    blk[22] = (unsigned char)(sum>>8); blk[23] = (unsigned char)sum;
+    adfWriteBlock(vol, nSect, blk);
+
+    memset(&one, 0, sizeof(struct NewEntry));
+    one.name = "OLD";
+    one.type = ST_DIR;
+    rc = adfCreateEntries(vol, vol->rootBlock, &one, 1)!=RC_OK;
+    adfUnMount(vol);
+    adfUnMountDev(flop);
+
+    printf("%-10s : corrupt name length, %s\n", title, rc ? "error" : "skipped");
+
+    return rc;
+}
+
+
+/*
+ *
+ *
+ */
+int main(int argc, char *argv[])
+{
+    BOOL true = TRUE;
+    int i, rc;
+
+    adfEnvInitDefault();
+
+    for(i=0; i<NBENT; i++) {
+        content[i] = (unsigned char*)malloc(BIGSIZE+NBENT);
+        if (!content[i]) exit(1);
+    }
+
+    rc = 0;
+    rc |= run(FSMASK_FFS, "FFS");
+    rc |= run(0, "OFS");
+    rc |= failBatch(FSMASK_FFS, "FFS");
+    rc |= corruptName(FSMASK_FFS, "FFS");
+    adfChgEnvProp(PR_USEDIRC, &true);
+    rc |= run(FSMASK_FFS|FSMASK_DIRCACHE, "DIRCACHE");
+    rc |= failBatch(FSMASK_FFS|FSMASK_DIRCACHE, "DIRCACHE");
+
+    for(i=0; i<NBENT; i++)
+        free(content[i]);
+    adfEnvCleanUp();
+
+    return rc;
+}
@@ -0,0 +1,279 @@
+/*
+ *  defrag.c
+ *
+ *  adfDefragVolume and adfDefragCopy : a fragmented floppy made contiguous in place,
+ *  and copied to a new image, still read by the usual functions. a file pointing
+ *  out of the volume stops the defragmentation
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include"adflib.h"
+
+
+#define NBFILE      30
+#define NBBIG       3
+#define BIGSIZE     60000
+
+
+char names[NBFILE+NBBIG][32];
+unsigned long sizes[NBFILE+NBBIG];
+BOOL removed[NBFILE+NBBIG];
+unsigned char *buf;
+
+
+/*
+ * fileByte
+ *
+ */
+unsigned char fileByte(int i, unsigned long pos)
+{
+    return (unsigned char)(i*11+pos+pos/491);
+}
+
+
+/*
+ * writeFile
+ *
+ * the even files in the root directory, the odd ones in 'Sub'
+ */
+int writeFile(struct Volume *vol, SECTNUM sub, int i)
+{
+    struct File *fic;
+    unsigned long j;
+
+    vol->curDirPtr = i%2==0 ? vol->rootBlock : sub;
+    fic = adfOpenFile(vol, names[i], "w");
+    if (!fic)
+        return 1;
+    for(j=0; j<sizes[i]; j++)
+        buf[j] = fileByte(i, j);
+    adfWriteFile(fic, sizes[i], buf);
+    adfCloseFile(fic);
+    adfToRootDir(vol);
+
+    return 0;
+}
+
+
+/*
+ * checkFiles
+ *
+ * returns the number of wrong files
+ */
+int checkFiles(struct Volume *vol)
+{
+    struct File *fic;
+    SECTNUM sub;
+    unsigned long j;
+    long n;
+    int i, bad;
+
+    bad = 0;
+    adfToRootDir(vol);
+    if (adfChangeDir(vol, "Sub")!=RC_OK)
+        return NBFILE+NBBIG;
+    sub = vol->curDirPtr;
+    for(i=0; i<NBFILE+NBBIG; i++) {
+        if (removed[i])
+            continue;
+        vol->curDirPtr = i%2==0 ? vol->rootBlock : sub;
+        fic = adfOpenFile(vol, names[i], "r");
+        if (!fic) {
+            bad++;
+            continue;
+        }
+        n = adfReadFile(fic, BIGSIZE+1, buf);
+        if (n!=(long)sizes[i])
+            bad++;
+        else
+            for(j=0; j<sizes[i]; j++)
+                if (buf[j]!=fileByte(i, j)) {
+                    bad++;
+                    break;
+                }
+        adfCloseFile(fic);
+    }
+    adfToRootDir(vol);
+
+    return bad;
+}
+
+
+/*
+ * corruptFile
+ *
+ * the first data block of the file 'name' of the root directory, in the dump, is
+ * out of the volume
+ */
+void corruptFile(struct Volume *vol, char *name)
+{
+    struct List *list, *cell;
+    struct Entry *e;
+    unsigned char sect[512];
+    unsigned long sum, l;
+    SECTNUM nSect;
+    int i;
+    FILE *f;
+
+    nSect = -1;
+    list = adfGetDirEnt(vol, vol->rootBlock);
+    for(cell=list; cell; cell=cell->next) {
+        e = (struct Entry*)cell->content;
+        if (strcmp(e->name, name)==0)
+            nSect = e->sector;
+    }
+    adfFreeDirList(list);
+    f = fopen("newdev", "r+b");
+    if (nSect==-1 || !f)
+        return;
+    fseek(f, 512L*nSect, SEEK_SET);
+    fread(sect, 1, 512, f);
+    /* dataBlocks[MAX_DATABLK-1] */
+    sect[308] = 0; sect[309] = 0; sect[310] = 0x13; sect[311] = 0x88;
+    memset(sect+20, 0, 4);
+    sum = 0;
+    for(i=0; i<512; i+=4) {
+        l = ((unsigned long)sect[i]<<24) | ((unsigned long)sect[i+1]<<16)
+            | ((unsigned long)sect[i+2]<<8) | sect[i+3];
+        sum += l;
+    }
+    sum = -sum;
+    sect[20] = (unsigned char)(sum>>24); sect[21] = (unsigned char)(sum>>16);
+    sect[22] = (unsigned char)(sum>>8); sect[23] = (unsigned char)sum;
+    fseek(f, 512L*nSect, SEEK_SET);
+    fwrite(sect, 1, 512, f);
+    fclose(f);
+}
+
+
+/*
+ * run
+ *
+ */
+int run(int volType, char *title)
+{
+    struct Device *flop;
+    struct Volume *vol;
+    SECTNUM sub;
+    long freeBlocks, moved, moved2;
+    int i, nbRemoved, bad, rc;
+
+    flop = adfCreateDumpDevice("newdev", 80, 2, 11);
+    if (!flop) {
+        fprintf(stderr, "can't mount device\n");
+        return 1;
+    }
+    adfCreateFlop(flop, "fragmented", volType);
+    vol = adfMount(flop, 0, FALSE);
+    if (!vol) {
+        adfUnMountDev(flop);
+        fprintf(stderr, "can't mount volume\n");
+        return 1;
+    }
+
+    rc = 0;
+    adfCreateDir(vol, vol->rootBlock, "Sub");
+    adfChangeDir(vol, "Sub");
+    sub = vol->curDirPtr;
+    adfToRootDir(vol);
+
+    /* small files, one in three removed, then large files in the holes */
+    for(i=0; i<NBFILE+NBBIG; i++) {
+        sprintf(names[i], "file%d", i);
+        sizes[i] = i<NBFILE ? (unsigned long)(i*1013%5000+1) : (unsigned long)(BIGSIZE-i);
+        removed[i] = FALSE;
+    }
+    for(i=0; i<NBFILE; i++)
+        rc |= writeFile(vol, sub, i);
+    nbRemoved = 0;
+    for(i=0; i<NBFILE; i+=3) {
+        rc |= adfRemoveEntry(vol, i%2==0 ? vol->rootBlock : sub, names[i])!=RC_OK;
+        removed[i] = TRUE;
+        nbRemoved++;
+    }
+    for(i=NBFILE; i<NBFILE+NBBIG; i++)
+        rc |= writeFile(vol, sub, i);
+    bad = checkFiles(vol);
+
+    /* the headers lost by adfRemoveEntry() are freed too */
+    freeBlocks = adfCountFreeBlocks(vol);
+    rc |= adfDefragVolume(vol, &moved)!=RC_OK;
+    rc |= moved==0;
+    bad += checkFiles(vol);
+    rc |= adfCountFreeBlocks(vol)!=freeBlocks+nbRemoved;
+    freeBlocks = adfCountFreeBlocks(vol);
+    /* nothing left to move */
+    rc |= adfDefragVolume(vol, &moved2)!=RC_OK;
+    rc |= moved2!=0;
+    adfUnMount(vol);
+    adfUnMountDev(flop);
+
+    /* on the disk */
+    flop = adfMountDev("newdev", FALSE);
+    vol = adfMount(flop, 0, FALSE);
+    bad += checkFiles(vol);
+    rc |= adfCountFreeBlocks(vol)!=freeBlocks;
+
+    /* the copy : the same files, the directory next to the root block */
+    rc |= adfDefragCopy(vol, "newdev2")!=RC_OK;
+    adfUnMount(vol);
+    adfUnMountDev(flop);
+
+    flop = adfMountDev("newdev2", TRUE);
+    vol = adfMount(flop, 0, TRUE);
+    bad += checkFiles(vol);
+    rc |= strcmp(vol->volName, "fragmented")!=0;
+    /* the dircache blocks are full */
+    rc |= adfCountFreeBlocks(vol)<freeBlocks;
+    adfChangeDir(vol, "Sub");
+    rc |= vol->curDirPtr>=vol->rootBlock || vol->curDirPtr<vol->rootBlock-2;
+    adfUnMount(vol);
+    adfUnMountDev(flop);
+
+    /* the bitmap isn't rebuilt from an invalid tree */
+    flop = adfMountDev("newdev", FALSE);
+    vol = adfMount(flop, 0, FALSE);
+    /* one data block : it isn't moved, only the bitmap sees it */
+    corruptFile(vol, names[10]);
+    adfUnMount(vol);
+    vol = adfMount(flop, 0, FALSE);
+    rc |= adfDefragVolume(vol, &moved2)==RC_OK;
+    adfUnMount(vol);
+    adfUnMountDev(flop);
+
+    printf("%-10s : %ld files moved, %ld free blocks, %d bad files\n", title, moved,
+        freeBlocks, bad);
+
+    return rc || bad!=0;
+}
+
+
+/*
+ *
+ *
+ */
+int main(int argc, char *argv[])
+{
+    BOOL true = TRUE;
+    int rc;
+
+    adfEnvInitDefault();
+
+    buf = (unsigned char*)malloc(BIGSIZE+1);
+    if (!buf) exit(1);
+
+    rc = 0;
+    rc |= run(FSMASK_FFS, "FFS");
+    rc |= run(0, "OFS");
+    adfChgEnvProp(PR_USEDIRC, &true);
+    rc |= run(FSMASK_FFS|FSMASK_DIRCACHE, "DIRCACHE");
+
+    free(buf);
+    adfEnvCleanUp();
+
+    return rc;
+}
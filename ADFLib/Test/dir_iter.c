@@ -0,0 +1,200 @@
+/*
+ *  dir_iter.c
+ *
+ *  compares adfReadDir() and adfWalkDir() with adfGetRDirEnt()
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include"adflib.h"
+
+#define NBDIRS  6
+#define NBFILES 50
+#define STOPAT  10
+
+
+struct Walk{
+    struct List *lists[8];      /* the expected list, per depth */
+    long n;
+    long limit;
+    BOOL ok;
+};
+
+
+/*
+ * sameEntry
+ *
+ */
+BOOL sameEntry(struct Entry *e1, struct Entry *e2)
+{
+    return strcmp(e1->name,e2->name)==0 && e1->sector==e2->sector
+        && e1->type==e2->type && e1->size==e2->size
+        && strcmp(e1->comment ? e1->comment : "", e2->comment ? e2->comment : "")==0;
+}
+
+
+/*
+ * walkFct
+ *
+ * the walk must follow the recursive list : depth first, in listing order
+ */
+BOOL walkFct(struct Entry *entry, int depth, void *data)
+{
+    struct Walk *w = (struct Walk*)data;
+    struct List *cell;
+
+    cell = w->lists[depth];
+    if (cell==NULL || !sameEntry(entry, (struct Entry*)cell->content)) {
+        w->ok = FALSE;
+        return FALSE;
+    }
+    w->lists[depth] = cell->next;
+    w->lists[depth+1] = cell->subdir;
+    w->n++;
+
+    return w->n!=w->limit;
+}
+
+
+/*
+ * fill
+ *
+ */
+void fill(struct Volume *vol)
+{
+    struct File *fic;
+    char name[MAXNAMELEN+1];
+    unsigned char buf[NBFILES];
+    int i, j;
+
+    memset(buf, 'x', NBFILES);
+    for(i=0; i<NBDIRS; i++) {
+        sprintf(name,"dir_%d",i);
+        adfCreateDir(vol, vol->curDirPtr, name);
+        adfChangeDir(vol, name);
+        for(j=0; j<NBFILES; j++) {
+            sprintf(name,"file_%d",j);
+            fic = adfOpenFile(vol, name, "w");
+            adfWriteFile(fic, j, buf);
+            adfCloseFile(fic);
+            if (j%5==0)
+                adfSetEntryComment(vol, vol->curDirPtr, name, "a comment");
+        }
+        adfParentDir(vol);
+    }
+}
+
+
+/*
+ * check
+ *
+ */
+int check(struct Volume *vol)
+{
+    struct List *list, *cell;
+    struct DirIter *it;
+    struct Entry *entry;
+    struct Walk w;
+    long n;
+    int rc;
+
+    rc = 0;
+
+    /* one level */
+    list = adfGetDirEnt(vol, vol->curDirPtr);
+    it = adfOpenDir(vol, vol->curDirPtr);
+    n = 0;
+    cell = list;
+    while((entry=adfReadDir(it))!=NULL) {
+        if (cell==NULL || !sameEntry(entry, (struct Entry*)cell->content))
+            break;
+        cell = cell->next;
+        n++;
+    }
+    printf("adfReadDir : %ld entries\n", n);
+    if (cell!=NULL || entry!=NULL || it->rc!=RC_OK || n!=NBDIRS)
+        rc = 1;
+    adfCloseDir(it);
+    adfFreeDirList(list);
+
+    /* whole tree, then stopped early */
+    list = adfGetRDirEnt(vol, vol->curDirPtr, TRUE);
+    memset(&w, 0, sizeof(struct Walk));
+    w.lists[0] = list;
+    w.limit = -1;
+    w.ok = TRUE;
+    if (adfWalkDir(vol, vol->curDirPtr, walkFct, &w)!=RC_OK || !w.ok)
+        rc = 1;
+    printf("adfWalkDir : %ld entries\n", w.n);
+    if (w.n!=NBDIRS*(NBFILES+1))
+        rc = 1;
+
+    memset(&w, 0, sizeof(struct Walk));
+    w.lists[0] = list;
+    w.limit = STOPAT;
+    w.ok = TRUE;
+    if (adfWalkDir(vol, vol->curDirPtr, walkFct, &w)!=RC_OK || !w.ok)
+        rc = 1;
+    printf("adfWalkDir stopped : %ld entries\n", w.n);
+    if (w.n!=STOPAT)
+        rc = 1;
+    adfFreeDirList(list);
+
+    return rc;
+}
+
+
+/*
+ *
+ *
+ */
+int main(int argc, char *argv[])
+{
+    struct Device *hd;
+    struct Volume *vol;
+    struct DirIter *it;
+    int i, rc;
+    BOOL useDirc;
+    int types[2] = { FSMASK_FFS, FSMASK_FFS|FSMASK_DIRCACHE };
+
+    adfEnvInitDefault();
+
+    rc = 0;
+    for(i=0; i<2; i++) {
+        hd = adfCreateDumpDevice("newdev", 80, 2, 22);
+        if (!hd) {
+            fprintf(stderr, "can't mount device\n");
+            adfEnvCleanUp(); exit(1);
+        }
+        adfCreateFlop( hd, "iter", types[i] );
+        vol = adfMount(hd, 0, FALSE);
+
+        useDirc = (i==1);
+        adfChgEnvProp(PR_USEDIRC,&useDirc);
+        fill(vol);
+
+        printf("%s\n", useDirc ? "dircache" : "hashtable");
+        if (check(vol))
+            rc = 1;
+
+        adfUnMount(vol);
+
+        /* the iterator reads the dircache blocks it needs, no model */
+        if (useDirc) {
+            vol = adfMount(hd, 0, FALSE);
+            it = adfOpenDir(vol, vol->curDirPtr);
+            if (adfReadDir(it)==NULL || vol->nbDirCache!=0)
+                rc = 1;
+            adfCloseDir(it);
+            adfUnMount(vol);
+        }
+        adfUnMountDev(hd);
+    }
+
+    adfEnvCleanUp();
+
+    return rc;
+}
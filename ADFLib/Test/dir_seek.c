@@ -0,0 +1,194 @@
+/*
+ *  dir_seek.c
+ *
+ *  recursive listing in hash table order and in sector order :
+ *  same tree, number of seeks and time
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include"adflib.h"
+
+#define NBDIRS  16
+#define NBFILES 100
+#define NBLOOPS 20
+
+
+long nbSeeks, distance;
+SECTNUM lastSect;
+
+
+/*
+ * countSeeks
+ *
+ * a seek is any access which is not the block following the previous one
+ */
+void countSeeks(SECTNUM physical, SECTNUM logical, BOOL write)
+{
+    if (physical!=lastSect+1) {
+        nbSeeks++;
+        distance += physical>lastSect ? physical-lastSect : lastSect-physical;
+    }
+    lastSect = physical;
+}
+
+
+/*
+ * compare
+ *
+ * returns the number of entries, -1 if the two trees differ
+ */
+long compare(struct List *l1, struct List *l2)
+{
+    struct Entry *e1, *e2;
+    long n, nSub;
+
+    n = 0;
+    while(l1 && l2) {
+        e1 = (struct Entry*)l1->content;
+        e2 = (struct Entry*)l2->content;
+        if (strcmp(e1->name,e2->name)!=0 || e1->sector!=e2->sector
+            || e1->type!=e2->type || e1->size!=e2->size)
+            return -1;
+        nSub = compare(l1->subdir, l2->subdir);
+        if (nSub<0)
+            return -1;
+        n += 1+nSub;
+        l1 = l1->next;
+        l2 = l2->next;
+    }
+    if (l1 || l2)
+        return -1;
+
+    return n;
+}
+
+
+/*
+ * fill
+ *
+ * the files are created in turn in each directory : their blocks are mixed
+ */
+void fill(struct Volume *vol)
+{
+    struct File *fic;
+    char name[MAXNAMELEN+1];
+    unsigned char buf[1024];
+    SECTNUM dirs[NBDIRS];
+    int i, j;
+
+    memset(buf, 'x', 1024);
+    for(i=0; i<NBDIRS; i++) {
+        sprintf(name,"dir_%d",i);
+        adfCreateDir(vol, vol->rootBlock, name);
+        adfChangeDir(vol, name);
+        dirs[i] = vol->curDirPtr;
+        adfToRootDir(vol);
+    }
+    for(j=0; j<NBFILES; j++)
+        for(i=0; i<NBDIRS; i++) {
+            vol->curDirPtr = dirs[i];
+            sprintf(name,"file_%d",j);
+            fic = adfOpenFile(vol, name, "w");
+            adfWriteFile(fic, 1024, buf);
+            adfCloseFile(fic);
+        }
+    adfToRootDir(vol);
+}
+
+
+/*
+ * list
+ *
+ */
+struct List* list(struct Volume *vol, BOOL seekOrder, double *t)
+{
+    struct List *tree;
+    clock_t start;
+    BOOL true = TRUE, false = FALSE;
+    int i;
+
+    adfChgEnvProp(PR_SEEKORDER, &seekOrder);
+
+    start = clock();
+    for(i=0; i<NBLOOPS; i++)
+        adfFreeDirList(adfGetRDirEnt(vol, vol->rootBlock, TRUE));
+    *t = (double)(clock()-start)/CLOCKS_PER_SEC/NBLOOPS;
+
+    nbSeeks = distance = 0;
+    lastSect = -2;
+    adfChgEnvProp(PR_USE_RWACCESS, &true);
+    tree = adfGetRDirEnt(vol, vol->rootBlock, TRUE);
+    adfChgEnvProp(PR_USE_RWACCESS, &false);
+
+    return tree;
+}
+
+
+/*
+ *
+ *
+ */
+int main(int argc, char *argv[])
+{
+    struct Device *hd;
+    struct Volume *vol;
+    struct List *l1, *l2;
+    struct DirTree *tree;
+    long n, seeks1, dist1;
+    double t1, t2;
+    BOOL seekOrder;
+    int rc;
+
+    adfEnvInitDefault();
+
+    hd = adfCreateDumpDevice("newdev", 512, 2, 32);
+    if (!hd) {
+        fprintf(stderr, "can't mount device\n");
+        adfEnvCleanUp(); exit(1);
+    }
+    adfCreateHdFile( hd, "seek", FSMASK_FFS );
+    vol = adfMount(hd, 0, FALSE);
+    if (!vol) {
+        adfUnMountDev(hd);
+        fprintf(stderr, "can't mount volume\n");
+        adfEnvCleanUp(); exit(1);
+    }
+    fill(vol);
+
+    adfChgEnvProp(PR_RWACCESS, countSeeks);
+
+    l1 = list(vol, FALSE, &t1);
+    seeks1 = nbSeeks; dist1 = distance;
+    printf("hash table order : %ld seeks, distance %ld, %.6f s\n", seeks1, dist1, t1);
+
+    l2 = list(vol, TRUE, &t2);
+    printf("sector order     : %ld seeks, distance %ld, %.6f s\n", nbSeeks, distance, t2);
+
+    n = compare(l1, l2);
+    printf("%ld entries\n", n);
+    rc = n!=NBDIRS*(NBFILES+1) || nbSeeks>=seeks1;
+    adfFreeDirList(l1);
+    adfFreeDirList(l2);
+
+    /* the arena listing uses the same traversal */
+    seekOrder = TRUE;
+    adfChgEnvProp(PR_SEEKORDER, &seekOrder);
+    l1 = adfGetRDirEnt(vol, vol->rootBlock, TRUE);
+    tree = adfGetDirTree(vol, vol->rootBlock, TRUE);
+    if (!tree || compare(l1, tree->list)!=n)
+        rc = 1;
+    adfFreeDirList(l1);
+    adfFreeDirTree(tree);
+
+    adfUnMount(vol);
+    adfUnMountDev(hd);
+
+    adfEnvCleanUp();
+
+    return rc;
+}
@@ -0,0 +1,128 @@
+/*
+ *  dir_tree.c
+ *
+ *  compares adfGetDirTree() with adfGetRDirEnt()
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include"adflib.h"
+
+#define NBDIRS  8
+#define NBFILES 40
+
+
+/*
+ * compare
+ *
+ * returns the number of entries, -1 if the two trees differ
+ */
+long compare(struct List *l1, struct List *l2)
+{
+    struct Entry *e1, *e2;
+    long n, nSub;
+
+    n = 0;
+    while(l1 && l2) {
+        e1 = (struct Entry*)l1->content;
+        e2 = (struct Entry*)l2->content;
+        if (strcmp(e1->name,e2->name)!=0 || e1->sector!=e2->sector
+            || e1->type!=e2->type || e1->size!=e2->size
+            || strcmp(e1->comment,e2->comment)!=0)
+            return -1;
+        nSub = compare(l1->subdir, l2->subdir);
+        if (nSub<0)
+            return -1;
+        n += 1+nSub;
+        l1 = l1->next;
+        l2 = l2->next;
+    }
+    if (l1 || l2)
+        return -1;
+
+    return n;
+}
+
+
+/*
+ * fill
+ *
+ */
+void fill(struct Volume *vol)
+{
+    struct File *fic;
+    char name[MAXNAMELEN+1];
+    unsigned char buf[NBFILES];
+    int i, j;
+
+    memset(buf, 'x', NBFILES);
+
+    for(i=0; i<NBDIRS; i++) {
+        sprintf(name,"dir_%d",i);
+        adfCreateDir(vol, vol->curDirPtr, name);
+        adfChangeDir(vol, name);
+        for(j=0; j<NBFILES; j++) {
+            /* the same names in every directory */
+            sprintf(name,"file_%d",j);
+            fic = adfOpenFile(vol, name, "w");
+            adfWriteFile(fic, j, buf);
+            adfCloseFile(fic);
+            if (j%4==0)
+                adfSetEntryComment(vol, vol->curDirPtr, name, "same comment");
+        }
+        adfParentDir(vol);
+    }
+}
+
+
+/*
+ *
+ *
+ */
+int main(int argc, char *argv[])
+{
+    struct Device *hd;
+    struct Volume *vol;
+    struct List *list;
+    struct DirTree *tree;
+    long n;
+    int i, rc;
+    BOOL useDirc;
+    int types[2] = { FSMASK_FFS, FSMASK_FFS|FSMASK_DIRCACHE };
+
+    adfEnvInitDefault();
+
+    rc = 0;
+    for(i=0; i<2; i++) {
+        hd = adfCreateDumpDevice("newdev", 80, 2, 22);
+        if (!hd) {
+            fprintf(stderr, "can't mount device\n");
+            adfEnvCleanUp(); exit(1);
+        }
+        adfCreateFlop( hd, "tree", types[i] );
+        vol = adfMount(hd, 0, FALSE);
+
+        useDirc = (i==1);
+        adfChgEnvProp(PR_USEDIRC,&useDirc);
+        fill(vol);
+
+        list = adfGetRDirEnt(vol, vol->curDirPtr, TRUE);
+        tree = adfGetDirTree(vol, vol->curDirPtr, TRUE);
+        n = tree ? compare(list, tree->list) : -1;
+        printf("%s : %ld entries\n", useDirc ? "dircache" : "hashtable", n);
+        if (n!=NBDIRS*(NBFILES+1))
+            rc = 1;
+        adfFreeDirList(list);
+        adfFreeDirTree(tree);
+
+        adfUnMount(vol);
+        adfUnMountDev(hd);
+    }
+
+    adfEnvCleanUp();
+
+    return rc;
+}
@@ -0,0 +1,154 @@
+/*
+ *  dircache.c
+ *
+ *  many creations, deletions and updates in one DIRCACHE directory
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include"adflib.h"
+
+#define NBFILES 1000
+#define NBDIRS  200
+
+
+/*
+ * count
+ *
+ * counts the entries, and the entries with a comment, with or without the dircache
+ */
+int count(struct Volume *vol, BOOL useDirc, int *nbComm)
+{
+    struct List *list, *cell;
+    int n;
+
+    adfChgEnvProp(PR_USEDIRC,&useDirc);
+    n = *nbComm = 0;
+    cell = list = adfGetDirEnt(vol, vol->curDirPtr);
+    while(cell) {
+        n++;
+        if (((struct Entry*)cell->content)->comment[0]!='\0')
+            (*nbComm)++;
+        cell = cell->next;
+    }
+    adfFreeDirList(list);
+
+    return n;
+}
+
+
+/*
+ * countTree
+ *
+ * counts the entries of a recursive listing
+ */
+int countTree(struct List *list)
+{
+    int n;
+
+    n = 0;
+    for(; list; list=list->next) {
+        n++;
+        if (list->subdir)
+            n += countTree(list->subdir);
+    }
+
+    return n;
+}
+
+
+/*
+ *
+ *
+ */
+int main(int argc, char *argv[])
+{
+    struct Device *hd;
+    struct Volume *vol;
+    struct File *fic;
+    struct List *list;
+    char name[MAXNAMELEN+1], newName[MAXNAMELEN+1];
+    int i, n1, n2, c1, c2, rc;
+    BOOL true = TRUE;
+
+    adfEnvInitDefault();
+
+    adfChgEnvProp(PR_USEDIRC,&true);
+
+    hd = adfCreateDumpDevice("newdev", 80, 2, 22);
+    if (!hd) {
+        fprintf(stderr, "can't mount device\n");
+        adfEnvCleanUp(); exit(1);
+    }
+    adfCreateFlop( hd, "dircache", FSMASK_FFS|FSMASK_DIRCACHE );
+    vol = adfMount(hd, 0, FALSE);
+    if (!vol) {
+        adfUnMountDev(hd);
+        fprintf(stderr, "can't mount volume\n");
+        adfEnvCleanUp(); exit(1);
+    }
+
+    for(i=0; i<NBFILES; i++) {
+        sprintf(name,"file_with_a_long_name_%04d",i);
+        fic = adfOpenFile(vol, name, "w");
+        adfWriteFile(fic, 4, (unsigned char*)"data");
+        adfCloseFile(fic);
+    }
+    /* removed, then longer records, then shorter records */
+    for(i=0; i<NBFILES; i+=3) {
+        sprintf(name,"file_with_a_long_name_%04d",i);
+        adfRemoveEntry(vol, vol->curDirPtr, name);
+    }
+    for(i=1; i<NBFILES; i+=3) {
+        sprintf(name,"file_with_a_long_name_%04d",i);
+        adfSetEntryComment(vol, vol->curDirPtr, name, "a comment long enough to move the record");
+    }
+    for(i=2; i<NBFILES; i+=3) {
+        sprintf(name,"file_with_a_long_name_%04d",i);
+        sprintf(newName,"f%d",i);
+        adfRenameEntry(vol, vol->curDirPtr, name, vol->curDirPtr, newName);
+    }
+
+    n1 = count(vol, TRUE, &c1);
+    n2 = count(vol, FALSE, &c2);
+    printf("mounted : dircache %d/%d, hashtable %d/%d\n",n1,c1,n2,c2);
+    rc = (n1!=n2 || c1!=c2);
+
+    /* the dircache blocks are written by adfUnMount() */
+    adfUnMount(vol);
+    vol = adfMount(hd, 0, FALSE);
+
+    n1 = count(vol, TRUE, &c1);
+    n2 = count(vol, FALSE, &c2);
+    printf("remounted : dircache %d/%d, hashtable %d/%d\n",n1,c1,n2,c2);
+    rc = rc || (n1!=n2 || c1!=c2);
+
+    /* many directories : a recursive listing keeps no model once finished */
+    for(i=0; i<NBDIRS; i++) {
+        sprintf(name,"dir%03d",i);
+        adfCreateDir(vol, vol->curDirPtr, name);
+        adfChangeDir(vol, name);
+        sprintf(name,"file%03d",i);
+        fic = adfOpenFile(vol, name, "w");
+        adfCloseFile(fic);
+        adfParentDir(vol);
+    }
+    adfUnMount(vol);
+    vol = adfMount(hd, 0, FALSE);
+    adfChgEnvProp(PR_USEDIRC,&true);
+    list = adfGetRDirEnt(vol, vol->curDirPtr, TRUE);
+    n1 = countTree(list);
+    printf("recursive : %d entries, %ld dircaches kept\n", n1, vol->nbDirCache);
+    rc = rc || n1!=n2+2*NBDIRS || vol->nbDirCache!=0;
+    adfFreeDirList(list);
+
+    adfUnMount(vol);
+    adfUnMountDev(hd);
+
+    adfEnvCleanUp();
+
+    return rc;
+}
@@ -0,0 +1,118 @@
+/*
+ *  dms_deep.c
+ *
+ *  xdms : the DEEP decruncher on random bit streams, with more zeros or
+ *  more ones, so the adaptive tree goes through every shape and is
+ *  rebuilt. The state is kept from one stream to the next, reset from
+ *  time to time like in an archive. The output must be the one of the
+ *  xDMS 1.3 decruncher of dms_ref.c
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../../xdms/cdata.h"
+#include "../../xdms/u_init.h"
+#include "../../xdms/u_deep.h"
+#include "dms_ref.h"
+
+
+#define NBSTREAM    400
+#define RESETEVERY  50
+#define TRACKLEN    11264
+#define INLEN       65536L      /* more than the longest codes can read */
+#define OUTMAX      (TRACKLEN+300)
+
+
+UCHAR in[INLEN];
+UCHAR out[OUTMAX], refOut[OUTMAX];
+unsigned long seed = 1;
+
+
+/*
+ * rnd
+ *
+ */
+unsigned long rnd(void)
+{
+    seed = seed*1103515245L+12345;
+    return (seed>>8) & 0xffffff;
+}
+
+
+/*
+ * fillStream
+ *
+ * each bit is 1 with a probability of p/256
+ */
+void fillStream(unsigned p)
+{
+    long k;
+    int b;
+    unsigned v;
+
+    for(k=0; k<INLEN; k++) {
+        v = 0;
+        for(b=0; b<8; b++)
+            v = (v<<1) | ((rnd()&255)<p);
+        in[k] = (UCHAR)v;
+    }
+}
+
+
+/*
+ *
+ *
+ */
+int main(int argc, char *argv[])
+{
+    clock_t t0, tLib, tRef;
+    long total;
+    int i, rc;
+    USHORT len, r1, r2;
+
+    text = (UCHAR*)calloc(32000,1);
+    if (!text) {
+        fprintf(stderr,"malloc error\n");
+        exit(1);
+    }
+
+    rc = 0;
+    total = 0;
+    tLib = tRef = 0;
+    for(i=0; i<NBSTREAM; i++) {
+        if (i%RESETEVERY==0) {
+            Init_Decrunchers();
+            ref_Init_Decrunchers();
+        }
+        fillStream(1+(i*37)%255);
+        len = (USHORT)(TRACKLEN-(i%7)*1000);
+        memset(out, 0, OUTMAX);
+        memset(refOut, 0, OUTMAX);
+
+        t0 = clock();
+        r1 = Unpack_DEEP(in, out, len);
+        tLib += clock()-t0;
+        t0 = clock();
+        r2 = ref_Unpack_DEEP(in, refOut, len);
+        tRef += clock()-t0;
+
+        if (r1!=r2 || memcmp(out, refOut, len)!=0) {
+            printf("stream %d : different\n", i);
+            rc = 1;
+        }
+        total += len;
+    }
+    printf("%d streams compared\n", NBSTREAM);
+    if (tLib>0 && tRef>0)
+        printf("deep : %.1f MB/s, xDMS 1.3 : %.1f MB/s\n",
+            (double)total/((double)tLib/CLOCKS_PER_SEC)/1e6,
+            (double)total/((double)tRef/CLOCKS_PER_SEC)/1e6);
+
+    free(text);
+
+    return rc;
+}
@@ -0,0 +1,296 @@
+/*
+ *  dms_heavy.c
+ *
+ *  xdms : the HEAVY1 and HEAVY2 decrunchers, byte for byte the same as
+ *  the xDMS 1.3 ones of dms_ref.c, on synthetic tracks with codes
+ *  longer than the 12 bits table and tables kept from one track to the
+ *  next. Then the speed of both
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../../xdms/cdata.h"
+#include "../../xdms/u_init.h"
+#include "../../xdms/u_heavy.h"
+#include "../../xdms/getbits.h"
+#include "dms_ref.h"
+
+
+#define NBTRACK     200
+#define TRACKLEN    11264
+#define PACKMAX     30000
+#define OUTMAX      (TRACKLEN+300)  /* the last match may go past the track */
+#define NBLOOP      20
+
+#define NC          510
+
+
+struct Track {
+    UCHAR pk[PACKMAX+BITBUF_PAD];
+    UCHAR flags;
+};
+
+struct Track trk[NBTRACK];
+UCHAR out[OUTMAX], refOut[OUTMAX];
+unsigned long seed = 1;
+
+UCHAR *wbuf;
+long wpos;
+int wbits;
+unsigned wacc;
+
+
+/*
+ * rnd
+ *
+ */
+unsigned long rnd(void)
+{
+    seed = seed*1103515245L+12345;
+    return (seed>>8) & 0xffffff;
+}
+
+
+/*
+ * putBits
+ *
+ * msb first, like the DMS bit reader
+ */
+void putBits(unsigned long v, int n)
+{
+    while(n--) {
+        wacc = (wacc<<1) | ((v>>n)&1);
+        if (++wbits==8) {
+            if (wpos<PACKMAX)
+                wbuf[wpos++] = (UCHAR)wacc;
+            wbits = 0; wacc = 0;
+        }
+    }
+}
+
+
+/*
+ * codeLengths
+ *
+ * huffman code lengths of freq, at most maxl bits : the frequencies
+ * are flattened until the tree is short enough
+ */
+void codeLengths(int n, unsigned long *freq0, UCHAR *len, int maxl)
+{
+    unsigned long f[2*NC], freq[NC];
+    int par[2*NC];
+    int i, k, nn, a, b, d, maxd;
+
+    for(i=0; i<n; i++)
+        freq[i] = freq0[i];
+    for(;;) {
+        for(i=0; i<n; i++) {
+            f[i] = freq[i];
+            par[i] = -1;
+        }
+        nn = n;
+        for(;;) {
+            a = b = -1;
+            for(i=0; i<nn; i++)
+                if (f[i]!=0 && par[i]==-1) {
+                    if (a==-1 || f[i]<f[a]) { b = a; a = i; }
+                    else if (b==-1 || f[i]<f[b]) b = i;
+                }
+            if (b==-1)
+                break;
+            f[nn] = f[a]+f[b];
+            par[nn] = -1;
+            par[a] = par[b] = nn;
+            nn++;
+        }
+        maxd = 0;
+        for(i=0; i<n; i++) {
+            d = 0;
+            if (freq[i]!=0)
+                for(k=i; par[k]!=-1; k=par[k])
+                    d++;
+            len[i] = (UCHAR)d;
+            if (d>maxd) maxd = d;
+        }
+        if (maxd<=maxl)
+            return;
+        for(i=0; i<n; i++)
+            if (freq[i]!=0) freq[i] = freq[i]/2+1;
+    }
+}
+
+
+/*
+ * canonCodes
+ *
+ * the codes make_table() expects : given in symbol order, per length
+ */
+void canonCodes(int n, UCHAR *len, unsigned long *code)
+{
+    UQUAD next[23];
+    int i, l;
+
+    memset(next, 0, sizeof(next));
+    for(i=0; i<n; i++)
+        if (len[i]!=0) next[len[i]+1] += (UQUAD)1<<(32-len[i]);
+    for(l=2; l<23; l++)
+        next[l] += next[l-1];
+    for(i=0; i<n; i++)
+        if (len[i]!=0) {
+            code[i] = (unsigned long)(next[len[i]]>>(32-len[i]));
+            next[len[i]] += (UQUAD)1<<(32-len[i]);
+        }
+}
+
+
+/*
+ * pick
+ *
+ */
+int pick(int n, unsigned long *freq, UCHAR *len, unsigned long total)
+{
+    unsigned long r;
+    int i;
+
+    do {
+        r = ((rnd()<<8) ^ rnd()) % total;
+        for(i=0; i<n-1 && r>=freq[i]; i++)
+            r -= freq[i];
+    }while(len[i]==0);
+
+    return i;
+}
+
+
+/*
+ * genTrack
+ *
+ * a track of random symbols, with new tables or with the ones of the
+ * previous track
+ */
+void genTrack(struct Track *t, int heavy2, int maxl, int newTables)
+{
+    static unsigned long cf[NC], pf[16], cc[NC], pc[16];
+    static UCHAR cl[NC], pl[16];
+    unsigned long ctot, ptot;
+    int i, c, j, np, n;
+
+    np = heavy2 ? 15 : 14;
+    wbuf = t->pk; wpos = 0; wbits = 0; wacc = 0;
+    memset(t->pk, 0, sizeof(t->pk));
+
+    if (newTables) {
+        /* a few frequent symbols, a lot of rare ones */
+        for(i=0; i<NC; i++) {
+            cf[i] = (rnd()%4==0) ? 0 : 1+rnd()%(i<256 ? 4000 : 20);
+            if (rnd()%3==0) cf[i] = 1+rnd()%3;
+        }
+        cf[rnd()%256] += 60000;
+        cf[256+rnd()%20] += 500;
+        for(i=0; i<np; i++)
+            pf[i] = 1+rnd()%(1000>>(i/2));
+        if (rnd()%2) pf[np-1] = 0;
+        codeLengths(NC, cf, cl, maxl);
+        codeLengths(np, pf, pl, 15);
+        canonCodes(NC, cl, cc);
+        canonCodes(np, pl, pc);
+
+        putBits(NC,9);
+        for(i=0; i<NC; i++) putBits(cl[i],5);
+        putBits(np,5);
+        for(i=0; i<np; i++) putBits(pl[i],4);
+        t->flags = 2;
+    }
+    else
+        t->flags = 0;
+    if (heavy2)
+        t->flags |= 8;
+
+    ctot = ptot = 0;
+    for(i=0; i<NC; i++) if (cl[i]) ctot += cf[i];
+    for(i=0; i<np; i++) if (pl[i]) ptot += pf[i];
+
+    n = 0;
+    while(n<TRACKLEN) {
+        c = pick(NC, cf, cl, ctot);
+        putBits(cc[c], cl[c]);
+        if (c<256)
+            n++;
+        else {
+            n += c-253;
+            j = pick(np, pf, pl, ptot);
+            putBits(pc[j], pl[j]);
+            if (j>1 && j!=np-1)
+                putBits(rnd(), j-1);
+        }
+    }
+    putBits(0, 7);
+}
+
+
+/*
+ *
+ *
+ */
+int main(int argc, char *argv[])
+{
+    clock_t t0;
+    double tLib, tRef;
+    int i, l, r1, r2, rc;
+
+    text = (UCHAR*)calloc(32000,1);
+    if (!text) {
+        fprintf(stderr,"malloc error\n");
+        exit(1);
+    }
+
+    /* heavy1 and heavy2 by pairs, the second track of a pair keeps the
+     * tables one time out of two ; one pair out of five has the longest codes */
+    for(i=0; i<NBTRACK; i++)
+        genTrack(&trk[i], (i/2)%2, (i/2)%5==4 ? 20 : 16, i%2==0 || i%4==1);
+
+    rc = 0;
+    Init_Decrunchers();
+    ref_Init_Decrunchers();
+    for(i=0; i<NBTRACK; i++) {
+        memset(out, 0, OUTMAX);
+        memset(refOut, 0, OUTMAX);
+        r1 = Unpack_HEAVY(trk[i].pk, out, trk[i].flags, TRACKLEN);
+        r2 = ref_Unpack_HEAVY(trk[i].pk, refOut, trk[i].flags, TRACKLEN);
+        if (r1!=r2 || memcmp(out, refOut, TRACKLEN)!=0) {
+            printf("track %d : different\n", i);
+            rc = 1;
+        }
+    }
+    printf("%d tracks compared\n", NBTRACK);
+
+    /* speed */
+    t0 = clock();
+    for(l=0; l<NBLOOP; l++) {
+        Init_Decrunchers();
+        for(i=0; i<NBTRACK; i++)
+            Unpack_HEAVY(trk[i].pk, out, trk[i].flags, TRACKLEN);
+    }
+    tLib = (double)(clock()-t0)/CLOCKS_PER_SEC;
+
+    t0 = clock();
+    for(l=0; l<NBLOOP; l++) {
+        ref_Init_Decrunchers();
+        for(i=0; i<NBTRACK; i++)
+            ref_Unpack_HEAVY(trk[i].pk, refOut, trk[i].flags, TRACKLEN);
+    }
+    tRef = (double)(clock()-t0)/CLOCKS_PER_SEC;
+
+    if (tLib>0 && tRef>0)
+        printf("heavy : %.1f MB/s, xDMS 1.3 : %.1f MB/s\n",
+            (double)NBLOOP*NBTRACK*TRACKLEN/tLib/1e6,
+            (double)NBLOOP*NBTRACK*TRACKLEN/tRef/1e6);
+
+    free(text);
+
+    return rc;
+}
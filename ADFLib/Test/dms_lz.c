@@ -0,0 +1,260 @@
+/*
+ *  dms_lz.c
+ *
+ *  xdms : a synthetic floppy packed in QUICK, MEDIUM, HEAVY1 and HEAVY2,
+ *  then the tracks of each archive decrunched by xdms and by the xDMS 1.3
+ *  decrunchers of dms_ref.c : the same output, and the speed of both for
+ *  each mode
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../../xdms/cdata.h"
+#include "../../xdms/Pfile.h"
+#include "../../xdms/Wfile.h"
+#include "../../xdms/u_init.h"
+#include "../../xdms/u_quick.h"
+#include "../../xdms/u_medium.h"
+#include "../../xdms/u_heavy.h"
+#include "../../xdms/getbits.h"
+#include "dms_ref.h"
+
+
+#define NBTRACK     80
+#define TRACKLEN    11264
+#define IMGSIZE     ((long)NBTRACK*TRACKLEN)
+#define OUTMAX      (TRACK_BUFFER_LEN+300)
+#define NBLOOP      10
+#define DMSNAME     "dms_lz.dms"
+
+
+UCHAR img[IMGSIZE];
+UCHAR *arc;
+UCHAR out[OUTMAX], refOut[OUTMAX];
+unsigned long seed = 1;
+
+int modes[4] = { 2, 3, 5, 6 };
+char *modeNames[7] = { "nocomp", "simple", "quick", "medium", "deep", "heavy1", "heavy2" };
+char *words[8] = { "the ", "disk ", "volume ", "amiga ", "block ", "file ", "of ", "\n" };
+
+
+/*
+ * rnd
+ *
+ */
+unsigned long rnd(void)
+{
+    seed = seed*1103515245L+12345;
+    return (seed>>8) & 0xffffff;
+}
+
+
+/*
+ * fillImage
+ *
+ * text, code like words, runs of zeros with a few bytes, noise
+ */
+void fillImage(void)
+{
+    UCHAR *p, *end;
+    char *w;
+    int i;
+
+    for(i=0; i<NBTRACK; i++) {
+        p = img+(long)i*TRACKLEN;
+        end = p+TRACKLEN;
+        switch(i%4) {
+        case 0:
+            while(p<end) {
+                for(w=words[rnd()%8]; *w && p<end; w++)
+                    *p++ = *w;
+            }
+            break;
+        case 1:
+            while(p+1<end) {
+                *p++ = (UCHAR)(0x40+(rnd()%4)*0x10);
+                *p++ = (UCHAR)(rnd()%16);
+            }
+            break;
+        case 2:
+            memset(p, 0, TRACKLEN);
+            while(p<end) {
+                *p = (UCHAR)rnd();
+                p += 1+rnd()%200;
+            }
+            break;
+        default:
+            while(p<end)
+                *p++ = (UCHAR)rnd();
+        }
+    }
+}
+
+
+/*
+ * unpack
+ *
+ * the first unpacking of a track, with xdms or with xDMS 1.3. Nothing
+ * to do for NOCOMP and SIMPLE, but the decrunchers may be reset
+ */
+USHORT unpack(struct DMS_Track *t, UCHAR *b, int ref)
+{
+    UCHAR *in;
+    USHORT r;
+
+    in = arc+t->offset;
+    r = 0;
+    switch(t->cmode) {
+    case 2:
+        r = ref ? ref_Unpack_QUICK(in, b, t->pklen2) : Unpack_QUICK(in, b, t->pklen2);
+        break;
+    case 3:
+        r = ref ? ref_Unpack_MEDIUM(in, b, t->pklen2) : Unpack_MEDIUM(in, b, t->pklen2);
+        break;
+    case 5:
+    case 6:
+        r = ref ? ref_Unpack_HEAVY(in, b, (UCHAR)(t->cmode==5 ? t->flags&7 : t->flags|8), t->pklen2)
+            : Unpack_HEAVY(in, b, (UCHAR)(t->cmode==5 ? t->flags&7 : t->flags|8), t->pklen2);
+        break;
+    }
+    if (!(t->flags & 1)) {
+        if (ref)
+            ref_Init_Decrunchers();
+        else
+            Init_Decrunchers();
+    }
+
+    return r;
+}
+
+
+/*
+ * readArchive
+ *
+ */
+long readArchive(char *name)
+{
+    FILE *f;
+    long size;
+
+    f = fopen(name, "rb");
+    if (!f)
+        return -1;
+    fseek(f, 0, SEEK_END);
+    size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    arc = (UCHAR*)calloc(size+BITBUF_PAD, 1);
+    if (!arc || fread(arc, 1, size, f)!=(size_t)size)
+        size = -1;
+    fclose(f);
+
+    return size;
+}
+
+
+/*
+ * testMode
+ *
+ */
+int testMode(int mode)
+{
+    struct DMS_Info info;
+    struct DMS_Track *t;
+    clock_t t0;
+    double tLib, tRef;
+    long size, unpk;
+    int i, l, n, rc;
+    USHORT r1, r2;
+
+    if (Pack_Image(img, IMGSIZE, DMSNAME, (USHORT)mode, PACK_THREADS)!=NO_PROBLEM
+        || Scan_File(DMSNAME, &info)!=NO_PROBLEM) {
+        printf("%s : can't pack\n", modeNames[mode]);
+        return 1;
+    }
+    size = readArchive(DMSNAME);
+    text = (UCHAR*)calloc(TRACK_BUFFER_LEN, 1);
+    if (size<0 || !text) {
+        fprintf(stderr,"can't read the archive\n");
+        exit(1);
+    }
+
+    rc = 0;
+    n = 0;
+    unpk = 0;
+    Init_Decrunchers();
+    ref_Init_Decrunchers();
+    for(i=0; i<info.nbtracks; i++) {
+        t = &info.tracks[i];
+        if (t->number>=80)
+            continue;
+        memset(out, 0, OUTMAX);
+        memset(refOut, 0, OUTMAX);
+        r1 = unpack(t, out, 0);
+        r2 = unpack(t, refOut, 1);
+        if (r1!=r2 || memcmp(out, refOut, t->pklen2)!=0) {
+            printf("%s : track %d different\n", modeNames[mode], t->number);
+            rc = 1;
+        }
+        if (t->cmode>=2) {
+            n++;
+            unpk += t->pklen2;
+        }
+    }
+
+    t0 = clock();
+    for(l=0; l<NBLOOP; l++) {
+        Init_Decrunchers();
+        for(i=0; i<info.nbtracks; i++)
+            if (info.tracks[i].number<80)
+                unpack(&info.tracks[i], out, 0);
+    }
+    tLib = (double)(clock()-t0)/CLOCKS_PER_SEC;
+
+    t0 = clock();
+    for(l=0; l<NBLOOP; l++) {
+        ref_Init_Decrunchers();
+        for(i=0; i<info.nbtracks; i++)
+            if (info.tracks[i].number<80)
+                unpack(&info.tracks[i], refOut, 1);
+    }
+    tRef = (double)(clock()-t0)/CLOCKS_PER_SEC;
+
+    printf("%s : %d tracks, %ld bytes packed", modeNames[mode], n, size);
+    if (tLib>0 && tRef>0)
+        printf(", %.1f MB/s, xDMS 1.3 : %.1f MB/s",
+            (double)NBLOOP*unpk/tLib/1e6, (double)NBLOOP*unpk/tRef/1e6);
+    printf("\n");
+    if (n==0)
+        rc = 1;
+
+    free(text);
+    free(arc);
+    Free_Info(&info);
+
+    return rc;
+}
+
+
+/*
+ *
+ *
+ */
+int main(int argc, char *argv[])
+{
+    int i, rc;
+
+    fillImage();
+
+    rc = 0;
+    for(i=0; i<4; i++)
+        if (testMode(modes[i]))
+            rc = 1;
+
+    remove(DMSNAME);
+
+    return rc;
+}
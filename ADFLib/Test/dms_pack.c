@@ -0,0 +1,217 @@
+/*
+ *  dms_pack.c
+ *
+ *  xdms : images packed in every mode, with one thread and with several,
+ *  then unpacked by Process_File() : the same image, and the same tracks
+ *  whatever the number of threads. The sizes and mode the packer refuses
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../xdms/cdata.h"
+#include "../../xdms/Pfile.h"
+#include "../../xdms/Wfile.h"
+
+
+#define TRACKLEN    11264L
+#define DDSIZE      (80*TRACKLEN)
+#define HDSIZE      (160*TRACKLEN)
+#define DMSNAME     "dms_pack.dms"
+#define DMSNAME2    "dms_pack2.dms"
+#define ADFNAME     "dms_pack.adf"
+
+
+UCHAR img[HDSIZE], back[HDSIZE+1];
+unsigned long seed = 1;
+char *words[8] = { "the ", "disk ", "volume ", "amiga ", "block ", "file ", "of ", "\n" };
+
+
+/*
+ * rnd
+ *
+ */
+unsigned long rnd(void)
+{
+    seed = seed*1103515245L+12345;
+    return (seed>>8) & 0xffffff;
+}
+
+
+/*
+ * fillImage
+ *
+ * text, code like words, zeros, noise, and runs of 0x90, the RLE escape
+ */
+void fillImage(long size)
+{
+    UCHAR *p, *end;
+    char *w;
+    long i;
+
+    for(i=0; i<size/TRACKLEN; i++) {
+        p = img+i*TRACKLEN;
+        end = p+TRACKLEN;
+        switch(i%5) {
+        case 0:
+            while(p<end)
+                for(w=words[rnd()%8]; *w && p<end; w++)
+                    *p++ = *w;
+            break;
+        case 1:
+            while(p+1<end) {
+                *p++ = (UCHAR)(0x40+(rnd()%4)*0x10);
+                *p++ = (UCHAR)(rnd()%16);
+            }
+            break;
+        case 2:
+            memset(p, 0, TRACKLEN);
+            break;
+        case 3:
+            while(p<end)
+                *p++ = (UCHAR)rnd();
+            break;
+        default:
+            memset(p, 0x90, TRACKLEN/2);
+            for(p+=TRACKLEN/2; p<end; p+=2) {
+                p[0] = 0x90;
+                p[1] = (UCHAR)rnd();
+            }
+        }
+    }
+    memcpy(img, "DOS\1", 4);
+}
+
+
+/*
+ * readFile
+ *
+ */
+long readFile(char *name, UCHAR *buf, long max)
+{
+    FILE *f;
+    long n;
+
+    f = fopen(name, "rb");
+    if (!f)
+        return -1;
+    n = (long)fread(buf, 1, max, f);
+    fclose(f);
+
+    return n;
+}
+
+
+/*
+ * sameTracks
+ *
+ * the archives but their header, which has the date
+ */
+int sameTracks(char *name1, char *name2)
+{
+    UCHAR *b1, *b2;
+    long n1, n2;
+    int same;
+
+    b1 = (UCHAR*)malloc(HDSIZE*2);
+    b2 = (UCHAR*)malloc(HDSIZE*2);
+    if (!b1 || !b2) {
+        fprintf(stderr,"malloc error\n");
+        exit(1);
+    }
+    n1 = readFile(name1, b1, HDSIZE*2);
+    n2 = readFile(name2, b2, HDSIZE*2);
+    same = n1>HEADLEN && n1==n2 && memcmp(b1+HEADLEN, b2+HEADLEN, n1-HEADLEN)==0;
+    free(b1);
+    free(b2);
+
+    return same;
+}
+
+
+/*
+ * roundTrip
+ *
+ */
+int roundTrip(long size, USHORT mode, USHORT nthreads)
+{
+    struct DMS_Info info;
+    USHORT r;
+    int rc;
+
+    rc = 0;
+    r = Pack_Image(img, size, DMSNAME, mode, 1);
+    if (r==NO_PROBLEM)
+        r = Pack_Image(img, size, DMSNAME2, mode, nthreads);
+    if (r==NO_PROBLEM)
+        r = Process_File(DMSNAME2, ADFNAME, 0, 0, 0);
+    if (r!=NO_PROBLEM) {
+        printf("size %ld mode %d : error %d\n", size, mode, r);
+        return 1;
+    }
+
+    if (readFile(ADFNAME, back, HDSIZE+1)!=size || memcmp(img, back, size)!=0) {
+        printf("size %ld mode %d : not the same image\n", size, mode);
+        rc = 1;
+    }
+    if (!sameTracks(DMSNAME, DMSNAME2)) {
+        printf("size %ld mode %d : %d threads, other tracks\n", size, mode, nthreads);
+        rc = 1;
+    }
+    /* a HD image has tracks of 2 floppy tracks */
+    if (Scan_File(DMSNAME2, &info)!=NO_PROBLEM
+        || info.nbtracks!=(size>DDSIZE ? size/(2*TRACKLEN) : size/TRACKLEN)
+        || info.tracks[0].unpklen!=(size>DDSIZE ? 2*TRACKLEN : TRACKLEN)) {
+        printf("size %ld mode %d : bad index\n", size, mode);
+        rc = 1;
+    }
+    else
+        printf("size %ld mode %d : %ld bytes packed\n", size, mode, info.pkfsize);
+    Free_Info(&info);
+
+    return rc;
+}
+
+
+/*
+ *
+ *
+ */
+int main(int argc, char *argv[])
+{
+    USHORT modes[6] = { 0, 1, 2, 3, 5, 6 };
+    int i, rc;
+
+    rc = 0;
+
+    fillImage(HDSIZE);
+    for(i=0; i<6; i++)
+        rc |= roundTrip(DDSIZE, modes[i], PACK_THREADS);
+    rc |= roundTrip(HDSIZE, 6, PACK_THREADS);
+    rc |= roundTrip(HDSIZE, 3, 8);
+    rc |= roundTrip(10*TRACKLEN, 2, 3);
+
+    /* one symbol only */
+    memset(img, 0, DDSIZE);
+    rc |= roundTrip(DDSIZE, 5, PACK_THREADS);
+    rc |= roundTrip(DDSIZE, 3, PACK_THREADS);
+    memset(img, 0x41, DDSIZE);
+    rc |= roundTrip(DDSIZE, 6, PACK_THREADS);
+    rc |= roundTrip(DDSIZE, 2, PACK_THREADS);
+
+    if (Pack_Image(img, 1000, DMSNAME, 2, 1)!=ERR_IMGSIZE
+        || Pack_Image(img, DDSIZE+TRACKLEN, DMSNAME, 2, 1)!=ERR_IMGSIZE
+        || Pack_Image(img, DDSIZE, DMSNAME, 4, 1)!=ERR_UNKNMODE
+        || Pack_Image(img, DDSIZE, DMSNAME, 7, 1)!=ERR_UNKNMODE) {
+        printf("bad size or mode accepted\n");
+        rc = 1;
+    }
+
+    remove(DMSNAME);
+    remove(DMSNAME2);
+    remove(ADFNAME);
+
+    return rc;
+}
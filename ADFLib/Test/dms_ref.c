@@ -0,0 +1,511 @@
+/*
+ *  dms_ref.c
+ *
+ *  the decrunchers of xDMS 1.3, by Andre Rodrigues de la Rocha, as they
+ *  were before the 64 bits bit reader and the block copies : a bit reader
+ *  refilled byte by byte, and the copies done one byte at a time through
+ *  the text buffer. Everything is static, so they can be linked with the
+ *  xdms objects and compared with them
+ */
+
+#include <string.h>
+
+#include "dms_ref.h"
+#include "../../xdms/tables.h"
+
+
+static UCHAR ref_text[0x4000];
+
+
+/*
+ * bit reader
+ */
+
+static ULONG mask_bits[]={
+    0x000000L,0x000001L,0x000003L,0x000007L,0x00000fL,0x00001fL,
+    0x00003fL,0x00007fL,0x0000ffL,0x0001ffL,0x0003ffL,0x0007ffL,
+    0x000fffL,0x001fffL,0x003fffL,0x007fffL,0x00ffffL,0x01ffffL,
+    0x03ffffL,0x07ffffL,0x0fffffL,0x1fffffL,0x3fffffL,0x7fffffL,
+    0xffffffL
+};
+
+static UCHAR *indata, bitcount;
+static ULONG bitbuf;
+
+#define GETBITS(n) ((USHORT)(bitbuf >> (bitcount-(n))))
+#define DROPBITS(n) {bitbuf &= mask_bits[bitcount-=(n)]; while (bitcount<16) {bitbuf = (bitbuf << 8) | *indata++;  bitcount += 8;}}
+
+static void initbitbuf(UCHAR *in)
+{
+    bitbuf = 0;
+    bitcount = 0;
+    indata = in;
+    DROPBITS(0);
+}
+
+
+/*
+ * QUICK
+ */
+
+#define QBITMASK 0xff
+
+static USHORT quick_text_loc;
+
+USHORT ref_Unpack_QUICK(UCHAR *in, UCHAR *out, USHORT origsize)
+{
+    USHORT i, j;
+    UCHAR *outend;
+
+    initbitbuf(in);
+
+    outend = out+origsize;
+    while (out < outend) {
+        if (GETBITS(1)!=0) {
+            DROPBITS(1);
+            *out++ = ref_text[quick_text_loc++ & QBITMASK] = (UCHAR)GETBITS(8);  DROPBITS(8);
+        } else {
+            DROPBITS(1);
+            j = (USHORT) (GETBITS(2)+2);  DROPBITS(2);
+            i = (USHORT) (quick_text_loc - GETBITS(8) - 1);  DROPBITS(8);
+            while(j--) {
+                *out++ = ref_text[quick_text_loc++ & QBITMASK] = ref_text[i++ & QBITMASK];
+            }
+        }
+    }
+    quick_text_loc = (USHORT)((quick_text_loc+5) & QBITMASK);
+
+    return 0;
+}
+
+
+/*
+ * MEDIUM
+ */
+
+#define MBITMASK 0x3fff
+
+static USHORT medium_text_loc;
+
+USHORT ref_Unpack_MEDIUM(UCHAR *in, UCHAR *out, USHORT origsize)
+{
+    USHORT i, j, c;
+    UCHAR u, *outend;
+
+    initbitbuf(in);
+
+    outend = out+origsize;
+    while (out < outend) {
+        if (GETBITS(1)!=0) {
+            DROPBITS(1);
+            *out++ = ref_text[medium_text_loc++ & MBITMASK] = (UCHAR)GETBITS(8);
+            DROPBITS(8);
+        } else {
+            DROPBITS(1);
+            c = GETBITS(8);  DROPBITS(8);
+            j = (USHORT) (d_code[c]+3);
+            u = d_len[c];
+            c = (USHORT) (((c << u) | GETBITS(u)) & 0xff);  DROPBITS(u);
+            u = d_len[c];
+            c = (USHORT) ((d_code[c] << 8) | (((c << u) | GETBITS(u)) & 0xff));  DROPBITS(u);
+            i = (USHORT) (medium_text_loc - c - 1);
+
+            while(j--) *out++ = ref_text[medium_text_loc++ & MBITMASK] = ref_text[i++ & MBITMASK];
+        }
+    }
+    medium_text_loc = (USHORT)((medium_text_loc+66) & MBITMASK);
+
+    return 0;
+}
+
+
+/*
+ * DEEP
+ */
+
+#define DBITMASK 0x3fff
+
+#define F       60
+#define THRESHOLD   2
+#define N_CHAR      (256 - THRESHOLD + F)
+#define T       (N_CHAR * 2 - 1)
+#define R       (T - 1)
+#define MAX_FREQ    0x8000
+
+static USHORT deep_text_loc;
+static int init_deep_tabs=1;
+static USHORT freq[T + 1];
+static USHORT prnt[T + N_CHAR];
+static USHORT son[T];
+
+static void Init_DEEP_Tabs(void)
+{
+    USHORT i, j;
+
+    for (i = 0; i < N_CHAR; i++) {
+        freq[i] = 1;
+        son[i] = (USHORT)(i + T);
+        prnt[i + T] = i;
+    }
+    i = 0; j = N_CHAR;
+    while (j <= R) {
+        freq[j] = (USHORT) (freq[i] + freq[i + 1]);
+        son[j] = i;
+        prnt[i] = prnt[i + 1] = j;
+        i += 2; j++;
+    }
+    freq[T] = 0xffff;
+    prnt[R] = 0;
+
+    init_deep_tabs = 0;
+}
+
+static void reconst(void)
+{
+    USHORT i, j, k, f, l;
+
+    j = 0;
+    for (i = 0; i < T; i++) {
+        if (son[i] >= T) {
+            freq[j] = (USHORT) ((freq[i] + 1) / 2);
+            son[j] = son[i];
+            j++;
+        }
+    }
+    for (i = 0, j = N_CHAR; j < T; i += 2, j++) {
+        k = (USHORT) (i + 1);
+        f = freq[j] = (USHORT) (freq[i] + freq[k]);
+        for (k = (USHORT)(j - 1); f < freq[k]; k--);
+        k++;
+        l = (USHORT)((j - k) * 2);
+        memmove(&freq[k + 1], &freq[k], (size_t)l);
+        freq[k] = f;
+        memmove(&son[k + 1], &son[k], (size_t)l);
+        son[k] = i;
+    }
+    for (i = 0; i < T; i++) {
+        if ((k = son[i]) >= T) {
+            prnt[k] = i;
+        } else {
+            prnt[k] = prnt[k + 1] = i;
+        }
+    }
+}
+
+static void update(USHORT c)
+{
+    USHORT i, j, k, l;
+
+    if (freq[R] == MAX_FREQ) {
+        reconst();
+    }
+    c = prnt[c + T];
+    do {
+        k = ++freq[c];
+
+        if (k > freq[l = (USHORT)(c + 1)]) {
+            while (k > freq[++l]);
+            l--;
+            freq[c] = freq[l];
+            freq[l] = k;
+
+            i = son[c];
+            prnt[i] = l;
+            if (i < T) prnt[i + 1] = l;
+
+            j = son[l];
+            son[l] = i;
+
+            prnt[j] = c;
+            if (j < T) prnt[j + 1] = c;
+            son[c] = j;
+
+            c = l;
+        }
+    } while ((c = prnt[c]) != 0);
+}
+
+static USHORT DecodeChar(void)
+{
+    USHORT c;
+
+    c = son[R];
+    while (c < T) {
+        c = son[c + GETBITS(1)];
+        DROPBITS(1);
+    }
+    c -= T;
+    update(c);
+    return c;
+}
+
+static USHORT DecodePosition(void)
+{
+    USHORT i, j, c;
+
+    i = GETBITS(8);  DROPBITS(8);
+    c = (USHORT) (d_code[i] << 8);
+    j = d_len[i];
+    i = (USHORT) (((i << j) | GETBITS(j)) & 0xff);  DROPBITS(j);
+
+    return (USHORT) (c | i) ;
+}
+
+USHORT ref_Unpack_DEEP(UCHAR *in, UCHAR *out, USHORT origsize)
+{
+    USHORT i, j, c;
+    UCHAR *outend;
+
+    initbitbuf(in);
+
+    if (init_deep_tabs) Init_DEEP_Tabs();
+
+    outend = out+origsize;
+    while (out < outend) {
+        c = DecodeChar();
+        if (c < 256) {
+            *out++ = ref_text[deep_text_loc++ & DBITMASK] = (UCHAR)c;
+        } else {
+            j = (USHORT) (c - 255 + THRESHOLD);
+            i = (USHORT) (deep_text_loc - DecodePosition() - 1);
+            while (j--) *out++ = ref_text[deep_text_loc++ & DBITMASK] = ref_text[i++ & DBITMASK];
+        }
+    }
+
+    deep_text_loc = (USHORT)((deep_text_loc+60) & DBITMASK);
+
+    return 0;
+}
+
+
+/*
+ * HEAVY
+ */
+
+#define NC 510
+#define NPT 20
+#define N1 510
+#define OFFSET 253
+
+static USHORT left[2 * NC - 1], right[2 * NC - 1 + 9];
+static UCHAR c_len[NC], pt_len[NPT];
+static USHORT c_table[4096], pt_table[256];
+static USHORT lastlen, np;
+static USHORT heavy_text_loc;
+
+static SHORT c;
+static USHORT n, tblsiz, len, depth, maxdepth, avail;
+static USHORT codeword, bit, *tbl, TabErr;
+static UCHAR *blen;
+
+static USHORT mktbl(void)
+{
+    USHORT i=0;
+
+    if (TabErr) return 0;
+
+    if (len == depth) {
+        while (++c < n)
+            if (blen[c] == len) {
+                i = codeword;
+                codeword += bit;
+                if (codeword > tblsiz) {
+                    TabErr=1;
+                    return 0;
+                }
+                while (i < codeword) tbl[i++] = (USHORT)c;
+                return (USHORT)c;
+            }
+        c = -1;
+        len++;
+        bit >>= 1;
+    }
+    depth++;
+    if (depth < maxdepth) {
+        mktbl();
+        mktbl();
+    } else if (depth > 32) {
+        TabErr = 2;
+        return 0;
+    } else {
+        if ((i = avail++) >= 2 * n - 1) {
+            TabErr = 3;
+            return 0;
+        }
+        left[i] = mktbl();
+        right[i] = mktbl();
+        if (codeword >= tblsiz) {
+            TabErr = 4;
+            return 0;
+        }
+        if (depth == maxdepth) tbl[codeword++] = i;
+    }
+    depth--;
+    return i;
+}
+
+static USHORT make_table(USHORT nchar, UCHAR bitlen[],USHORT tablebits, USHORT table[])
+{
+    n = avail = nchar;
+    blen = bitlen;
+    tbl = table;
+    tblsiz = (USHORT) (1U << tablebits);
+    bit = (USHORT) (tblsiz / 2);
+    maxdepth = (USHORT)(tablebits + 1);
+    depth = len = 1;
+    c = -1;
+    codeword = 0;
+    TabErr = 0;
+    mktbl();
+    if (TabErr) return TabErr;
+    mktbl();
+    if (TabErr) return TabErr;
+    if (codeword != tblsiz) return 5;
+    return 0;
+}
+
+static USHORT decode_c(void)
+{
+    USHORT i, j, m;
+
+    j = c_table[GETBITS(12)];
+    if (j < N1) {
+        DROPBITS(c_len[j]);
+    } else {
+        DROPBITS(12);
+        i = GETBITS(16);
+        m = 0x8000;
+        do {
+            if (i & m) j = right[j];
+            else              j = left [j];
+            m >>= 1;
+        } while (j >= N1);
+        DROPBITS(c_len[j] - 12);
+    }
+    return j;
+}
+
+static USHORT decode_p(void)
+{
+    USHORT i, j, m;
+
+    j = pt_table[GETBITS(8)];
+    if (j < np) {
+        DROPBITS(pt_len[j]);
+    } else {
+        DROPBITS(8);
+        i = GETBITS(16);
+        m = 0x8000;
+        do {
+            if (i & m) j = right[j];
+            else             j = left [j];
+            m >>= 1;
+        } while (j >= np);
+        DROPBITS(pt_len[j] - 8);
+    }
+
+    if (j != np-1) {
+        if (j > 0) {
+            j = (USHORT)(GETBITS(i=(USHORT)(j-1)) | (1U << (j-1)));
+            DROPBITS(i);
+        }
+        lastlen=j;
+    }
+
+    return lastlen;
+}
+
+static USHORT read_tree_c(void)
+{
+    USHORT i,n;
+
+    n = GETBITS(9);
+    DROPBITS(9);
+    if (n>0){
+        for (i=0; i<n; i++) {
+            c_len[i] = (UCHAR)GETBITS(5);
+            DROPBITS(5);
+        }
+        for (i=n; i<510; i++) c_len[i] = 0;
+        if (make_table(510,c_len,12,c_table)) return 1;
+    } else {
+        n = GETBITS(9);
+        DROPBITS(9);
+        for (i=0; i<510; i++) c_len[i] = 0;
+        for (i=0; i<4096; i++) c_table[i] = n;
+    }
+    return 0;
+}
+
+static USHORT read_tree_p(void)
+{
+    USHORT i,n;
+
+    n = GETBITS(5);
+    DROPBITS(5);
+    if (n>0){
+        for (i=0; i<n; i++) {
+            pt_len[i] = (UCHAR)GETBITS(4);
+            DROPBITS(4);
+        }
+        for (i=n; i<np; i++) pt_len[i] = 0;
+        if (make_table(np,pt_len,8,pt_table)) return 1;
+    } else {
+        n = GETBITS(5);
+        DROPBITS(5);
+        for (i=0; i<np; i++) pt_len[i] = 0;
+        for (i=0; i<256; i++) pt_table[i] = n;
+    }
+    return 0;
+}
+
+USHORT ref_Unpack_HEAVY(UCHAR *in, UCHAR *out, UCHAR flags, USHORT origsize)
+{
+    USHORT j, i, c, bitmask;
+    UCHAR *outend;
+
+    if (flags & 8) {
+        np = 15;
+        bitmask = 0x1fff;
+    } else {
+        np = 14;
+        bitmask = 0x0fff;
+    }
+
+    initbitbuf(in);
+
+    if (flags & 2) {
+        if (read_tree_c()) return 1;
+        if (read_tree_p()) return 2;
+    }
+
+    outend = out+origsize;
+
+    while (out<outend) {
+        c = decode_c();
+        if (c < 256) {
+            *out++ = ref_text[heavy_text_loc++ & bitmask] = (UCHAR)c;
+        } else {
+            j = (USHORT) (c - OFFSET);
+            i = (USHORT) (heavy_text_loc - decode_p() - 1);
+            while(j--) *out++ = ref_text[heavy_text_loc++ & bitmask] = ref_text[i++ & bitmask];
+        }
+    }
+
+    return 0;
+}
+
+
+/*
+ * ref_Init_Decrunchers
+ *
+ */
+void ref_Init_Decrunchers(void)
+{
+    quick_text_loc = 251;
+    medium_text_loc = 0x3fbe;
+    heavy_text_loc = 0;
+    deep_text_loc = 0x3fc4;
+    init_deep_tabs = 1;
+    memset(ref_text,0,0x3fc8);
+}
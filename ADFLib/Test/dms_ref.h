@@ -0,0 +1,18 @@
+/*
+ *  dms_ref.h
+ *
+ *  the xDMS 1.3 decrunchers, kept as the reference of the dms tests
+ */
+
+#ifndef DMS_REF_H
+#define DMS_REF_H
+
+#include "../../xdms/cdata.h"
+
+void ref_Init_Decrunchers(void);
+USHORT ref_Unpack_QUICK(UCHAR *, UCHAR *, USHORT);
+USHORT ref_Unpack_MEDIUM(UCHAR *, UCHAR *, USHORT);
+USHORT ref_Unpack_DEEP(UCHAR *, UCHAR *, USHORT);
+USHORT ref_Unpack_HEAVY(UCHAR *, UCHAR *, UCHAR, USHORT);
+
+#endif /* DMS_REF_H */
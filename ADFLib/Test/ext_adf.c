@@ -0,0 +1,466 @@
+/*
+ *  ext_adf.c
+ *
+ *  extended ADF : a floppy written as UAE-1ADF with sector tracks, raw MFM
+ *  tracks starting anywhere and a custom track, mounted, listed and read
+ *  as the plain dump
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "adflib.h"
+
+
+#define NBFILE      12
+#define NBTRACK     160
+#define CUSTOM      158
+#define NBLOOP      20
+#define MAXTRACK    110000
+
+
+unsigned char *adf;
+unsigned char buf[100000];
+unsigned char *raw, *track;
+long pos;
+int last;
+unsigned long seed = 1;
+
+
+/*
+ * rnd
+ *
+ */
+int rnd(int n)
+{
+    seed = seed*1103515245+12345;
+    return (int)((seed>>16)%n);
+}
+
+
+/*
+ * fileByte
+ *
+ */
+unsigned char fileByte(int i, long p)
+{
+    return (unsigned char)(i*13+p+p/487);
+}
+
+
+/*
+ * makeAdf
+ *
+ * a floppy with some files, read into 'adf'
+ */
+int makeAdf()
+{
+    struct Device *flop;
+    struct Volume *vol;
+    struct File *fic;
+    char name[32];
+    long j, size;
+    int i;
+    FILE *f;
+
+    flop = adfCreateDumpDevice("newdev", 80, 2, 11);
+    if (!flop)
+        return 1;
+    adfCreateFlop(flop, "ext", FSMASK_FFS);
+    vol = adfMount(flop, 0, FALSE);
+    if (!vol) {
+        adfUnMountDev(flop);
+        return 1;
+    }
+    for(i=0; i<NBFILE; i++) {
+        sprintf(name, "file%d", i);
+        size = i*3001L;
+        for(j=0; j<size; j++)
+            buf[j] = fileByte(i, j);
+        fic = adfOpenFile(vol, name, "w");
+        adfWriteFile(fic, size, buf);
+        adfCloseFile(fic);
+    }
+    adfUnMount(vol);
+    adfUnMountDev(flop);
+
+    f = fopen("newdev", "rb");
+    if (!f)
+        return 1;
+    fread(adf, 1, NBTRACK*11*512, f);
+    fclose(f);
+
+    return 0;
+}
+
+
+/*
+ * putBit
+ *
+ */
+void putBit(int b)
+{
+    if (b)
+        raw[pos>>3] |= (unsigned char)(0x80>>(pos&7));
+    pos++;
+}
+
+
+/*
+ * putData
+ *
+ * a data bit and its clock
+ */
+void putData(int d)
+{
+    putBit(!(last|d));
+    putBit(d);
+    last = d;
+}
+
+
+/*
+ * putField
+ *
+ * the odd bits, then the even bits
+ */
+void putField(unsigned char *data, int len)
+{
+    int h, i, j;
+
+    for(h=0; h<2; h++)
+        for(i=0; i<len; i++)
+            for(j=7-h; j>=0; j-=2)
+                putData((data[i]>>j)&1);
+}
+
+
+/*
+ * mfmSum
+ *
+ */
+unsigned long mfmSum(unsigned char *data, int len)
+{
+    unsigned long s, l;
+    int i;
+
+    s = 0;
+    for(i=0; i<len; i+=4) {
+        l = ((unsigned long)data[i]<<24) | ((unsigned long)data[i+1]<<16)
+            | ((unsigned long)data[i+2]<<8) | data[i+3];
+        s ^= l^(l>>1);
+    }
+
+    return s&0x55555555L;
+}
+
+
+/*
+ * putLong
+ *
+ */
+void putLong(unsigned long l)
+{
+    unsigned char b[4];
+
+    b[0] = (unsigned char)(l>>24); b[1] = (unsigned char)(l>>16);
+    b[2] = (unsigned char)(l>>8); b[3] = (unsigned char)l;
+    putField(b, 4);
+}
+
+
+/*
+ * encodeTrack
+ *
+ * the sectors of track 't' in MFM, from sector t%11, rotated so that
+ * the index falls anywhere. returns the length in bits, in 'track'
+ */
+long encodeTrack(int t)
+{
+    unsigned char info[4], label[16];
+    long bits, rot, i;
+    int n, s, j;
+
+    memset(raw, 0, MAXTRACK/8+8);
+    pos = 0;
+    last = 0;
+    for(j=0; j<t%8; j++)
+        putBit(0);
+    memset(label, 0, 16);
+    for(n=0; n<11; n++) {
+        s = (t+n)%11;
+        for(j=0; j<16; j++)
+            putData(0);
+        for(j=31; j>=0; j--)
+            putBit((int)((0x44894489L>>j)&1));
+        last = 1;
+        info[0] = 0xff;
+        info[1] = (unsigned char)t;
+        info[2] = (unsigned char)s;
+        info[3] = (unsigned char)(11-n);
+        putField(info, 4);
+        putField(label, 16);
+        putLong(mfmSum(info, 4)^mfmSum(label, 16));
+        putLong(mfmSum(adf+(t*11+s)*512, 512));
+        putField(adf+(t*11+s)*512, 512);
+    }
+    for(j=0; j<300*8; j++)
+        putData(0);
+    bits = pos;
+
+    memset(track, 0, MAXTRACK/8+8);
+    rot = (t*9777L)%bits;
+    for(i=0; i<bits; i++)
+        if ((raw[((i+rot)%bits)>>3]>>(7-((i+rot)%bits)%8))&1)
+            track[i>>3] |= (unsigned char)(0x80>>(i&7));
+
+    return bits;
+}
+
+
+/*
+ * put32
+ *
+ */
+void put32(unsigned char *p, unsigned long l)
+{
+    p[0] = (unsigned char)(l>>24); p[1] = (unsigned char)(l>>16);
+    p[2] = (unsigned char)(l>>8); p[3] = (unsigned char)l;
+}
+
+
+/*
+ * makeExt
+ *
+ * the floppy as an extended ADF. if 'mfm', the odd tracks as raw MFM
+ * and CUSTOM as random bits
+ */
+void makeExt(BOOL mfm)
+{
+    unsigned char hdr[12+12*NBTRACK];
+    long bits, len;
+    FILE *f;
+    int t, i;
+
+    f = fopen("newdev2", "wb");
+    if (!f) exit(1);
+    memset(hdr, 0, sizeof(hdr));
+    memcpy(hdr, "UAE-1ADF", 8);
+    hdr[11] = NBTRACK;
+    /* the headers are written again with the sizes of the tracks */
+    fwrite(hdr, 1, sizeof(hdr), f);
+    for(t=0; t<NBTRACK; t++) {
+        if (mfm && t==CUSTOM) {
+            len = 12000;
+            for(i=0; i<len; i++)
+                track[i] = (unsigned char)rnd(256);
+            bits = len*8-3;
+            hdr[12+t*12+3] = 1;
+        }
+        else if (mfm && t%2==1) {
+            bits = encodeTrack(t);
+            len = (bits+7)/8;
+            hdr[12+t*12+3] = 1;
+        }
+        else {
+            len = 11*512;
+            bits = len*8;
+            memcpy(track, adf+t*11*512, len);
+        }
+        put32(hdr+12+t*12+4, len);
+        put32(hdr+12+t*12+8, bits);
+        fwrite(track, 1, len, f);
+    }
+    fseek(f, 0, SEEK_SET);
+    fwrite(hdr, 1, sizeof(hdr), f);
+    fclose(f);
+}
+
+
+/*
+ * checkFiles
+ *
+ * lists the root directory and reads the files. returns the number of wrong files
+ */
+int checkFiles(struct Volume *vol)
+{
+    struct List *list, *cell;
+    struct File *fic;
+    char name[32];
+    long j, n;
+    int i, bad;
+
+    n = 0;
+    cell = list = adfGetDirEnt(vol, vol->curDirPtr);
+    while(cell) {
+        n++;
+        cell = cell->next;
+    }
+    adfFreeDirList(list);
+    bad = n!=NBFILE;
+
+    for(i=0; i<NBFILE; i++) {
+        sprintf(name, "file%d", i);
+        fic = adfOpenFile(vol, name, "r");
+        if (!fic) {
+            bad++;
+            continue;
+        }
+        n = adfReadFile(fic, sizeof(buf), buf);
+        if (n!=i*3001L)
+            bad++;
+        else
+            for(j=0; j<n; j++)
+                if (buf[j]!=fileByte(i, j)) {
+                    bad++;
+                    break;
+                }
+        adfCloseFile(fic);
+    }
+
+    return bad;
+}
+
+
+/*
+ * timeMount
+ *
+ * mounts, lists and reads NBLOOP times. returns the ms, -1 if a file is wrong
+ */
+long timeMount(char *name)
+{
+    struct Device *dev;
+    struct Volume *vol;
+    clock_t t0;
+    int i, bad;
+
+    bad = 0;
+    t0 = clock();
+    for(i=0; i<NBLOOP; i++) {
+        dev = adfMountDev(name, TRUE);
+        if (!dev)
+            return -1;
+        vol = adfMount(dev, 0, TRUE);
+        if (!vol) {
+            adfUnMountDev(dev);
+            return -1;
+        }
+        bad += checkFiles(vol);
+        adfUnMount(vol);
+        adfUnMountDev(dev);
+    }
+    if (bad)
+        return -1;
+
+    return (long)((clock()-t0)*1000/CLOCKS_PER_SEC);
+}
+
+
+/*
+ *
+ *
+ */
+int main(int argc, char *argv[])
+{
+    struct Device *dev;
+    struct Volume *vol;
+    struct File *fic;
+    long bits, msAdf, msExt;
+    int rc, type;
+
+    adfEnvInitDefault();
+
+    adf = (unsigned char*)malloc(NBTRACK*11*512);
+    raw = (unsigned char*)malloc(MAXTRACK/8+8);
+    track = (unsigned char*)malloc(MAXTRACK/8+8);
+    if (!adf || !raw || !track) exit(1);
+
+    rc = 0;
+    if (makeAdf()!=0) {
+        fprintf(stderr, "can't create the floppy\n");
+        return 1;
+    }
+
+    /* raw MFM tracks : read only, the types of the tracks */
+    makeExt(TRUE);
+    dev = adfMountDev("newdev2", FALSE);
+    if (!dev) {
+        fprintf(stderr, "can't mount device\n");
+        return 1;
+    }
+    rc |= dev->devType!=DEVTYPE_FLOPDD || !dev->readOnly;
+    rc |= adfReadExtTrack(dev, 0, buf, sizeof(buf), &type)!=11*512*8 || type!=EXT_DOS;
+    rc |= memcmp(buf, adf, 11*512)!=0;
+    bits = encodeTrack(1);
+    rc |= adfReadExtTrack(dev, 1, buf, sizeof(buf), &type)!=bits || type!=EXT_MFM;
+    rc |= memcmp(buf, track, bits/8)!=0;
+    rc |= adfReadExtTrack(dev, CUSTOM, buf, sizeof(buf), &type)!=12000*8-3 || type!=EXT_CUSTOM;
+    rc |= adfReadExtTrack(dev, NBTRACK, buf, sizeof(buf), &type)!=-1;
+    vol = adfMount(dev, 0, FALSE);
+    if (!vol) {
+        adfUnMountDev(dev);
+        fprintf(stderr, "can't mount volume\n");
+        return 1;
+    }
+    rc |= checkFiles(vol)!=0;
+    rc |= strcmp(vol->volName, "ext")!=0;
+    rc |= adfOpenFile(vol, "added", "w")!=NULL;
+    adfUnMount(vol);
+    adfUnMountDev(dev);
+
+    /* the same as the plain dump */
+    msExt = timeMount("newdev2");
+    msAdf = timeMount("newdev");
+    rc |= msExt==-1 || msAdf==-1;
+
+    /* not an extended ADF */
+    dev = adfMountDev("newdev", TRUE);
+    rc |= dev==NULL || adfReadExtTrack(dev, 0, buf, sizeof(buf), &type)!=-1;
+    if (dev)
+        adfUnMountDev(dev);
+
+    /* sector tracks only : written */
+    makeExt(FALSE);
+    dev = adfMountDev("newdev2", FALSE);
+    rc |= dev==NULL || dev->readOnly;
+    vol = dev ? adfMount(dev, 0, FALSE) : NULL;
+    if (vol) {
+        fic = adfOpenFile(vol, "added", "w");
+        rc |= fic==NULL;
+        if (fic) {
+            memset(buf, 0x5a, 20000);
+            adfWriteFile(fic, 20000, buf);
+            adfCloseFile(fic);
+        }
+        adfUnMount(vol);
+    }
+    else
+        rc = 1;
+    if (dev)
+        adfUnMountDev(dev);
+    dev = adfMountDev("newdev2", TRUE);
+    vol = dev ? adfMount(dev, 0, TRUE) : NULL;
+    if (vol) {
+        fic = adfOpenFile(vol, "added", "r");
+        rc |= fic==NULL || adfReadFile(fic, sizeof(buf), buf)!=20000 || buf[19999]!=0x5a;
+        if (fic)
+            adfCloseFile(fic);
+        adfUnMount(vol);
+    }
+    else
+        rc = 1;
+    if (dev)
+        adfUnMountDev(dev);
+
+    printf("%d mounts, files read : adf %ld ms, extended adf %ld ms\n", NBLOOP, msAdf, msExt);
+
+    free(track);
+    free(raw);
+    free(adf);
+    adfEnvCleanUp();
+
+    return rc;
+}
@@ -0,0 +1,317 @@
+/*
+ *  fdi_adf.c
+ *
+ *  fdi2adf : the dump of an FDI file made from a floppy, with a bad and
+ *  a missing sector, mounted in memory and read by the usual functions
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "adflib.h"
+#include "../../fdi2adf.h"
+
+
+#define NBFILE      12
+#define BADTRACK    150
+
+
+unsigned char *adf;
+unsigned char buf[100000];
+
+
+/*
+ * fileByte
+ *
+ */
+unsigned char fileByte(int i, long pos)
+{
+    return (unsigned char)(i*7+pos+pos/509);
+}
+
+
+/*
+ * makeAdf
+ *
+ * a floppy with some files, read into 'adf'
+ */
+int makeAdf(int sectors)
+{
+    struct Device *flop;
+    struct Volume *vol;
+    struct File *fic;
+    char name[32];
+    long j, size;
+    int i;
+    FILE *f;
+
+    flop = adfCreateDumpDevice("newdev", 80, 2, sectors);
+    if (!flop)
+        return 1;
+    adfCreateFlop(flop, "fdi", FSMASK_FFS);
+    vol = adfMount(flop, 0, FALSE);
+    if (!vol) {
+        adfUnMountDev(flop);
+        return 1;
+    }
+    for(i=0; i<NBFILE; i++) {
+        sprintf(name, "file%d", i);
+        size = i*3001L;
+        for(j=0; j<size; j++)
+            buf[j] = fileByte(i, j);
+        fic = adfOpenFile(vol, name, "w");
+        adfWriteFile(fic, size, buf);
+        adfCloseFile(fic);
+    }
+    adfUnMount(vol);
+    adfUnMountDev(flop);
+
+    f = fopen("newdev", "rb");
+    if (!f)
+        return 1;
+    fread(adf, 1, 80*2*sectors*512, f);
+    fclose(f);
+
+    return 0;
+}
+
+
+/*
+ * makeFdi
+ *
+ * standard tracks starting at several sectors. If 'bad', a track described
+ * sector by sector : sector 3 with a wrong checksum, no sector 7
+ */
+void makeFdi(int sectors, BOOL bad)
+{
+    unsigned char hdr[512];
+    FILE *f;
+    int t, s, n;
+
+    memset(hdr, 0, 512);
+    strcpy((char*)hdr, "Formatted Disk Image file");
+    hdr[140] = 1;
+    hdr[143] = 79;
+    hdr[144] = 1;
+    hdr[145] = 1;
+    for(t=0; t<160; t++) {
+        if (sectors==22) {
+            hdr[152+t*2] = 2;
+            hdr[153+t*2] = 44;
+        }
+        else {
+            hdr[152+t*2] = 1;
+            hdr[153+t*2] = (unsigned char)(((t%11)<<4) | 11);
+        }
+    }
+
+    f = fopen("newdev2", "wb");
+    if (!f) exit(1);
+    /* the header is written again with the sizes of the tracks */
+    fwrite(hdr, 1, 512, f);
+    for(t=0; t<160; t++) {
+        if (!bad || t!=BADTRACK) {
+            fwrite(adf+t*sectors*512, 1, sectors*512, f);
+            continue;
+        }
+        /* a bit before the first sync, then sector headers and data */
+        n = 0;
+        buf[n++] = 1;
+        buf[n++] = 0; buf[n++] = 0; buf[n++] = 0;
+        buf[n++] = 0x00;
+        for(s=0; s<sectors; s++) {
+            if (s==7)
+                continue;
+            buf[n++] = 0x22;
+            buf[n++] = (unsigned char)s;
+            buf[n++] = (unsigned char)(sectors-s);
+            if (s==3) {
+                /* not decoded data, and its checksum */
+                buf[n++] = 0x25;
+                buf[n++] = 2;
+                memset(buf+n, 0x12, 4);
+                memcpy(buf+n+4, adf+(t*sectors+s)*512, 512);
+                n += 4+512;
+            }
+            else {
+                buf[n++] = 0x23;
+                memcpy(buf+n, adf+(t*sectors+s)*512, 512);
+                n += 512;
+            }
+        }
+        buf[n++] = 0xff;
+        hdr[152+t*2] = 0xe2;
+        hdr[153+t*2] = (unsigned char)(n/256+1);
+        memset(buf+n, 0, 256);
+        fwrite(buf, 1, (n/256+1)*256, f);
+    }
+    fseek(f, 0, SEEK_SET);
+    fwrite(hdr, 1, 512, f);
+    fclose(f);
+}
+
+
+/*
+ * checkFiles
+ *
+ * returns the number of wrong files
+ */
+int checkFiles(struct Volume *vol)
+{
+    struct File *fic;
+    char name[32];
+    long j, n;
+    int i, bad;
+
+    bad = 0;
+    for(i=0; i<NBFILE; i++) {
+        sprintf(name, "file%d", i);
+        fic = adfOpenFile(vol, name, "r");
+        if (!fic) {
+            bad++;
+            continue;
+        }
+        n = adfReadFile(fic, sizeof(buf), buf);
+        if (n!=i*3001L)
+            bad++;
+        else
+            for(j=0; j<n; j++)
+                if (buf[j]!=fileByte(i, j)) {
+                    bad++;
+                    break;
+                }
+        adfCloseFile(fic);
+    }
+
+    return bad;
+}
+
+
+/*
+ * run
+ *
+ */
+int run(int sectors, BOOL bad, char *title)
+{
+    struct fdi2adf_info info, info1;
+    struct Device *dev;
+    struct Volume *vol;
+    struct File *fic;
+    unsigned char *img, *img1;
+    long i, size, nbDiff;
+    clock_t t0, t1, t2;
+    int rc, nbBad;
+
+    rc = 0;
+    size = 80*2*sectors*512L;
+    if (makeAdf(sectors)!=0) {
+        fprintf(stderr, "can't create the floppy\n");
+        return 1;
+    }
+    makeFdi(sectors, bad);
+
+    /* the same dump with one thread or several */
+    t0 = clock();
+    img1 = fdi2adf_decode("newdev2", 1, &info1);
+    t1 = clock();
+    img = fdi2adf_decode("newdev2", 4, &info);
+    t2 = clock();
+    if (!img || !img1) {
+        fprintf(stderr, "can't decode\n");
+        return 1;
+    }
+    rc |= info.sectors!=sectors || info.cylinders!=80 || info1.bad!=info.bad;
+    rc |= memcmp(img, img1, size)!=0 || memcmp(info.status, info1.status, 160*sectors)!=0;
+
+    /* the bad sectors, and the others as on the floppy */
+    nbDiff = 0;
+    nbBad = 0;
+    for(i=0; i<160*sectors; i++) {
+        if (info.status[i]==FDI2ADF_OK) {
+            if (memcmp(img+i*512, adf+i*512, 512)!=0)
+                nbDiff++;
+            continue;
+        }
+        nbBad++;
+        if (!bad || i/sectors!=BADTRACK)
+            rc = 1;
+        else if (i%sectors==3)
+            rc |= info.status[i]!=FDI2ADF_BADDATA;
+        else if (i%sectors==7)
+            rc |= info.status[i]!=FDI2ADF_MISSING;
+        else
+            rc = 1;
+    }
+    rc |= nbBad!=info.bad || nbBad!=(bad ? 2 : 0) || nbDiff!=0;
+    free(img);
+    free(img1);
+    fdi2adf_free_info(&info1);
+    fdi2adf_free_info(&info);
+
+    /* in memory : read, written */
+    dev = fdi2adf_mount("newdev2", 0, &info);
+    if (!dev) {
+        fprintf(stderr, "can't mount device\n");
+        return 1;
+    }
+    rc |= dev->devType!=(sectors==22 ? DEVTYPE_FLOPHD : DEVTYPE_FLOPDD);
+    vol = adfMount(dev, 0, FALSE);
+    if (!vol) {
+        adfUnMountDev(dev);
+        fprintf(stderr, "can't mount volume\n");
+        return 1;
+    }
+    rc |= checkFiles(vol)!=0;
+    rc |= strcmp(vol->volName, "fdi")!=0;
+    fic = adfOpenFile(vol, "added", "w");
+    rc |= fic==NULL;
+    if (fic) {
+        memset(buf, 0x5a, 20000);
+        adfWriteFile(fic, 20000, buf);
+        adfCloseFile(fic);
+    }
+    fic = adfOpenFile(vol, "added", "r");
+    rc |= fic==NULL || adfReadFile(fic, sizeof(buf), buf)!=20000 || buf[19999]!=0x5a;
+    if (fic)
+        adfCloseFile(fic);
+    adfUnMount(vol);
+    adfUnMountDev(dev);
+    fdi2adf_free_info(&info);
+
+    printf("%-10s : %d bad sectors, 1 thread %ld ms, 4 threads %ld ms\n", title, nbBad,
+        (long)((t1-t0)*1000/CLOCKS_PER_SEC), (long)((t2-t1)*1000/CLOCKS_PER_SEC));
+
+    return rc;
+}
+
+
+/*
+ *
+ *
+ */
+int main(int argc, char *argv[])
+{
+    struct fdi2adf_info info;
+    int rc;
+
+    adfEnvInitDefault();
+
+    adf = (unsigned char*)malloc(80*2*22*512);
+    if (!adf) exit(1);
+
+    rc = 0;
+    rc |= run(11, FALSE, "DD");
+    rc |= run(11, TRUE, "DD, bad");
+    rc |= run(22, FALSE, "HD");
+
+    /* not an FDI file */
+    rc |= fdi2adf_mount("newdev", 0, &info)!=NULL;
+
+    free(adf);
+    adfEnvCleanUp();
+
+    return rc;
+}
@@ -0,0 +1,422 @@
+/*
+ *  fdi_mfm.c
+ *
+ *  fdi2raw : the tracks of the word MFM encoder, bit for bit the same as
+ *  the ones of the bit by bit encoder, on a synthetic FDI file. Then the
+ *  same tracks read at random through the cache of decoded tracks
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../../fdi2raw.h"
+
+/* the reference : fdi2raw.c built with the bit by bit encoder */
+#define FDI2RAW_BITWISE
+#define fdi2raw_read_track ref_read_track
+#define fdi2raw_header ref_header
+#define fdi2raw_header_free ref_header_free
+#define fdi2raw_get_last_track ref_get_last_track
+#define fdi2raw_get_last_head ref_get_last_head
+#define fdi2raw_get_type ref_get_type
+#define fdi2raw_get_bit_rate ref_get_bit_rate
+#define fdi2raw_get_rotation ref_get_rotation
+#define fdi2raw_get_write_protect ref_get_write_protect
+#define fdi2raw_set_cache ref_set_cache
+#include "../../fdi2raw.c"
+#undef fdi2raw_read_track
+#undef fdi2raw_header
+#undef fdi2raw_header_free
+#undef fdi2raw_get_last_track
+#undef fdi2raw_get_last_head
+#undef fdi2raw_get_type
+#undef fdi2raw_get_bit_rate
+#undef fdi2raw_get_rotation
+#undef fdi2raw_get_write_protect
+#undef fdi2raw_set_cache
+
+
+#define NBTRACK     160
+#define SRCMAX      15000
+#define OUTMAX      110000L
+#define NBLOOP      10
+#define NBRANDOM    5000
+#define NBCACHE     8
+
+
+unsigned char hdr[512];
+unsigned char trk[NBTRACK][MAX_SRC_BUFFER];
+int trkLen[NBTRACK];
+unsigned char refBuf[MAX_DST_BUFFER];
+unsigned char out[NBTRACK][MAX_DST_BUFFER];
+int outLen[NBTRACK], outRate[NBTRACK];
+unsigned long seed = 1;
+
+
+/*
+ * rnd
+ *
+ */
+int rnd(int n)
+{
+    seed = seed*1103515245+12345;
+    return (int)((seed>>16)%n);
+}
+
+
+/*
+ * putRnd
+ *
+ */
+void putRnd(unsigned char *p, int n)
+{
+    while(n--)
+        *p++ = (unsigned char)rnd(256);
+}
+
+
+/*
+ * putCode
+ *
+ * one random code of a sector described track, returns the source length,
+ * 'out' is incremented by more than its mfm length. No s0d : its 65536 sync
+ * bits are too many for the bit by bit encoder
+ */
+int putCode(unsigned char *p, int code, long *out)
+{
+    int n, shift;
+
+    p[0] = (unsigned char)code;
+    n = 1;
+    switch(code) {
+    case 0x00: case 0x01: case 0x04:
+        *out += 1;
+        break;
+    case 0x02: case 0x03:
+        *out += 16;
+        break;
+    case 0x08: case 0x09:
+        /* 0 is 256 bytes */
+        p[1] = (unsigned char)(rnd(4)==0 ? 0 : rnd(40));
+        p[2] = (unsigned char)rnd(256);
+        n = 3;
+        *out += 16*256;
+        break;
+    case 0x0a: case 0x0c:
+        /* a part of a byte, or no bit at all */
+        shift = rnd(4)==0 ? rnd(8) : rnd(300);
+        p[1] = (unsigned char)(shift>>8);
+        p[2] = (unsigned char)shift;
+        putRnd(p+3, (shift+7)/8);
+        n = 3+(shift+7)/8;
+        *out += 2*shift;
+        break;
+    case 0x0b:
+        shift = rnd(20);
+        p[1] = 0;
+        p[2] = (unsigned char)shift;
+        putRnd(p+3, (65536+shift+7)/8);
+        n = 3+(65536+shift+7)/8;
+        *out += 65536+shift;
+        break;
+    case 0x10: case 0x11: case 0x12:
+        *out += 3000;
+        break;
+    case 0x13: case 0x14:
+        putRnd(p+1, 4);
+        n = 5;
+        *out += 1000;
+        break;
+    case 0x15: case 0x16:
+        p[1] = (unsigned char)rnd(20);
+        n = 2;
+        *out += 1000;
+        break;
+    case 0x17:
+        putRnd(p+1, 6);
+        n = 7;
+        *out += 1000;
+        break;
+    case 0x18:
+        putRnd(p+1, 5);
+        n = 6;
+        *out += 1000;
+        break;
+    case 0x19:
+        putRnd(p+1, 512);
+        n = 513;
+        *out += 16*600;
+        break;
+    case 0x1a: case 0x1b: case 0x24: case 0x25:
+        shift = rnd(3);
+        p[1] = (unsigned char)shift;
+        n = 2+(128<<shift)+(code==0x1b ? 2 : code==0x25 ? 4 : 0);
+        putRnd(p+2, n-2);
+        *out += 16*(n+100);
+        break;
+    case 0x1c:
+        /* the size of the data is in the header */
+        shift = rnd(3);
+        putRnd(p+1, 3);
+        p[4] = (unsigned char)shift;
+        putRnd(p+5, 128<<shift);
+        n = 5+(128<<shift);
+        *out += 16*(n+200);
+        break;
+    case 0x1d:
+        p[1] = (unsigned char)rnd(20);
+        putRnd(p+2, 512);
+        n = 514;
+        *out += 16*(n+200);
+        break;
+    case 0x20:
+        putRnd(p+1, 20);
+        n = 21;
+        *out += 1000;
+        break;
+    case 0x21:
+        putRnd(p+1, 4);
+        n = 5;
+        *out += 1000;
+        break;
+    case 0x22:
+        p[1] = (unsigned char)rnd(11);
+        p[2] = (unsigned char)rnd(12);
+        n = 3;
+        *out += 1000;
+        break;
+    case 0x23:
+        putRnd(p+1, 512);
+        n = 513;
+        *out += 16*600;
+        break;
+    case 0x26:
+        putRnd(p+1, 516);
+        n = 517;
+        *out += 16*700;
+        break;
+    case 0x27:
+        p[1] = (unsigned char)rnd(11);
+        p[2] = (unsigned char)rnd(12);
+        putRnd(p+3, 512);
+        n = 515;
+        *out += 16*700;
+        break;
+    }
+
+    return n;
+}
+
+
+/*
+ * describedTrack
+ *
+ * the bits, the syncs and the drops mixed, sometimes a sync just before the end
+ */
+int describedTrack(unsigned char *p, int big)
+{
+    static int codes[] = { 0x00, 0x01, 0x02, 0x03, 0x04, 0x04, 0x08, 0x09, 0x0a, 0x0c, 0x0c,
+        0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x1b, 0x1c, 0x1d,
+        0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27 };
+    int n, len, code;
+    long out;
+
+    /* encoding type, index offset */
+    p[0] = 1;
+    p[1] = p[2] = 0;
+    p[3] = (unsigned char)rnd(256);
+    len = 4;
+    out = 0;
+    /* the first sync needs a bit before it */
+    len += putCode(p+len, rnd(2), &out);
+    if (big)
+        len += putCode(p+len, 0x0b, &out);
+    for(;;) {
+        code = codes[rnd(sizeof(codes)/sizeof(int))];
+        if (code==0x04 && rnd(2)==0) {
+            /* s04 twice */
+            p[len++] = 0x04;
+            out++;
+        }
+        n = len;
+        len += putCode(p+len, code, &out);
+        if (len>SRCMAX || out>OUTMAX) {
+            len = n;
+            break;
+        }
+    }
+    if (rnd(3)==0)
+        p[len++] = 0x04;
+    p[len++] = 0xff;
+
+    return len;
+}
+
+
+/*
+ * makeImage
+ *
+ */
+void makeImage(char *name)
+{
+    FILE *f;
+    int i, j, n;
+
+    memset(hdr, 0, 512);
+    strcpy((char*)hdr, "Formatted Disk Image file");
+    hdr[140] = 1;
+    hdr[141] = 0;
+    hdr[142] = 0;
+    hdr[143] = NBTRACK/2-1;
+    hdr[144] = 1;
+    hdr[145] = 1;
+
+    for(i=0; i<NBTRACK; i++) {
+        memset(trk[i], 0, MAX_SRC_BUFFER);
+        switch(i) {
+        case 0: case 1:
+            /* amiga dd, first sector 3 */
+            hdr[152+i*2] = 1;
+            hdr[153+i*2] = (3<<4)|11;
+            putRnd(trk[i], 11*512);
+            trkLen[i] = 11*512;
+            break;
+        case 2:
+            /* amiga hd */
+            hdr[152+i*2] = 2;
+            hdr[153+i*2] = 44;
+            putRnd(trk[i], 22*512);
+            trkLen[i] = 22*512;
+            break;
+        case 3: case 4:
+            /* atari st 9, pc 9 */
+            hdr[152+i*2] = i==3 ? 3 : 6;
+            hdr[153+i*2] = 18;
+            putRnd(trk[i], 9*512);
+            trkLen[i] = 9*512;
+            break;
+        case 5:
+            /* raw */
+            hdr[152+i*2] = 0xf2;
+            n = 100003;
+            trk[i][0] = 0; trk[i][1] = (unsigned char)(n>>16);
+            trk[i][2] = (unsigned char)(n>>8); trk[i][3] = (unsigned char)n;
+            putRnd(trk[i]+4, (n+7)/8);
+            trkLen[i] = 4+(n+7)/8;
+            hdr[153+i*2] = (unsigned char)(trkLen[i]/256+1);
+            break;
+        default:
+            hdr[152+i*2] = 0xe2;
+            trkLen[i] = describedTrack(trk[i], i%10==0);
+            hdr[153+i*2] = (unsigned char)(trkLen[i]/256+1);
+        }
+    }
+
+    f = fopen(name, "wb");
+    if (!f) {
+        fprintf(stderr, "can't create '%s'\n", name);
+        exit(1);
+    }
+    fwrite(hdr, 1, 512, f);
+    for(i=0; i<NBTRACK; i++) {
+        n = hdr[152+i*2]==1 ? (hdr[153+i*2]&15)*512 : hdr[153+i*2]*256;
+        for(j=0; j<n; j++)
+            putc(trk[i][j], f);
+    }
+    fclose(f);
+}
+
+
+/*
+ * main
+ *
+ */
+int main(int argc, char *argv[])
+{
+    FILE *f;
+    FDI *fdi, *ref;
+    unsigned char *p;
+    int i, track, len, refLen, nbErr, rc;
+    clock_t t0, t1, t2;
+
+    makeImage("newdev");
+
+    f = fopen("newdev", "rb");
+    if (!f) {
+        fprintf(stderr, "can't open 'newdev'\n");
+        return 1;
+    }
+    fdi = fdi2raw_header(f);
+    ref = ref_header(f);
+    if (!fdi || !ref) {
+        fprintf(stderr, "can't read the header\n");
+        return 1;
+    }
+    rc = fdi2raw_get_last_track(fdi)!=NBTRACK;
+    /* each track decoded */
+    fdi2raw_set_cache(fdi, 0);
+    ref_set_cache(ref, 0);
+
+    /* the bytes after the track too : 0 */
+    nbErr = 0;
+    for(i=0; i<NBTRACK; i++) {
+        p = ref_read_track(ref, i, &refLen);
+        memcpy(refBuf, p, MAX_DST_BUFFER);
+        p = fdi2raw_read_track(fdi, i, &len);
+        memcpy(out[i], p, MAX_DST_BUFFER);
+        outLen[i] = len;
+        outRate[i] = fdi2raw_get_bit_rate(fdi);
+        /* 22 sectors : too many sync bits for the old sync buffer */
+        if (i==2) {
+            rc |= refLen!=-1 || len<=0;
+            continue;
+        }
+        if (refLen<0)
+            nbErr++;
+        if (len!=refLen || memcmp(refBuf, p, MAX_DST_BUFFER)!=0) {
+            fprintf(stderr, "track %d : %d bits, %d expected\n", i, len, refLen);
+            rc = 1;
+        }
+    }
+
+    t0 = clock();
+    for(i=0; i<NBLOOP*NBTRACK; i++)
+        ref_read_track(ref, i%NBTRACK, &len);
+    t1 = clock();
+    for(i=0; i<NBLOOP*NBTRACK; i++)
+        fdi2raw_read_track(fdi, i%NBTRACK, &len);
+    t2 = clock();
+    printf("%d tracks, %d in error : bit %ld ms, word %ld ms\n", NBTRACK, nbErr,
+        (long)((t1-t0)*1000/CLOCKS_PER_SEC), (long)((t2-t1)*1000/CLOCKS_PER_SEC));
+
+    /* random reads, mostly among a few tracks, with and without the cache */
+    t0 = clock();
+    for(i=0; i<NBRANDOM; i++)
+        fdi2raw_read_track(fdi, rnd(4)!=0 ? rnd(NBCACHE) : rnd(NBTRACK), &len);
+    t1 = clock();
+    fdi2raw_set_cache(fdi, NBCACHE);
+    for(i=0; i<NBRANDOM; i++) {
+        track = rnd(4)!=0 ? rnd(NBCACHE) : rnd(NBTRACK);
+        p = fdi2raw_read_track(fdi, track, &len);
+        if (len!=outLen[track] || memcmp(out[track], p, MAX_DST_BUFFER)!=0
+            || fdi2raw_get_bit_rate(fdi)!=outRate[track]) {
+            fprintf(stderr, "cached track %d : %d bits, %d expected\n", track, len, outLen[track]);
+            rc = 1;
+            break;
+        }
+    }
+    t2 = clock();
+    printf("%d random reads : %ld ms, cache of %d tracks %ld ms\n", NBRANDOM,
+        (long)((t1-t0)*1000/CLOCKS_PER_SEC), NBCACHE, (long)((t2-t1)*1000/CLOCKS_PER_SEC));
+
+    fdi2raw_header_free(fdi);
+    free(fdi);
+    ref_header_free(ref);
+    free(ref);
+    fclose(f);
+
+    return rc;
+}
@@ -78,3 +78,62 @@ undel3 testofs_adf
 diff moon_gif $CHECK/MOON.GIF
 rm moon_gif testofs_adf
 echo "-----"
+
+carve
+rm newdev
+echo "-----"
+
+dircache
+rm newdev
+echo "-----"
+
+dir_tree
+rm newdev
+echo "-----"
+
+dir_iter
+rm newdev
+echo "-----"
+
+block_io
+rm newdev
+echo "-----"
+
+aio_read
+rm newdev newdev2
+echo "-----"
+
+session
+rm newdev
+echo "-----"
+
+create_ent
+rm newdev
+echo "-----"
+build_img
+rm newdev newdev2
+echo "-----"
+defrag
+rm newdev newdev2
+echo "-----"
+
+fdi_mfm
+rm newdev
+echo "-----"
+fdi_adf
+rm newdev newdev2
+echo "-----"
+mfm_dec
+echo "-----"
+ext_adf
+rm newdev newdev2
+echo "-----"
+
+dms_heavy
+echo "-----"
+dms_lz
+echo "-----"
+dms_deep
+echo "-----"
+dms_pack
+echo "-----"
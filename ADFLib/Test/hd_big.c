@@ -0,0 +1,123 @@
+/*
+ *  hd_big.c
+ *
+ *  a sparse 6GB dump with two partitions, the second one beyond 4GB
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include"adflib.h"
+
+
+#define CYLINDERS   12483
+#define HEADS       16
+#define SECTORS     63
+
+#define FILESIZE    100000
+
+
+/*
+ *
+ *
+ */
+int main(int argc, char *argv[])
+{
+    struct Device *hd;
+    struct Volume *vol;
+    struct File *fic;
+    struct Partition part1, part2;
+    struct Partition *partList[2];
+    unsigned char *buf, *buf2;
+    ADFOFF size;
+    long i, n;
+    int rc;
+
+    adfEnvInitDefault();
+
+    buf = (unsigned char*)malloc(FILESIZE);
+    buf2 = (unsigned char*)malloc(FILESIZE);
+    if (!buf || !buf2) exit(1);
+    for(i=0; i<FILESIZE; i++)
+        buf[i] = (unsigned char)(i*7+i/251);
+
+    hd = adfCreateDumpDevice("newdev", CYLINDERS, HEADS, SECTORS);
+    if (!hd) {
+        fprintf(stderr, "can't mount device\n");
+        adfEnvCleanUp(); exit(1);
+    }
+
+    part1.startCyl = 2;
+    part1.lenCyl = 7000;
+    part1.volName = "small";
+    part1.volType = FSMASK_FFS;
+    part2.startCyl = 7002;
+    part2.lenCyl = CYLINDERS-7002;
+    part2.volName = "big";
+    part2.volType = FSMASK_FFS|FSMASK_DIRCACHE;
+    partList[0] = &part1;
+    partList[1] = &part2;
+    if (adfCreateHd(hd, 2, partList)!=RC_OK) {
+        fprintf(stderr, "can't create the partitions\n");
+        adfUnMountDev(hd);
+        adfEnvCleanUp(); exit(1);
+    }
+    adfUnMountDev(hd);
+
+    /* write on both partitions */
+    hd = adfMountDev("newdev", FALSE);
+    if (!hd) {
+        fprintf(stderr, "can't mount device\n");
+        adfEnvCleanUp(); exit(1);
+    }
+    size = (ADFOFF)CYLINDERS*HEADS*SECTORS*512;
+    printf("device size : %.0f, expected %.0f\n", (double)hd->size, (double)size);
+    rc = hd->size!=size || hd->nVol!=2;
+
+    for(n=0; n<hd->nVol && !rc; n++) {
+        vol = adfMount(hd, n, FALSE);
+        if (!vol) {
+            rc = 1;
+            break;
+        }
+        fic = adfOpenFile(vol, "file", "w");
+        adfWriteFile(fic, FILESIZE, buf);
+        adfCloseFile(fic);
+        printf("partition %ld : %s, blocks %ld to %ld, root at %.0f bytes\n", n,
+            vol->volName, vol->firstBlock, vol->lastBlock,
+            (double)((ADFOFF)(vol->firstBlock+vol->rootBlock)*512));
+        adfUnMount(vol);
+    }
+    adfUnMountDev(hd);
+
+    /* read them back */
+    hd = adfMountDev("newdev", TRUE);
+    if (!hd) {
+        fprintf(stderr, "can't mount device\n");
+        adfEnvCleanUp(); exit(1);
+    }
+    for(n=0; n<hd->nVol && !rc; n++) {
+        vol = adfMount(hd, n, TRUE);
+        if (!vol) {
+            rc = 1;
+            break;
+        }
+        memset(buf2, 0, FILESIZE);
+        fic = adfOpenFile(vol, "file", "r");
+        rc = !fic || adfReadFile(fic, FILESIZE, buf2)!=FILESIZE
+            || memcmp(buf, buf2, FILESIZE)!=0;
+        if (fic)
+            adfCloseFile(fic);
+        printf("partition %ld : %s\n", n, rc ? "different" : "same");
+        adfUnMount(vol);
+    }
+    adfUnMountDev(hd);
+
+    free(buf); free(buf2);
+
+    adfEnvCleanUp();
+
+    return rc;
+}
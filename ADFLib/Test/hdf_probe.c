@@ -0,0 +1,153 @@
+/*
+ *  hdf_probe.c
+ *
+ *  rootblock discovery of hardfiles with odd sizes
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include"adflib.h"
+
+
+/*
+ * makeHdf
+ *
+ * a hardfile of 'nbSect' sectors, with one file
+ */
+long makeHdf(long nbSect)
+{
+    struct Device *hd;
+    struct Volume *vol;
+    struct File *fic;
+    unsigned char buf[1500];
+    long nFree;
+
+    hd = adfCreateDumpDevice("newdev", nbSect, 1, 1);
+    if (!hd)
+        return -1;
+    adfCreateHdFile( hd, "probe", FSMASK_FFS );
+    vol = adfMount(hd, 0, FALSE);
+    if (!vol) {
+        adfUnMountDev(hd);
+        return -1;
+    }
+    memset(buf, 'p', 1500);
+    fic = adfOpenFile(vol, "file", "w");
+    adfWriteFile(fic, 1500, buf);
+    adfCloseFile(fic);
+    nFree = adfCountFreeBlocks(vol);
+    adfUnMount(vol);
+    adfUnMountDev(hd);
+
+    return nFree;
+}
+
+
+/*
+ * appendHdf
+ *
+ * adds 'len' bytes at the end of the file. with 'fakeAt', the sector 'fakeAt'
+ * looks like a rootblock but has a wrong checksum
+ */
+void appendHdf(long len, long fakeAt)
+{
+    FILE *fd;
+    unsigned char sect[512];
+    long i;
+
+    fd = fopen("newdev", "ab");
+    memset(sect, 0, 512);
+    for(i=0; i<len/512; i++)
+        fwrite(sect, 1, 512, fd);
+    fwrite(sect, 1, len%512, fd);
+    fclose(fd);
+
+    if (fakeAt>0) {
+        sect[3] = 2;                    /* T_HEADER */
+        sect[511] = 1;                  /* ST_ROOT */
+        sect[23] = 0x55;                /* checksum */
+        fd = fopen("newdev", "r+b");
+        fseek(fd, 512*fakeAt, SEEK_SET);
+        fwrite(sect, 1, 512, fd);
+        fclose(fd);
+    }
+}
+
+
+/*
+ * checkHdf
+ *
+ */
+int checkHdf(char *title, long nFree, long root, long last)
+{
+    struct Device *hd;
+    struct Volume *vol;
+    struct List *list;
+    int rc;
+
+    hd = adfMountDev("newdev", TRUE);
+    if (!hd) {
+        printf("%-28s : can't mount device\n", title);
+        return 1;
+    }
+    vol = adfMount(hd, 0, TRUE);
+    if (!vol) {
+        printf("%-28s : can't mount volume\n", title);
+        adfUnMountDev(hd);
+        return 1;
+    }
+    list = adfGetDirEnt(vol, vol->curDirPtr);
+    rc = list==NULL || strcmp(((struct Entry*)list->content)->name, "file")!=0;
+    adfFreeDirList(list);
+
+    printf("%-28s : root=%ld last=%ld free=%ld\n", title, vol->rootBlock,
+        vol->lastBlock, adfCountFreeBlocks(vol));
+    rc = rc || vol->rootBlock!=root || vol->lastBlock!=last
+        || adfCountFreeBlocks(vol)!=nFree;
+
+    adfUnMount(vol);
+    adfUnMountDev(hd);
+
+    return rc;
+}
+
+
+/*
+ *
+ *
+ */
+int main(int argc, char *argv[])
+{
+    long nFree;
+    int rc;
+
+    adfEnvInitDefault();
+
+    rc = 0;
+
+    nFree = makeHdf(4000);
+    rc |= checkHdf("even size", nFree, 2000, 3999);
+    rc |= checkHdf("even size, remembered", nFree, 2000, 3999);
+
+    nFree = makeHdf(4001);
+    rc |= checkHdf("odd size", nFree, 2000, 4000);
+
+    appendHdf(300, -1);
+    rc |= checkHdf("incomplete last sector", nFree, 2000, 4000);
+
+    /* the volume is smaller than the file, a fake rootblock in the padding */
+    nFree = makeHdf(4000);
+    appendHdf(512*6000, 4800);
+    rc |= checkHdf("padded, fake rootblock", nFree, 2000, 3999);
+
+    nFree = makeHdf(6666);
+    appendHdf(512*17+100, -1);
+    rc |= checkHdf("padded, odd size", nFree, 3333, 6665);
+
+    adfEnvCleanUp();
+
+    return rc;
+}
@@ -0,0 +1,136 @@
+/*
+ *  mfm_dec.c
+ *
+ *  adfMfmDecode : each kernel against a decoder bit by bit, at every
+ *  bit of a byte, then the MB/s of MFM decoded as sectors
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "adflib.h"
+
+
+#define MFMSIZE     4096
+#define NBSECT      20000
+
+
+unsigned char mfm[MFMSIZE+1];
+unsigned char data[MFMSIZE/2+16], ref[MFMSIZE/2];
+unsigned long seed = 1;
+char *kernels[] = { "any", "scalar", "sse2", "avx2" };
+
+
+/*
+ * rnd
+ *
+ */
+int rnd(int n)
+{
+    seed = seed*1103515245+12345;
+    return (int)((seed>>16)%n);
+}
+
+
+/*
+ * bit
+ *
+ */
+int bit(unsigned char *p, long n)
+{
+    return (p[n/8]>>(7-n%8))&1;
+}
+
+
+/*
+ * refDecode
+ *
+ * the data bits are the odd bits of the longs : bit 1 of each pair
+ */
+unsigned long refDecode(unsigned char *p, int shift, unsigned char *out, int len)
+{
+    unsigned long chk, l;
+    long i, j;
+    int o, e;
+
+    memset(out, 0, len);
+    for(i=0; i<len*8; i++) {
+        o = bit(p, (long)shift+(i/2)*2+1);
+        e = bit(p, (long)shift+len*8+(i/2)*2+1);
+        if ((i%2==0 ? o : e))
+            out[i/8] |= (unsigned char)(0x80>>(i%8));
+    }
+
+    chk = 0;
+    for(i=0; i<len*2; i+=4) {
+        l = 0;
+        for(j=0; j<32; j++)
+            l = (l<<1) | bit(p, (long)shift+i*8+j);
+        chk ^= l;
+    }
+
+    return chk&0x55555555L;
+}
+
+
+/*
+ * main
+ *
+ */
+int main(int argc, char *argv[])
+{
+    static int lens[] = { 4, 8, 16, 20, 28, 32, 36, 60, 64, 100, 512, 516, 2048 };
+    unsigned long chk, rchk;
+    int k, used, i, j, shift, l, len, rc, nbTest;
+    clock_t t0;
+    double s;
+
+    rc = 0;
+    for(k=MFM_SCALAR; k<=MFM_AVX2; k++) {
+        used = adfMfmKernel(k);
+        if (used==-1) {
+            printf("%-6s : not available\n", kernels[k]);
+            continue;
+        }
+        rc |= used!=k;
+
+        nbTest = 0;
+        for(i=0; i<200; i++) {
+            for(l=0; l<(int)(sizeof(lens)/sizeof(int)); l++) {
+                len = lens[l];
+                for(shift=0; shift<8; shift++) {
+                    for(j=0; j<2*len+1; j++)
+                        mfm[j] = (unsigned char)rnd(256);
+                    memset(data, 0xaa, len+16);
+                    chk = adfMfmDecode(mfm, shift, data, len);
+                    rchk = refDecode(mfm, shift, ref, len);
+                    if (chk!=rchk || memcmp(data, ref, len)!=0 || data[len]!=0xaa) {
+                        fprintf(stderr, "%s : len %d shift %d wrong\n", kernels[k], len, shift);
+                        rc = 1;
+                    }
+                    nbTest++;
+                }
+            }
+        }
+
+        /* sectors : 1024 bytes of data, aligned or not */
+        for(i=0; i<MFMSIZE; i++)
+            mfm[i] = (unsigned char)rnd(256);
+        for(shift=0; shift<=3; shift+=3) {
+            t0 = clock();
+            for(i=0; i<NBSECT; i++)
+                adfMfmDecode(mfm+(i%3)*1024, shift, data, 512);
+            s = (double)(clock()-t0)/CLOCKS_PER_SEC;
+            printf("%-6s : %d fields, shift %d : %.0f MB/s\n", kernels[k], nbTest, shift,
+                s>0 ? NBSECT*1024.0/s/1e6 : 0.0);
+        }
+    }
+
+    /* back to the default */
+    rc |= adfMfmKernel(MFM_ANY)==-1;
+
+    return rc;
+}
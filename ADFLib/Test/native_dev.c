@@ -0,0 +1,145 @@
+/*
+ *  native_dev.c
+ *
+ *  image files mounted with the native driver ("|name") : RDB disk,
+ *  hardfile and floppy
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include"adflib.h"
+
+
+#define FILESIZE    70000
+
+
+unsigned char buf[FILESIZE], buf2[FILESIZE];
+
+
+/*
+ * copyFile
+ *
+ * writes 'name' on the partition 'nPart' of 'devName', or checks it
+ */
+int copyFile(char *devName, int nPart, char *name, BOOL write)
+{
+    struct Device *dev;
+    struct Volume *vol;
+    struct File *fic;
+    int rc;
+
+    dev = adfMountDev(devName, !write);
+    if (!dev)
+        return 1;
+    vol = adfMount(dev, nPart, !write);
+    if (!vol) {
+        adfUnMountDev(dev);
+        return 1;
+    }
+    fic = adfOpenFile(vol, name, write ? "w" : "r");
+    if (!fic)
+        rc = 1;
+    else if (write)
+        rc = adfWriteFile(fic, FILESIZE, buf)!=FILESIZE;
+    else {
+        memset(buf2, 0, FILESIZE);
+        rc = adfReadFile(fic, FILESIZE, buf2)!=FILESIZE || memcmp(buf, buf2, FILESIZE)!=0;
+    }
+    if (fic)
+        adfCloseFile(fic);
+    adfUnMount(vol);
+    adfUnMountDev(dev);
+
+    return rc;
+}
+
+
+/*
+ * checkDevice
+ *
+ * the native mount sees what the dump mount wrote and the other way round
+ */
+int checkDevice(char *title, int nPart)
+{
+    struct Device *dump, *native;
+    int rc;
+
+    dump = adfMountDev("newdev", TRUE);
+    native = adfMountDev("|newdev", TRUE);
+    rc = !dump || !native || !native->isNativeDev || native->size!=dump->size
+        || native->nVol!=dump->nVol || native->devType!=dump->devType;
+    if (dump) adfUnMountDev(dump);
+    if (native) adfUnMountDev(native);
+
+    rc |= copyFile("newdev", nPart, "dump", TRUE);
+    rc |= copyFile("|newdev", nPart, "dump", FALSE);
+    rc |= copyFile("|newdev", nPart, "native", TRUE);
+    rc |= copyFile("newdev", nPart, "native", FALSE);
+
+    printf("%-10s : %s\n", title, rc ? "error" : "ok");
+
+    return rc;
+}
+
+
+/*
+ *
+ *
+ */
+int main(int argc, char *argv[])
+{
+    struct Device *dev;
+    struct Volume *vol;
+    struct Partition part;
+    struct Partition *partList[1];
+    long i;
+    int rc;
+
+    adfEnvInitDefault();
+
+    for(i=0; i<FILESIZE; i++)
+        buf[i] = (unsigned char)(i*3+i/1021);
+
+    rc = 0;
+
+    /* RDB disk */
+    dev = adfCreateDumpDevice("newdev", 2891, 1, 68);
+    if (!dev) {
+        fprintf(stderr, "can't mount device\n");
+        adfEnvCleanUp(); exit(1);
+    }
+    part.startCyl = 2;
+    part.lenCyl = 2889;
+    part.volName = "rdb";
+    part.volType = FSMASK_FFS|FSMASK_DIRCACHE;
+    partList[0] = &part;
+    adfCreateHd(dev, 1, partList);
+    adfUnMountDev(dev);
+    rc |= checkDevice("RDB disk", 0);
+
+    /* hardfile */
+    dev = adfCreateDumpDevice("newdev", 5000, 1, 1);
+    adfCreateHdFile(dev, "hdf", FSMASK_FFS);
+    adfUnMountDev(dev);
+    rc |= checkDevice("hardfile", 0);
+
+    /* floppy */
+    dev = adfCreateDumpDevice("newdev", 80, 2, 11);
+    adfCreateFlop(dev, "flop", 0);
+    adfUnMountDev(dev);
+    rc |= checkDevice("floppy", 0);
+
+    /* read only */
+    dev = adfMountDev("|newdev", TRUE);
+    vol = adfMount(dev, 0, FALSE);
+    rc |= adfWriteBlock(vol, 100, buf)==RC_OK;
+    adfUnMount(vol);
+    adfUnMountDev(dev);
+
+    adfEnvCleanUp();
+
+    return rc;
+}
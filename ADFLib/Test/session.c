@@ -0,0 +1,213 @@
+/*
+ *  session.c
+ *
+ *  many small files written with and without a session : the same volume,
+ *  and far fewer writes of the metadata blocks
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include"adflib.h"
+
+
+#define NBFILES     300
+#define FILESIZE    700
+
+
+long writes[1760];
+unsigned char buf[FILESIZE];
+
+
+/*
+ * countWrites
+ *
+ * counts the writes of each block
+ */
+void countWrites(SECTNUM physical, SECTNUM logical, BOOL write)
+{
+    if (write && logical>=0 && logical<1760)
+        writes[logical]++;
+}
+
+
+/*
+ * fileData
+ *
+ */
+void fileData(int i, unsigned char *data)
+{
+    int j;
+
+    for(j=0; j<FILESIZE; j++)
+        data[j] = (unsigned char)(i*31+j);
+}
+
+
+/*
+ * fill
+ *
+ * writes the files, removes one out of three, then renames and writes again
+ */
+void fill(struct Volume *vol)
+{
+    struct File *fic;
+    char name[MAXNAMELEN+1], newName[MAXNAMELEN+1];
+    int i;
+
+    adfCreateDir(vol, vol->rootBlock, "dir");
+    adfChangeDir(vol, "dir");
+    for(i=0; i<NBFILES; i++) {
+        sprintf(name, "file%d", i);
+        fileData(i, buf);
+        fic = adfOpenFile(vol, name, "w");
+        adfWriteFile(fic, FILESIZE, buf);
+        adfCloseFile(fic);
+    }
+    for(i=0; i<NBFILES; i+=3) {
+        sprintf(name, "file%d", i);
+        adfRemoveEntry(vol, vol->curDirPtr, name);
+    }
+    for(i=1; i<NBFILES; i+=3) {
+        sprintf(name, "file%d", i);
+        sprintf(newName, "moved%d", i);
+        adfRenameEntry(vol, vol->curDirPtr, name, vol->curDirPtr, newName);
+    }
+    for(i=NBFILES; i<NBFILES+NBFILES/3; i++) {
+        sprintf(name, "file%d", i);
+        fileData(i, buf);
+        fic = adfOpenFile(vol, name, "w");
+        adfWriteFile(fic, FILESIZE, buf);
+        adfCloseFile(fic);
+    }
+}
+
+
+/*
+ * check
+ *
+ * reads every file back. returns the number of wrong ones
+ */
+int check(struct Volume *vol)
+{
+    struct File *fic;
+    unsigned char data[FILESIZE], ref[FILESIZE];
+    char name[MAXNAMELEN+1];
+    int i, bad;
+
+    bad = 0;
+    adfToRootDir(vol);
+    if (adfChangeDir(vol, "dir")!=RC_OK)
+        return NBFILES;
+    for(i=0; i<NBFILES+NBFILES/3; i++) {
+        if (i<NBFILES && i%3==0)
+            continue;
+        if (i<NBFILES && i%3==1)
+            sprintf(name, "moved%d", i);
+        else
+            sprintf(name, "file%d", i);
+        fileData(i, ref);
+        fic = adfOpenFile(vol, name, "r");
+        if (!fic) {
+            bad++;
+            continue;
+        }
+        if (adfReadFile(fic, FILESIZE, data)!=FILESIZE || memcmp(data, ref, FILESIZE)!=0)
+            bad++;
+        adfCloseFile(fic);
+    }
+    if (adfOpenFile(vol, "file0", "r")!=NULL)
+        bad++;
+
+    return bad;
+}
+
+
+/*
+ * run
+ *
+ */
+int run(int volType, BOOL session, char *title)
+{
+    struct Device *flop;
+    struct Volume *vol;
+    long i, total, most;
+    int bad, rc;
+    BOOL true = TRUE;
+
+    flop = adfCreateDumpDevice("newdev", 80, 2, 11);
+    if (!flop) {
+        fprintf(stderr, "can't mount device\n");
+        return 1;
+    }
+    adfCreateFlop(flop, "session", volType);
+    vol = adfMount(flop, 0, FALSE);
+    if (!vol) {
+        adfUnMountDev(flop);
+        fprintf(stderr, "can't mount volume\n");
+        return 1;
+    }
+
+    memset(writes, 0, sizeof(writes));
+    adfChgEnvProp(PR_USE_RWACCESS, &true);
+    rc = 0;
+    if (session)
+        rc |= adfBeginSession(vol)!=RC_OK;
+    fill(vol);
+    /* the library reads its own changes during the session */
+    bad = check(vol);
+    if (session)
+        rc |= adfCommitSession(vol)!=RC_OK;
+    true = FALSE;
+    adfChgEnvProp(PR_USE_RWACCESS, &true);
+
+    total = most = 0;
+    for(i=0; i<1760; i++) {
+        total += writes[i];
+        if (writes[i]>most)
+            most = writes[i];
+    }
+    adfUnMount(vol);
+    adfUnMountDev(flop);
+
+    /* on the disk */
+    flop = adfMountDev("newdev", TRUE);
+    vol = adfMount(flop, 0, TRUE);
+    bad += check(vol);
+    adfUnMount(vol);
+    adfUnMountDev(flop);
+
+    printf("%-20s : %5ld block writes, at most %4ld for one block, %d bad files\n",
+        title, total, most, bad);
+
+    return rc || bad!=0;
+}
+
+
+/*
+ *
+ *
+ */
+int main(int argc, char *argv[])
+{
+    BOOL true = TRUE;
+    int rc;
+
+    adfEnvInitDefault();
+    adfChgEnvProp(PR_RWACCESS, countWrites);
+
+    rc = 0;
+    rc |= run(FSMASK_FFS, FALSE, "FFS");
+    rc |= run(FSMASK_FFS, TRUE, "FFS, session");
+    rc |= run(0, FALSE, "OFS");
+    rc |= run(0, TRUE, "OFS, session");
+    adfChgEnvProp(PR_USEDIRC, &true);
+    rc |= run(FSMASK_FFS|FSMASK_DIRCACHE, FALSE, "DIRCACHE");
+    rc |= run(FSMASK_FFS|FSMASK_DIRCACHE, TRUE, "DIRCACHE, session");
+
+    adfEnvCleanUp();
+
+    return rc;
+}
@@ -89,6 +89,14 @@ LINK32=link.exe
 # Name "dynlib - Win32 Debug"
 # Begin Source File
 
+SOURCE=.\Lib\adf_aio.c
+# End Source File
+# Begin Source File
+
+SOURCE=.\Lib\adf_aio.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\Lib\adf_bitm.c
 # End Source File
 # Begin Source File
@@ -101,6 +109,14 @@ SOURCE=.\Lib\adf_blk.h
 # End Source File
 # Begin Source File
 
+SOURCE=.\Lib\adf_build.c
+# End Source File
+# Begin Source File
+
+SOURCE=.\Lib\adf_build.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\Lib\adf_cache.c
 # End Source File
 # Begin Source File
@@ -113,6 +129,14 @@ SOURCE=.\Lib\adf_defs.h
 # End Source File
 # Begin Source File
 
+SOURCE=.\Lib\adf_defrag.c
+# End Source File
+# Begin Source File
+
+SOURCE=.\Lib\adf_defrag.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\Lib\adf_dir.c
 # End Source File
 # Begin Source File
@@ -149,6 +173,14 @@ SOURCE=.\Lib\adf_err.h
 # End Source File
 # Begin Source File
 
+SOURCE=.\Lib\adf_ext.c
+# End Source File
+# Begin Source File
+
+SOURCE=.\Lib\adf_ext.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\Lib\adf_file.c
 # End Source File
 # Begin Source File
@@ -169,10 +201,18 @@ SOURCE=.\Lib\adf_link.c
 # End Source File
 # Begin Source File
 
+SOURCE=.\Lib\adf_mfm.c
+# End Source File
+# Begin Source File
+
 SOURCE=.\Lib\adf_link.h
 # End Source File
 # Begin Source File
 
+SOURCE=.\Lib\adf_mfm.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\Lib\Win32\adf_nativ.c
 # End Source File
 # Begin Source File
@@ -60,6 +60,9 @@ extern char* adfGetVersionNumber(); /* this shouldn't be here */
 
 ENV_DECLARATION;
 
+/* bytes of file data read in memory for one adfCreateEntries() call */
+#define COPY_BATCH_SIZE	(4 * 1024 * 1024)
+
 /* function prototypes */
 LRESULT CALLBACK MainWinProc(HWND, UINT, WPARAM, LPARAM);
 BOOL CreateProc(HWND);
@@ -72,6 +75,8 @@ void CopyAmi2Win(char *, char *, struct Volume *, long);
 BOOL CopyAmiDir2Win(char *, char *, struct Volume *);
 void CopyWin2Ami(char *, char *, struct Volume *, long);
 BOOL CopyWinDir2Ami(char *, char *, struct Volume *);
+BOOL CopyWinDirContents2Ami(char *, struct Volume *);
+unsigned char *ReadWinFile(char *, long);
 void CopyWin2Win(char *, char *);
 BOOL CopyWinDir2Win(char *, char *, char *);
 void CopyAmi2Ami(char *, struct Volume *, struct Volume *, long);
@@ -1031,45 +1036,129 @@ BOOL CopyAmiDir2Win(char *srcDir, char *destPath, struct Volume *vol)
 }
 
 BOOL CopyWinDir2Ami(char *srcDir, char *srcPath, struct Volume *vol)
+{
+	BOOL rc;
+
+	adfCreateDir(vol, vol->curDirPtr, srcDir);
+	adfChangeDir(vol, srcDir);
+
+	rc = CopyWinDirContents2Ami(srcPath, vol);
+
+	adfParentDir(vol);
+
+	return rc;
+}
+
+/* reads a whole windows file into memory, for adfCreateEntries() */
+unsigned char *ReadWinFile(char *srcPath, long fileSize)
+{
+	HANDLE winFile;
+	unsigned char *data;
+	DWORD act;
+
+	data = malloc(fileSize > 0 ? fileSize : 1);
+	if (data == NULL)
+		return NULL;
+
+	winFile = CreateFile(srcPath, GENERIC_READ, 0, NULL, OPEN_EXISTING, 0, NULL);
+	if (winFile == INVALID_HANDLE_VALUE) {
+		free(data);
+		return NULL;
+	}
+	if (fileSize > 0 && (!ReadFile(winFile, data, fileSize, &act, NULL) || act != (DWORD)fileSize)) {
+		CloseHandle(winFile);
+		free(data);
+		return NULL;
+	}
+	CloseHandle(winFile);
+
+	return data;
+}
+
+/* the files and subdirectories of one level are created with one adfCreateEntries() call,
+   large files and long names are copied one by one */
+BOOL CopyWinDirContents2Ami(char *srcPath, struct Volume *vol)
 {
 	WIN32_FIND_DATA wfd;
 	HANDLE search;
-	char curPath[MAX_PATH * 2];
 	char searchPath[MAX_PATH * 2];
 	char subdir[MAX_PATH * 2];
+	struct NewEntry *ents = NULL, *tmp;
+	int nbEnts = 0, maxEnts = 0, i;
+	long batchSize = 0;
+	RETCODE rc;
 
-	strcpy(curPath, srcPath);
-	sprintf(searchPath, "%s\\*", curPath);
-
-	adfCreateDir(vol, vol->curDirPtr, srcDir);
-	adfChangeDir(vol, srcDir);
+	sprintf(searchPath, "%s\\*", srcPath);
 
 	search = FindFirstFile(searchPath, &wfd);
 	if (search == INVALID_HANDLE_VALUE)
 		return FALSE;
 
 	do {
-		/* if current entry is a dir, and isn't the current or parent dir, then copy it */
-		if (wfd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
-			if ( !((wfd.cFileName[1] == 0) && (wfd.cFileName[0] == '.')) )
-				if ( !((wfd.cFileName[2] == 0) && (wfd.cFileName[1] == '.') && (wfd.cFileName[0] == '.')) ) {
-					sprintf(subdir, "%s\\%s", curPath, wfd.cFileName);
-					CopyWinDir2Ami(wfd.cFileName, subdir, vol);
-					//RemoveDirectoryRecursive(subdir);
-				}
-		} else {
-			/* it's a file so just copy it */
-			sprintf(subdir, "%s\\%s", curPath, wfd.cFileName);
-			CopyWin2Ami(wfd.cFileName, subdir, vol, wfd.nFileSizeLow);
+		/* the current and parent dirs are skipped */
+		if ((wfd.cFileName[0] == '.') && ((wfd.cFileName[1] == 0) ||
+			((wfd.cFileName[1] == '.') && (wfd.cFileName[2] == 0))))
+			continue;
+
+		sprintf(subdir, "%s\\%s", srcPath, wfd.cFileName);
+		if ((strlen(wfd.cFileName) > MAXNAMELEN) ||
+			(!(wfd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) &&
+			(batchSize + (long)wfd.nFileSizeLow > COPY_BATCH_SIZE))) {
+			if (wfd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+				CopyWinDir2Ami(wfd.cFileName, subdir, vol);
+			else
+				CopyWin2Ami(wfd.cFileName, subdir, vol, wfd.nFileSizeLow);
+			continue;
 		}
 
+		if (nbEnts == maxEnts) {
+			maxEnts = maxEnts ? maxEnts * 2 : 64;
+			tmp = realloc(ents, maxEnts * sizeof(struct NewEntry));
+			if (tmp == NULL)
+				break;
+			ents = tmp;
+		}
+		memset(&ents[nbEnts], 0, sizeof(struct NewEntry));
+		ents[nbEnts].name = strdup(wfd.cFileName);
+		if (wfd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+			ents[nbEnts].type = ST_DIR;
+		else {
+			ents[nbEnts].type = ST_FILE;
+			ents[nbEnts].size = wfd.nFileSizeLow;
+			ents[nbEnts].data = ReadWinFile(subdir, wfd.nFileSizeLow);
+			if (ents[nbEnts].data == NULL) {
+				free(ents[nbEnts].name);
+				continue;
+			}
+			batchSize += wfd.nFileSizeLow;
+		}
+		if (ents[nbEnts].name != NULL)
+			nbEnts++;
 	} while (FindNextFile(search, &wfd));
 
 	FindClose(search);
 
-	adfParentDir(vol);
+	rc = adfCreateEntries(vol, vol->curDirPtr, ents, nbEnts);
+	if (rc == RC_VOLFULL)
+		MessageBox(ghwndFrame, "Could not copy directory. There is insufficient "
+			"free space on the destination volume.", "Error", MB_OK | MB_ICONERROR);
+	else if (rc != RC_OK)
+		MessageBox(ghwndFrame, "Could not copy directory.", "Error", MB_OK | MB_ICONERROR);
+
+	for (i = 0 ; i < nbEnts ; i++) {
+		/* then the subdirectories */
+		if ((rc == RC_OK) && (ents[i].type == ST_DIR)) {
+			sprintf(subdir, "%s\\%s", srcPath, ents[i].name);
+			adfChangeDir(vol, ents[i].name);
+			CopyWinDirContents2Ami(subdir, vol);
+			adfParentDir(vol);
+		}
+		free(ents[i].name);
+		free(ents[i].data);
+	}
+	free(ents);
 
-	return TRUE;
+	return (rc == RC_OK);
 }
 
 BOOL CopyWinDir2Win(char *srcPath, char *destPath, char *dirName)
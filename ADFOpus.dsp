@@ -131,6 +131,10 @@ SOURCE=.\fdi.c
 # End Source File
 # Begin Source File
 
+SOURCE=.\fdi2adf.c
+# End Source File
+# Begin Source File
+
 SOURCE=.\fdi2raw.c
 # End Source File
 # Begin Source File
@@ -212,6 +216,10 @@ SOURCE=.\fdi.h
 # End Source File
 # Begin Source File
 
+SOURCE=.\fdi2adf.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\fdi2raw.h
 # End Source File
 # Begin Source File
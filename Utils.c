@@ -62,11 +62,11 @@ BOOL OpenDlg(HWND hwndOwner)
 	return res;
 }
 
-void SizeToStr(const long Size, char *strBuf)
+void SizeToStr(const ADFOFF Size, char *strBuf)
 /* converts a number to a string containing size in KB */
 {
 	char strTemp[40];
-	long lTemp = Size / 1024;
+	long lTemp = (long)(Size / 1024);
 
 	lTemp = lTemp > 0 ? lTemp : lTemp + 1;
 	itoa(lTemp, strTemp, 10);
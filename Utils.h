@@ -12,7 +12,7 @@
 
 void SizeToParent(HWND, HWND);
 BOOL OpenDlg(HWND);
-void SizeToStr(const long, char *);
+void SizeToStr(const ADFOFF, char *);
 void AddCommas(char *);
 void ResizeMDIClientWin();
 void SetMenuBitmaps(HINSTANCE, HMENU);
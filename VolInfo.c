@@ -226,11 +226,11 @@ void VolInfoInit(HWND dlg, HWND tc)
 	memcpy(tempStr, root.diskName, root.nameLen);
 	SetDlgItemText(pages[1], IDC_VOLLABEL, tempStr);
 
-	SizeToStr((ci->vol->lastBlock + 1 - ci->vol->firstBlock) * LOGICAL_BLOCK_SIZE, tempStr);
+	SizeToStr((ADFOFF)(ci->vol->lastBlock + 1 - ci->vol->firstBlock) * LOGICAL_BLOCK_SIZE, tempStr);
 	SetDlgItemText(pages[1], IDC_VOLTOTAL, tempStr);
-	SizeToStr(((ci->vol->lastBlock + 1 - ci->vol->firstBlock) - adfCountFreeBlocks(ci->vol)) * LOGICAL_BLOCK_SIZE, tempStr);
+	SizeToStr((ADFOFF)((ci->vol->lastBlock + 1 - ci->vol->firstBlock) - adfCountFreeBlocks(ci->vol)) * LOGICAL_BLOCK_SIZE, tempStr);
 	SetDlgItemText(pages[1], IDC_VOLUSED, tempStr);
-	SizeToStr((adfCountFreeBlocks(ci->vol)) * LOGICAL_BLOCK_SIZE, tempStr);
+	SizeToStr((ADFOFF)(adfCountFreeBlocks(ci->vol)) * LOGICAL_BLOCK_SIZE, tempStr);
 	SetDlgItemText(pages[1], IDC_VOLFREE, tempStr);
 	percent = (((ci->vol->lastBlock + 1 - ci->vol->firstBlock) -
 		adfCountFreeBlocks(ci->vol)) * 100) /
@@ -0,0 +1,304 @@
+/*
+
+  FDI to ADF
+
+  The Amiga sectors of the tracks decoded by fdi2raw.c, checked and put
+  in a dump, or mounted by ADFLib as a device in memory. The tracks are
+  decoded by several threads, each with its own FDI, the sectors by the
+  MFM kernels of ADFLib.
+
+  Same license as fdi2raw.c : GNU General Public License, version 2 or later.
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <process.h>
+#else
+#include <pthread.h>
+#endif
+
+#include "types.h"
+#include "fdi2raw.h"
+#include "fdi2adf.h"
+#include "adflib.h"
+
+/* info, label, header checksum, data checksum and data : odd and even longs */
+#define SECTOR_LONGS 270
+#define MAX_SECTORS 22
+/* the whole track table of an FDI header, and the 84 cylinders of a dump */
+#define MAX_FDI_TRACKS 180
+#define MAX_ADF_TRACKS 168
+/* size of the track buffer of fdi2raw.c */
+#define MAX_TRACK_BYTES 40000
+/* the start of the track copied after its end, for the sectors over the index */
+#define WRAP_BITS ((SECTOR_LONGS + 1) * 32)
+
+struct fdi2adf_job {
+	char *name;
+	int tracks;		/* in the FDI */
+	int heads;
+	uae_u8 *sec;		/* MAX_SECTORS sectors by dump track */
+	uae_u8 *status;		/* MAX_SECTORS by dump track */
+#ifdef _WIN32
+	LONG next;
+#else
+	int next;		/* next FDI track to decode */
+	pthread_mutex_t lock;
+#endif
+};
+
+static uae_u32 get_be (uae_u8 *p)
+{
+	return ((uae_u32)p[0] << 24) | ((uae_u32)p[1] << 16) | ((uae_u32)p[2] << 8) | p[3];
+}
+
+/* one sector after its syncs. 0 if it is not a sector of this track */
+static int decode_sector (uae_u8 *trk, int pos, int track, uae_u8 *sec, uae_u8 *status)
+{
+	uae_u8 *p = trk + (pos >> 3);
+	int shift = pos & 7;
+	uae_u8 info[4], label[16], chk[4];
+	uae_u32 sum;
+	int n;
+
+	/* format, track, sector, sectors until the gap */
+	sum = adfMfmDecode (p, shift, info, 4);
+	n = info[2];
+	if (info[1] != track || n >= MAX_SECTORS)
+		return 0;
+	sum ^= adfMfmDecode (p + 8, shift, label, 16);
+	adfMfmDecode (p + 40, shift, chk, 4);
+	if (sum != get_be (chk))
+		return 0;
+	if (status[n] == FDI2ADF_OK)
+		return 1;
+
+	adfMfmDecode (p + 48, shift, chk, 4);
+	sum = adfMfmDecode (p + 56, shift, sec + n * 512, 512);
+	status[n] = sum == get_be (chk) ? FDI2ADF_OK : FDI2ADF_BADDATA;
+	return 1;
+}
+
+/* the sectors of one track of len bits. trk is a buffer of MAX_TRACK_BYTES + WRAP_BITS / 8 + 8 bytes */
+static void decode_track (uae_u8 *trk, uae_u8 *raw, int len, int track, uae_u8 *sec, uae_u8 *status)
+{
+	int i, b, bytes, nbits;
+	uae_u32 w;
+
+	bytes = (len + 7) >> 3;
+	memcpy (trk, raw, bytes);
+	memset (trk + bytes, 0, WRAP_BITS / 8 + 8);
+	if (len & 7)
+		trk[bytes - 1] &= (uae_u8)(0xff << (8 - (len & 7)));
+	for (i = 0; i < WRAP_BITS; i++) {
+		b = i % len;
+		if (trk[b >> 3] & (0x80 >> (b & 7)))
+			trk[(len + i) >> 3] |= (uae_u8)(0x80 >> ((len + i) & 7));
+	}
+
+	/* two syncs starting in the track */
+	w = 0;
+	nbits = 0;
+	for (b = 0; b < len + 31; b++) {
+		w = ((w << 1) | ((trk[b >> 3] >> (7 - (b & 7))) & 1)) & 0xffffffff;
+		if (++nbits < 32 || w != 0x44894489)
+			continue;
+		if (decode_sector (trk, b + 1, track, sec, status)) {
+			b += SECTOR_LONGS * 32;
+			nbits = 0;
+		}
+	}
+}
+
+static int next_track (struct fdi2adf_job *job)
+{
+	int i;
+
+#ifdef _WIN32
+	i = (int)(InterlockedIncrement (&job->next) - 1);
+#else
+	pthread_mutex_lock (&job->lock);
+	i = job->next++;
+	pthread_mutex_unlock (&job->lock);
+#endif
+	return i;
+}
+
+/* run by each thread, until there is no track left */
+static void decode_tracks (struct fdi2adf_job *job, FDI *fdi)
+{
+	uae_u8 *trk, *raw;
+	int t, adft, len;
+
+	trk = (uae_u8 *)malloc (MAX_TRACK_BYTES + WRAP_BITS / 8 + 8);
+	if (!trk) return;
+	while ((t = next_track (job)) < job->tracks) {
+		/* the tracks of a single sided disk are the even ones of the dump */
+		adft = job->heads == 1 ? t * 2 : t;
+		if (adft >= MAX_ADF_TRACKS) continue;
+		raw = fdi2raw_read_track (fdi, t, &len);
+		if (len <= 0 || len > MAX_TRACK_BYTES * 8) continue;
+		decode_track (trk, raw, len, adft, job->sec + adft * MAX_SECTORS * 512,
+			job->status + adft * MAX_SECTORS);
+	}
+	free (trk);
+}
+
+/* the other threads read the file with their own FDI */
+static void decode_tracks_fdi (struct fdi2adf_job *job)
+{
+	FILE *f;
+	FDI *fdi;
+
+	f = fopen (job->name, "rb");
+	if (!f) return;
+	fdi = fdi2raw_header (f);
+	if (fdi) {
+		fdi2raw_set_cache (fdi, 0);
+		decode_tracks (job, fdi);
+		fdi2raw_header_free (fdi);
+		free (fdi);
+	}
+	fclose (f);
+}
+
+#ifdef _WIN32
+static unsigned __stdcall decode_thread (void *job)
+{
+	decode_tracks_fdi ((struct fdi2adf_job *)job);
+	return 0;
+}
+#else
+static void *decode_thread (void *job)
+{
+	decode_tracks_fdi ((struct fdi2adf_job *)job);
+	return NULL;
+}
+#endif
+
+/* the dump of an FDI file, malloc()ed. nthreads : 0 for FDI2ADF_THREADS */
+uae_u8 *fdi2adf_decode (char *name, int nthreads, struct fdi2adf_info *info)
+{
+	struct fdi2adf_job job;
+	FILE *f;
+	FDI *fdi;
+	uae_u8 *img;
+	int i, t, s, last, nstarted;
+#ifdef _WIN32
+	HANDLE threads[MAX_FDI_TRACKS];
+#else
+	pthread_t threads[MAX_FDI_TRACKS];
+#endif
+
+	memset (info, 0, sizeof (struct fdi2adf_info));
+	f = fopen (name, "rb");
+	if (!f) return NULL;
+	fdi = fdi2raw_header (f);
+	if (!fdi) {
+		fclose (f);
+		return NULL;
+	}
+	/* each track is decoded once */
+	fdi2raw_set_cache (fdi, 0);
+
+	memset (&job, 0, sizeof (job));
+	job.name = name;
+	job.tracks = fdi2raw_get_last_track (fdi);
+	job.heads = fdi2raw_get_last_head (fdi) + 1;
+	job.sec = (uae_u8 *)malloc (MAX_ADF_TRACKS * MAX_SECTORS * 512);
+	job.status = (uae_u8 *)calloc (MAX_ADF_TRACKS * MAX_SECTORS, 1);
+	img = NULL;
+	if (!job.sec || !job.status || job.tracks > MAX_FDI_TRACKS)
+		goto end;
+
+	/* the calling thread decodes tracks too, so it works with no thread started */
+	if (!nthreads) nthreads = FDI2ADF_THREADS;
+	if (nthreads > job.tracks) nthreads = job.tracks;
+	nstarted = 0;
+#ifdef _WIN32
+	while (nstarted < nthreads - 1) {
+		threads[nstarted] = (HANDLE)_beginthreadex (NULL, 0, decode_thread, &job, 0, NULL);
+		if (!threads[nstarted]) break;
+		nstarted++;
+	}
+	decode_tracks (&job, fdi);
+	for (i = 0; i < nstarted; i++) {
+		WaitForSingleObject (threads[i], INFINITE);
+		CloseHandle (threads[i]);
+	}
+#else
+	pthread_mutex_init (&job.lock, NULL);
+	while (nstarted < nthreads - 1) {
+		if (pthread_create (&threads[nstarted], NULL, decode_thread, &job) != 0) break;
+		nstarted++;
+	}
+	decode_tracks (&job, fdi);
+	for (i = 0; i < nstarted; i++) pthread_join (threads[i], NULL);
+	pthread_mutex_destroy (&job.lock);
+#endif
+
+	/* high density if a sector number needs it. 80 to 83 cylinders for a double density one */
+	info->sectors = 11;
+	last = 0;
+	for (i = 0; i < MAX_ADF_TRACKS * MAX_SECTORS; i++) {
+		if (job.status[i] == FDI2ADF_MISSING) continue;
+		if (i % MAX_SECTORS >= 11) info->sectors = 22;
+		last = i / MAX_SECTORS;
+	}
+	info->cylinders = last / 2 + 1;
+	if (info->cylinders < 80 || info->sectors == 22)
+		info->cylinders = 80;
+	if (info->cylinders > 83)
+		info->cylinders = 83;
+
+	img = (uae_u8 *)malloc (info->cylinders * 2 * info->sectors * 512);
+	info->status = (uae_u8 *)malloc (info->cylinders * 2 * info->sectors);
+	if (!img || !info->status) {
+		free (img);
+		free (info->status);
+		info->status = NULL;
+		img = NULL;
+		goto end;
+	}
+	for (t = 0; t < info->cylinders * 2; t++) {
+		for (s = 0; s < info->sectors; s++) {
+			i = t * info->sectors + s;
+			info->status[i] = job.status[t * MAX_SECTORS + s];
+			if (info->status[i] == FDI2ADF_MISSING)
+				memset (img + i * 512, 0, 512);
+			else
+				memcpy (img + i * 512, job.sec + (t * MAX_SECTORS + s) * 512, 512);
+			if (info->status[i] != FDI2ADF_OK)
+				info->bad++;
+		}
+	}
+
+end:
+	free (job.sec);
+	free (job.status);
+	fdi2raw_header_free (fdi);
+	free (fdi);
+	fclose (f);
+	return img;
+}
+
+/* the dump of an FDI file as an ADFLib device, freed by adfUnMountDev() */
+struct Device *fdi2adf_mount (char *name, int nthreads, struct fdi2adf_info *info)
+{
+	uae_u8 *img;
+
+	img = fdi2adf_decode (name, nthreads, info);
+	if (!img) return NULL;
+	return adfMountMemDev (img, (ADFOFF)info->cylinders * 2 * info->sectors * 512, FALSE);
+}
+
+void fdi2adf_free_info (struct fdi2adf_info *info)
+{
+	free (info->status);
+	info->status = NULL;
+}
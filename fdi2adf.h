@@ -0,0 +1,35 @@
+#ifndef __FDI2ADF_H
+#define __FDI2ADF_H
+
+#include "types.h"
+
+/* tracks decoded at once when the caller does not tell */
+#define FDI2ADF_THREADS 4
+
+/* status of a sector */
+#define FDI2ADF_MISSING 0	/* not found on the track */
+#define FDI2ADF_OK 1
+#define FDI2ADF_BADDATA 2	/* found, with a wrong data checksum */
+
+struct fdi2adf_info {
+	int cylinders;		/* 2 heads each */
+	int sectors;		/* by track, 11 or 22 */
+	int bad;		/* sectors missing or with a wrong checksum */
+	uae_u8 *status;		/* status of each sector, in block order */
+};
+
+struct Device;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern uae_u8 *fdi2adf_decode (char *name, int nthreads, struct fdi2adf_info *info);
+extern struct Device *fdi2adf_mount (char *name, int nthreads, struct fdi2adf_info *info);
+extern void fdi2adf_free_info (struct fdi2adf_info *info);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
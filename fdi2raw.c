@@ -30,6 +30,15 @@
 #include <stdlib.h>
 #include <string.h>
 
+#ifdef _WIN32
+#include <windows.h>
+#include <io.h>
+#define FDI2RAW_MAP
+#elif defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#define FDI2RAW_MAP
+#endif
+
 #include "types.h" /* remove if merged with UAE */
 #include "fdi2raw.h"
 
@@ -76,12 +85,25 @@ static char *datalog(uae_u8 *src, int len) { return ""; }
 #define MAX_SRC_BUFFER 20000
 #define MAX_DST_BUFFER 40000
 #define MAX_MFM_SYNC_BUFFER 60000
+/* decoded tracks kept by an FDI, unless fdi2raw_set_cache() tells */
+#define FDI2RAW_CACHE 16
+
+struct fdi_cache {
+	int track;		/* -1 if the entry is free */
+	int len;		/* bits, -1 if the track can't be decoded */
+	int bit_rate;
+	unsigned int last;	/* time of the last use */
+	uae_u8 *data;		/* (len + 7) / 8 bytes */
+};
 
 struct fdi {
 	uae_u8 *track_src_buffer;
+	int track_src_size;	/* MAX_SRC_BUFFER, or the largest track */
+	int track_src_dirty;	/* bytes of the previous track, the others are 0 */
 	uae_u8 *track_src;
 	int track_src_len;
 	uae_u8 *track_dst_buffer;
+	int track_dst_dirty;	/* bytes which may not be 0 */
 	uae_u8 *track_dst;
 	uae_u8 track_len;
 	uae_u8 track_type;
@@ -96,14 +118,33 @@ struct fdi {
 	uae_u8 header[512];
 	int track_offsets[181];
 	FILE *file;
+	/* the whole file, NULL if it is read track by track */
+	uae_u8 *map;
+	long map_size;
+#ifdef _WIN32
+	HANDLE map_handle;
+#endif
+	struct fdi_cache *cache;
+	int cache_size;
+	unsigned int cache_time;
 	int out;
+#ifdef FDI2RAW_BITWISE
 	int mfmsync_offset;
 	int *mfmsync_buffer;
+#endif
 	/* sector described only */
 	int index_offset;
 	int encoding_type;
+	uae_u16 ibm_crc;	/* crc of the IBM sector being encoded */
 	/* bit handling */
 	int nextdrop;
+#ifndef FDI2RAW_BITWISE
+	uae_u64 mfm_acc;	/* the last mfm_accbits bits, not in track_dst yet */
+	int mfm_accbits;
+	int mfm_pos;		/* position in track_dst of the first bit of mfm_acc */
+	int mfm_lastbit;	/* last bit put in mfm_acc */
+	int mfm_sync;		/* an mfm sync bit waits for the next bit */
+#endif
 };
 
 #define get_u32(x) ((((x)[0])<<24)|(((x)[1])<<16)|(((x)[2])<<8)|((x)[3]))
@@ -111,6 +152,11 @@ struct fdi {
 static int decode_raw_track (FDI *fdi)
 {
 	int size = get_u32(fdi->track_src);
+	if (size < 0 || size > MAX_DST_BUFFER * 8 || (size + 7) / 8 + 4 > fdi->track_src_size) {
+		outlog ("raw track of %d bits\n", size);
+		fdi->err = 1;
+		return -1;
+	}
 	memcpy (fdi->track_dst, fdi->track_src, (size + 7) >> 3);
 	fdi->track_src += (size + 7) >> 3;
 	return size;
@@ -146,6 +192,20 @@ static void dyy (FDI *fdi)
 	outlog ("\ntrack %d: unsupported sector described 0x%02.2X\n", fdi->current_track, fdi->track_type);
 	fdi->err = 1;
 }
+
+static void bit_mfm_add (FDI *fdi, int bit);
+
+#ifdef FDI2RAW_BITWISE
+
+/* one bit at a time, and the mfm sync bits set at the end of the track: */
+/* the reference of the word encoder below, see ADFLib/Test/fdi_mfm.c */
+
+static void mfm_init (FDI *fdi)
+{
+	fdi->out = 0;
+	fdi->mfmsync_offset = 0;
+}
+
 /* add position of mfm sync bit */
 static void add_mfm_sync_bit (FDI *fdi)
 {
@@ -186,55 +246,219 @@ static void bit_add (FDI *fdi, int bit)
 		fdi->out = 1;
 	}
 }
-/* add bit and mfm sync bit */
-static void bit_mfm_add (FDI *fdi, int bit)
+/* add one byte */
+static void byte_add (FDI *fdi, uae_u8 v)
 {
-	add_mfm_sync_bit (fdi);
-	bit_add (fdi, bit);
+	int i;
+	for (i = 7; i >= 0; i--)
+		bit_add (fdi, v & (1 << i));
 }
-/* remove following bit */
-static void bit_drop_next (FDI *fdi)
+/* add one word */
+static void word_add (FDI *fdi, uae_u16 v)
 {
-	if (fdi->nextdrop > 0) {
-		outlog("multiple bit_drop_next() called");
-	} else if (fdi->nextdrop < 0) {
+	byte_add (fdi, (uae_u8)(v >> 8));
+	byte_add (fdi, (uae_u8)v);
+}
+/* add one byte and mfm encode it */
+static void byte_mfm_add (FDI *fdi, uae_u8 v)
+{
+	int i;
+	for (i = 7; i >= 0; i--)
+		bit_mfm_add (fdi, v & (1 << i));
+}
+/* add multiple bytes and mfm encode them */
+static void bytes_mfm_add (FDI *fdi, uae_u8 v, int len)
+{
+	int i;
+	for (i = 0; i < len; i++) byte_mfm_add (fdi, v);
+}
+/* add one mfm encoded word and re-mfm encode it */
+static void word_post_mfm_add (FDI *fdi, uae_u16 v)
+{
+	int i;
+	for (i = 14; i >= 0; i -= 2)
+		bit_mfm_add (fdi, v & (1 << i));
+}
+
+static void fix_mfm_sync (FDI *fdi)
+{
+	int i, pos, off1, off2, off3, mask1, mask2, mask3;
+
+	for (i = 0; i < fdi->mfmsync_offset; i++) {
+		pos = fdi->mfmsync_buffer[i];
+		off1 = (pos - 1) >> 3;
+		off2 = (pos + 1) >> 3;
+		off3 = pos >> 3;
+		mask1 = 1 << (7 - ((pos - 1) & 7));
+		mask2 = 1 << (7 - ((pos + 1) & 7));
+		mask3 = 1 << (7 - (pos & 7));
+		if (!(fdi->track_dst[off1] & mask1) && !(fdi->track_dst[off2] & mask2))
+			fdi->track_dst[off3] |= mask3;
+		else
+			fdi->track_dst[off3] &= ~mask3;
+	}
+}
+
+#else
+
+/* mfm encoded bytes, with the clock bit of bit 7 set as if a 0 was before */
+static const uae_u16 mfm_table[256] = {
+	0xaaaa, 0xaaa9, 0xaaa4, 0xaaa5, 0xaa92, 0xaa91, 0xaa94, 0xaa95,
+	0xaa4a, 0xaa49, 0xaa44, 0xaa45, 0xaa52, 0xaa51, 0xaa54, 0xaa55,
+	0xa92a, 0xa929, 0xa924, 0xa925, 0xa912, 0xa911, 0xa914, 0xa915,
+	0xa94a, 0xa949, 0xa944, 0xa945, 0xa952, 0xa951, 0xa954, 0xa955,
+	0xa4aa, 0xa4a9, 0xa4a4, 0xa4a5, 0xa492, 0xa491, 0xa494, 0xa495,
+	0xa44a, 0xa449, 0xa444, 0xa445, 0xa452, 0xa451, 0xa454, 0xa455,
+	0xa52a, 0xa529, 0xa524, 0xa525, 0xa512, 0xa511, 0xa514, 0xa515,
+	0xa54a, 0xa549, 0xa544, 0xa545, 0xa552, 0xa551, 0xa554, 0xa555,
+	0x92aa, 0x92a9, 0x92a4, 0x92a5, 0x9292, 0x9291, 0x9294, 0x9295,
+	0x924a, 0x9249, 0x9244, 0x9245, 0x9252, 0x9251, 0x9254, 0x9255,
+	0x912a, 0x9129, 0x9124, 0x9125, 0x9112, 0x9111, 0x9114, 0x9115,
+	0x914a, 0x9149, 0x9144, 0x9145, 0x9152, 0x9151, 0x9154, 0x9155,
+	0x94aa, 0x94a9, 0x94a4, 0x94a5, 0x9492, 0x9491, 0x9494, 0x9495,
+	0x944a, 0x9449, 0x9444, 0x9445, 0x9452, 0x9451, 0x9454, 0x9455,
+	0x952a, 0x9529, 0x9524, 0x9525, 0x9512, 0x9511, 0x9514, 0x9515,
+	0x954a, 0x9549, 0x9544, 0x9545, 0x9552, 0x9551, 0x9554, 0x9555,
+	0x4aaa, 0x4aa9, 0x4aa4, 0x4aa5, 0x4a92, 0x4a91, 0x4a94, 0x4a95,
+	0x4a4a, 0x4a49, 0x4a44, 0x4a45, 0x4a52, 0x4a51, 0x4a54, 0x4a55,
+	0x492a, 0x4929, 0x4924, 0x4925, 0x4912, 0x4911, 0x4914, 0x4915,
+	0x494a, 0x4949, 0x4944, 0x4945, 0x4952, 0x4951, 0x4954, 0x4955,
+	0x44aa, 0x44a9, 0x44a4, 0x44a5, 0x4492, 0x4491, 0x4494, 0x4495,
+	0x444a, 0x4449, 0x4444, 0x4445, 0x4452, 0x4451, 0x4454, 0x4455,
+	0x452a, 0x4529, 0x4524, 0x4525, 0x4512, 0x4511, 0x4514, 0x4515,
+	0x454a, 0x4549, 0x4544, 0x4545, 0x4552, 0x4551, 0x4554, 0x4555,
+	0x52aa, 0x52a9, 0x52a4, 0x52a5, 0x5292, 0x5291, 0x5294, 0x5295,
+	0x524a, 0x5249, 0x5244, 0x5245, 0x5252, 0x5251, 0x5254, 0x5255,
+	0x512a, 0x5129, 0x5124, 0x5125, 0x5112, 0x5111, 0x5114, 0x5115,
+	0x514a, 0x5149, 0x5144, 0x5145, 0x5152, 0x5151, 0x5154, 0x5155,
+	0x54aa, 0x54a9, 0x54a4, 0x54a5, 0x5492, 0x5491, 0x5494, 0x5495,
+	0x544a, 0x5449, 0x5444, 0x5445, 0x5452, 0x5451, 0x5454, 0x5455,
+	0x552a, 0x5529, 0x5524, 0x5525, 0x5512, 0x5511, 0x5514, 0x5515,
+	0x554a, 0x5549, 0x5544, 0x5545, 0x5552, 0x5551, 0x5554, 0x5555
+};
+
+/* add n bits, n <= 32. Whole 32-bit words are written to track_dst */
+static void mfm_put (FDI *fdi, uae_u32 v, int n)
+{
+	uae_u8 *p;
+	uae_u32 w;
+
+	fdi->mfm_acc = (fdi->mfm_acc << n) | v;
+	fdi->mfm_accbits += n;
+	if (fdi->mfm_accbits >= 32) {
+		fdi->mfm_accbits -= 32;
+		w = (uae_u32)(fdi->mfm_acc >> fdi->mfm_accbits);
+		p = fdi->track_dst + (fdi->mfm_pos >> 3);
+		p[0] = (uae_u8)(w >> 24);
+		p[1] = (uae_u8)(w >> 16);
+		p[2] = (uae_u8)(w >> 8);
+		p[3] = (uae_u8)w;
+		fdi->mfm_pos += 32;
+	}
+}
+
+/* count n added bits */
+static void mfm_count (FDI *fdi, int n)
+{
+	fdi->out += n;
+	if (fdi->out >= MAX_DST_BUFFER * 8 - 32) {
+		outlog ("destination buffer overflow\n");
+		fdi->err = 1;
+		fdi->out = 1;
+		fdi->mfm_pos = 0;
+		fdi->mfm_accbits = 0;
+		fdi->mfm_sync = 0;
+	}
+}
+
+/* set the waiting mfm sync bit, now that the next bit is known: 0 if it is a sync bit too */
+static void mfm_sync_set (FDI *fdi, int next)
+{
+	if (fdi->mfm_sync) {
+		fdi->mfm_sync = 0;
+		fdi->mfm_lastbit = !(fdi->mfm_lastbit | next);
+		mfm_put (fdi, fdi->mfm_lastbit, 1);
+	}
+}
+
+static void mfm_init (FDI *fdi)
+{
+	fdi->out = 0;
+	fdi->mfm_acc = 0;
+	fdi->mfm_accbits = 0;
+	fdi->mfm_pos = 0;
+	fdi->mfm_lastbit = 0;
+	fdi->mfm_sync = 0;
+}
+
+/* add position of mfm sync bit. It is 1 if the bits before and after it are 0 */
+static void add_mfm_sync_bit (FDI *fdi)
+{
+	if (fdi->nextdrop) {
 		fdi->nextdrop = 0;
-		debuglog(":DNN:");
 		return;
 	}
-	debuglog(":DN:");
-	fdi->nextdrop = 1;
+	if (fdi->out == 0) {
+		outlog ("illegal position for mfm sync bit, offset=%d\n",fdi->out);
+		fdi->err = 1;
+	}
+	mfm_sync_set (fdi, 0);
+	fdi->mfm_sync = 1;
+	fdi->out++;
 }
 
-/* ignore next bit_drop_next() */
-static void bit_dedrop (FDI *fdi)
+/* add n bits, n <= 16, the top one first */
+static void bits_add (FDI *fdi, uae_u32 v, int n)
 {
 	if (fdi->nextdrop) {
-		outlog("bit_drop_next called before bit_dedrop");
+		fdi->nextdrop = 0;
+		if (--n == 0) return;
+		v &= (1 << n) - 1;
 	}
-	fdi->nextdrop = -1;
-	debuglog(":BDD:");
+	mfm_sync_set (fdi, (v >> (n - 1)) & 1);
+	mfm_put (fdi, v, n);
+	fdi->mfm_lastbit = v & 1;
+	mfm_count (fdi, n);
 }
 
+/* add one bit */
+static void bit_add (FDI *fdi, int bit)
+{
+	bits_add (fdi, bit ? 1 : 0, 1);
+}
 /* add one byte */
 static void byte_add (FDI *fdi, uae_u8 v)
 {
-	int i;
-	for (i = 7; i >= 0; i--)
-		bit_add (fdi, v & (1 << i));
+	bits_add (fdi, v, 8);
 }
 /* add one word */
 static void word_add (FDI *fdi, uae_u16 v)
 {
-	byte_add (fdi, (uae_u8)(v >> 8));
-	byte_add (fdi, (uae_u8)v);
+	bits_add (fdi, v, 16);
 }
 /* add one byte and mfm encode it */
 static void byte_mfm_add (FDI *fdi, uae_u8 v)
 {
-	int i;
-	for (i = 7; i >= 0; i--)
-		bit_mfm_add (fdi, v & (1 << i));
+	uae_u32 w = mfm_table[v];
+
+	if (fdi->nextdrop) {
+		/* without the sync bit of bit 7 */
+		fdi->nextdrop = 0;
+		mfm_sync_set (fdi, v >> 7);
+		mfm_put (fdi, w & 0x7fff, 15);
+		mfm_count (fdi, 15);
+	} else {
+		if (fdi->out == 0) {
+			outlog ("illegal position for mfm sync bit, offset=%d\n",fdi->out);
+			fdi->err = 1;
+		}
+		mfm_sync_set (fdi, 0);
+		if (fdi->mfm_lastbit)
+			w &= 0x7fff;
+		mfm_put (fdi, w, 16);
+		mfm_count (fdi, 16);
+	}
+	fdi->mfm_lastbit = v & 1;
 }
 /* add multiple bytes and mfm encode them */
 static void bytes_mfm_add (FDI *fdi, uae_u8 v, int len)
@@ -246,8 +470,59 @@ static void bytes_mfm_add (FDI *fdi, uae_u8 v, int len)
 static void word_post_mfm_add (FDI *fdi, uae_u16 v)
 {
 	int i;
+	uae_u8 b = 0;
 	for (i = 14; i >= 0; i -= 2)
-		bit_mfm_add (fdi, v & (1 << i));
+		b = (uae_u8)((b << 1) | ((v >> i) & 1));
+	byte_mfm_add (fdi, b);
+}
+/* write the last bits */
+static void fix_mfm_sync (FDI *fdi)
+{
+	uae_u8 *p;
+	uae_u32 w;
+
+	mfm_sync_set (fdi, 0);
+	if (fdi->mfm_accbits > 0) {
+		w = (uae_u32)(fdi->mfm_acc << (32 - fdi->mfm_accbits));
+		p = fdi->track_dst + (fdi->mfm_pos >> 3);
+		p[0] = (uae_u8)(w >> 24);
+		p[1] = (uae_u8)(w >> 16);
+		p[2] = (uae_u8)(w >> 8);
+		p[3] = (uae_u8)w;
+	}
+}
+
+#endif /* FDI2RAW_BITWISE */
+
+/* remove following bit */
+static void bit_drop_next (FDI *fdi)
+{
+	if (fdi->nextdrop > 0) {
+		outlog("multiple bit_drop_next() called");
+	} else if (fdi->nextdrop < 0) {
+		fdi->nextdrop = 0;
+		debuglog(":DNN:");
+		return;
+	}
+	debuglog(":DN:");
+	fdi->nextdrop = 1;
+}
+
+/* ignore next bit_drop_next() */
+static void bit_dedrop (FDI *fdi)
+{
+	if (fdi->nextdrop) {
+		outlog("bit_drop_next called before bit_dedrop");
+	}
+	fdi->nextdrop = -1;
+	debuglog(":BDD:");
+}
+
+/* add bit and mfm sync bit */
+static void bit_mfm_add (FDI *fdi, int bit)
+{
+	add_mfm_sync_bit (fdi);
+	bit_add (fdi, bit);
 }
 
 /* bit 0 */
@@ -646,9 +921,9 @@ static void s27(FDI *fdi)
 /* IBM */
 /* *** */
 
-static uae_u16 ibm_crc (uae_u8 byte, int reset)
+static uae_u16 ibm_crc (FDI *fdi, uae_u8 byte, int reset)
 {
-	static uae_u16 crc;
+	uae_u16 crc = fdi->ibm_crc;
 	int i;
 
 	if (reset) crc = 0xcdb4;
@@ -662,6 +937,7 @@ static uae_u16 ibm_crc (uae_u8 byte, int reset)
 		}
 		byte <<= 1;
 	}
+	fdi->ibm_crc = crc;
 	return crc;
 }
 
@@ -675,10 +951,10 @@ static void ibm_data (FDI *fdi, uae_u8 *data, uae_u8 *crc, int len)
 	word_add (fdi, 0x4489);
 	word_add (fdi, 0x4489);
 	byte_mfm_add (fdi, 0xfb);
-	ibm_crc (0xfb, 1);
+	ibm_crc (fdi, 0xfb, 1);
 	for (i = 0; i < len; i++) {
 		byte_mfm_add (fdi, data[i]);
-		crcv = ibm_crc (data[i], 0);
+		crcv = ibm_crc (fdi, data[i], 0);
 	}
 	if (!crc) {
 		crc = crcbuf;
@@ -710,11 +986,11 @@ static void ibm_sector_header (FDI *fdi, uae_u8 *data, uae_u8 *crc, int secnum,
 	} else {
 		memcpy (secbuf + 1, data, 4);
 	}
-	ibm_crc (secbuf[0], 1);
-	ibm_crc (secbuf[1], 0);
-	ibm_crc (secbuf[2], 0);
-	ibm_crc (secbuf[3], 0);
-	crcv = ibm_crc (secbuf[4], 0);
+	ibm_crc (fdi, secbuf[0], 1);
+	ibm_crc (fdi, secbuf[1], 0);
+	ibm_crc (fdi, secbuf[2], 0);
+	ibm_crc (fdi, secbuf[3], 0);
+	crcv = ibm_crc (fdi, secbuf[4], 0);
 	if (crc) {
 		memcpy (crcbuf, crc, 2);
 	} else {
@@ -994,25 +1270,6 @@ static decode_normal_track_func decode_normal_track[] =
 	zxx,zxx,zxx,zxx,zxx /* A-F */
 };
 
-static void fix_mfm_sync (FDI *fdi)
-{
-	int i, pos, off1, off2, off3, mask1, mask2, mask3;
-
-	for (i = 0; i < fdi->mfmsync_offset; i++) {
-		pos = fdi->mfmsync_buffer[i];
-		off1 = (pos - 1) >> 3;
-		off2 = (pos + 1) >> 3;
-		off3 = pos >> 3;
-		mask1 = 1 << (7 - ((pos - 1) & 7));
-		mask2 = 1 << (7 - ((pos + 1) & 7));
-		mask3 = 1 << (7 - (pos & 7));
-		if (!(fdi->track_dst[off1] & mask1) && !(fdi->track_dst[off2] & mask2))
-			fdi->track_dst[off3] |= mask3;
-		else
-			fdi->track_dst[off3] &= ~mask3;
-	}
-}
-
 static int handle_sectors_described_track (FDI *fdi)
 {
 	int oldout;
@@ -1047,14 +1304,125 @@ static int handle_sectors_described_track (FDI *fdi)
 static unsigned char fdiid[]={"Formatted Disk Image file"};
 static int bit_rate_table[16] = { 125,150,250,300,500,1000 };
 
+/* the file in memory, the tracks are copied from there without a seek and a read each */
+static void map_file (FDI *fdi)
+{
+	long pos;
+
+	pos = ftell (fdi->file);
+	fseek (fdi->file, 0, SEEK_END);
+	fdi->map_size = ftell (fdi->file);
+	fseek (fdi->file, pos, SEEK_SET);
+	if (fdi->map_size <= 0) return;
+#ifdef _WIN32
+	fdi->map_handle = CreateFileMapping ((HANDLE)_get_osfhandle (_fileno (fdi->file)), NULL, PAGE_READONLY, 0, 0, NULL);
+	if (!fdi->map_handle) return;
+	fdi->map = (uae_u8 *)MapViewOfFile (fdi->map_handle, FILE_MAP_READ, 0, 0, 0);
+	if (!fdi->map) {
+		CloseHandle (fdi->map_handle);
+		fdi->map_handle = NULL;
+	}
+#elif defined(FDI2RAW_MAP)
+	fdi->map = (uae_u8 *)mmap (NULL, fdi->map_size, PROT_READ, MAP_PRIVATE, fileno (fdi->file), 0);
+	if (fdi->map == (uae_u8 *)MAP_FAILED) fdi->map = NULL;
+#endif
+}
+
+static void unmap_file (FDI *fdi)
+{
+	if (!fdi->map) return;
+#ifdef _WIN32
+	UnmapViewOfFile (fdi->map);
+	CloseHandle (fdi->map_handle);
+	fdi->map_handle = NULL;
+#elif defined(FDI2RAW_MAP)
+	munmap (fdi->map, fdi->map_size);
+#endif
+	fdi->map = NULL;
+}
+
+/* keep the last tracks decoded, tracks = 0 frees them and decodes each time */
+void fdi2raw_set_cache (FDI *fdi, int tracks)
+{
+	int i;
+
+	for (i = 0; i < fdi->cache_size; i++)
+		free (fdi->cache[i].data);
+	free (fdi->cache);
+	fdi->cache = NULL;
+	fdi->cache_size = 0;
+	if (tracks <= 0) return;
+	fdi->cache = (struct fdi_cache *)malloc (tracks * sizeof (struct fdi_cache));
+	if (!fdi->cache) return;
+	for (i = 0; i < tracks; i++) {
+		fdi->cache[i].track = -1;
+		fdi->cache[i].data = NULL;
+		fdi->cache[i].last = 0;
+	}
+	fdi->cache_size = tracks;
+}
+
+static struct fdi_cache *cache_find (FDI *fdi, int track)
+{
+	int i;
+
+	for (i = 0; i < fdi->cache_size; i++) {
+		if (fdi->cache[i].track == track) {
+			fdi->cache[i].last = ++fdi->cache_time;
+			return &fdi->cache[i];
+		}
+	}
+	return NULL;
+}
+
+/* the track replaces the one used least recently */
+static void cache_add (FDI *fdi, int track, int len)
+{
+	struct fdi_cache *c;
+	uae_u8 *data;
+	int i, bytes;
+
+	if (!fdi->cache_size) return;
+	c = &fdi->cache[0];
+	for (i = 1; i < fdi->cache_size; i++) {
+		if (fdi->cache[i].last < c->last)
+			c = &fdi->cache[i];
+	}
+	bytes = len > 0 ? (len + 7) >> 3 : 0;
+	data = (uae_u8 *)realloc (c->data, bytes ? bytes : 1);
+	if (!data) return;
+	memcpy (data, fdi->track_dst_buffer, bytes);
+	c->data = data;
+	c->track = track;
+	c->len = len;
+	c->bit_rate = fdi->bit_rate;
+	c->last = ++fdi->cache_time;
+}
+
+/* the bytes after the track are 0 as in a cleared buffer. Only those of the previous track are cleared */
+static void clear_dst (FDI *fdi, int len)
+{
+	int bytes = len > 0 ? (len + 7) >> 3 : 0;
+
+	if (len > 0 && (len & 7))
+		fdi->track_dst_buffer[bytes - 1] &= (uae_u8)(0xff << (8 - (len & 7)));
+	if (fdi->track_dst_dirty > bytes)
+		memset (fdi->track_dst_buffer + bytes, 0, fdi->track_dst_dirty - bytes);
+	fdi->track_dst_dirty = bytes;
+}
+
 void fdi2raw_header_free (FDI *fdi)
 {
+#ifdef FDI2RAW_BITWISE
 	free (fdi->mfmsync_buffer);
 	fdi->mfmsync_buffer = 0;
+#endif
 	free (fdi->track_src_buffer);
 	fdi->track_src_buffer = 0;
 	free (fdi->track_dst_buffer);
 	fdi->track_dst_buffer = 0;
+	fdi2raw_set_cache (fdi, 0);
+	unmap_file (fdi);
 	memset (fdi, 0, sizeof (FDI));
 }
 
@@ -1090,11 +1458,13 @@ int fdi2raw_get_write_protect (FDI *fdi)
 
 FDI *fdi2raw_header(FILE *f)
 {
-	int i, offset, oldseek;
+	int i, offset, oldseek, len;
 	uae_u8 type, size;
 	FDI *fdi;
 
 	fdi = (FDI *)malloc(sizeof(FDI));
+	if (!fdi) return NULL;
+	memset (fdi, 0, sizeof (FDI));
 
 	fdi->file = f;
 	oldseek = ftell (fdi->file);
@@ -1104,12 +1474,10 @@ FDI *fdi2raw_header(FILE *f)
 	if (memcmp (fdiid, fdi->header, strlen (fdiid)) ) { free(fdi); return NULL;}
 	if (fdi->header[140] != 1 || fdi->header[141] != 0) {free(fdi); return NULL;}
 
-	fdi->mfmsync_buffer = malloc (MAX_MFM_SYNC_BUFFER * sizeof(int));
-	fdi->track_dst_buffer = malloc (MAX_DST_BUFFER);
-	fdi->track_src_buffer = malloc (MAX_SRC_BUFFER);
-	
 	fdi->last_track = ((fdi->header[142] << 8) + fdi->header[143]) + 1;
 	fdi->last_track *= fdi->header[144] + 1;
+	/* the header has room for 180 tracks */
+	if (fdi->last_track > 180) {free(fdi); return NULL;}
 	fdi->last_head = fdi->header[144];
 	fdi->disk_type = fdi->header[145];
 	fdi->rotation_speed = fdi->header[146] + 128;
@@ -1117,30 +1485,71 @@ FDI *fdi2raw_header(FILE *f)
 	outlog ("last_track=%d rotation_speed=%d\n",fdi->last_track,fdi->rotation_speed);
 
 	offset = 512;
+	fdi->track_src_size = MAX_SRC_BUFFER;
 	for (i = 0; i < fdi->last_track; i++) {
 		fdi->track_offsets[i] = offset;
 		type = fdi->header[152 + i * 2];
 		size = fdi->header[152 + i * 2 + 1];
-		if (type == 1) offset += (size & 15) * 512; else offset += size * 256;
+		if (type == 1) len = (size & 15) * 512; else len = size * 256;
+		if (len > fdi->track_src_size) fdi->track_src_size = len;
+		offset += len;
 	}
 	fdi->track_offsets[i] = offset;
 
+	/* cleared once, then as much as the tracks use */
+#ifdef FDI2RAW_BITWISE
+	fdi->mfmsync_buffer = malloc (MAX_MFM_SYNC_BUFFER * sizeof(int));
+#endif
+	fdi->track_dst_buffer = calloc (MAX_DST_BUFFER, 1);
+	fdi->track_src_buffer = calloc (fdi->track_src_size, 1);
+	map_file (fdi);
+	fdi2raw_set_cache (fdi, FDI2RAW_CACHE);
+
 	return fdi;
 }
 
 
 uae_u8 *fdi2raw_read_track(FDI *fdi, int track, int *len)
 {
+	struct fdi_cache *c;
 	uae_u8 *p;
-	int outlen;
+	int outlen, n;
 
 	*len = -1;
+	if (track < 0 || track >= fdi->last_track) return fdi->track_dst_buffer;
+	c = cache_find (fdi, track);
+	if (c) {
+		if (c->len > 0)
+			memcpy (fdi->track_dst_buffer, c->data, (c->len + 7) >> 3);
+		clear_dst (fdi, c->len);
+		fdi->current_track = track;
+		fdi->bit_rate = c->bit_rate;
+		*len = c->len;
+		return fdi->track_dst_buffer;
+	}
+
 	fdi->err = 0;
+	/* a bit drop at the end of the previous track is not for this one */
+	fdi->nextdrop = 0;
 	fdi->track_src_len = fdi->track_offsets[track + 1] - fdi->track_offsets[track];
-	memset (fdi->track_src_buffer, 0, MAX_SRC_BUFFER);
-	fseek (fdi->file, fdi->track_offsets[track], SEEK_SET);
-	fread (fdi->track_src_buffer, fdi->track_src_len, 1, fdi->file);
+	/* the source past the end of the file reads as 0, as fread() leaves it */
+	n = 0;
+	if (fdi->map) {
+		n = fdi->map_size - fdi->track_offsets[track];
+		if (n > fdi->track_src_len) n = fdi->track_src_len;
+		if (n > 0) memcpy (fdi->track_src_buffer, fdi->map + fdi->track_offsets[track], n);
+		else n = 0;
+	} else {
+		fseek (fdi->file, fdi->track_offsets[track], SEEK_SET);
+		n = (int)fread (fdi->track_src_buffer, 1, fdi->track_src_len, fdi->file);
+	}
+	if (fdi->track_src_dirty > n)
+		memset (fdi->track_src_buffer + n, 0, fdi->track_src_dirty - n);
+	fdi->track_src_dirty = n;
+#ifdef FDI2RAW_BITWISE
+	/* the sync bits are only set, the bit by bit encoder needs a cleared buffer */
 	memset (fdi->track_dst_buffer, 0, MAX_DST_BUFFER);
+#endif
 
 	fdi->current_track = track;
 	fdi->track_src = fdi->track_src_buffer;
@@ -1149,8 +1558,7 @@ uae_u8 *fdi2raw_read_track(FDI *fdi, int track, int *len)
 	fdi->track_type = *p++;
 	fdi->track_len = *p++;
 	fdi->bit_rate = 0;
-	fdi->out = 0;
-	fdi->mfmsync_offset = 0;
+	mfm_init (fdi);
 
 	if ((fdi->track_type & 0xf0) == 0xf0 || (fdi->track_type & 0xf0) == 0xe0)
 		fdi->bit_rate = bit_rate_table[fdi->track_type & 0x0f];
@@ -1185,7 +1593,13 @@ uae_u8 *fdi2raw_read_track(FDI *fdi, int track, int *len)
 
 	}
 
-	if (fdi->err) outlen = -1;
+	if (fdi->err || outlen < 0) {
+		/* the overflows start again at the beginning of the buffer, anything may be written */
+		outlen = -1;
+		fdi->track_dst_dirty = MAX_DST_BUFFER;
+	}
+	clear_dst (fdi, outlen);
+	cache_add (fdi, track, outlen);
 	*len = outlen;
 	return fdi->track_dst_buffer;
 }
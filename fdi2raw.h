@@ -18,6 +18,7 @@ extern int fdi2raw_get_type (FDI *);
 extern int fdi2raw_get_bit_rate (FDI *);
 extern int fdi2raw_get_rotation (FDI *);
 extern int fdi2raw_get_write_protect (FDI *);
+extern void fdi2raw_set_cache (FDI *, int tracks);
 
 #ifdef __cplusplus
 }
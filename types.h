@@ -7,5 +7,10 @@ typedef unsigned short uae_u16;
 typedef signed short uae_s16;
 typedef unsigned long uae_u32;
 typedef signed long uae_s32;
+#ifdef _MSC_VER
+typedef unsigned __int64 uae_u64;
+#else
+typedef unsigned long long uae_u64;
+#endif
 
 #endif
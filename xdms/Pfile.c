@@ -8,9 +8,6 @@
  */
 
 
-#define HEADLEN 56
-#define THLEN 20
-#define TRACK_BUFFER_LEN 32000
 #define TEMP_BUFFER_LEN 32000
 
 
@@ -27,10 +24,13 @@
 #include "u_deep.h"
 #include "u_heavy.h"
 #include "crc_csum.h"
+#include "getbits.h"
 #include "pfile.h"
 
 
 
+static USHORT Read_Header(FILE *, UCHAR *, struct DMS_Info *);
+static USHORT Read_Track_Header(UCHAR *, struct DMS_Track *);
 static USHORT Process_Track(FILE *, FILE *, UCHAR *, UCHAR *, USHORT, USHORT);
 static USHORT Unpack_Track(UCHAR *, UCHAR *, USHORT, USHORT, UCHAR, UCHAR);
 static void dms_decrypt(UCHAR *, USHORT);
@@ -43,15 +43,18 @@ UCHAR *text;
 
 
 
+/*  oname NULL : the archive is only verified, the tracks are unpacked  */
+/*  in memory and checked, and no file is written                       */
+
 USHORT Process_File(char *iname, char *oname, USHORT opt, USHORT PCRC, USHORT pwd){
 	FILE *fi, *fo=NULL;
-	USHORT from, to, geninfo, c_version, cmode, hcrc, disktype, ret;
-	ULONG pkfsize, unpkfsize;
+	struct DMS_Info info;
+	USHORT ret;
 	UCHAR *b1, *b2;
-	time_t date;
 
 
-	b1 = (UCHAR *)calloc((size_t)TRACK_BUFFER_LEN,1);
+	/*  the packed data is read by the bit reader, 4 bytes at once  */
+	b1 = (UCHAR *)calloc((size_t)(TRACK_BUFFER_LEN+BITBUF_PAD),1);
 	if (!b1) return ERR_NOMEMORY;
 	b2 = (UCHAR *)calloc((size_t)TRACK_BUFFER_LEN,1);
 	if (!b2) {
@@ -73,87 +76,158 @@ USHORT Process_File(char *iname, char *oname, USHORT opt, USHORT PCRC, USHORT pw
 		return ERR_CANTOPENIN;
 	}
 
-	if (fread(b1,1,HEADLEN,fi) != HEADLEN) {
-		if (iname) fclose(fi);
-		free(b1);
-		free(b2);
-		free(text);
-		return ERR_SREAD;
+	ret = Read_Header(fi, b1, &info);
+
+	PWDCRC = PCRC;
+
+	if ((ret == NO_PROBLEM) && (info.geninfo & 2) && (!pwd))
+		ret = ERR_NOPASSWD;
+
+	if ((ret == NO_PROBLEM) && oname) {
+		fo = fopen(oname,"wb");
+		if (!fo) ret = ERR_CANTOPENOUT;
 	}
 
-	if ( (b1[0] != 'D') || (b1[1] != 'M') || (b1[2] != 'S') || (b1[3] != '!') ) {
-		/*  Check the first 4 bytes of file to see if it is "DMS!"  */
-		if (iname) fclose(fi);
+	if (ret != NO_PROBLEM) {
+		fclose(fi);
 		free(b1);
 		free(b2);
 		free(text);
-		return ERR_NOTDMS;
+		return ret;
 	}
 
-	hcrc = (USHORT)((b1[HEADLEN-2]<<8) | b1[HEADLEN-1]);
-	/* Header CRC */
+	Init_Decrunchers();
 
-	if (hcrc != CreateCRC(b1+4,(ULONG)(HEADLEN-6))) {
-		if (iname) fclose(fi);
-		free(b1);
-		free(b2);
-		free(text);
-		return ERR_HCRC;
-	}
-	
-	geninfo = (USHORT) ((b1[10]<<8) | b1[11]);	/* General info about archive */
-	date = (time_t) ((((ULONG)b1[12])<<24) | (((ULONG)b1[13])<<16) | (((ULONG)b1[14])<<8) | (ULONG)b1[15]);	/* date in standard UNIX/ANSI format */
-	from = (USHORT) ((b1[16]<<8) | b1[17]);		/*  Lowest track in archive. May be incorrect if archive is "appended" */
-	to = (USHORT) ((b1[18]<<8) | b1[19]);		/*  Highest track in archive. May be incorrect if archive is "appended" */
+	while ( (ret=Process_Track(fi,fo,b1,b2,opt,(info.geninfo & 2)?pwd:0)) == NO_PROBLEM ) ;
 
-	pkfsize = (ULONG) ((((ULONG)b1[21])<<16) | (((ULONG)b1[22])<<8) | (ULONG)b1[23]);	/*  Length of total packed data as in archive   */
-	unpkfsize = (ULONG) ((((ULONG)b1[25])<<16) | (((ULONG)b1[26])<<8) | (ULONG)b1[27]);	/*  Length of unpacked data. Usually 901120 bytes  */
+	if (ret == DMS_FILE_END) ret = NO_PROBLEM;
 
-	c_version = (USHORT) ((b1[46]<<8) | b1[47]);	/*  version of DMS used to generate it  */
-	disktype = (USHORT) ((b1[50]<<8) | b1[51]);		/*  Type of compressed disk  */
-	cmode = (USHORT) ((b1[52]<<8) | b1[53]);        /*  Compression mode mostly used in this archive  */
+	/*  Used to give an error message, but I have seen some DMS  */
+	/*  files with texts or zeros at the end of the valid data   */
+	/*  So, when we find something that is not a track header,   */
+	/*  we suppose that the valid data is over. And say it's ok. */
+	if (ret == ERR_NOTTRACK) ret = NO_PROBLEM;
 
-	PWDCRC = PCRC;
 
-	if (disktype == 7) {
-		/*  It's not a DMS compressed disk image, but a FMS archive  */
-		if (iname) fclose(fi);
+	fclose(fi);
+	if (fo) fclose(fo);
+
+	free(b1);
+	free(b2);
+	free(text);
+
+	return ret;
+}
+
+
+
+/*  Builds the index of an archive from its header and its track headers.  */
+/*  The packed data is skipped, except the banner and FILEID.DIZ, unpacked  */
+/*  if they are not encrypted. Nothing is written. A banner or FILEID.DIZ  */
+/*  which doesn't unpack gives its error code, with the whole index.       */
+
+USHORT Scan_File(char *iname, struct DMS_Info *info){
+	FILE *fi;
+	struct DMS_Track t, *tracks;
+	USHORT ret, l, maxtracks, texterr;
+	UCHAR *b1, *b2;
+	char **dest;
+	long fsize;
+
+	memset(info,0,sizeof(struct DMS_Info));
+
+	b1 = (UCHAR *)calloc((size_t)(TRACK_BUFFER_LEN+BITBUF_PAD),1);
+	b2 = (UCHAR *)calloc((size_t)TRACK_BUFFER_LEN,1);
+	text = (UCHAR *)calloc((size_t)TEMP_BUFFER_LEN,1);
+	if (!b1 || !b2 || !text) {
 		free(b1);
 		free(b2);
 		free(text);
-		return ERR_FMS;
+		return ERR_NOMEMORY;
 	}
 
-	if ((geninfo & 2) && (!pwd))
-		return ERR_NOPASSWD;
-
-	fo = fopen(oname,"wb");
-	if (!fo) {
-		if (iname) fclose(fi);
+	fi = fopen(iname,"rb");
+	if (!fi) {
 		free(b1);
 		free(b2);
 		free(text);
-		return ERR_CANTOPENOUT;
+		return ERR_CANTOPENIN;
 	}
+	fseek(fi,0,SEEK_END);
+	fsize = ftell(fi);
+	fseek(fi,0,SEEK_SET);
 
-	ret=NO_PROBLEM;
+	ret = Read_Header(fi, b1, info);
 
 	Init_Decrunchers();
+	maxtracks = 0;
+	texterr = NO_PROBLEM;
 
-	while ( (ret=Process_Track(fi,fo,b1,b2,opt,(geninfo & 2)?pwd:0)) == NO_PROBLEM ) ;
-
-	if (ret == DMS_FILE_END) ret = NO_PROBLEM;
+	while (ret == NO_PROBLEM) {
+		l = (USHORT)fread(b1,1,THLEN,fi);
+		if (l != THLEN) {
+			if (l != 0) ret = ERR_SREAD;
+			break;
+		}
+		ret = Read_Track_Header(b1, &t);
+		if (ret == ERR_NOTTRACK) {
+			ret = NO_PROBLEM;
+			break;
+		}
+		if (ret != NO_PROBLEM) break;
+		t.offset = (ULONG)ftell(fi);
+		if ((long)t.offset+t.pklen1 > fsize) {
+			ret = ERR_SREAD;
+			break;
+		}
 
-	/*  Used to give an error message, but I have seen some DMS  */
-	/*  files with texts or zeros at the end of the valid data   */
-	/*  So, when we find something that is not a track header,   */
-	/*  we suppose that the valid data is over. And say it's ok. */
-	if (ret == ERR_NOTTRACK) ret = NO_PROBLEM;
+		if (info->nbtracks == maxtracks) {
+			maxtracks = (USHORT)(maxtracks ? 2*maxtracks : 84);
+			tracks = (struct DMS_Track *)realloc(info->tracks, maxtracks*sizeof(struct DMS_Track));
+			if (!tracks) {
+				ret = ERR_NOMEMORY;
+				break;
+			}
+			info->tracks = tracks;
+		}
+		info->tracks[info->nbtracks++] = t;
+
+		/*  the banner is encrypted with the rest of the archive  */
+		dest = NULL;
+		if (t.number == 80)
+			dest = &(info->diz);
+		else if ((t.number == 0xffff) && !(info->geninfo & 2))
+			dest = &(info->banner);
+
+		if (!dest || *dest) {
+			fseek(fi,(long)t.pklen1,SEEK_CUR);
+			continue;
+		}
+		if (fread(b1,1,(size_t)t.pklen1,fi) != t.pklen1) {
+			ret = ERR_SREAD;
+			break;
+		}
+		if (CreateCRC(b1,(ULONG)t.pklen1) != t.dcrc) {
+			ret = ERR_TDCRC;
+			break;
+		}
+		l = Unpack_Track(b1, b2, t.pklen2, t.unpklen, t.cmode, t.flags);
+		if ((l == NO_PROBLEM) && (t.usum != Calc_CheckSum(b2,(ULONG)t.unpklen))) l = ERR_CSUM;
+		if (l != NO_PROBLEM) {
+			/*  the tracks after it are still indexed  */
+			if (texterr == NO_PROBLEM) texterr = l;
+			continue;
+		}
+		*dest = (char *)malloc((size_t)t.unpklen+1);
+		if (*dest) {
+			memcpy(*dest,b2,(size_t)t.unpklen);
+			(*dest)[t.unpklen] = '\0';
+		}
+	}
 
+	if (ret == NO_PROBLEM) ret = texterr;
 
 	fclose(fi);
-	fclose(fo);
-
 	free(b1);
 	free(b2);
 	free(text);
@@ -163,19 +237,57 @@ USHORT Process_File(char *iname, char *oname, USHORT opt, USHORT PCRC, USHORT pw
 
 
 
-static USHORT Process_Track(FILE *fi, FILE *fo, UCHAR *b1, UCHAR *b2, USHORT opt, USHORT pwd){
-	USHORT hcrc, dcrc, usum, number, pklen1, pklen2, unpklen, l, r;
-	UCHAR cmode, flags;
+void Free_Info(struct DMS_Info *info){
+	free(info->tracks);
+	free(info->banner);
+	free(info->diz);
+	info->tracks = NULL;
+	info->banner = info->diz = NULL;
+	info->nbtracks = 0;
+}
 
-	l = (USHORT)fread(b1,1,THLEN,fi);
 
-	if (l != THLEN) {
-		if (l==0)
-			return DMS_FILE_END;
-		else
-			return ERR_SREAD;
+
+static USHORT Read_Header(FILE *fi, UCHAR *b1, struct DMS_Info *info){
+	USHORT hcrc;
+
+	if (fread(b1,1,HEADLEN,fi) != HEADLEN) return ERR_SREAD;
+
+	if ( (b1[0] != 'D') || (b1[1] != 'M') || (b1[2] != 'S') || (b1[3] != '!') ) {
+		/*  Check the first 4 bytes of file to see if it is "DMS!"  */
+		return ERR_NOTDMS;
+	}
+
+	hcrc = (USHORT)((b1[HEADLEN-2]<<8) | b1[HEADLEN-1]);
+	/* Header CRC */
+
+	if (hcrc != CreateCRC(b1+4,(ULONG)(HEADLEN-6))) return ERR_HCRC;
+
+	info->geninfo = (USHORT) ((b1[10]<<8) | b1[11]);	/* General info about archive */
+	info->date = (ULONG) ((((ULONG)b1[12])<<24) | (((ULONG)b1[13])<<16) | (((ULONG)b1[14])<<8) | (ULONG)b1[15]);	/* date in standard UNIX/ANSI format */
+	info->from = (USHORT) ((b1[16]<<8) | b1[17]);		/*  Lowest track in archive. May be incorrect if archive is "appended" */
+	info->to = (USHORT) ((b1[18]<<8) | b1[19]);		/*  Highest track in archive. May be incorrect if archive is "appended" */
+
+	info->pkfsize = (ULONG) ((((ULONG)b1[21])<<16) | (((ULONG)b1[22])<<8) | (ULONG)b1[23]);	/*  Length of total packed data as in archive   */
+	info->unpkfsize = (ULONG) ((((ULONG)b1[25])<<16) | (((ULONG)b1[26])<<8) | (ULONG)b1[27]);	/*  Length of unpacked data. Usually 901120 bytes  */
+
+	info->c_version = (USHORT) ((b1[46]<<8) | b1[47]);	/*  version of DMS used to generate it  */
+	info->disktype = (USHORT) ((b1[50]<<8) | b1[51]);		/*  Type of compressed disk  */
+	info->cmode = (USHORT) ((b1[52]<<8) | b1[53]);        /*  Compression mode mostly used in this archive  */
+
+	if (info->disktype == 7) {
+		/*  It's not a DMS compressed disk image, but a FMS archive  */
+		return ERR_FMS;
 	}
 
+	return NO_PROBLEM;
+}
+
+
+
+static USHORT Read_Track_Header(UCHAR *b1, struct DMS_Track *t){
+	USHORT hcrc;
+
 	/*  "TR" identifies a Track Header  */
 	if ((b1[0] != 'T')||(b1[1] != 'R')) return ERR_NOTTRACK;
 
@@ -184,40 +296,62 @@ static USHORT Process_Track(FILE *fi, FILE *fo, UCHAR *b1, UCHAR *b2, USHORT opt
 
 	if (CreateCRC(b1,(ULONG)(THLEN-2)) != hcrc) return ERR_THCRC;
 
-	number = (USHORT)((b1[2] << 8) | b1[3]);	/*  Number of track  */
-	pklen1 = (USHORT)((b1[6] << 8) | b1[7]);	/*  Length of packed track data as in archive  */
-	pklen2 = (USHORT)((b1[8] << 8) | b1[9]);	/*  Length of data after first unpacking  */
-	unpklen = (USHORT)((b1[10] << 8) | b1[11]);	/*  Length of data after subsequent rle unpacking */
-	flags = b1[12];		/*  control flags  */
-	cmode = b1[13];		/*  compression mode used  */
-	usum = (USHORT)((b1[14] << 8) | b1[15]);	/*  Track Data CheckSum AFTER unpacking  */
-	dcrc = (USHORT)((b1[16] << 8) | b1[17]);	/*  Track Data CRC BEFORE unpacking  */
+	t->number = (USHORT)((b1[2] << 8) | b1[3]);	/*  Number of track  */
+	t->pklen1 = (USHORT)((b1[6] << 8) | b1[7]);	/*  Length of packed track data as in archive  */
+	t->pklen2 = (USHORT)((b1[8] << 8) | b1[9]);	/*  Length of data after first unpacking  */
+	t->unpklen = (USHORT)((b1[10] << 8) | b1[11]);	/*  Length of data after subsequent rle unpacking */
+	t->flags = b1[12];		/*  control flags  */
+	t->cmode = b1[13];		/*  compression mode used  */
+	t->usum = (USHORT)((b1[14] << 8) | b1[15]);	/*  Track Data CheckSum AFTER unpacking  */
+	t->dcrc = (USHORT)((b1[16] << 8) | b1[17]);	/*  Track Data CRC BEFORE unpacking  */
+	t->offset = 0;
+
+	if ((t->pklen1 > TRACK_BUFFER_LEN) || (t->pklen2 >TRACK_BUFFER_LEN) || (t->unpklen > TRACK_BUFFER_LEN)) return ERR_BIGTRACK;
+
+	return NO_PROBLEM;
+}
+
+
+
+static USHORT Process_Track(FILE *fi, FILE *fo, UCHAR *b1, UCHAR *b2, USHORT opt, USHORT pwd){
+	struct DMS_Track t;
+	USHORT l, r;
+
+	l = (USHORT)fread(b1,1,THLEN,fi);
+
+	if (l != THLEN) {
+		if (l==0)
+			return DMS_FILE_END;
+		else
+			return ERR_SREAD;
+	}
 
-	if ((pklen1 > TRACK_BUFFER_LEN) || (pklen2 >TRACK_BUFFER_LEN) || (unpklen > TRACK_BUFFER_LEN)) return ERR_BIGTRACK;
+	r = Read_Track_Header(b1, &t);
+	if (r != NO_PROBLEM) return r;
 
-	if (fread(b1,1,(size_t)pklen1,fi) != pklen1) return ERR_SREAD;
+	if (fread(b1,1,(size_t)t.pklen1,fi) != t.pklen1) return ERR_SREAD;
 
-	if (CreateCRC(b1,(ULONG)pklen1) != dcrc) return ERR_TDCRC;
+	if (CreateCRC(b1,(ULONG)t.pklen1) != t.dcrc) return ERR_TDCRC;
 
 	/*  track 80 is FILEID.DIZ, track 0xffff (-1) is Banner  */
 	/*  and track 0 with 1024 bytes only is a fake boot block with more advertising */
 	/*  FILE_ID.DIZ is never encrypted  */
 
-	if (pwd && (number!=80)) dms_decrypt(b1,pklen1);
+	if (pwd && (t.number!=80)) dms_decrypt(b1,t.pklen1);
 
-	if ((number<80) && (unpklen>2048)) {
-		r = Unpack_Track(b1, b2, pklen2, unpklen, cmode, flags);
+	if ((t.number<80) && (t.unpklen>2048)) {
+		r = Unpack_Track(b1, b2, t.pklen2, t.unpklen, t.cmode, t.flags);
 		if (r != NO_PROBLEM) 
 			if (pwd)
 				return ERR_BADPASSWD;
 			else
 				return r;
-		if (usum != Calc_CheckSum(b2,(ULONG)unpklen))
+		if (t.usum != Calc_CheckSum(b2,(ULONG)t.unpklen))
 			if (pwd)
 				return ERR_BADPASSWD;
 			else
 				return ERR_CSUM;
-		if (fwrite(b2,1,(size_t)unpklen,fo) != unpklen) return ERR_CANTWRITE;
+		if (fo && (fwrite(b2,1,(size_t)t.unpklen,fo) != t.unpklen)) return ERR_CANTWRITE;
 		if (opt == OPT_VERBOSE) {
 			fprintf(stderr,"#");
 			fflush(stderr);
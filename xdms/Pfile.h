@@ -23,6 +23,7 @@
 #define ERR_FMS 18
 #define ERR_GZIP 19
 #define ERR_READDISK 20
+#define ERR_IMGSIZE 21
 
 
 /* Command to execute */
@@ -40,6 +41,43 @@
 #define OPT_QUIET 2
 
 
+/* Archive layout, shared with the packer */
+#define HEADLEN 56
+#define THLEN 20
+#define TRACK_BUFFER_LEN 32000
+
+
+/*  Archive index built by Scan_File  */
+
+struct DMS_Track {
+	USHORT number;		/*  80 is FILEID.DIZ, 0xffff is the banner  */
+	USHORT pklen1;		/*  packed data in the archive  */
+	USHORT pklen2;		/*  after the first unpacking  */
+	USHORT unpklen;		/*  after the rle unpacking  */
+	USHORT usum;		/*  checksum after unpacking  */
+	USHORT dcrc;		/*  crc of the packed data  */
+	UCHAR flags;
+	UCHAR cmode;		/*  0 NOCOMP, 1 SIMPLE, 2 QUICK, 3 MEDIUM, 4 DEEP, 5 HEAVY1, 6 HEAVY2  */
+	ULONG offset;		/*  of the packed data in the archive  */
+};
+
+struct DMS_Info {
+	USHORT geninfo;		/*  2 : encrypted  */
+	ULONG date;			/*  UNIX date  */
+	USHORT from, to;	/*  track range, may be wrong if the archive was appended  */
+	ULONG pkfsize, unpkfsize;
+	USHORT c_version;	/*  version of DMS used  */
+	USHORT disktype;	/*  7 : FMS archive  */
+	USHORT cmode;		/*  compression mode mostly used  */
+	USHORT nbtracks;
+	struct DMS_Track *tracks;
+	char *banner;		/*  unpacked banner and FILEID.DIZ, or NULL  */
+	char *diz;
+};
+
+
 USHORT Process_File(char *, char *, USHORT, USHORT, USHORT);
+USHORT Scan_File(char *, struct DMS_Info *);
+void Free_Info(struct DMS_Info *);
 
 #endif /* ndef PFILE_H */
\ No newline at end of file
@@ -0,0 +1,331 @@
+
+/*
+ *     xDMS  v1.3  -  Portable DMS archive unpacker  -  Public Domain
+ *
+ *     Writes a DMS archive from a disk image. The tracks are packed
+ *     alone, by several threads, and written in order
+ *
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <process.h>
+#else
+#include <pthread.h>
+#endif
+
+#include "cdata.h"
+#include "crc_csum.h"
+#include "pfile.h"
+#include "wfile.h"
+#include "p_rle.h"
+#include "p_lz.h"
+#include "p_heavy.h"
+
+
+#define DD_TRACKLEN 11264	/*  2 heads of 11 sectors  */
+#define MAX_TRACKS 80
+
+
+/*  what a thread needs to pack a track  */
+struct PACK_WORK {
+	UCHAR rle[TRACK_BUFFER_LEN];
+	struct LZ_STATE lz;
+};
+
+struct PACK_JOB {
+	UCHAR *img;
+	USHORT tracklen, ntracks;
+	UCHAR cmode;
+	UCHAR *out;		/*  THLEN+TRACK_BUFFER_LEN bytes for each track  */
+	USHORT len[MAX_TRACKS];	/*  length of the packed track with its header, 0 if not packed  */
+#ifdef _WIN32
+	LONG next;
+#else
+	USHORT next;		/*  next track to pack  */
+	pthread_mutex_t lock;
+#endif
+};
+
+
+static USHORT Pack_Track(struct PACK_WORK *, UCHAR *, USHORT, USHORT, UCHAR, UCHAR *);
+static USHORT Next_Track(struct PACK_JOB *);
+static void Pack_Tracks(struct PACK_JOB *);
+static void put_word(UCHAR *, USHORT);
+static void put_long(UCHAR *, ULONG);
+
+
+
+static void put_word(UCHAR *b, USHORT v){
+	b[0] = (UCHAR)(v >> 8);
+	b[1] = (UCHAR)v;
+}
+
+
+
+static void put_long(UCHAR *b, ULONG v){
+	put_word(b, (USHORT)(v >> 16));
+	put_word(b+2, (USHORT)v);
+}
+
+
+
+/*  Packs a track and writes its header before it, in out.  */
+/*  Returns the length written.                             */
+
+static USHORT Pack_Track(struct PACK_WORK *w, UCHAR *in, USHORT number, USHORT unpklen, UCHAR cmode, UCHAR *out){
+	USHORT pklen1, pklen2, rlelen;
+	UCHAR flags, *data, *src;
+
+	data = out+THLEN;
+	pklen1 = 0;
+	pklen2 = rlelen = (USHORT)(cmode ? Pack_RLE(in, w->rle, unpklen, TRACK_BUFFER_LEN) : 0);
+
+	/*  the flags are cleared : the decrunchers are reset after each track  */
+	flags = 0;
+	switch (cmode) {
+		case 1:
+			break;
+		case 2:
+			if (!pklen2) break;
+			lz_parse(&w->lz, w->rle, pklen2, 2, 5, 256, 32);
+			pklen1 = Pack_QUICK(&w->lz, data, (USHORT)(unpklen-1));
+			break;
+		case 3:
+			if (!pklen2) break;
+			lz_parse(&w->lz, w->rle, pklen2, 3, 66, 0x4000, 128);
+			pklen1 = Pack_MEDIUM(&w->lz, data, (USHORT)(unpklen-1));
+			break;
+		case 5:
+		case 6:
+			/*  new tables with each track, RLE only if it helps  */
+			flags = 2;
+			src = in;
+			if (pklen2 && (pklen2 < unpklen)) {
+				flags |= 4;
+				src = w->rle;
+			} else
+				pklen2 = unpklen;
+			lz_parse(&w->lz, src, pklen2, 3, 256, (cmode == 5) ? 0x1000 : 0x2000, 128);
+			pklen1 = Pack_HEAVY(&w->lz, data, (USHORT)(unpklen-1), (USHORT)((cmode == 5) ? 14 : 15));
+			break;
+	}
+
+	/*  the RLE alone when it is smaller, as with mostly empty tracks,  */
+	/*  and stored as it is when nothing helps                         */
+	if (rlelen && (rlelen < unpklen) && (!pklen1 || (rlelen <= pklen1))) {
+		cmode = 1;
+		flags = 0;
+		memcpy(data, w->rle, (size_t)rlelen);
+		pklen1 = pklen2 = rlelen;
+	} else if (!pklen1) {
+		cmode = 0;
+		flags = 0;
+		memcpy(data, in, (size_t)unpklen);
+		pklen1 = pklen2 = unpklen;
+	}
+
+	memset(out, 0, THLEN);
+	out[0] = 'T';
+	out[1] = 'R';
+	put_word(out+2, number);
+	put_word(out+6, pklen1);
+	put_word(out+8, pklen2);
+	put_word(out+10, unpklen);
+	out[12] = flags;
+	out[13] = cmode;
+	put_word(out+14, Calc_CheckSum(in, (ULONG)unpklen));
+	put_word(out+16, CreateCRC(data, (ULONG)pklen1));
+	put_word(out+18, CreateCRC(out, (ULONG)(THLEN-2)));
+
+	return (USHORT)(THLEN+pklen1);
+}
+
+
+
+static USHORT Next_Track(struct PACK_JOB *job){
+	USHORT i;
+
+#ifdef _WIN32
+	i = (USHORT)(InterlockedIncrement(&job->next) - 1);
+#else
+	pthread_mutex_lock(&job->lock);
+	i = job->next++;
+	pthread_mutex_unlock(&job->lock);
+#endif
+	return i;
+}
+
+
+
+/*  Run by each thread, until there is no track left  */
+
+static void Pack_Tracks(struct PACK_JOB *job){
+	struct PACK_WORK *w;
+	USHORT i;
+
+	w = (struct PACK_WORK *)malloc(sizeof(struct PACK_WORK));
+	if (!w) return;
+	while ((i = Next_Track(job)) < job->ntracks)
+		job->len[i] = Pack_Track(w, job->img + (ULONG)i*job->tracklen, i, job->tracklen, job->cmode,
+			job->out + (ULONG)i*(THLEN+TRACK_BUFFER_LEN));
+	free(w);
+}
+
+
+
+#ifdef _WIN32
+static unsigned __stdcall Pack_Thread(void *job){
+	Pack_Tracks((struct PACK_JOB *)job);
+	return 0;
+}
+#else
+static void *Pack_Thread(void *job){
+	Pack_Tracks((struct PACK_JOB *)job);
+	return NULL;
+}
+#endif
+
+
+
+/*  cmode : 0 NOCOMP, 1 SIMPLE, 2 QUICK, 3 MEDIUM, 5 HEAVY1 or 6 HEAVY2.           */
+/*  The image is a double density disk, or a part of it, or a high density one.  */
+/*  nthreads : 0 for PACK_THREADS                                                 */
+
+USHORT Pack_Image(UCHAR *img, ULONG size, char *oname, USHORT cmode, USHORT nthreads){
+	struct PACK_JOB *job;
+	UCHAR head[HEADLEN];
+	ULONG pkfsize;
+	USHORT i, nstarted, ret;
+	FILE *fo;
+#ifdef _WIN32
+	HANDLE threads[MAX_TRACKS];
+#else
+	pthread_t threads[MAX_TRACKS];
+#endif
+
+	if ((cmode > 6) || (cmode == 4)) return ERR_UNKNMODE;
+
+	job = (struct PACK_JOB *)calloc(1, sizeof(struct PACK_JOB));
+	if (!job) return ERR_NOMEMORY;
+	job->tracklen = (USHORT)((size > MAX_TRACKS*DD_TRACKLEN) ? 2*DD_TRACKLEN : DD_TRACKLEN);
+	if ((size == 0) || (size % job->tracklen) || (size / job->tracklen > MAX_TRACKS)) {
+		free(job);
+		return ERR_IMGSIZE;
+	}
+	job->ntracks = (USHORT)(size / job->tracklen);
+	job->img = img;
+	job->cmode = (UCHAR)cmode;
+	job->out = (UCHAR *)malloc((size_t)job->ntracks*(THLEN+TRACK_BUFFER_LEN));
+	if (!job->out) {
+		free(job);
+		return ERR_NOMEMORY;
+	}
+
+	/*  the calling thread packs tracks too, so it works with no thread started  */
+	if (!nthreads) nthreads = PACK_THREADS;
+	if (nthreads > job->ntracks) nthreads = job->ntracks;
+	nstarted = 0;
+#ifdef _WIN32
+	while (nstarted < nthreads-1) {
+		threads[nstarted] = (HANDLE)_beginthreadex(NULL, 0, Pack_Thread, job, 0, NULL);
+		if (!threads[nstarted]) break;
+		nstarted++;
+	}
+	Pack_Tracks(job);
+	for (i=0; i<nstarted; i++) {
+		WaitForSingleObject(threads[i], INFINITE);
+		CloseHandle(threads[i]);
+	}
+#else
+	pthread_mutex_init(&job->lock, NULL);
+	while (nstarted < nthreads-1) {
+		if (pthread_create(&threads[nstarted], NULL, Pack_Thread, job) != 0) break;
+		nstarted++;
+	}
+	Pack_Tracks(job);
+	for (i=0; i<nstarted; i++) pthread_join(threads[i], NULL);
+	pthread_mutex_destroy(&job->lock);
+#endif
+
+	ret = NO_PROBLEM;
+	pkfsize = 0;
+	for (i=0; i<job->ntracks; i++) {
+		if (!job->len[i]) ret = ERR_NOMEMORY;
+		pkfsize += job->len[i]-THLEN;
+	}
+
+	if (ret == NO_PROBLEM) {
+		memset(head, 0, HEADLEN);
+		memcpy(head, "DMS!PRO ", 8);
+		put_word(head+10, (USHORT)((job->tracklen > DD_TRACKLEN) ? 16 : 0));	/*  16 : high density  */
+		put_long(head+12, (ULONG)time(NULL));
+		put_word(head+16, 0);
+		put_word(head+18, (USHORT)(job->ntracks-1));
+		put_long(head+20, pkfsize);
+		put_long(head+24, size);
+		put_word(head+46, 111);		/*  same as DMS 1.11  */
+		/*  1 + the type of the dos boot block  */
+		if ((img[0] == 'D') && (img[1] == 'O') && (img[2] == 'S') && (img[3] < 6))
+			put_word(head+50, (USHORT)(img[3]+1));
+		put_word(head+52, cmode);
+		put_word(head+54, CreateCRC(head+4, (ULONG)(HEADLEN-6)));
+
+		fo = fopen(oname, "wb");
+		if (!fo)
+			ret = ERR_CANTOPENOUT;
+		else {
+			if (fwrite(head, 1, HEADLEN, fo) != HEADLEN) ret = ERR_CANTWRITE;
+			for (i=0; (i<job->ntracks) && (ret == NO_PROBLEM); i++)
+				if (fwrite(job->out + (ULONG)i*(THLEN+TRACK_BUFFER_LEN), 1, (size_t)job->len[i], fo) != job->len[i])
+					ret = ERR_CANTWRITE;
+			if (fclose(fo) != 0) ret = ERR_CANTWRITE;
+		}
+	}
+
+	free(job->out);
+	free(job);
+
+	return ret;
+}
+
+
+
+USHORT Pack_File(char *iname, char *oname, USHORT cmode, USHORT nthreads){
+	FILE *fi;
+	UCHAR *img;
+	long size;
+	USHORT ret;
+
+	fi = fopen(iname, "rb");
+	if (!fi) return ERR_CANTOPENIN;
+	fseek(fi, 0, SEEK_END);
+	size = ftell(fi);
+	fseek(fi, 0, SEEK_SET);
+	if ((size <= 0) || (size > 2*MAX_TRACKS*DD_TRACKLEN)) {
+		fclose(fi);
+		return ERR_IMGSIZE;
+	}
+	img = (UCHAR *)malloc((size_t)size);
+	if (!img) {
+		fclose(fi);
+		return ERR_NOMEMORY;
+	}
+	if (fread(img, 1, (size_t)size, fi) != (size_t)size) {
+		fclose(fi);
+		free(img);
+		return ERR_SREAD;
+	}
+	fclose(fi);
+
+	ret = Pack_Image(img, (ULONG)size, oname, cmode, nthreads);
+	free(img);
+
+	return ret;
+}
@@ -0,0 +1,11 @@
+#ifndef WFILE_H
+#define WFILE_H
+
+/* Tracks packed at the same time when no number is given */
+#define PACK_THREADS 4
+
+
+USHORT Pack_File(char *, char *, USHORT, USHORT);
+USHORT Pack_Image(UCHAR *, ULONG, char *, USHORT, USHORT);
+
+#endif /* ndef WFILE_H */
@@ -14,6 +14,7 @@
 //#include "Xdms.h"
 #include "cdata.h"
 #include "pfile.h"
+#include "wfile.h"
 #include "crc_csum.h"
 
 
@@ -22,6 +23,24 @@ int dmsUnpack(char *src, char *dest)
 	return Process_File(src, dest, 0, 0, 0);
 }
 
+/* unpacks every track in memory and checks it, nothing is written */
+int dmsVerify(char *src)
+{
+	return Process_File(src, NULL, 0, 0, 0);
+}
+
+/* the header and the track list, without unpacking the disk */
+int dmsScan(char *src, struct DMS_Info *info)
+{
+	return Scan_File(src, info);
+}
+
+/* mode : 1 SIMPLE, 2 QUICK, 3 MEDIUM, 5 HEAVY1, 6 HEAVY2 */
+int dmsPack(char *src, char *dest, int mode)
+{
+	return Pack_File(src, dest, (USHORT)mode, 0);
+}
+
 static void dmsErrMsg(USHORT err, char *i, char *o, char *errMess)
 {
 	switch (err) {
@@ -83,6 +102,9 @@ static void dmsErrMsg(USHORT err, char *i, char *o, char *errMess)
 		case ERR_FMS:
 			sprintf(errMess,"Error in file %s : this file is not really a compressed disk image, but an FMS archive !\n",i);
 			break;
+		case ERR_IMGSIZE:
+			sprintf(errMess,"File %s is not a floppy disk image !\n",i);
+			break;
 		default:
 			sprintf(errMess,"Error while processing file  %s : internal error !\n",i);
 			sprintf(errMess,"This is a bug in xDMS\n");
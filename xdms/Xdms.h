@@ -4,6 +4,9 @@
 #include "pfile.h"
 
 int dmsUnpack(char *, char *);
+int dmsVerify(char *);
+int dmsScan(char *, struct DMS_Info *);
+int dmsPack(char *, char *, int);
 static void dmsErrMsg(USHORT err, char *i, char *o, char *errMess);
 
 #endif
@@ -24,6 +24,14 @@
 #define ULONG unsigned long
 #endif
 
+#ifndef UQUAD
+	#ifdef _MSC_VER
+		#define UQUAD unsigned __int64
+	#else
+		#define UQUAD unsigned long long
+	#endif
+#endif
+
 
 
 #ifndef INLINE
@@ -1,9 +1,15 @@
 
-extern ULONG mask_bits[], bitbuf;
+extern UQUAD bitbuf;
 extern UCHAR *indata, bitcount;
 
-#define GETBITS(n) ((USHORT)(bitbuf >> (bitcount-(n))))
-#define DROPBITS(n) {bitbuf &= mask_bits[bitcount-=(n)]; while (bitcount<16) {bitbuf = (bitbuf << 8) | *indata++;  bitcount += 8;}}
+/*  bitbuf holds bitcount bits, from its top bit. After DROPBITS there are at least 32,  */
+/*  refilled 32 bits at once, so GETBITS can return up to 16 bits without testing bitcount  */
+
+#define BITBUF_PAD 8	/*  bytes that may be read past the end of the packed data  */
+
+#define GETBITS(n) ((USHORT)((bitbuf >> 1) >> (63-(n))))
+#define DROPBITS(n) {bitbuf <<= (n); bitcount -= (n); if (bitcount<32) REFILLBITS;}
+#define REFILLBITS {bitbuf |= ((UQUAD)(((ULONG)indata[0]<<24) | ((ULONG)indata[1]<<16) | ((ULONG)indata[2]<<8) | (ULONG)indata[3])) << (32-bitcount);  indata += 4;  bitcount += 32;}
 
 
 void initbitbuf(UCHAR *);
@@ -0,0 +1,71 @@
+/*
+ *     xDMS  v1.3  -  Portable DMS archive unpacker  -  Public Domain
+ *
+ *     Copy of the matches of the LZ decompression modes. The output of
+ *     a track is its own history : the ring buffer text[] is only read
+ *     for the bytes of the previous tracks, and written once at the end
+ *
+ */
+
+
+#include <string.h>
+
+#include "cdata.h"
+#include "lzcopy.h"
+
+
+
+/*  Copies len bytes from dist bytes before out (1 to mask+1). start is the  */
+/*  beginning of the output of the track, at the position loc of the ring   */
+
+UCHAR *lz_copy(UCHAR *out, UCHAR *start, USHORT loc, USHORT mask, USHORT dist, USHORT len){
+	USHORT i;
+
+	/*  from the previous tracks  */
+	if (dist > out-start) {
+		i = (USHORT)(loc + (out-start) - dist);
+		while (len && dist > out-start) {
+			*out++ = text[i++ & mask];
+			len--;
+		}
+	}
+
+	if (dist == 1) {
+		memset(out, out[-1], (size_t)len);
+		return out+len;
+	}
+	/*  overlapping : dist bytes at once  */
+	while (len > dist) {
+		memcpy(out, out-dist, (size_t)dist);
+		out += dist;
+		len = (USHORT)(len - dist);
+	}
+	memcpy(out, out-dist, (size_t)len);
+
+	return out+len;
+}
+
+
+
+/*  Writes the end of the output of the track in the ring, */
+/*  returns the position after it                           */
+
+USHORT lz_sync(UCHAR *out, UCHAR *start, USHORT loc, USHORT mask){
+	ULONG n, k, size;
+
+	n = (ULONG)(out-start);
+	size = (ULONG)mask+1;
+	loc = (USHORT)(loc+n);
+	if (n > size) {
+		start = out-size;
+		n = size;
+	}
+	k = size - ((USHORT)(loc-n) & mask);
+	if (k > n) k = n;
+	memcpy(text + ((USHORT)(loc-n) & mask), start, (size_t)k);
+	memcpy(text, start+k, (size_t)(n-k));
+
+	return loc;
+}
+
+
@@ -0,0 +1,4 @@
+
+UCHAR *lz_copy(UCHAR *out, UCHAR *start, USHORT loc, USHORT mask, USHORT dist, USHORT len);
+USHORT lz_sync(UCHAR *out, UCHAR *start, USHORT loc, USHORT mask);
+
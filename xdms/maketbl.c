@@ -90,3 +90,38 @@ static USHORT mktbl(void){
 }
 
 
+
+/*  Makes the subtables of the codes longer than tablebits, after make_table() :  */
+/*  the node table[i] >= nchar of the tree is resolved by the next 16-tablebits   */
+/*  bits, at sub[(table[i]-nchar) << (16-tablebits)]. So any code up to 16 bits   */
+/*  is found with 2 lookups. Returns 1 if a code is longer, the tree is used then. */
+
+USHORT make_wide_table(USHORT nchar, UCHAR bitlen[], USHORT tablebits, USHORT table[], USHORT sub[]){
+	ULONG start[18], code;
+	USHORT i, k, l, subbits;
+
+	for (i=1; i<=17; i++) start[i] = 0;
+	for (i=0; i<nchar; i++) {
+		if (bitlen[i] > 16) return 1;
+		start[bitlen[i]+1] += 1UL << (16-bitlen[i]);
+	}
+	start[0] = start[1] = 0;
+	for (i=2; i<=17; i++) start[i] += start[i-1];
+
+	/*  the codes in the order of make_table() : by length, then by symbol  */
+	subbits = (USHORT)(16-tablebits);
+	for (i=0; i<nchar; i++) {
+		l = bitlen[i];
+		if (l == 0) continue;
+		code = start[l];
+		start[l] += 1UL << (16-l);
+		if (l <= tablebits) continue;
+		k = (USHORT)(((table[code >> subbits] - nchar) << subbits) | (code & ((1UL << subbits) - 1)));
+		for (code = 1UL << (16-l); code--; ) sub[k++] = i;
+	}
+
+	return 0;
+}
+
+
+
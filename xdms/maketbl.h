@@ -2,4 +2,5 @@
 extern USHORT left[], right[];
 
 USHORT make_table(USHORT nchar, UCHAR bitlen[], USHORT tablebits, USHORT table[]);
+USHORT make_wide_table(USHORT nchar, UCHAR bitlen[], USHORT tablebits, USHORT table[], USHORT sub[]);
 
@@ -0,0 +1,210 @@
+
+/*
+ *     xDMS  v1.3  -  Portable DMS archive unpacker  -  Public Domain
+ *
+ *     Lempel-Ziv-Huffman packing function of Heavy 1 & 2 modes,
+ *     read back by Unpack_HEAVY. The tables are sent with each track
+ *
+ */
+
+
+#include <stdlib.h>
+
+#include "cdata.h"
+#include "pfile.h"
+#include "p_lz.h"
+#include "p_heavy.h"
+#include "putbits.h"
+
+
+#define NC 510
+#define NPT 20
+#define OFFSET 253
+#define CBITS 16	/*  longest codes allowed  */
+#define PBITS 15	/*  their lengths are written on 4 bits  */
+
+
+static USHORT pos_code(USHORT);
+static int cmp_weight(const void *, const void *);
+static void make_len(USHORT, ULONG *, USHORT, UCHAR *);
+static void make_code(USHORT, UCHAR *, USHORT, USHORT *);
+static void put_tree(struct PUTBITS *, USHORT, UCHAR *, USHORT, USHORT, USHORT);
+
+
+
+/*  position code of a distance-1  */
+
+static USHORT pos_code(USHORT v){
+	USHORT j;
+
+	for (j=0; v >> j; j++) ;
+	return j;
+}
+
+
+
+static int cmp_weight(const void *a, const void *b){
+	ULONG x = *(const ULONG *)a, y = *(const ULONG *)b;
+
+	return (x < y) ? -1 : (x > y);
+}
+
+
+
+/*  Huffman code lengths of at most maxbits bits. They are all 0  */
+/*  if less than 2 symbols are used                               */
+
+static void make_len(USHORT n, ULONG *freq, USHORT maxbits, UCHAR *len){
+	ULONG w[2*NC], sym[NC], cum;
+	USHORT parent[2*NC], depth[2*NC], cnt[CBITS+1];
+	USHORT m, i, j, k, a, b, l;
+
+	/*  weight in the high bits, symbol in the low ones : sorted by weight  */
+	m = 0;
+	for (i=0; i<n; i++) {
+		len[i] = 0;
+		if (freq[i]) sym[m++] = (freq[i] << 16) | i;
+	}
+	if (m < 2) return;
+	qsort(sym, (size_t)m, sizeof(ULONG), cmp_weight);
+	for (i=0; i<m; i++) w[i] = sym[i] >> 16;
+
+	/*  leaves and nodes are both taken in increasing weights  */
+	i = 0;
+	j = m;
+	for (k=m; k<2*m-1; k++) {
+		a = ((i < m) && ((j >= k) || (w[i] <= w[j]))) ? i++ : j++;
+		b = ((i < m) && ((j >= k) || (w[i] <= w[j]))) ? i++ : j++;
+		w[k] = w[a] + w[b];
+		parent[a] = parent[b] = k;
+	}
+	depth[2*m-2] = 0;
+	for (k=(USHORT)(2*m-2); k--; ) depth[k] = (USHORT)(depth[parent[k]] + 1);
+
+	/*  too long codes are shortened, keeping the code complete  */
+	for (l=0; l<=maxbits; l++) cnt[l] = 0;
+	for (i=0; i<m; i++) cnt[(depth[i] > maxbits) ? maxbits : depth[i]]++;
+	cum = 0;
+	for (l=1; l<=maxbits; l++) cum += (ULONG)cnt[l] << (maxbits-l);
+	while (cum > (1UL << maxbits)) {
+		cnt[maxbits]--;
+		for (l=(USHORT)(maxbits-1); l>0; l--)
+			if (cnt[l]) {
+				cnt[l]--;
+				cnt[l+1] += 2;
+				break;
+			}
+		cum--;
+	}
+
+	/*  the longest codes to the least used symbols  */
+	i = 0;
+	for (l=maxbits; l>0; l--)
+		for (k=cnt[l]; k--; )
+			len[sym[i++] & 0xffff] = (UCHAR)l;
+}
+
+
+
+/*  Same codes as make_table() : by length, then by symbol. The unused  */
+/*  symbols, and the only one used, are written on 0 bits               */
+
+static void make_code(USHORT n, UCHAR *len, USHORT maxbits, USHORT *code){
+	USHORT i, l, c;
+
+	for (i=0; i<n; i++) code[i] = 0;
+	c = 0;
+	for (l=1; l<=maxbits; l++) {
+		for (i=0; i<n; i++)
+			if (len[i] == l) code[i] = c++;
+		c <<= 1;
+	}
+}
+
+
+
+/*  The number of lengths and the lengths, or 0 and the only symbol used  */
+
+static void put_tree(struct PUTBITS *pb, USHORT n, UCHAR *len, USHORT nbits, USHORT lbits, USHORT only){
+	USHORT i;
+
+	while (n && !len[n-1]) n--;
+	PUTBITS(pb, nbits, n);
+	if (!n) {
+		PUTBITS(pb, nbits, only);
+		return;
+	}
+	for (i=0; i<n; i++) PUTBITS(pb, lbits, len[i]);
+}
+
+
+
+/*  np : 14 for Heavy 1 and its 4Kb dictionary, 15 for Heavy 2 and 8Kb.  */
+/*  The last position code repeats the distance of the previous match     */
+
+USHORT Pack_HEAVY(struct LZ_STATE *s, UCHAR *out, USHORT max, USHORT np){
+	struct PUTBITS pb;
+	ULONG c_freq[NC], p_freq[NPT];
+	USHORT c_code[NC], p_code[NPT];
+	UCHAR c_len[NC], p_len[NPT], *in;
+	USHORT i, c, j, v, last, c_only, p_only;
+
+	for (i=0; i<NC; i++) c_freq[i] = 0;
+	for (i=0; i<np; i++) p_freq[i] = 0;
+	in = s->in;
+	last = 0xffff;
+	c_only = p_only = 0;
+	for (i=0; i<s->ntok; i++) {
+		if (!s->len[i]) {
+			c_only = *in++;
+			c_freq[c_only]++;
+			continue;
+		}
+		c_only = (USHORT)(s->len[i] + OFFSET);
+		c_freq[c_only]++;
+		in += s->len[i];
+		v = (USHORT)(s->dist[i]-1);
+		if (v == last) {
+			p_freq[np-1]++;
+			continue;
+		}
+		j = pos_code(v);
+		p_freq[j]++;
+		p_only = j;
+		last = v;
+	}
+
+	make_len(NC, c_freq, CBITS, c_len);
+	make_code(NC, c_len, CBITS, c_code);
+	make_len(np, p_freq, PBITS, p_len);
+	make_code(np, p_len, PBITS, p_code);
+
+	initputbits(&pb, out, max);
+	put_tree(&pb, NC, c_len, 9, 5, c_only);
+	put_tree(&pb, np, p_len, 5, 4, p_only);
+
+	in = s->in;
+	last = 0xffff;
+	for (i=0; i<s->ntok; i++) {
+		if (!s->len[i]) {
+			c = *in++;
+			PUTBITS(&pb, c_len[c], c_code[c]);
+		} else {
+			c = (USHORT)(s->len[i] + OFFSET);
+			PUTBITS(&pb, c_len[c], c_code[c]);
+			in += s->len[i];
+			v = (USHORT)(s->dist[i]-1);
+			if (v == last) {
+				PUTBITS(&pb, p_len[np-1], p_code[np-1]);
+			} else {
+				/*  the number of bits of the distance, then the bits after the top one  */
+				j = pos_code(v);
+				PUTBITS(&pb, p_len[j], p_code[j]);
+				if (j > 1) PUTBITS(&pb, j-1, v & ((1U << (j-1)) - 1));
+				last = v;
+			}
+		}
+		if (pb.full) return 0;
+	}
+	return flushputbits(&pb, out);
+}
@@ -0,0 +1,2 @@
+
+USHORT Pack_HEAVY(struct LZ_STATE *, UCHAR *, USHORT, USHORT);
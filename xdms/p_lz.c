@@ -0,0 +1,156 @@
+
+/*
+ *     xDMS  v1.3  -  Portable DMS archive unpacker  -  Public Domain
+ *
+ *     Match finder of the LZ packing modes, and the packing functions
+ *     of QUICK and MEDIUM modes, read back by Unpack_QUICK and Unpack_MEDIUM
+ *
+ */
+
+
+#include <string.h>
+
+#include "cdata.h"
+#include "pfile.h"
+#include "p_lz.h"
+#include "putbits.h"
+#include "tables.h"
+
+
+#define LZ_NIL 0xffff
+
+/*  2 bytes for QUICK, where a match of 2 bytes is shorter than 2 literals  */
+#define HASH(in,p,min) ((min == 2) ? (USHORT)((in[p] << 8) | in[(p)+1]) : \
+	(USHORT)((in[p] << 8) ^ (in[(p)+1] << 4) ^ in[(p)+2] ^ (in[(p)+2] << 12)))
+
+
+static USHORT lz_find(struct LZ_STATE *, USHORT, USHORT, USHORT, USHORT, USHORT, USHORT *);
+
+
+
+/*  Longest match of at most maxlen bytes, at most maxdist bytes before pos.  */
+/*  Matches never reach the previous tracks, so the tracks can be unpacked   */
+/*  alone, and packed in any order                                           */
+
+static USHORT lz_find(struct LZ_STATE *s, USHORT pos, USHORT minlen, USHORT maxlen, USHORT maxdist, USHORT chain, USHORT *dist){
+	USHORT p, l, best;
+	UCHAR *in;
+
+	if (pos+minlen > s->size) return 0;
+	if (maxlen > s->size-pos) maxlen = (USHORT)(s->size-pos);
+	in = s->in;
+	best = 0;
+	for (p = s->head[HASH(in,pos,minlen)]; (p != LZ_NIL) && (pos-p <= maxdist) && chain--; p = s->prev[p]) {
+		if (in[p+best] != in[pos+best]) continue;
+		for (l=0; (l < maxlen) && (in[p+l] == in[pos+l]); l++) ;
+		if (l > best) {
+			best = l;
+			*dist = (USHORT)(pos-p);
+			if (l == maxlen) break;
+		}
+	}
+	return (USHORT)((best >= minlen) ? best : 0);
+}
+
+
+
+#define INSERT(s,pos,min) if ((pos)+(min) <= (s)->size) { \
+	h = HASH((s)->in,pos,min);  (s)->prev[pos] = (s)->head[h];  (s)->head[h] = (pos); }
+
+
+/*  Splits a track in literals and matches. A match is kept only if the next  */
+/*  byte does not start a longer one                                           */
+
+void lz_parse(struct LZ_STATE *s, UCHAR *in, USHORT size, USHORT minlen, USHORT maxlen, USHORT maxdist, USHORT chain){
+	USHORT pos, len, dist, nlen, ndist, i, h, n;
+
+	s->in = in;
+	s->size = size;
+	memset(s->head, 0xff, sizeof(s->head));
+
+	n = 0;
+	pos = 0;
+	dist = 0;
+	len = lz_find(s, 0, minlen, maxlen, maxdist, chain, &dist);
+	while (pos < size) {
+		INSERT(s, pos, minlen);
+		if (len) {
+			nlen = lz_find(s, (USHORT)(pos+1), minlen, maxlen, maxdist, chain, &ndist);
+			if (nlen > len) {
+				s->len[n++] = 0;
+				pos++;
+				len = nlen;
+				dist = ndist;
+				continue;
+			}
+			s->len[n] = len;
+			s->dist[n++] = dist;
+			for (i=1; i<len; i++) INSERT(s, (USHORT)(pos+i), minlen);
+			pos = (USHORT)(pos+len);
+		} else {
+			s->len[n++] = 0;
+			pos++;
+		}
+		len = lz_find(s, pos, minlen, maxlen, maxdist, chain, &dist);
+	}
+	s->ntok = n;
+}
+
+
+
+/*  1 and a byte, or 0, the length-2 on 2 bits and the distance-1 on 8 bits  */
+
+USHORT Pack_QUICK(struct LZ_STATE *s, UCHAR *out, USHORT max){
+	struct PUTBITS pb;
+	USHORT i;
+	UCHAR *in;
+
+	initputbits(&pb, out, max);
+	in = s->in;
+	for (i=0; i<s->ntok; i++) {
+		if (!s->len[i]) {
+			PUTBITS(&pb, 9, 0x100 | *in);
+			in++;
+		} else {
+			PUTBITS(&pb, 11, ((s->len[i]-2) << 8) | (s->dist[i]-1));
+			in += s->len[i];
+		}
+		if (pb.full) return 0;
+	}
+	return flushputbits(&pb, out);
+}
+
+
+
+/*  1 and a byte, or 0, the codes of the length-3 and of the 6 high bits of  */
+/*  the distance-1 from d_code[] and d_len[], and its 8 low bits              */
+
+USHORT Pack_MEDIUM(struct LZ_STATE *s, UCHAR *out, USHORT max){
+	struct PUTBITS pb;
+	USHORT i, c, v;
+	UCHAR p_len[64], p_code[64], *in;
+
+	/*  the codes are the first bits of the bytes that d_code[] maps to the value  */
+	for (c=256; c--; ) {
+		p_len[d_code[c]] = d_len[c];
+		p_code[d_code[c]] = (UCHAR)(c >> (8-d_len[c]));
+	}
+
+	initputbits(&pb, out, max);
+	in = s->in;
+	for (i=0; i<s->ntok; i++) {
+		if (!s->len[i]) {
+			PUTBITS(&pb, 9, 0x100 | *in);
+			in++;
+		} else {
+			c = (USHORT)(s->len[i]-3);
+			v = (USHORT)(s->dist[i]-1);
+			PUTBITS(&pb, 1+p_len[c], p_code[c]);
+			PUTBITS(&pb, p_len[v >> 8], p_code[v >> 8]);
+			PUTBITS(&pb, 8, v & 0xff);
+			in += s->len[i];
+		}
+		if (pb.full) return 0;
+	}
+	return flushputbits(&pb, out);
+}
@@ -0,0 +1,18 @@
+
+/*  Matches of a track for the LZ packing modes. Everything is in the  */
+/*  structure, one for each thread packing tracks                       */
+
+struct LZ_STATE {
+	UCHAR *in;
+	USHORT size;
+	USHORT ntok;		/*  tokens found by lz_parse()  */
+	USHORT head[65536];	/*  last position of each hash  */
+	USHORT prev[TRACK_BUFFER_LEN];	/*  previous position with the same hash  */
+	USHORT len[TRACK_BUFFER_LEN];	/*  0 : a literal  */
+	USHORT dist[TRACK_BUFFER_LEN];	/*  1 : the previous byte  */
+};
+
+
+void lz_parse(struct LZ_STATE *, UCHAR *, USHORT, USHORT, USHORT, USHORT, USHORT);
+USHORT Pack_QUICK(struct LZ_STATE *, UCHAR *, USHORT);
+USHORT Pack_MEDIUM(struct LZ_STATE *, UCHAR *, USHORT);
@@ -0,0 +1,51 @@
+
+/*
+ *     xDMS  v1.3  -  Portable DMS archive unpacker  -  Public Domain
+ *
+ *     Run Length Encoding, read back by Unpack_RLE
+ *
+ */
+
+#include "cdata.h"
+#include "p_rle.h"
+
+
+
+/*  Returns the packed length, 0 if it is more than max  */
+
+USHORT Pack_RLE(UCHAR *in, UCHAR *out, USHORT size, USHORT max){
+	USHORT n;
+	UCHAR a, *inend, *outstart, *outend;
+
+	inend = in+size;
+	outstart = out;
+	outend = out+max;
+	while (in < inend) {
+		a = *in;
+		for (n=1; (in+n < inend) && (in[n] == a) && (n < 0xffff); n++) ;
+		if ((n > 3) || ((a == 0x90) && (n > 1))) {
+			/*  0x90, count, byte. A count of 0xff is followed by the real one on 16 bits  */
+			if (out+((n < 0xff) ? 3 : 5) > outend) return 0;
+			*out++ = 0x90;
+			if (n < 0xff) {
+				*out++ = (UCHAR)n;
+				*out++ = a;
+			} else {
+				*out++ = 0xff;
+				*out++ = a;
+				*out++ = (UCHAR)(n >> 8);
+				*out++ = (UCHAR)n;
+			}
+			in += n;
+		} else if (a == 0x90) {
+			if (out+2 > outend) return 0;
+			*out++ = 0x90;
+			*out++ = 0;
+			in++;
+		} else {
+			if (out+n > outend) return 0;
+			while (n--) *out++ = *in++;
+		}
+	}
+	return (USHORT)(out-outstart);
+}
@@ -0,0 +1,2 @@
+
+USHORT Pack_RLE(UCHAR *, UCHAR *, USHORT, USHORT);
@@ -0,0 +1,31 @@
+
+/*
+ *     xDMS  v1.3  -  Portable DMS archive unpacker  -  Public Domain
+ *
+ *     Functions/macros to put a variable number of bits
+ *
+ */
+
+#include "cdata.h"
+#include "putbits.h"
+
+
+
+void initputbits(struct PUTBITS *p, UCHAR *out, USHORT max){
+	p->out = out;
+	p->end = out+max;
+	p->bitbuf = 0;
+	p->bitcount = 0;
+	p->full = 0;
+}
+
+
+
+/*  Writes the last bits, completed with zeros. Returns the length written  */
+/*  from out, 0 if it did not fit                                           */
+
+USHORT flushputbits(struct PUTBITS *p, UCHAR *out){
+	if (p->bitcount) PUTBITS(p, 8-p->bitcount, 0);
+	if (p->full) return 0;
+	return (USHORT)(p->out - out);
+}
@@ -0,0 +1,21 @@
+
+/*  Bits written from the top one, the reverse of getbits.h. The state is in the  */
+/*  structure, not in globals, so that several tracks are packed at the same time  */
+
+struct PUTBITS {
+	UCHAR *out, *end;
+	ULONG bitbuf;		/*  the last bitcount bits are not written yet  */
+	USHORT bitcount;
+	USHORT full;		/*  the packed data did not fit in the buffer  */
+};
+
+
+/*  up to 16 bits, v must not have bits above the n low ones  */
+
+#define PUTBITS(p,n,v) {(p)->bitbuf = ((p)->bitbuf << (n)) | (ULONG)(v);  (p)->bitcount += (n);  \
+	while ((p)->bitcount >= 8) {(p)->bitcount -= 8;  \
+		if ((p)->out < (p)->end) *(p)->out++ = (UCHAR)((p)->bitbuf >> (p)->bitcount); else (p)->full = 1;}}
+
+
+void initputbits(struct PUTBITS *, UCHAR *, USHORT);
+USHORT flushputbits(struct PUTBITS *, UCHAR *);
@@ -15,6 +15,7 @@
 #include "tables.h"
 #include "u_deep.h"
 #include "getbits.h"
+#include "lzcopy.h"
 
 
 INLINE USHORT DecodeChar(void);
@@ -73,24 +74,26 @@ void Init_DEEP_Tabs(void){
 
 USHORT Unpack_DEEP(UCHAR *in, UCHAR *out, USHORT origsize){
 	USHORT i, j, c;
-	UCHAR *outend;
+	UCHAR *outstart, *outend;
 
 	initbitbuf(in);
 
 	if (init_deep_tabs) Init_DEEP_Tabs();
 
+	outstart = out;
 	outend = out+origsize;
 	while (out < outend) {
 		c = DecodeChar();
 		if (c < 256) {
-			*out++ = text[deep_text_loc++ & DBITMASK] = (UCHAR)c;
+			*out++ = (UCHAR)c;
 		} else {
 			j = (USHORT) (c - 255 + THRESHOLD);
-			i = (USHORT) (deep_text_loc - DecodePosition() - 1);
-			while (j--) *out++ = text[deep_text_loc++ & DBITMASK] = text[i++ & DBITMASK];
+			i = (USHORT) ((DecodePosition() & DBITMASK) + 1);
+			out = lz_copy(out, outstart, deep_text_loc, DBITMASK, i, j);
 		}
 	}
 
+	deep_text_loc = lz_sync(out, outstart, deep_text_loc, DBITMASK);
 	deep_text_loc = (USHORT)((deep_text_loc+60) & DBITMASK);
 
 	return 0;
@@ -99,17 +102,26 @@ USHORT Unpack_DEEP(UCHAR *in, UCHAR *out, USHORT origsize){
 
 
 INLINE USHORT DecodeChar(void){
-	USHORT c;
+	UQUAD b;
+	USHORT c, n;
 
 	c = son[R];
 
 	/* travel from root to leaf, */
 	/* choosing the smaller child node (son[]) if the read bit is 0, */
 	/* the bigger (son[]+1} if 1 */
+	/* the bits are taken from a copy of bitbuf and dropped once : bitbuf holds */
+	/* at least 32 bits, and no code is longer. The tree keeps its nodes sorted */
+	/* by frequency, so a leaf at depth d needs a root frequency of at least    */
+	/* fibonacci(d+2), and the root never goes over MAX_FREQ : d is 21 at most  */
+	b = bitbuf;
+	n = 0;
 	while (c < T) {
-		c = son[c + GETBITS(1)];
-		DROPBITS(1);
+		c = son[c + (USHORT)(b >> 63)];
+		b <<= 1;
+		n++;
 	}
+	DROPBITS(n);
 	c -= T;
 	update(c);
 	return c;
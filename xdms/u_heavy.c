@@ -14,6 +14,7 @@
 #include "u_heavy.h"
 #include "getbits.h"
 #include "maketbl.h"
+#include "lzcopy.h"
 
 
 #define NC 510
@@ -24,6 +25,8 @@
 USHORT left[2 * NC - 1], right[2 * NC - 1 + 9];
 static UCHAR c_len[NC], pt_len[NPT];
 static USHORT c_table[4096], pt_table[256];
+static USHORT c_sub[NC << 4], pt_sub[NPT << 8];	/*  second lookups, see make_wide_table()  */
+static USHORT c_wide, pt_wide;	/*  pt_wide : np of pt_sub[], 0 if none  */
 static USHORT lastlen, np;
 USHORT heavy_text_loc;
 
@@ -37,7 +40,7 @@ INLINE USHORT decode_p(void);
 
 USHORT Unpack_HEAVY(UCHAR *in, UCHAR *out, UCHAR flags, USHORT origsize){
 	USHORT j, i, c, bitmask;
-	UCHAR *outend;
+	UCHAR *outstart, *outend;
 
 	/*  Heavy 1 uses a 4Kb dictionary,  Heavy 2 uses 8Kb  */
 
@@ -56,18 +59,20 @@ USHORT Unpack_HEAVY(UCHAR *in, UCHAR *out, UCHAR flags, USHORT origsize){
 		if (read_tree_p()) return 2;
 	}
 
+	outstart = out;
 	outend = out+origsize;
 
 	while (out<outend) {
 		c = decode_c();
 		if (c < 256) {
-			*out++ = text[heavy_text_loc++ & bitmask] = (UCHAR)c;
+			*out++ = (UCHAR)c;
 		} else {
 			j = (USHORT) (c - OFFSET);
-			i = (USHORT) (heavy_text_loc - decode_p() - 1);
-			while(j--) *out++ = text[heavy_text_loc++ & bitmask] = text[i++ & bitmask];
+			i = (USHORT) ((decode_p() & bitmask) + 1);
+			out = lz_copy(out, outstart, heavy_text_loc, bitmask, i, j);
 		}
 	}
+	heavy_text_loc = lz_sync(out, outstart, heavy_text_loc, bitmask);
 
 	return 0;
 }
@@ -77,9 +82,13 @@ USHORT Unpack_HEAVY(UCHAR *in, UCHAR *out, UCHAR flags, USHORT origsize){
 INLINE USHORT decode_c(void){
 	USHORT i, j, m;
 
-	j = c_table[GETBITS(12)];
+	i = GETBITS(16);
+	j = c_table[i >> 4];
 	if (j < N1) {
 		DROPBITS(c_len[j]);
+	} else if (c_wide) {
+		j = c_sub[((j - N1) << 4) | (i & 0x0f)];
+		DROPBITS(c_len[j]);
 	} else {
 		DROPBITS(12);
 		i = GETBITS(16);
@@ -99,9 +108,13 @@ INLINE USHORT decode_c(void){
 INLINE USHORT decode_p(void){
 	USHORT i, j, m;
 
-	j = pt_table[GETBITS(8)];
+	i = GETBITS(16);
+	j = pt_table[i >> 8];
 	if (j < np) {
 		DROPBITS(pt_len[j]);
+	} else if (pt_wide == np) {
+		j = pt_sub[((j - np) << 8) | (i & 0xff)];
+		DROPBITS(pt_len[j]);
 	} else {
 		DROPBITS(8);
 		i = GETBITS(16);
@@ -140,11 +153,13 @@ static USHORT read_tree_c(void){
 		}
 		for (i=n; i<510; i++) c_len[i] = 0;
 		if (make_table(510,c_len,12,c_table)) return 1;
+		c_wide = (USHORT)!make_wide_table(510,c_len,12,c_table,c_sub);
 	} else {
 		n = GETBITS(9);
 		DROPBITS(9);
 		for (i=0; i<510; i++) c_len[i] = 0;
 		for (i=0; i<4096; i++) c_table[i] = n;
+		c_wide = 0;
 	}
 	return 0;
 }
@@ -163,11 +178,13 @@ static USHORT read_tree_p(void){
 		}
 		for (i=n; i<np; i++) pt_len[i] = 0;
 		if (make_table(np,pt_len,8,pt_table)) return 1;
+		pt_wide = (USHORT)(make_wide_table(np,pt_len,8,pt_table,pt_sub) ? 0 : np);
 	} else {
 		n = GETBITS(5);
 		DROPBITS(5);
 		for (i=0; i<np; i++) pt_len[i] = 0;
 		for (i=0; i<256; i++) pt_table[i] = n;
+		pt_wide = 0;
 	}
 	return 0;
 }
@@ -14,6 +14,7 @@
 #include "u_medium.h"
 #include "getbits.h"
 #include "tables.h"
+#include "lzcopy.h"
 
 
 #define MBITMASK 0x3fff
@@ -24,17 +25,18 @@ USHORT medium_text_loc;
 
 
 USHORT Unpack_MEDIUM(UCHAR *in, UCHAR *out, USHORT origsize){
-	USHORT i, j, c;
-	UCHAR u, *outend;
+	USHORT j, c;
+	UCHAR u, *outstart, *outend;
 
 
 	initbitbuf(in);
 
+	outstart = out;
 	outend = out+origsize;
 	while (out < outend) {
 		if (GETBITS(1)!=0) {
 			DROPBITS(1);
-			*out++ = text[medium_text_loc++ & MBITMASK] = (UCHAR)GETBITS(8);
+			*out++ = (UCHAR)GETBITS(8);
 			DROPBITS(8);
 		} else {
 			DROPBITS(1);
@@ -44,12 +46,10 @@ USHORT Unpack_MEDIUM(UCHAR *in, UCHAR *out, USHORT origsize){
 			c = (USHORT) (((c << u) | GETBITS(u)) & 0xff);  DROPBITS(u);
 			u = d_len[c];
 			c = (USHORT) ((d_code[c] << 8) | (((c << u) | GETBITS(u)) & 0xff));  DROPBITS(u);
-			i = (USHORT) (medium_text_loc - c - 1);
-
-			while(j--) *out++ = text[medium_text_loc++ & MBITMASK] = text[i++ & MBITMASK];
-			
+			out = lz_copy(out, outstart, medium_text_loc, MBITMASK, (USHORT)((c & MBITMASK) + 1), j);
 		}
 	}
+	medium_text_loc = lz_sync(out, outstart, medium_text_loc, MBITMASK);
 	medium_text_loc = (USHORT)((medium_text_loc+66) & MBITMASK);
 
 	return 0;
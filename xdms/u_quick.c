@@ -12,6 +12,7 @@
 #include "cdata.h"
 #include "u_quick.h"
 #include "getbits.h"
+#include "lzcopy.h"
 
 
 #define QBITMASK 0xff
@@ -21,25 +22,30 @@ USHORT quick_text_loc;
 
 
 USHORT Unpack_QUICK(UCHAR *in, UCHAR *out, USHORT origsize){
-	USHORT i, j;
-	UCHAR *outend;
+	USHORT i, j, c;
+	UCHAR *outstart, *outend, *src;
 
 	initbitbuf(in);
 
+	outstart = out;
 	outend = out+origsize;
 	while (out < outend) {
+		/*  a whole symbol at once : flag and byte, or flag, length and distance  */
 		if (GETBITS(1)!=0) {
-			DROPBITS(1);
-			*out++ = text[quick_text_loc++ & QBITMASK] = (UCHAR)GETBITS(8);  DROPBITS(8);
+			*out++ = (UCHAR)GETBITS(9);  DROPBITS(9);
 		} else {
-			DROPBITS(1);
-			j = (USHORT) (GETBITS(2)+2);  DROPBITS(2);
-			i = (USHORT) (quick_text_loc - GETBITS(8) - 1);  DROPBITS(8);
-			while(j--) {
-				*out++ = text[quick_text_loc++ & QBITMASK] = text[i++ & QBITMASK];
-			}
+			c = GETBITS(11);  DROPBITS(11);
+			j = (USHORT) ((c >> 8) + 2);
+			i = (USHORT) ((c & 0xff) + 1);
+			/*  2 to 5 bytes : a call costs more than the copy  */
+			if (i <= out-outstart) {
+				src = out-i;
+				while (j--) *out++ = *src++;
+			} else
+				out = lz_copy(out, outstart, quick_text_loc, QBITMASK, i, j);
 		}
 	}
+	quick_text_loc = lz_sync(out, outstart, quick_text_loc, QBITMASK);
 	quick_text_loc = (USHORT)((quick_text_loc+5) & QBITMASK);
 
 	return 0;
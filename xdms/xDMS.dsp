@@ -102,6 +102,14 @@ SOURCE=.\Getbits.h
 # End Source File
 # Begin Source File
 
+SOURCE=.\Lzcopy.c
+# End Source File
+# Begin Source File
+
+SOURCE=.\Lzcopy.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\Maketbl.c
 # End Source File
 # Begin Source File
@@ -110,6 +118,30 @@ SOURCE=.\Maketbl.h
 # End Source File
 # Begin Source File
 
+SOURCE=.\P_heavy.c
+# End Source File
+# Begin Source File
+
+SOURCE=.\P_heavy.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\P_lz.c
+# End Source File
+# Begin Source File
+
+SOURCE=.\P_lz.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\P_rle.c
+# End Source File
+# Begin Source File
+
+SOURCE=.\P_rle.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\Pfile.c
 # End Source File
 # Begin Source File
@@ -118,6 +150,14 @@ SOURCE=.\Pfile.h
 # End Source File
 # Begin Source File
 
+SOURCE=.\Putbits.c
+# End Source File
+# Begin Source File
+
+SOURCE=.\Putbits.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\Tables.c
 # End Source File
 # Begin Source File
@@ -174,6 +214,14 @@ SOURCE=.\U_rle.h
 # End Source File
 # Begin Source File
 
+SOURCE=.\Wfile.c
+# End Source File
+# Begin Source File
+
+SOURCE=.\Wfile.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\Xdms.c
 # End Source File
 # Begin Source File